@@ -0,0 +1,108 @@
+#!/bin/bash
+
+# ----------------------------------------------------
+#
+# Runs `test-shared-gl-context-with-fbo` in benchmark
+# mode and writes the results as JSON. When there is no
+# X display (e.g. on the build farm) we start the
+# benchmark under Xvfb. Pass `software` to force Mesa's
+# llvmpipe rasterizer. Pass `instances=1000,10000,100000`
+# to run the instancing stress scene once per count; the
+# results are written to `bench-<count>.json`. Add
+# `lods=4` to give the stress scene levels of detail;
+# the results are then written to `bench-<count>-lods4.json`.
+# Pass `quantize` to render quantized meshes; `-quantized`
+# is added to the name of the output files.
+#
+#   ./benchmark.sh [debug] [software] [quantize] [frames=1000] [warmup=100] [output=bench.json] [instances=1000,10000] [lods=4]
+#
+# ----------------------------------------------------
+
+curr_dir=${PWD}
+base_dir=${curr_dir}/..
+install_dir=${base_dir}/install/
+
+# ----------------------------------------------------
+
+debug_flag=""
+num_frames="1000"
+num_warmup="100"
+output_file="${curr_dir}/bench.json"
+instance_counts=""
+num_lods=""
+bench_flags=""
+is_quantized="n"
+
+# ----------------------------------------------------
+
+for var in "$@"
+do
+    if [ "${var}" = "debug" ] ; then
+        debug_flag="-debug"
+    elif [ "${var}" = "quantize" ] ; then
+        is_quantized="y"
+        bench_flags="${bench_flags} --quantize-meshes"
+    elif [ "${var}" = "software" ] ; then
+        export LIBGL_ALWAYS_SOFTWARE=1
+        export GALLIUM_DRIVER=llvmpipe
+    elif [[ "${var}" == frames=* ]] ; then
+        num_frames="${var#frames=}"
+    elif [[ "${var}" == warmup=* ]] ; then
+        num_warmup="${var#warmup=}"
+    elif [[ "${var}" == output=* ]] ; then
+        output_file="${var#output=}"
+    elif [[ "${var}" == instances=* ]] ; then
+        instance_counts="${var#instances=}"
+    elif [[ "${var}" == lods=* ]] ; then
+        num_lods="${var#lods=}"
+    fi
+done
+
+if [ "${is_quantized}" = "y" ] ; then
+    output_file="${output_file%.json}-quantized.json"
+fi
+
+# ----------------------------------------------------
+
+function run_bench() {
+
+    local bench_cmd="./test-shared-gl-context-with-fbo${debug_flag} --bench --frames=${num_frames} --warmup=${num_warmup} ${bench_flags} $@"
+
+    if [ -z "${DISPLAY}" ] ; then
+        if ! [ -x "$(command -v xvfb-run)" ] ; then
+            echo "No DISPLAY and xvfb-run is not installed."
+            exit 1
+        fi
+        xvfb-run -a -s "-screen 0 1280x720x24" ${bench_cmd}
+    else
+        ${bench_cmd}
+    fi
+
+    if [ $? -ne 0 ] ; then
+        echo "Benchmark failed"
+        exit 1
+    fi
+}
+
+# ----------------------------------------------------
+
+cd ${install_dir}/bin
+
+if [ -z "${instance_counts}" ] ; then
+    run_bench --output=${output_file}
+    cat ${output_file}
+else
+    for count in ${instance_counts//,/ }
+    do
+        if [ -z "${num_lods}" ] ; then
+            instance_output="${output_file%.json}-${count}.json"
+            run_bench --instances=${count} --output=${instance_output}
+        else
+            instance_output="${output_file%.json}-${count}-lods${num_lods}.json"
+            run_bench --instances=${count} --lods=${num_lods} --output=${instance_output}
+        fi
+        cat ${instance_output}
+    done
+fi
+
+# ----------------------------------------------------
@@ -21,7 +21,11 @@ ExternalProject_Add(
 # ----------------------------------------------------
 
 ExternalProject_Get_Property(filament install_dir)
+ExternalProject_Get_Property(filament source_dir)
 include_directories(${install_dir}/include)
+
+# Filament installs `libmeshoptimizer.a` but not its header.
+include_directories(${source_dir}/third_party/meshoptimizer/src)
 list(APPEND poly_deps filament)
 
 list(APPEND poly_libs
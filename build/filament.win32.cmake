@@ -32,10 +32,14 @@ ExternalProject_Add(
 # ----------------------------------------------------
 
 ExternalProject_Get_Property(filament install_dir)
+ExternalProject_Get_Property(filament source_dir)
 set(lib_dir ${install_dir}/lib/x86_64/)
 set(inc_dir ${install_dir}/include)
 include_directories(${inc_dir})
 
+# Filament installs `meshoptimizer.lib` but not its header.
+include_directories(${source_dir}/third_party/meshoptimizer/src)
+
 list(APPEND poly_libs
   ${lib_dir}/backend.lib
   ${lib_dir}/bluegl.lib
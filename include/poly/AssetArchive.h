@@ -0,0 +1,174 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  ASSET ARCHIVE
+  =============
+
+  GENERAL INFO:
+
+    Packs many asset files (filamesh, filamat, ...) into one
+    file. On a slow disk opening and reading hundreds of small
+    files at startup means hundreds of seeks; the archive is
+    opened and mapped once and `prefault()` reads it front to
+    back in one sequential read. The layout is:
+
+      AssetArchiveHeader
+      AssetArchiveEntry       x `header.num_entries`
+      uint32_t                x `header.num_slots`, the hash table
+      names                   `header.names_size` bytes, '\0' terminated
+      data                    every entry aligned to `ASSET_ARCHIVE_ALIGNMENT`
+
+    The hash table maps the hash of a name (`poly/Hash.h`) to
+    the index of its entry. It has a power of two number of
+    slots, at least twice the number of entries, and uses linear
+    probing, so `find()` is O(1) and doesn't allocate. We compare
+    the name too, so two names with the same hash are fine.
+
+    Entries are stored as they are or, when packed with
+    `ASSET_ARCHIVE_FLAG_COMPRESS` and it saves at least
+    `ASSET_ARCHIVE_MIN_SAVING`, encoded with meshoptimizer's
+    vertex codec (which we already link). `get()` returns a
+    pointer into the mapping for stored entries; compressed
+    entries are decoded the first time you ask for them and kept
+    until `close()`.
+
+    The entries are written in the order you pass them to
+    `asset_archive_write()`; pass them in the order you load them
+    so the reads stay sequential.
+
+  USAGE:
+
+    // Packing, see `poly-pack`.
+    std::vector<AssetArchiveInput> inputs = { { "monkey.filamesh", "./assets/monkey.filamesh" } };
+    asset_archive_write("./assets.pack", inputs, ASSET_ARCHIVE_FLAG_COMPRESS);
+
+    // Loading.
+    AssetArchive archive;
+    archive.open("./assets.pack");
+    archive.prefault();
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    archive.get("monkey.filamesh", &data, &size);
+
+  IMPORTANT:
+
+    The data returned by `get()` is valid until `close()`. When
+    you hand it to Filament without copying it (e.g. with
+    `mesh_create()`) keep the archive open until Filament
+    released the buffers. `find()` and `get()` may be called from
+    multiple threads once the archive is open.
+
+ */
+
+#ifndef POLY_ASSET_ARCHIVE_H
+#define POLY_ASSET_ARCHIVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <poly/MappedFile.h>
+
+/* -------------------------------------------- */
+
+#define ASSET_ARCHIVE_MAGIC "POLYPACK"
+#define ASSET_ARCHIVE_MAGIC_SIZE 8
+#define ASSET_ARCHIVE_VERSION 1
+#define ASSET_ARCHIVE_ALIGNMENT 16                    /* Of the data of every entry. */
+#define ASSET_ARCHIVE_NO_ENTRY 0xFFFFFFFF             /* An empty slot in the hash table. */
+#define ASSET_ARCHIVE_FLAG_COMPRESS 0x01              /* Flag for `asset_archive_write()`. */
+#define ASSET_ARCHIVE_MIN_SAVING 0.125f               /* Only store an entry compressed when that saves at least this fraction. */
+#define ASSET_COMPRESSION_NONE 0
+#define ASSET_COMPRESSION_MESHOPT 1                   /* `meshopt_encodeVertexBuffer()` with 4 byte "vertices". */
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct AssetArchiveHeader {
+    char magic[ASSET_ARCHIVE_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t num_entries;
+    uint32_t num_slots;                               /* A power of two. */
+    uint32_t names_size;
+    uint64_t size;                                    /* Of the whole archive; to detect truncated files. */
+  };
+
+  struct AssetArchiveEntry {
+    uint64_t hash;                                    /* `hash_bytes()` of the name. */
+    uint64_t offset;                                  /* From the start of the archive. */
+    uint64_t size;                                    /* Stored size. */
+    uint64_t original_size;                           /* Size after decompression. */
+    uint32_t compression;                             /* `ASSET_COMPRESSION_*` */
+    uint32_t name_offset;                             /* Into the names. */
+  };
+
+  struct AssetArchiveInput {
+    std::string name;                                 /* The name we look the entry up with. */
+    std::string filepath;                             /* The file we read it from. */
+  };
+
+  /* -------------------------------------------- */
+
+  class AssetArchive {
+  public:
+    AssetArchive();
+    ~AssetArchive();
+    int open(const std::string& filepath);
+    int close();
+    void prefault();                                  /* Reads the whole archive, sequentially, on the calling thread. */
+    const AssetArchiveEntry* find(const std::string& name);   /* Returns nullptr when the archive has no entry with this name. */
+    int get(const std::string& name, const uint8_t** data, size_t* size);
+    int get(const AssetArchiveEntry* entry, const uint8_t** data, size_t* size);
+    uint32_t get_num_entries();
+    const AssetArchiveEntry* get_entry(uint32_t index);
+    const char* get_name(const AssetArchiveEntry* entry);
+    bool is_open();
+
+  private:
+    MappedFile file;
+    const AssetArchiveHeader* header;
+    const AssetArchiveEntry* entries;
+    const uint32_t* slots;
+    const char* names;
+    std::mutex mtx;                                   /* Protects `decompressed`. */
+    std::unordered_map<uint32_t, std::vector<uint8_t>> decompressed;  /* Entry index => decompressed data. */
+  };
+
+  /* -------------------------------------------- */
+
+  inline bool AssetArchive::is_open() {
+    return nullptr != header;
+  }
+
+  inline uint32_t AssetArchive::get_num_entries() {
+    return (nullptr == header) ? 0 : header->num_entries;
+  }
+
+  /* -------------------------------------------- */
+
+  int asset_archive_write(const std::string& filepath, const std::vector<AssetArchiveInput>& inputs, uint32_t flags);
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
@@ -0,0 +1,214 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  ASYNC MESH LOADER
+  =================
+
+  GENERAL INFO:
+
+    Loads filamesh files without blocking the render loop. When
+    you call `load()` we immediately add a placeholder (a small
+    cube) to the scene and return an `AsyncMesh`. A pool of
+    worker threads maps and parses the file and touches all its
+    pages, so the disk reads happen on the worker and not on
+    Filament's driver thread during the upload. Compressed files
+    are decoded into the heap on the worker too.
+
+    Filament's `Engine` may only be used from one thread, so
+    `update()`, which you call once per frame from the render
+    loop, creates the vertex and index buffers of the parsed
+    meshes. The real renderable is built on the entity of the
+    placeholder, which means that a transform you've set on the
+    placeholder is kept. Filament executes the uploads before it
+    draws the first frame that uses the new geometry.
+
+    Once the driver has consumed the vertex and index data (the
+    release callback of the buffer descriptors was called) the
+    file is unmapped, the mesh becomes `ASYNC_MESH_STATE_READY`
+    and we call your completion callback from `update()`. The
+    callback is also called when loading failed; in that case we
+    remove the placeholder from the scene. When we fail after
+    the buffers were created, we wait for their release callback
+    before the mesh becomes `ASYNC_MESH_STATE_FAILED`, so it's
+    safe to `release()` it from the completion callback.
+
+    Every `AsyncMesh` records how long each step took: waiting
+    in the queue, parsing on the worker, creating the buffers on
+    the main thread and the upload.
+
+    After `set_optimize(true)` the workers load the
+    meshoptimizer'd copy of a file (see `poly/MeshOptimizer.h`)
+    and create it first when it's missing or out of date; that
+    time is part of `parse_ms`.
+
+    `update(max_upload_bytes, max_create_ms)` limits the work of
+    one frame: we stop creating buffers when the vertex and index
+    data of this frame would go over `max_upload_bytes` or when
+    we spent `max_create_ms`; the other parsed meshes wait for
+    the next frame, in order. We always create at least one mesh
+    per frame, so a mesh larger than the budget still loads. A
+    limit of 0 means no limit, which is what `update()` uses.
+
+    `set_placeholders(false)` disables the placeholder cubes; the
+    entity of an `AsyncMesh` then only gets its renderable (and
+    is added to the scene) once the mesh was created. A streamer
+    that loads many chunks at once uses this (see
+    `poly/MeshStreamer.h`); it also calls `release()` for the
+    meshes it unloads so we don't keep their bookkeeping around;
+    `release()` may be called from the completion callback.
+
+  USAGE:
+
+    AsyncMeshLoader loader;
+    loader.init(engine, scene, &registry);
+    loader.load("./monkey.filamesh", on_mesh_loaded, nullptr);
+
+    // every frame
+    loader.update();
+
+    // at exit
+    loader.print();
+    loader.shutdown();
+
+  IMPORTANT:
+
+    The `AsyncMesh` instances are owned by the loader and are
+    valid until `shutdown()`. The Filament objects of meshes that
+    were loaded successfully are owned by you.
+
+ */
+
+#ifndef POLY_ASYNC_MESH_LOADER_H
+#define POLY_ASYNC_MESH_LOADER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <filameshio/MeshReader.h>
+#include <poly/Filamesh.h>
+#include <poly/MappedFile.h>
+#include <poly/MeshOptimizer.h>
+
+/* -------------------------------------------- */
+
+#define ASYNC_MESH_STATE_LOADING 0      /* Waiting for, or being mapped and parsed by, a worker. */
+#define ASYNC_MESH_STATE_UPLOADING 1    /* The buffers have been created; waiting for the driver to consume the data. */
+#define ASYNC_MESH_STATE_READY 2
+#define ASYNC_MESH_STATE_FAILED 3
+
+/* -------------------------------------------- */
+
+namespace filament {
+  class Engine;
+  class Scene;
+  class VertexBuffer;
+  class IndexBuffer;
+}
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct AsyncMesh;
+  typedef void(*AsyncMeshCallback)(AsyncMesh* mesh, void* user);
+
+  /* -------------------------------------------- */
+
+  struct AsyncMesh {
+    std::string filepath;
+    utils::Entity entity;                         /* The placeholder and, once loaded, the real renderable. */
+    filamesh::MeshReader::Mesh mesh;              /* Valid when the state is `ASYNC_MESH_STATE_READY`. */
+    uint32_t state;                               /* One of the `ASYNC_MESH_STATE_*` values; only read it on the main thread. */
+    AsyncMeshCallback callback;
+    void* user;
+
+    /* Timings in milliseconds. */
+    double queue_ms;                              /* From `load()` until a worker picked it up. */
+    double parse_ms;                              /* Mapping, parsing and touching the pages (or decoding) on the worker. */
+    double create_ms;                             /* Creating the buffers and the renderable in `update()`. */
+    double upload_ms;                             /* From creating the buffers until the driver released the data. */
+    double total_ms;                              /* From `load()` until the completion callback. */
+
+    /* Internal */
+    std::string loaded_filepath;                  /* `filepath` or its optimized copy; set by the worker. */
+    int result;                                   /* Set by the worker; 0 when the file was mapped and parsed. */
+    MappedFile file;
+    FilameshData data;
+    std::vector<uint8_t> decoded_vertices;        /* When the file is compressed; freed once the driver released the data. */
+    std::vector<uint8_t> decoded_indices;
+    uint64_t load_ns;
+    uint64_t create_ns;
+    std::atomic<uint64_t> released_ns;            /* Set from Filament's driver thread; 0 until the data was released. */
+  };
+
+  /* -------------------------------------------- */
+
+  class AsyncMeshLoader {
+  public:
+    AsyncMeshLoader();
+    ~AsyncMeshLoader();
+    int init(filament::Engine* engine, filament::Scene* scene, filamesh::MeshReader::MaterialRegistry* materials, uint32_t num_threads = 2);
+    int shutdown();                                /* Waits for the pending meshes; call before destroying the engine. */
+    void set_optimize(bool optimize, uint32_t flags = MESH_OPTIMIZE_DEFAULT); /* Call before `init()`; see `poly/MeshOptimizer.h`. */
+    void set_placeholders(bool enabled);           /* Call before `init()`; enabled by default. */
+    AsyncMesh* load(const std::string& filepath, AsyncMeshCallback callback = nullptr, void* user = nullptr);
+    int release(AsyncMesh* mesh);                  /* Deletes a mesh which is ready or failed; its Filament objects stay yours. */
+    void update();                                 /* Call once per frame from the thread that uses the engine. */
+    void update(uint64_t max_upload_bytes, double max_create_ms); /* Same, with a budget for this frame; 0 is no limit. */
+    size_t get_num_pending();
+    size_t get_num_waiting();                      /* Parsed meshes which wait for a frame with budget left. */
+    uint64_t get_num_upload_bytes();               /* Of the meshes created by the last `update()`. */
+    double get_create_ms();                        /* Spent in the last `update()` creating meshes. */
+    void print();
+
+  private:
+    void worker_main(uint32_t dx);
+    int create_placeholder_geometry();
+    void finish(AsyncMesh* mesh);
+
+  private:
+    filament::Engine* engine;
+    filament::Scene* scene;
+    filamesh::MeshReader::MaterialRegistry* materials;
+    filament::VertexBuffer* placeholder_vb;
+    filament::IndexBuffer* placeholder_ib;
+    std::vector<std::thread> workers;
+    std::vector<AsyncMesh*> meshes;                /* All meshes, owned by us. */
+    std::vector<AsyncMesh*> uploading;             /* Main thread only. */
+    std::deque<AsyncMesh*> todo;                   /* Protected by `mutex`. */
+    std::deque<AsyncMesh*> parsed;                 /* Protected by `mutex`. */
+    std::deque<AsyncMesh*> waiting;                /* Parsed, but over the budget of a previous frame; main thread only. */
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool is_running;                               /* Protected by `mutex`. */
+    bool optimize;                                 /* Read by the workers, only set before `init()`. */
+    uint32_t optimize_flags;
+    bool placeholders;                             /* Only set before `init()`. */
+    size_t num_pending;                            /* Main thread only. */
+    uint64_t num_upload_bytes;                     /* Main thread only. */
+    double create_ms;                              /* Main thread only. */
+  };
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
@@ -0,0 +1,97 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  CAMERA CONTROLLER
+  =================
+
+  GENERAL INFO:
+
+    A small orbit camera controller: drag with the (left) mouse
+    button to rotate around the target and scroll to zoom. It
+    doesn't know anything about GLFW or Filament; the host feeds
+    it the input and asks for a `CameraPose` which it passes to
+    `filament::Camera::lookAt()`.
+
+    Every time the pose changes we publish it into a
+    `LatestValue<CameraPose>` slot. The render loop reads this
+    slot right before `Renderer::render()` ("late latching"), so
+    the frame uses the most recent input without the input side
+    and the renderer ever waiting on each other.
+
+  USAGE:
+
+    CameraController controller;
+    LatestValue<CameraPose> camera_slot(controller.get_pose());
+
+    void cursor_callback(GLFWwindow* win, double x, double y) {
+      if (true == controller.on_cursor(x, y)) {
+        camera_slot.store(controller.get_pose());
+      }
+    }
+
+    // Right before `render()`
+    CameraPose pose;
+    camera_slot.load(pose);
+    camera->lookAt(pose.eye, pose.target, pose.up);
+
+ */
+
+#ifndef POLY_CAMERA_CONTROLLER_H
+#define POLY_CAMERA_CONTROLLER_H
+
+#include <stdint.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct CameraPose {
+    float eye[3];
+    float target[3];
+    float up[3];
+  };
+
+  /* -------------------------------------------- */
+
+  class CameraController {
+  public:
+    CameraController();
+    void set_target(float x, float y, float z);
+    void set_distance(float dist);
+    bool on_cursor(double x, double y);               /* Returns true when the pose changed. */
+    bool on_button(bool is_pressed, double x, double y);
+    bool on_scroll(double offset);
+    CameraPose get_pose();
+
+  private:
+    float target[3];
+    float yaw;                /* Rotation around the Y-axis, in radians. */
+    float pitch;              /* Rotation above/below the XZ-plane, in radians. */
+    float distance;           /* Distance between the eye and the target. */
+    float min_distance;
+    float max_distance;
+    float rotate_speed;       /* Radians per pixel. */
+    float zoom_speed;         /* Fraction of the distance per scroll step. */
+    double last_x;
+    double last_y;
+    bool is_dragging;
+  };
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
@@ -0,0 +1,150 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  FILAMESH
+  ========
+
+  GENERAL INFO:
+
+    Reading and writing of the `.filamesh` format that Filament's
+    `filamesh` tool creates and `filamesh::MeshReader` loads. The
+    reader of Filament hides the format, but we need access to
+    the raw vertex and index regions to upload them without
+    copies, to optimize them, etc. The layout of a file is:
+
+      "FILAMESH"              8 bytes magic
+      FilameshHeader
+      vertex data             `header.vertex_size` bytes
+      index data              `header.index_size` bytes
+      FilameshPart            x `header.parts`
+      uint32_t                number of materials
+      per material:
+        uint32_t              length of the name
+        char[length + 1]      the name, including a '\0'
+
+    The vertex data is either interleaved or stored per
+    attribute; the offsets and strides in the header describe
+    where each attribute lives. Positions are stored as HALF4,
+    tangents as a SHORT4 (normalized) quaternion, colors as
+    UBYTE4 and UV0 as HALF2 or, when `FILAMESH_FLAG_TEXCOORD_SNORM16`
+    is set, as SHORT2 (normalized).
+
+    `FILAMESH_FLAG_QUANTIZED` is our own extension, written by
+    `poly/MeshQuantizer.h`: positions are SHORT4 (normalized)
+    relative to `header.aabb` (-1 and 1 are the sides of the
+    box) and tangents a BYTE4 (normalized) quaternion. Filament's
+    `MeshReader` can't read these files.
+
+    `filamesh_parse()` doesn't copy anything; the returned
+    `FilameshData` points into the buffer you pass in. It only
+    accepts `FILAMESH_VERSION`, as the header of another version
+    may have another layout.
+
+ */
+
+#ifndef POLY_FILAMESH_H
+#define POLY_FILAMESH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/* -------------------------------------------- */
+
+#define FILAMESH_MAGIC "FILAMESH"
+#define FILAMESH_MAGIC_SIZE 8
+#define FILAMESH_VERSION 1
+#define FILAMESH_FLAG_INTERLEAVED 0x01
+#define FILAMESH_FLAG_TEXCOORD_SNORM16 0x02
+#define FILAMESH_FLAG_COMPRESSION 0x04
+#define FILAMESH_FLAG_QUANTIZED 0x08         /* Not a Filament flag; see `poly/MeshQuantizer.h`. */
+#define FILAMESH_INDEX_TYPE_UINT 0
+#define FILAMESH_INDEX_TYPE_USHORT 1
+#define FILAMESH_NO_ATTRIBUTE 0xFFFFFFFF   /* Offset and stride of an attribute which is not used (e.g. UV1). */
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct FilameshBox {
+    float center[3];
+    float half_extent[3];
+  };
+
+  struct FilameshHeader {
+    uint32_t version;
+    uint32_t parts;
+    FilameshBox aabb;
+    uint32_t flags;
+    uint32_t offset_position;
+    uint32_t stride_position;
+    uint32_t offset_tangents;
+    uint32_t stride_tangents;
+    uint32_t offset_color;
+    uint32_t stride_color;
+    uint32_t offset_uv0;
+    uint32_t stride_uv0;
+    uint32_t offset_uv1;
+    uint32_t stride_uv1;
+    uint32_t vertex_count;
+    uint32_t vertex_size;
+    uint32_t index_type;
+    uint32_t index_count;
+    uint32_t index_size;
+  };
+
+  struct FilameshPart {
+    uint32_t offset;
+    uint32_t index_count;
+    uint32_t min_index;
+    uint32_t max_index;
+    uint32_t material_id;
+    FilameshBox aabb;
+  };
+
+  /* -------------------------------------------- */
+
+  struct FilameshData {
+    FilameshHeader header;
+    const uint8_t* vertices;                   /* Points into the buffer that was parsed. */
+    const uint8_t* indices;                    /* Points into the buffer that was parsed. */
+    std::vector<FilameshPart> parts;
+    std::vector<std::string> materials;
+  };
+
+  /* -------------------------------------------- */
+
+  int filamesh_parse(const uint8_t* data, size_t size, FilameshData& result);  /* Returns 0 on success, < 0 when the data is not a valid filamesh. */
+  int filamesh_write(
+    const std::string& filepath,
+    const FilameshHeader& header,
+    const uint8_t* vertices,
+    const uint8_t* indices,
+    const std::vector<FilameshPart>& parts,
+    const std::vector<std::string>& materials
+  );
+  int filamesh_decode_positions(const FilameshData& data, std::vector<float>& positions); /* x, y, z per vertex; for meshoptimizer. */
+  uint16_t filamesh_float_to_half(float value);
+  float filamesh_half_to_float(uint16_t value);
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
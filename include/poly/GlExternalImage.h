@@ -0,0 +1,158 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  GL EXTERNAL IMAGE
+  =================
+
+  GENERAL INFO:
+
+    The GL side of rendering with Vulkan and compositing with
+    GL. Vulkan allocates the memory of an image as exportable
+    (`VkExternalMemoryImageCreateInfo` with
+    `VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT`) and hands us
+    the file descriptor from `vkGetMemoryFdKHR()`. We import it
+    with `GL_EXT_memory_object_fd` and create a texture on top
+    of it with `glTexStorageMem2DEXT()`, so GL samples the pixels
+    that Vulkan rendered without a copy.
+
+    The two APIs don't know about each other's work, so we use
+    two semaphores which Vulkan exports with
+    `vkGetSemaphoreFdKHR()` and we import with
+    `GL_EXT_semaphore_fd`: Vulkan signals `ready` after it
+    rendered a frame and `begin_read()` makes the GL queue wait
+    for it; `end_read()` signals `done` after our composite, and
+    Vulkan waits for that before it renders into the image again.
+
+    `get_uuids()` returns the device and driver UUID of the GL
+    context. Compare them with `VkPhysicalDeviceIDProperties` of
+    the Vulkan device; memory can only be shared between the same
+    device and driver (e.g. lavapipe and llvmpipe of the same Mesa
+    build, or the Vulkan and GL drivers of the same GPU).
+
+  USAGE:
+
+    GlExternalImageSettings cfg;
+    cfg.memory_fd = memory_fd;
+    cfg.memory_size = requirements.size;
+    cfg.memory_offset = 0;
+    cfg.is_dedicated = true;
+    cfg.width = 1280;
+    cfg.height = 720;
+    cfg.internal_format = GL_RGBA8;
+    cfg.ready_fd = ready_fd;
+    cfg.done_fd = done_fd;
+    cfg.read_layout = GL_LAYOUT_SHADER_READ_ONLY_EXT;
+    cfg.release_layout = GL_LAYOUT_COLOR_ATTACHMENT_EXT;
+
+    GlExternalImage image;
+    image.init(cfg);
+
+    // every frame, after Vulkan submitted the frame
+    image.begin_read();
+    glBindTexture(GL_TEXTURE_2D, image.get_texture());
+    ...
+    image.end_read();
+
+    image.shutdown();
+
+  IMPORTANT:
+
+    Call everything with the same GL context current. When
+    `init()` fails because the image is already initialized, the
+    driver lacks the extensions or the settings are incomplete
+    (-1, -2 or -3) we didn't touch the file descriptors and they
+    are still yours. Otherwise `init()` takes all of them: GL
+    owns the ones it imported and we close the others when a
+    later step fails, so never close them yourself. The
+    settings must describe the image exactly as Vulkan created
+    it (size, format, a single level, optimal tiling and whether
+    it's a dedicated allocation), otherwise the pixels are
+    garbage. The layouts passed to the
+    semaphore calls are the Vulkan layouts of the image at that
+    moment (`read_layout` is the one Vulkan transitioned the
+    image to before it signaled `ready`). The Filament version
+    that we link doesn't export the memory of its Vulkan
+    textures, so the exporting side has to come from Filament or
+    from your own Vulkan code. We import POSIX file
+    descriptors, so this is only built on Unix; Windows would
+    need the `GL_EXT_memory_object_win32` handles.
+
+ */
+
+#ifndef POLY_GL_EXTERNAL_IMAGE_H
+#define POLY_GL_EXTERNAL_IMAGE_H
+
+#include <stdint.h>
+
+/* -------------------------------------------- */
+
+#define GL_EXTERNAL_IMAGE_UUID_SIZE 16
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct GlExternalImageSettings {
+    int memory_fd;                              /* From `vkGetMemoryFdKHR()`. */
+    uint64_t memory_size;                       /* The size of the allocation, not of the pixels. */
+    uint64_t memory_offset;                     /* Where the image starts in the allocation. */
+    bool is_dedicated;                          /* Allocated with `VkMemoryDedicatedAllocateInfo`. */
+    uint32_t width;
+    uint32_t height;
+    uint32_t internal_format;                   /* E.g. `GL_RGBA8` for `VK_FORMAT_R8G8B8A8_UNORM`. */
+    int ready_fd;                               /* Signaled by Vulkan after rendering; -1 when you sync yourself. */
+    int done_fd;                                /* Signaled by us after reading; -1 when you sync yourself. */
+    uint32_t read_layout;                       /* `GL_LAYOUT_*_EXT`; the layout Vulkan leaves the image in. */
+    uint32_t release_layout;                    /* `GL_LAYOUT_*_EXT`; the layout we leave the image in. */
+  };
+
+  /* -------------------------------------------- */
+
+  class GlExternalImage {
+  public:
+    GlExternalImage();
+    ~GlExternalImage();
+    int init(const GlExternalImageSettings& cfg);
+    int shutdown();
+    int begin_read();                           /* Makes GL wait for the `ready` semaphore. */
+    int end_read();                             /* Signals the `done` semaphore and flushes. */
+    uint32_t get_texture();
+
+  public:
+    static bool is_supported();                 /* `GL_EXT_memory_object_fd` and `GL_EXT_semaphore_fd`. */
+    static int get_uuids(uint8_t* device_uuid, uint8_t* driver_uuid);  /* Both hold `GL_EXTERNAL_IMAGE_UUID_SIZE` bytes. */
+
+  private:
+    GlExternalImageSettings settings;
+    uint32_t memory;
+    uint32_t texture;
+    uint32_t ready;
+    uint32_t done;
+  };
+
+  /* -------------------------------------------- */
+
+  inline uint32_t GlExternalImage::get_texture() {
+    return texture;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
@@ -0,0 +1,185 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  GL UPLOADER
+  ===========
+
+  GENERAL INFO:
+
+    Uploads textures and buffers and compiles programs for the
+    host on a worker thread with its own GL context, so the
+    thread that composites never blocks on `glTexImage2D()`,
+    `glBufferData()` or the compiler. This is a third context,
+    next to our main context and the one of Filament; `init()`
+    creates it as a hidden GLFW window which shares with the
+    main window, and the worker makes it current.
+
+    When the worker has issued the GL calls of an upload it
+    inserts a fence with `glFenceSync()` and flushes. Sync
+    objects are shared between the contexts, so `update()`, which
+    you call once per frame on the main thread, polls the fences
+    with a timeout of 0. When a fence was signaled the GPU has
+    executed the upload, the object can be used in the main
+    context and we call the completion callback. We never wait
+    for a fence in `update()`.
+
+    Every `GlUpload` records how long the GL calls took on the
+    worker (`upload_ms`) and the time from the request until it
+    was ready on the main thread (`total_ms`).
+
+  USAGE:
+
+    GlUploader uploader;
+    uploader.init(win);
+
+    uploader.upload_texture(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, pixels, true, on_uploaded, nullptr);
+
+    // every frame
+    uploader.update();
+
+    // at exit
+    uploader.shutdown();
+
+  IMPORTANT:
+
+    Call `init()`, `update()` and `shutdown()` on the main
+    thread with the main context current, GLFW only creates
+    windows there. `init()` sets the `GLFW_VISIBLE` hint back to
+    its default. Bind a texture or buffer again after it became
+    ready, GL only guarantees that a context sees the changes of
+    another context after it (re)binds the object. The data you pass
+    must stay valid until the upload is ready or failed (the
+    callback was called). Textures, buffers and programs are
+    shared between contexts but vertex array objects and
+    framebuffers are not, so create those in the context which
+    uses them. Once an upload is ready the GL object is yours;
+    `release()` only frees the `GlUpload`. To stream video
+    frames, upload into a couple of textures in turn and only
+    reuse a texture when the main thread doesn't sample from it
+    anymore. We use the function pointers that glad loaded for
+    the main context; the upload context is created by the same
+    driver.
+
+ */
+
+#ifndef POLY_GL_UPLOADER_H
+#define POLY_GL_UPLOADER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* -------------------------------------------- */
+
+#define GL_UPLOAD_TYPE_TEXTURE 0
+#define GL_UPLOAD_TYPE_BUFFER 1
+#define GL_UPLOAD_TYPE_PROGRAM 2
+
+#define GL_UPLOAD_STATE_QUEUED 0              /* Waiting for, or being handled by, the worker. */
+#define GL_UPLOAD_STATE_FENCED 1              /* The worker issued the GL calls; waiting for the fence. */
+#define GL_UPLOAD_STATE_READY 2
+#define GL_UPLOAD_STATE_FAILED 3
+
+/* -------------------------------------------- */
+
+struct GLFWwindow;
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct GlUpload;
+  typedef void(*GlUploadCallback)(GlUpload* upload, void* user);
+
+  /* -------------------------------------------- */
+
+  struct GlUpload {
+    uint32_t type;                               /* One of the `GL_UPLOAD_TYPE_*` values. */
+    uint32_t state;                              /* One of the `GL_UPLOAD_STATE_*` values; only read it on the main thread. */
+    uint32_t id;                                 /* The texture, buffer or program; 0 until ready. */
+    GlUploadCallback callback;
+    void* user;
+
+    /* Texture */
+    uint32_t width;
+    uint32_t height;
+    uint32_t internal_format;                    /* E.g. `GL_RGBA8`. */
+    uint32_t format;                             /* E.g. `GL_RGBA`. */
+    uint32_t data_type;                          /* E.g. `GL_UNSIGNED_BYTE`. */
+    bool mipmaps;
+
+    /* Buffer */
+    uint32_t target;                             /* E.g. `GL_ARRAY_BUFFER`. */
+    size_t size;
+
+    /* Texture and buffer */
+    const void* data;
+
+    /* Program */
+    std::string vs;
+    std::string fs;
+
+    /* Timings in milliseconds. */
+    double upload_ms;                            /* The GL calls on the worker. */
+    double total_ms;                             /* From the request until the fence was signaled. */
+
+    /* Internal */
+    void* fence;                                 /* The `GLsync` of the worker. */
+    uint64_t request_ns;
+  };
+
+  /* -------------------------------------------- */
+
+  class GlUploader {
+  public:
+    GlUploader();
+    ~GlUploader();
+    int init(GLFWwindow* main_window);            /* Creates the upload context which shares with `main_window` and starts the worker. */
+    int shutdown();                               /* Finishes the queued uploads and destroys the upload context. */
+    GlUpload* upload_texture(uint32_t width, uint32_t height, uint32_t internal_format, uint32_t format, uint32_t data_type, const void* pixels, bool mipmaps, GlUploadCallback callback = nullptr, void* user = nullptr);
+    GlUpload* upload_buffer(uint32_t target, const void* data, size_t size, GlUploadCallback callback = nullptr, void* user = nullptr);
+    GlUpload* compile_program(const std::string& vs, const std::string& fs, GlUploadCallback callback = nullptr, void* user = nullptr);
+    void update();                                /* Call once per frame on the main thread; calls the callbacks of the uploads which are ready. */
+    int release(GlUpload* upload);                /* Frees a ready or failed upload; doesn't delete the GL object. */
+    size_t get_num_pending();
+
+  private:
+    GlUpload* add(GlUpload* upload);
+    void worker_main();
+    int handle(GlUpload* upload);
+
+  private:
+    GLFWwindow* window;                           /* Hidden; owns the upload context. */
+    std::thread worker;
+    std::vector<GlUpload*> uploads;               /* All uploads, owned by us. */
+    std::vector<GlUpload*> fenced;                /* Main thread only. */
+    std::deque<GlUpload*> todo;                   /* Protected by `mutex`. */
+    std::deque<GlUpload*> done;                   /* Handled by the worker; protected by `mutex`. */
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool is_running;                              /* Protected by `mutex`. */
+    size_t num_pending;                           /* Main thread only. */
+  };
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
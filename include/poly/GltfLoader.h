@@ -0,0 +1,207 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  GLTF LOADER
+  ===========
+
+  GENERAL INFO:
+
+    Loads glTF files (`.gltf` with external buffers and images,
+    or `.glb`) with gltfio without blocking the render loop. A
+    file goes through these stages; the ones marked `worker` run
+    on our pool of worker threads, the others in `update()` on
+    the thread that uses the engine:
+
+      read      worker   Map the file and read its pages.
+      create    main     `AssetLoader::createAssetFromJson()` or
+                         `createAssetFromBinary()`: parses the
+                         glTF and creates the entities, buffers
+                         and material instances.
+      fetch     worker   Map and read every external buffer and
+                         image the asset refers to; they are
+                         handed to the `ResourceLoader` with
+                         `addResourceData()`, so it doesn't read
+                         them itself.
+      begin     main     `ResourceLoader::asyncBeginLoad()`:
+                         uploads the vertex and index data and
+                         starts decoding the textures on the jobs
+                         of Filament's `JobSystem`.
+      textures  main     `asyncUpdateLoad()` every frame uploads
+                         the textures which were decoded and
+                         generates their mipmaps, until the
+                         progress reaches 1.
+      add       main     Adds the entities to the scene.
+
+    Every `GltfAsset` records the time of each stage and how much
+    of it was spent on the main thread, so you can see where a
+    large scene spends its load time.
+
+    We pace the work on the main thread: `update(max_main_ms)`
+    begins at most one asset per frame (which is where its
+    vertex data is uploaded), and adds the entities of loaded
+    assets in batches until `max_main_ms` has been spent. Files
+    are read and fetched while other assets are still uploading,
+    so a couple of files load as a pipeline.
+
+    Every asset gets its own `ResourceLoader`, because it
+    resolves relative URIs against the path of the glTF file and
+    keeps the resource data by URI.
+
+  USAGE:
+
+    GltfLoader loader;
+    loader.init(engine, scene);
+    loader.load("./scene/scene.gltf", on_gltf_loaded, nullptr);
+
+    // every frame
+    loader.update(2.0);
+
+    // at exit
+    loader.print();
+    loader.shutdown();
+
+  IMPORTANT:
+
+    We use gltfio's material generator, which compiles the
+    materials the assets need at runtime, in the `create` stage.
+    The `GltfAsset` instances and the Filament objects of the
+    assets are owned by the loader and destroyed by `destroy()`
+    or `shutdown()`. The glTF file itself is unmapped once the
+    asset is created; its external resources stay mapped until
+    the asset is destroyed.
+
+ */
+
+#ifndef POLY_GLTF_LOADER_H
+#define POLY_GLTF_LOADER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <poly/MappedFile.h>
+
+/* -------------------------------------------- */
+
+#define GLTF_ASSET_STATE_READING 0          /* Waiting for, or being read by, a worker; created by `update()` when done. */
+#define GLTF_ASSET_STATE_FETCHING 1         /* Waiting for, or being fetched by, a worker. */
+#define GLTF_ASSET_STATE_BEGINNING 2        /* Fetched; waiting for a frame in which we can begin the upload. */
+#define GLTF_ASSET_STATE_TEXTURES 3         /* Uploading the vertex data and the textures. */
+#define GLTF_ASSET_STATE_ADDING 4           /* Loaded; adding the entities to the scene. */
+#define GLTF_ASSET_STATE_READY 5
+#define GLTF_ASSET_STATE_FAILED 6
+
+/* -------------------------------------------- */
+
+namespace filament {
+  class Engine;
+  class Scene;
+}
+
+namespace gltfio {
+  class AssetLoader;
+  class MaterialProvider;
+  class ResourceLoader;
+  class FilamentAsset;
+}
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct GltfAsset;
+  typedef void(*GltfAssetCallback)(GltfAsset* asset, void* user);
+
+  /* -------------------------------------------- */
+
+  struct GltfAsset {
+    std::string filepath;
+    gltfio::FilamentAsset* asset;                 /* Set in the create stage. */
+    uint32_t state;                               /* One of the `GLTF_ASSET_STATE_*` values; only read it on the main thread. */
+    GltfAssetCallback callback;
+    void* user;
+
+    /* Timings in milliseconds. */
+    double queue_ms;                              /* From `load()` until a worker picked it up. */
+    double read_ms;
+    double create_ms;
+    double fetch_ms;
+    double begin_ms;
+    double textures_ms;                           /* From the end of `begin` until all textures were uploaded. */
+    double textures_main_ms;                      /* The part of `textures_ms` we spent in `asyncUpdateLoad()`. */
+    double add_ms;                                /* From the end of `textures` until all entities were added. */
+    double main_ms;                               /* Everything we did on the main thread. */
+    double total_ms;                              /* From `load()` until the completion callback. */
+    uint64_t num_resource_bytes;                  /* Of the external buffers and images. */
+
+    /* Internal */
+    int result;                                   /* Set by the workers under the mutex; 0 on success. */
+    MappedFile file;
+    std::vector<std::string> uris;                /* Copied from the asset, for the fetch stage. */
+    std::vector<MappedFile*> resources;           /* Owned by the resource loader once they are added. */
+    gltfio::ResourceLoader* resource_loader;
+    size_t num_added;                             /* Entities added to the scene. */
+    uint64_t load_ns;
+    uint64_t stage_ns;                            /* When the current stage started. */
+  };
+
+  /* -------------------------------------------- */
+
+  class GltfLoader {
+  public:
+    GltfLoader();
+    ~GltfLoader();
+    int init(filament::Engine* engine, filament::Scene* scene, uint32_t num_threads = 2);
+    int shutdown();                                /* Waits for the pending assets and destroys all assets; call before destroying the engine. */
+    GltfAsset* load(const std::string& filepath, GltfAssetCallback callback = nullptr, void* user = nullptr);
+    int destroy(GltfAsset* asset);                 /* Removes a ready or failed asset from the scene and destroys it. */
+    void update();                                 /* Call once per frame from the thread that uses the engine. */
+    void update(double max_main_ms);               /* Same, but spends at most `max_main_ms` adding entities; 0 is no limit. */
+    size_t get_num_pending();
+    void print();
+
+  private:
+    void worker_main(uint32_t dx);
+    void create(GltfAsset* asset);
+    void begin(GltfAsset* asset);
+    void fail(GltfAsset* asset);
+    void finish(GltfAsset* asset);
+
+  private:
+    filament::Engine* engine;
+    filament::Scene* scene;
+    gltfio::MaterialProvider* materials;
+    gltfio::AssetLoader* asset_loader;
+    std::vector<std::thread> workers;
+    std::vector<GltfAsset*> assets;                /* All assets, owned by us. */
+    std::vector<GltfAsset*> loading;               /* In the textures or add stage; main thread only. */
+    std::deque<GltfAsset*> beginning;              /* Main thread only. */
+    std::deque<GltfAsset*> todo;                   /* Protected by `mutex`. */
+    std::deque<GltfAsset*> done;                   /* Read or fetched by a worker; protected by `mutex`. */
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool is_running;                               /* Protected by `mutex`. */
+    size_t num_pending;                            /* Main thread only. */
+  };
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
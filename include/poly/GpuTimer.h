@@ -0,0 +1,151 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  GPU TIMER
+  =========
+
+  GENERAL INFO:
+
+    The `GpuTimer` measures how long sections of a frame take on
+    the GPU and on the CPU. For every section we issue a
+    `GL_TIMESTAMP` query (using `glQueryCounter()`) at the start
+    and at the end. Because timestamps are absolute, sections may
+    nest, which is not possible with `GL_TIME_ELAPSED`.
+
+    We never block on the results. The queries are stored in a
+    ring of `GPU_TIMER_NUM_FRAMES` frames and we only read the
+    results of a frame when we are about to reuse its slot; at
+    that point the GPU is usually done with it. When the results
+    are not available yet we drop that frame instead of
+    stalling (see `get_num_dropped_frames()`).
+
+    The results are aggregated into `RollingStats` so you can
+    query the p50/p95/p99 of both the CPU and GPU time of each
+    section. When the CPU time of the frame is higher than the
+    GPU time you're CPU bound, otherwise GPU bound.
+
+  USAGE:
+
+    GpuTimer timer;
+    int sec_composite = timer.add_section("composite");
+    timer.init();
+
+    while (running) {
+      timer.begin_frame();
+      timer.begin(sec_composite);
+      ... draw ...
+      timer.end(sec_composite);
+      timer.end_frame();
+    }
+
+    timer.shutdown();
+
+  IMPORTANT:
+
+    The queries are created in the context which is current when
+    you call `init()` and all other functions must be called with
+    that same context current. Filament renders from its own
+    (shared) context on its driver thread, which means that a
+    section that wraps `beginFrame()` / `endFrame()` in the host
+    context measures the GPU timeline between the two host
+    timestamps; this includes the Filament work the GPU executed
+    in between but is not an exact per-command measurement.
+
+ */
+
+#ifndef POLY_GPU_TIMER_H
+#define POLY_GPU_TIMER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <poly/Stats.h>
+
+/* -------------------------------------------- */
+
+#define GPU_TIMER_NUM_FRAMES 4      /* Number of frames we keep in flight before reading back the results. */
+#define GPU_TIMER_MAX_SECTIONS 16   /* Max number of sections we can time, including the implicit "frame" section. */
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct GpuTimerSection {
+    std::string name;
+    RollingStats cpu_ms;
+    RollingStats gpu_ms;
+  };
+
+  /* -------------------------------------------- */
+
+  struct GpuTimerFrame {
+    uint32_t queries[GPU_TIMER_MAX_SECTIONS * 2]; /* Begin and end timestamp query per section. */
+    double cpu_ms[GPU_TIMER_MAX_SECTIONS];        /* CPU time we measured for each section. */
+    uint32_t used;                                /* Bitmask of the sections that were timed this frame. */
+    bool is_pending;                              /* True when the queries were issued and the results haven't been read. */
+  };
+
+  /* -------------------------------------------- */
+
+  class GpuTimer {
+  public:
+    GpuTimer(size_t num_samples = 512);           /* `num_samples` is the number of frames we keep for the percentiles. */
+    ~GpuTimer();
+    int add_section(const std::string& name);     /* Add sections before calling `init()`; returns the section id or < 0 on error. */
+    int init();                                   /* Creates the query objects; make sure the GL context is current. */
+    int shutdown();
+    void begin_frame();                           /* Reads back the oldest frame (when ready) and starts timing the "frame" section. */
+    void end_frame();
+    void begin(int section);
+    void end(int section);
+    void reset();                                 /* Discards the frames in flight and resets the stats, e.g. after warming up. */
+    void finish();                                /* Blocks until the frames in flight are done and collects them; use at the end of a benchmark. */
+    void print();                                 /* Prints the p50/p95/p99 of each section. */
+    int get_frame_section();                      /* Returns the id of the implicit "frame" section. */
+    GpuTimerSection* get_section(int section);
+    uint64_t get_num_dropped_frames();
+
+  private:
+    void read_results(GpuTimerFrame& frame);
+
+  private:
+    std::vector<GpuTimerSection*> sections;
+    GpuTimerFrame frames[GPU_TIMER_NUM_FRAMES];
+    std::chrono::steady_clock::time_point cpu_begin[GPU_TIMER_MAX_SECTIONS];
+    uint64_t frame_index;
+    uint64_t num_dropped_frames;
+    size_t num_samples;
+    bool is_init;
+  };
+
+  /* -------------------------------------------- */
+
+  inline int GpuTimer::get_frame_section() {
+    return 0;
+  }
+
+  inline uint64_t GpuTimer::get_num_dropped_frames() {
+    return num_dropped_frames;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
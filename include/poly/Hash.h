@@ -0,0 +1,54 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  HASH
+  ====
+
+  GENERAL INFO:
+
+    A fast, non-cryptographic 64-bit hash for content addressed
+    caches. We consume 8 bytes at a time (FNV-1a style, on words
+    instead of bytes) and finish with the MurmurHash3 mixer so
+    all input bits affect all output bits. It hashes a couple of
+    GB per second, which means hashing an asset is cheap compared
+    to loading it. Don't use it for anything security related.
+
+  USAGE:
+
+    uint64_t h = poly::hash_bytes(data, size);
+    h = poly::hash_bytes(more, more_size, h);   // continue hashing
+
+ */
+
+#ifndef POLY_HASH_H
+#define POLY_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* -------------------------------------------- */
+
+#define HASH_SEED 0xcbf29ce484222325ULL
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  uint64_t hash_bytes(const void* data, size_t nbytes, uint64_t seed = HASH_SEED);
+
+} /* namespace poly */
+
+#endif
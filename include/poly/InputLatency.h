@@ -0,0 +1,118 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  INPUT LATENCY
+  =============
+
+  GENERAL INFO:
+
+    `InputLatency` measures how long it takes before an input
+    event (mouse, keyboard) is visible. We timestamp every event
+    when GLFW hands it to us and keep the timestamp of the oldest
+    event that hasn't been used by a frame yet. The frame which
+    consumes the input marks each stage it passes through:
+
+      - camera:    the input was applied (e.g. to the camera).
+      - submit:    Filament's `render()` and `endFrame()` returned.
+      - composite: our own GL context drew Filament's texture.
+      - present:   `glfwSwapBuffers()` returned.
+
+    For each stage we keep a histogram and the percentiles of
+    the time between the input event and that stage. The
+    "present" stage is the closest we can get to photons without
+    external hardware; with vsync enabled the image is scanned
+    out at the next vblank after this.
+
+    Comparing `test-shared-gl-context` (Filament presents
+    directly) with `test-shared-gl-context-with-fbo` (we
+    composite Filament's texture in our own context) shows what
+    the shared-context indirection costs.
+
+  USAGE:
+
+    void cursor_callback(GLFWwindow* win, double x, double y) {
+      input_latency.on_input();
+    }
+
+    while (running) {
+      input_latency.begin_frame();
+      ... apply input ...
+      input_latency.mark(INPUT_LATENCY_STAGE_CAMERA);
+      ... render, composite, swap, marking each stage ...
+      input_latency.end_frame();
+    }
+
+    input_latency.print();
+
+    When a frame doesn't show its input (it wasn't rendered),
+    call `skip_frame()` before `end_frame()`; its marks are
+    dropped and its input counts for the next frame.
+
+  IMPORTANT:
+
+    GLFW calls the input callbacks on the main thread from
+    `glfwPollEvents()`; this class is not thread safe.
+
+ */
+
+#ifndef POLY_INPUT_LATENCY_H
+#define POLY_INPUT_LATENCY_H
+
+#include <stdint.h>
+#include <poly/Stats.h>
+
+/* -------------------------------------------- */
+
+#define INPUT_LATENCY_STAGE_CAMERA 0
+#define INPUT_LATENCY_STAGE_SUBMIT 1
+#define INPUT_LATENCY_STAGE_COMPOSITE 2
+#define INPUT_LATENCY_STAGE_PRESENT 3
+#define INPUT_LATENCY_NUM_STAGES 4
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  class InputLatency {
+  public:
+    InputLatency();
+    void on_input();                          /* Call this when an input event arrives; we timestamp it. */
+    void on_input(uint64_t arrival_ns);       /* Same as `on_input()` but with a timestamp from `get_time_ns()`. */
+    void begin_frame();                       /* The current frame consumes all input that arrived so far. */
+    void consume_late_input();                /* The current frame also consumes the input that arrived after `begin_frame()`, e.g. when it reprojects. */
+    void skip_frame();                        /* The current frame doesn't show its input (e.g. `beginFrame()` returned false); the next frame consumes it. */
+    void mark(int stage);                     /* Marks that the current frame reached the given stage. */
+    void end_frame();                         /* Adds the latencies of the current frame to the stats. */
+    void print();
+    static uint64_t get_time_ns();            /* Monotonic time in nanoseconds. */
+
+  private:
+    Histogram histograms[INPUT_LATENCY_NUM_STAGES];
+    RollingStats stats[INPUT_LATENCY_NUM_STAGES];
+    uint64_t stage_ns[INPUT_LATENCY_NUM_STAGES];
+    uint64_t pending_input_ns;               /* Arrival time of the oldest input that no frame consumed yet; 0 when there is none. */
+    uint64_t frame_input_ns;                 /* Arrival time of the oldest input consumed by the current frame; 0 when there is none. */
+    uint64_t num_events;
+    uint64_t num_frames_with_input;
+  };
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
@@ -0,0 +1,126 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  INPUT QUEUE
+  ===========
+
+  GENERAL INFO:
+
+    High rate mice can make GLFW call the cursor and scroll
+    callbacks hundreds of times per frame. Instead of handling
+    every event in the callback, the callbacks `push()` a small
+    `InputEvent` into this fixed capacity single-producer,
+    single-consumer ring and the render loop `drain()`s it once
+    per frame.
+
+    When the newest event in the ring is of the same kind as the
+    one we push, we merge them:
+
+      - cursor: we keep the latest position.
+      - scroll: we add up the offsets.
+
+    Button, key and char events are never merged, so every
+    press/release transition is preserved and in order. The
+    merged event keeps the arrival time of the first event so
+    latency measurements stay honest.
+
+    Char events (the `codepoint` of `glfwSetCharCallback()`) are
+    queued like key events, in order with them. What to do with
+    them is up to the consumer; the FBO host has no text input and
+    ignores them explicitly, its shortcuts are key events.
+
+    The cost of handling input per frame is bounded by the
+    capacity of the ring, regardless of the device rate. When the
+    ring is full we drop (and count) the event; as motion is
+    merged, the capacity is only reached when a frame takes
+    hundreds of clicks or key presses.
+
+  IMPORTANT:
+
+    The producer may only merge into an event the consumer isn't
+    reading. The index of the newest, still mergeable event is
+    stored in `open`. The producer claims it with a
+    compare-and-swap (marking it busy) before it merges and
+    reopens it afterwards with another compare-and-swap, so it
+    never reopens an event the consumer closed. `drain()` closes
+    it with a compare-and-swap too; when it finds it busy it
+    leaves it busy and skips the newest event it saw until the
+    next drain. Neither side ever waits for the other.
+
+ */
+
+#ifndef POLY_INPUT_QUEUE_H
+#define POLY_INPUT_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+/* -------------------------------------------- */
+
+#define INPUT_QUEUE_CAPACITY 256         /* Must be a power of two. */
+#define INPUT_QUEUE_INDEX_MASK 0x7FFFFFFF
+#define INPUT_QUEUE_OPEN_NONE 0xFFFFFFFF  /* There is no event the producer can merge into. */
+#define INPUT_QUEUE_OPEN_BUSY 0xFFFFFFFE  /* The producer is merging into the newest event. */
+
+#define INPUT_EVENT_CURSOR 1
+#define INPUT_EVENT_SCROLL 2
+#define INPUT_EVENT_BUTTON 3
+#define INPUT_EVENT_KEY 4
+#define INPUT_EVENT_CHAR 5
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct InputEvent {
+    uint32_t type;          /* One of the `INPUT_EVENT_*` types. */
+    int32_t button;         /* Button or key code. */
+    int32_t action;         /* GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT. */
+    int32_t mods;
+    uint32_t codepoint;     /* Unicode code point for char events. */
+    double x;               /* Cursor position, or the scroll offset. */
+    double y;
+    uint64_t arrival_ns;    /* When the (first merged) event arrived; see `InputLatency::get_time_ns()`. */
+    uint32_t num_merged;    /* How many device events were merged into this one. */
+  };
+
+  /* -------------------------------------------- */
+
+  class InputQueue {
+  public:
+    InputQueue();
+    bool push(const InputEvent& ev);                        /* Producer only; returns false when the event was dropped. */
+    uint32_t drain(InputEvent* out, uint32_t max_events);    /* Consumer only; returns the number of events copied into `out`. */
+    uint64_t get_num_dropped();
+    uint64_t get_num_merged();
+
+  private:
+    InputEvent events[INPUT_QUEUE_CAPACITY];
+    std::atomic<uint32_t> head;                             /* Written by the producer; index of the next free slot. */
+    std::atomic<uint32_t> tail;                             /* Written by the consumer; index of the oldest unread event. */
+    std::atomic<uint32_t> open;                             /* Index of the event the producer may merge into, or one of the `INPUT_QUEUE_OPEN_*` values. */
+    uint32_t last_type;                                     /* Producer only; type of the newest event we pushed. */
+    uint64_t num_dropped;
+    uint64_t num_merged;
+  };
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
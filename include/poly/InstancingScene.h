@@ -0,0 +1,165 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  INSTANCING SCENE
+  ================
+
+  GENERAL INFO:
+
+    A stress scene for crowd-like content: we spawn N instances
+    (1k - 100k) of one mesh on a square grid in the XZ-plane.
+    All instances share the vertex and index buffers through the
+    `MeshCache`; every instance is its own entity with its own
+    renderable and transform component, which is how our crowd
+    scenes are built.
+
+    `update()` spins every instance around its Y-axis, with a
+    different phase per instance. By default it composes the
+    matrices with the SIMD kernels of `poly/TransformBatch.h` and
+    commits them in one transaction; `set_batched(false)` uses
+    the scalar `mat4f` composition and one `setTransform()` per
+    instance, so we can compare both. We measure how long the
+    update takes; together with the time spent in
+    `Renderer::render()` (culling and command generation) and the
+    GPU time, this tells us where Filament's scaling wall is.
+
+    The grid always covers the same area (`extent` units wide),
+    we scale the instances down when we spawn more of them.
+
+    When the mesh cache generates lods (`MeshCache::set_lods()`)
+    `update_lods()` selects a level per instance from its size
+    on screen (see `poly/MeshLod.h`) and only touches the
+    renderables whose level changed. It also counts the
+    triangles we submit, with or without lods; culling is not
+    taken into account.
+
+    When the cache loads quantized meshes (`MESH_OPTIMIZE_QUANTIZE`)
+    we multiply every transform with the transform that maps the
+    positions back into the box of the mesh.
+
+  USAGE:
+
+    InstancingScene stress;
+    stress.init(engine, scene, &cache, "./monkey.filamesh", 10000);
+
+    // every frame, before `render()`
+    stress.update(time_in_seconds);
+    stress.update_lods(*camera);
+
+    stress.get_transform_stats().print(); // etc.
+    stress.shutdown();
+
+ */
+
+#ifndef POLY_INSTANCING_SCENE_H
+#define POLY_INSTANCING_SCENE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <filament/TransformManager.h>
+#include <poly/Stats.h>
+#include <poly/TransformBatch.h>
+
+/* -------------------------------------------- */
+
+namespace filament {
+  class Engine;
+  class Scene;
+  class Camera;
+}
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  class MeshCache;
+  struct MeshCacheEntry;
+
+  /* -------------------------------------------- */
+
+  class InstancingScene {
+  public:
+    InstancingScene();
+    ~InstancingScene();
+    int init(filament::Engine* engine, filament::Scene* scene, MeshCache* cache, const std::string& filepath, uint32_t num_instances, float extent = 40.0f);
+    int shutdown();
+    void update(double time);                        /* `time` in seconds. */
+    void update_lods(const filament::Camera& camera);
+    void set_batched(bool batched);                  /* Use the `TransformBatch` (default) or the scalar path. */
+    uint32_t get_num_instances();
+    RollingStats& get_transform_stats();             /* CPU time of `update()` in milliseconds. */
+    RollingStats& get_lod_stats();                   /* CPU time of `update_lods()` in milliseconds. */
+    uint32_t get_num_lod_levels();                   /* 1 when the mesh has no lods. */
+    uint64_t get_num_triangles();                    /* Submitted in the last `update_lods()`. */
+    uint64_t get_num_lod_switches();                 /* Since `init()` or `reset_stats()`. */
+    uint32_t get_num_vertex_bytes();                 /* Size of the vertex data that all instances share. */
+    void reset_stats();                              /* Resets the timings and the lod switch count, e.g. after a warmup. */
+
+  private:
+    void update_scalar(float angle);
+    void update_batched(float angle);
+
+  private:
+    filament::Engine* engine;
+    filament::Scene* scene;
+    MeshCache* cache;
+    std::vector<utils::Entity> entities;
+    std::vector<filament::TransformManager::Instance> transforms;
+    std::vector<float> positions;                    /* x, y, z per instance. */
+    std::vector<float> phases;                       /* Rotation offset per instance, in radians. */
+    std::vector<uint8_t> lod_levels;                 /* Current lod level per instance. */
+    MeshCacheEntry* mesh;                            /* The entry all instances share. */
+    float scale;
+    bool batched;
+    TransformBatch batch;
+    RollingStats transform_ms;
+    RollingStats lod_ms;
+    uint64_t num_triangles;
+    uint64_t num_lod_switches;
+  };
+
+  /* -------------------------------------------- */
+
+  inline void InstancingScene::set_batched(bool on) {
+    batched = on;
+  }
+
+  inline uint32_t InstancingScene::get_num_instances() {
+    return uint32_t(entities.size());
+  }
+
+  inline RollingStats& InstancingScene::get_transform_stats() {
+    return transform_ms;
+  }
+
+  inline RollingStats& InstancingScene::get_lod_stats() {
+    return lod_ms;
+  }
+
+  inline uint64_t InstancingScene::get_num_triangles() {
+    return num_triangles;
+  }
+
+  inline uint64_t InstancingScene::get_num_lod_switches() {
+    return num_lod_switches;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
@@ -0,0 +1,50 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  JSON
+  ====
+
+  GENERAL INFO:
+
+    The trace, the startup timeline, the benchmark results and
+    the reports of the tests are written as JSON with `fprintf()`.
+    Names in there come from file paths, the GL driver or the
+    command line, so they may contain quotes, backslashes or
+    control characters; `json_write_string()` writes them as a
+    quoted and escaped JSON string.
+
+  USAGE:
+
+    fprintf(fp, "{ \"name\": ");
+    poly::json_write_string(fp, name.c_str());
+    fprintf(fp, " }\n");
+
+ */
+
+#ifndef POLY_JSON_H
+#define POLY_JSON_H
+
+#include <stdio.h>
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  void json_write_string(FILE* fp, const char* str);          /* Writes `str` with quotes; nullptr is written as "". */
+
+} /* namespace poly */
+
+#endif
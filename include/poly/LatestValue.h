@@ -0,0 +1,115 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  LATEST VALUE
+  ============
+
+  GENERAL INFO:
+
+    `LatestValue<T>` is a lock-free single-producer,
+    single-consumer slot that always hands the reader the most
+    recent value that the writer stored. Intermediate values are
+    simply overwritten. We use it to pass the camera pose from
+    the input side to the render loop so the renderer can sample
+    it as late as possible without ever waiting for the input
+    side (and vice versa).
+
+    Internally this is a triple buffer: the writer owns the
+    "back" buffer, the reader owns the "front" buffer and the
+    "middle" buffer is exchanged atomically. The upper bit of
+    the middle index tells the reader that the writer published
+    a new value. Both `store()` and `load()` are wait free.
+
+  USAGE:
+
+    LatestValue<CameraPose> slot(initial_pose);
+
+    // writer thread
+    slot.store(pose);
+
+    // reader thread
+    CameraPose pose;
+    slot.load(pose);
+
+ */
+
+#ifndef POLY_LATEST_VALUE_H
+#define POLY_LATEST_VALUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  template<class T>
+  class LatestValue {
+  public:
+    LatestValue(const T& initial = T());
+    void store(const T& value);    /* Call from the writer thread only. */
+    bool load(T& value);           /* Call from the reader thread only; returns true when `value` was stored after the previous `load()`. */
+
+  private:
+    static const uint32_t INDEX_MASK = 0x3;
+    static const uint32_t NEW_BIT = 0x4;
+
+  private:
+    T buffers[3];
+    std::atomic<uint32_t> middle;
+    uint32_t back;
+    uint32_t front;
+  };
+
+  /* -------------------------------------------- */
+
+  template<class T>
+  LatestValue<T>::LatestValue(const T& initial)
+    :middle(1)
+    ,back(0)
+    ,front(2)
+  {
+    buffers[0] = initial;
+    buffers[1] = initial;
+    buffers[2] = initial;
+  }
+
+  template<class T>
+  void LatestValue<T>::store(const T& value) {
+    buffers[back] = value;
+    back = middle.exchange(back | NEW_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+  }
+
+  template<class T>
+  bool LatestValue<T>::load(T& value) {
+
+    bool is_new = false;
+
+    if (0 != (middle.load(std::memory_order_relaxed) & NEW_BIT)) {
+      front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+      is_new = true;
+    }
+
+    value = buffers[front];
+
+    return is_new;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
@@ -0,0 +1,96 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MAPPED FILE
+  ===========
+
+  GENERAL INFO:
+
+    Maps a file read-only into memory (`mmap()` on Linux,
+    `MapViewOfFile()` on Windows). Pages are only read from disk
+    when they are touched and they are backed by the page cache,
+    not by the heap, so mapping a file of 1GB doesn't allocate
+    1GB.
+
+  USAGE:
+
+    MappedFile file;
+    if (0 != file.open("./monkey.filamesh")) {
+      exit(EXIT_FAILURE);
+    }
+
+    parse(file.get_data(), file.get_size());
+    file.close();
+
+  IMPORTANT:
+
+    The destructor doesn't close the mapping for you; memory
+    handed to Filament must stay mapped until Filament calls the
+    release callback of the buffer descriptor, which happens
+    after we're long gone from the scope that opened the file.
+
+ */
+
+#ifndef POLY_MAPPED_FILE_H
+#define POLY_MAPPED_FILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  class MappedFile {
+  public:
+    MappedFile();
+    ~MappedFile();
+    int open(const std::string& filepath);
+    int close();
+    void prefault();                 /* Touches every page so the reads from disk happen now, on the calling thread. */
+    bool is_open();
+    const uint8_t* get_data();
+    size_t get_size();
+
+  private:
+    const uint8_t* data;
+    size_t size;
+#if defined(_WIN32)
+    void* file_handle;
+    void* map_handle;
+#endif
+  };
+
+  /* -------------------------------------------- */
+
+  inline bool MappedFile::is_open() {
+    return nullptr != data;
+  }
+
+  inline const uint8_t* MappedFile::get_data() {
+    return data;
+  }
+
+  inline size_t MappedFile::get_size() {
+    return size;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
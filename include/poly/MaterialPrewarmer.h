@@ -0,0 +1,169 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MATERIAL PREWARMER
+  ==================
+
+  GENERAL INFO:
+
+    Filament creates the GL program of a material variant the
+    first time it draws something with it, so the first frame
+    that shows a new material stalls while the driver compiles
+    and links. The prewarmer moves that to a moment of our
+    choice, e.g. while we show a loading screen: `prewarm()`
+    renders a quad with every material we added, one per frame,
+    into a tiny offscreen render target and waits until the
+    driver executed the frame.
+
+    Which variants Filament needs depends on the scene and the
+    view, so you describe those with `MaterialPrewarmFeatures`:
+    with `directional_light` we add a sun to our scene (the lit
+    variants), with `shadows` the quad casts and receives shadows
+    (the shadow receiver and depth variants) and
+    `post_processing` should match the view you render with, so
+    the post processing materials are compiled as well.
+
+    For every material we log how long its frame took. We first
+    render one frame without any renderable; the difference with
+    that frame is the time spent on the programs of the material.
+
+  USAGE:
+
+    MaterialPrewarmer prewarmer;
+    prewarmer.init(engine);
+    prewarmer.add(engine->getDefaultMaterial()->getDefaultInstance(), "default");
+    prewarmer.add(registry);
+    prewarmer.prewarm(renderer, swap_chain, features);
+    prewarmer.print();
+
+    // between frames, after a loader registered new materials
+    prewarmer.add(registry);
+    prewarmer.add(gltf_asset->asset);
+    if (0 != prewarmer.get_num_pending()) {
+      prewarmer.prewarm(renderer, swap_chain, features);
+    }
+
+    // at exit
+    prewarmer.shutdown();
+
+  IMPORTANT:
+
+    Call `prewarm()` between frames (not between `beginFrame()`
+    and `endFrame()`), from the thread that uses the engine. We
+    prewarm per `Material`; adding a second instance of a
+    material which we already have is a no-op. Materials that
+    were prewarmed are skipped by the next `prewarm()`, so you
+    can call it again after loading more meshes; it returns
+    right away when nothing is pending. The material instances
+    must stay alive until they were prewarmed.
+
+ */
+
+#ifndef POLY_MATERIAL_PREWARMER_H
+#define POLY_MATERIAL_PREWARMER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utils/Entity.h>
+#include <filameshio/MeshReader.h>
+
+/* -------------------------------------------- */
+
+#define MATERIAL_PREWARM_TARGET_SIZE 4         /* Width and height of our render target. */
+#define MATERIAL_PREWARM_MAX_SKIPPED 10        /* How many times `beginFrame()` may return false before we give up. */
+
+/* -------------------------------------------- */
+
+namespace filament {
+  class Engine;
+  class Renderer;
+  class SwapChain;
+  class Scene;
+  class View;
+  class Camera;
+  class Texture;
+  class RenderTarget;
+  class VertexBuffer;
+  class IndexBuffer;
+  class Material;
+  class MaterialInstance;
+}
+
+namespace gltfio {
+  class FilamentAsset;
+}
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct MaterialPrewarmFeatures {
+    bool directional_light;                     /* The scene has a directional light or sun. */
+    bool shadows;                               /* Renderables cast and receive shadows. */
+    bool post_processing;                       /* Same as `View::setPostProcessingEnabled()` of your view. */
+  };
+
+  /* -------------------------------------------- */
+
+  struct MaterialPrewarmEntry {
+    std::string name;
+    const filament::Material* material;
+    const filament::MaterialInstance* instance;
+    bool is_prewarmed;
+    double frame_ms;                            /* The frame that used the material, including the wait for the driver. */
+  };
+
+  /* -------------------------------------------- */
+
+  class MaterialPrewarmer {
+  public:
+    MaterialPrewarmer();
+    ~MaterialPrewarmer();
+    int init(filament::Engine* engine);
+    int shutdown();
+    int add(const filament::MaterialInstance* instance, const std::string& name);
+    int add(filamesh::MeshReader::MaterialRegistry& registry);  /* Adds all registered material instances. */
+    int add(const gltfio::FilamentAsset* asset);               /* Adds the material instances of a glTF asset. */
+    int prewarm(filament::Renderer* renderer, filament::SwapChain* swap_chain, const MaterialPrewarmFeatures& features);
+    size_t get_num_pending();                                  /* Materials which were added but not prewarmed yet. */
+    double get_total_ms();                                     /* Of all `prewarm()` calls. */
+    void print();
+
+  private:
+    int render_frame(filament::Renderer* renderer, filament::SwapChain* swap_chain, double& ms);
+
+  private:
+    filament::Engine* engine;
+    filament::Scene* scene;
+    filament::View* view;
+    filament::Camera* camera;
+    filament::Texture* color;
+    filament::Texture* depth;
+    filament::RenderTarget* render_target;
+    filament::VertexBuffer* vb;
+    filament::IndexBuffer* ib;
+    utils::Entity light;
+    std::vector<MaterialPrewarmEntry> entries;
+    double baseline_ms;                                        /* The last frame without a renderable. */
+    double total_ms;
+  };
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
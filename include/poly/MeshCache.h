@@ -0,0 +1,193 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MESH CACHE
+  ==========
+
+  GENERAL INFO:
+
+    Every call to `MeshReader::loadMeshFromFile()` creates new
+    vertex and index buffers, even when we load the same file a
+    hundred times. The `MeshCache` loads every unique mesh once
+    and shares its buffers and material instances between all
+    the renderables that use it. `MeshCache::get()` returns the
+    cache of the process; use it everywhere you load meshes so
+    they are deduplicated between the parts of the app too.
+
+    Parts whose material name is registered in the material
+    registry use that instance. For the other names we create
+    one instance of the default material per name, which all
+    entries share; these instances are owned by the cache and
+    destroyed in `shutdown()`.
+
+    Entries are keyed by the hash of the file contents (see
+    `poly/Hash.h`), so two paths with the same data share one
+    entry too. To avoid hashing a file every time we ask for it,
+    we remember the hash per path together with the size and
+    modification time of the file; when either changes we hash
+    (and load) it again.
+
+    `create_instance()` returns a new entity with a renderable
+    component which uses the shared buffers; it increments the
+    reference count of the entry. `destroy_instance()` destroys
+    the entity and decrements the count. Entries that aren't
+    referenced anymore stay in the cache, so creating a new
+    instance is cheap, until the total size of the vertex and
+    index data of all entries exceeds the budget; then we evict
+    the least recently used unreferenced entries. Referenced
+    entries are never evicted.
+
+    When you build the renderables yourself (e.g. with other
+    transforms or materials) use `acquire()` and `release()`.
+
+    After `set_optimize(true)` we load the meshoptimizer'd copy
+    of a file (see `poly/MeshOptimizer.h`) and create it when
+    it's missing or out of date. With `MESH_OPTIMIZE_QUANTIZE`
+    the instances get the transform that maps the quantized
+    positions back (see `poly/MeshLoader.h`).
+
+    After `set_lods(n)` we generate up to n levels of detail for
+    the meshes we load (see `poly/MeshLod.h`). Every instance
+    starts at level 0; `set_instance_lod()` switches the index
+    range of its renderable to another level.
+
+  USAGE:
+
+    MeshCache& cache = MeshCache::get();
+    cache.init(engine, &registry, 256 * 1024 * 1024);
+
+    for (int i = 0; i < 100; ++i) {
+      utils::Entity ent = cache.create_instance("./monkey.filamesh");
+      scene->addEntity(ent);
+    }
+
+    // ...
+
+    scene->remove(ent);
+    cache.destroy_instance(ent);
+    cache.shutdown();
+
+  IMPORTANT:
+
+    Use the cache from the thread that uses the engine. Call
+    `shutdown()` before you destroy the engine; it destroys the
+    buffers and all instances that you didn't destroy yet.
+
+ */
+
+#ifndef POLY_MESH_CACHE_H
+#define POLY_MESH_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filameshio/MeshReader.h>
+#include <poly/Filamesh.h>
+#include <poly/MeshLod.h>
+#include <poly/MeshOptimizer.h>
+
+/* -------------------------------------------- */
+
+#define MESH_CACHE_DEFAULT_BUDGET (256 * 1024 * 1024)
+
+/* -------------------------------------------- */
+
+namespace filament {
+  class Engine;
+  class VertexBuffer;
+  class IndexBuffer;
+  class MaterialInstance;
+}
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct MeshCacheEntry {
+    uint64_t hash;                                            /* Hash of the file contents. */
+    std::string filepath;                                     /* The path we loaded it from first. */
+    FilameshData data;                                        /* Header, parts and material names; `vertices` and `indices` are nullptr. */
+    filament::VertexBuffer* vb;
+    filament::IndexBuffer* ib;
+    std::vector<const filament::MaterialInstance*> materials; /* One per part. */
+    MeshLods lods;                                            /* Empty when lods are disabled. */
+    filament::IndexBuffer* lod_ib;                            /* The triangles of lod level 1 and up, or nullptr. */
+    uint32_t refcount;
+    uint64_t last_used;                                       /* Value of the cache tick when it was last acquired. */
+    size_t num_bytes;                                         /* Size of the vertex and index data, including the lods. */
+  };
+
+  /* -------------------------------------------- */
+
+  struct MeshCacheFileInfo {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+  };
+
+  /* -------------------------------------------- */
+
+  class MeshCache {
+  public:
+    MeshCache();
+    ~MeshCache();
+    int init(filament::Engine* engine, filamesh::MeshReader::MaterialRegistry* materials, size_t budget = MESH_CACHE_DEFAULT_BUDGET);
+    int shutdown();
+    static MeshCache& get();                                  /* The cache of the process. */
+    MeshCacheEntry* acquire(const std::string& filepath);     /* Returns nullptr when the file can't be loaded. */
+    void release(MeshCacheEntry* entry);
+    utils::Entity create_instance(const std::string& filepath); /* Returns a null entity when the file can't be loaded. */
+    int destroy_instance(utils::Entity entity);
+    MeshCacheEntry* get_instance_entry(utils::Entity entity); /* The entry whose buffers `entity` uses, or nullptr. */
+    int set_instance_lod(utils::Entity entity, uint32_t level);
+    void set_budget(size_t budget);
+    void set_optimize(bool optimize, uint32_t flags = MESH_OPTIMIZE_DEFAULT); /* Load the optimized copy of the files; see `poly/MeshOptimizer.h`. */
+    void set_lods(uint32_t num_levels);                       /* Generate lods for meshes we load from now on; 0 or 1 disables them. */
+    size_t get_num_entries();
+    size_t get_num_bytes();
+    void print();
+
+  private:
+    MeshCacheEntry* load(const std::string& filepath, MeshCacheFileInfo& info);
+    void get_materials(const FilameshData& data, std::vector<const filament::MaterialInstance*>& result);
+    void evict();
+    void destroy_entry(MeshCacheEntry* entry);
+
+  private:
+    filament::Engine* engine;
+    filamesh::MeshReader::MaterialRegistry* materials;
+    std::unordered_map<uint64_t, MeshCacheEntry*> entries;      /* Keyed by the content hash. */
+    std::unordered_map<std::string, MeshCacheFileInfo> files;   /* The hash of every file we loaded. */
+    std::unordered_map<uint32_t, MeshCacheEntry*> instances;    /* Keyed by the entity id. */
+    std::unordered_map<std::string, filament::MaterialInstance*> material_instances; /* Created by us for names that aren't registered. */
+    size_t budget;
+    bool optimize;
+    uint32_t optimize_flags;
+    uint32_t num_lods;
+    size_t num_bytes;
+    uint64_t tick;
+    uint64_t num_hits;
+    uint64_t num_content_hits;                                  /* A different path with contents we already had. */
+    uint64_t num_misses;
+    uint64_t num_evictions;
+  };
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
@@ -0,0 +1,168 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MESH LOADER
+  ===========
+
+  GENERAL INFO:
+
+    `filamesh::MeshReader::loadMeshFromFile()` reads the whole
+    file into the heap before it hands the vertex and index data
+    to Filament. `mesh_load_mapped()` maps the file instead and
+    passes the vertex and index regions of the mapping straight
+    to `VertexBuffer::setBufferAt()` and `IndexBuffer::setBuffer()`.
+    The file is unmapped from the release callback of the last
+    buffer descriptor, i.e. once the backend uploaded the data.
+    The only copy left is the upload into the GPU buffers.
+
+    `mesh_create()` does the work for any `FilameshData`; you
+    pass a callback which is called exactly once, when Filament
+    doesn't need the memory that `data` points into anymore. It's
+    also called when `mesh_create()` fails, so the memory is
+    always released from the same place. When `result.renderable`
+    is set we build the renderable component on that entity,
+    otherwise we create a new entity (and destroy it again when
+    we fail).
+
+    `mesh_create()` is built from three steps which you can use
+    on their own when you want to share the buffers and material
+    instances between renderables (see `MeshCache`):
+
+      mesh_create_buffers()       creates and fills the vertex and index buffer.
+      mesh_get_materials()        resolves the material instance of every part.
+      mesh_create_renderable()    adds a renderable component to an entity.
+
+    Quantized filamesh files (see `poly/MeshQuantizer.h`) store
+    their positions relative to the bounding box of the mesh.
+    `mesh_create_renderable()` multiplies the transform of the
+    entity with `mesh_get_position_transform()`, which maps them
+    back, and creates the transform component when the entity
+    doesn't have one yet.
+
+    `mesh_load_archive()` does the same for an entry of an
+    `AssetArchive`: the buffers point straight into the mapping
+    of the archive (or into the entry that the archive decoded),
+    so nothing is copied but the archive must stay open until
+    Filament released the buffers, e.g. until after
+    `Engine::flushAndWait()` when you destroy the mesh.
+
+    Compressed filamesh files can't be used without decoding
+    them first; `mesh_load_mapped()` falls back to
+    `MeshReader::loadMeshFromFile()` and `mesh_load_archive()` to
+    `MeshReader::loadMeshFromBuffer()` for those.
+
+  USAGE:
+
+    filamesh::MeshReader::MaterialRegistry registry;
+    filamesh::MeshReader::Mesh mesh;
+
+    if (0 != mesh_load_mapped(engine, "./monkey.filamesh", registry, mesh)) {
+      exit(EXIT_FAILURE);
+    }
+
+    scene->addEntity(mesh.renderable);
+
+    // Or from an archive that stays open.
+    if (0 != mesh_load_archive(engine, archive, "monkey.filamesh", registry, mesh)) {
+      exit(EXIT_FAILURE);
+    }
+
+  IMPORTANT:
+
+    When you set the transform of a renderable with a quantized
+    mesh yourself, multiply it with `mesh_get_position_transform()`
+    on the right.
+
+ */
+
+#ifndef POLY_MESH_LOADER_H
+#define POLY_MESH_LOADER_H
+
+#include <string>
+#include <vector>
+#include <math/mat4.h>
+#include <filameshio/MeshReader.h>
+#include <poly/Filamesh.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  class AssetArchive;
+
+  /* -------------------------------------------- */
+
+  typedef void(*MeshReleaseCallback)(void* user);
+
+  /* -------------------------------------------- */
+
+  int mesh_create_buffers(
+    filament::Engine* engine,
+    const FilameshData& data,
+    MeshReleaseCallback release,                    /* Called exactly once when the memory of `data` isn't used anymore, also on failure; may be nullptr. */
+    void* user,
+    filament::VertexBuffer** vb,
+    filament::IndexBuffer** ib
+  );
+
+  int mesh_get_materials(
+    filament::Engine* engine,
+    const FilameshData& data,
+    filamesh::MeshReader::MaterialRegistry& registry,
+    std::vector<const filament::MaterialInstance*>& result  /* Parts without a registered material get the default material instance. */
+  );
+
+  int mesh_create_renderable(
+    filament::Engine* engine,
+    const FilameshData& data,                       /* Only the header, parts and materials are used. */
+    filament::VertexBuffer* vb,
+    filament::IndexBuffer* ib,
+    const std::vector<const filament::MaterialInstance*>& materials,
+    utils::Entity entity
+  );
+
+  filament::math::mat4f mesh_get_position_transform(const FilameshHeader& header); /* Identity, unless the mesh is quantized. */
+  void mesh_unmap_file(void* user);                 /* A `MeshReleaseCallback` that closes and deletes the `MappedFile*` in `user`. */
+
+  int mesh_create(
+    filament::Engine* engine,
+    const FilameshData& data,
+    MeshReleaseCallback release,                    /* Called exactly once when the memory of `data` isn't used anymore, also on failure; may be nullptr. */
+    void* user,
+    filamesh::MeshReader::MaterialRegistry& materials,
+    filamesh::MeshReader::Mesh& result
+  );
+
+  int mesh_load_mapped(
+    filament::Engine* engine,
+    const std::string& filepath,
+    filamesh::MeshReader::MaterialRegistry& materials,
+    filamesh::MeshReader::Mesh& result
+  );
+
+  int mesh_load_archive(
+    filament::Engine* engine,
+    AssetArchive& archive,                          /* Must stay open until Filament released the buffers. */
+    const std::string& name,
+    filamesh::MeshReader::MaterialRegistry& materials,
+    filamesh::MeshReader::Mesh& result
+  );
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
@@ -0,0 +1,111 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MESH LOD
+  ========
+
+  GENERAL INFO:
+
+    Builds levels of detail for a filamesh with meshoptimizer's
+    simplifier and selects a level per instance from the size of
+    the instance on screen.
+
+    All levels share the vertex buffer of the mesh; a level is
+    only a different set of triangles. Level 0 is the mesh
+    itself, so its index ranges point into the index buffer of
+    the mesh. The triangles of the other levels are stored one
+    after the other in `MeshLods::indices`, which
+    `mesh_create_lod_buffer()` uploads into one extra index
+    buffer. Switching the level of a renderable is a call to
+    `RenderableManager::setGeometryAt()` per part; see
+    `MeshCache::set_instance_lod()`.
+
+    Every level has a quarter of the triangles of the previous
+    one, and is used until the bounding sphere of the mesh covers
+    less than half the screen height of the previous level; so
+    the triangle density on screen stays about the same. When a
+    level can't be simplified much further we stop adding levels.
+
+    `mesh_select_lod()` applies hysteresis: we only switch to a
+    coarser level when the screen size drops `MESH_LOD_HYSTERESIS`
+    below the threshold, and back when it rises the same amount
+    above it. Without this, an instance right at the threshold
+    would pop between two levels every frame.
+
+  USAGE:
+
+    MeshLods lods;
+    mesh_generate_lods(data, 4, lods);
+    mesh_create_lod_buffer(engine, lods, data.header.vertex_count, &lod_ib);
+
+    // per instance, every frame
+    float size = mesh_get_screen_size(lods, position, scale, camera_position, projection[1][1]);
+    level = mesh_select_lod(lods, size, level);
+
+ */
+
+#ifndef POLY_MESH_LOD_H
+#define POLY_MESH_LOD_H
+
+#include <stdint.h>
+#include <vector>
+#include <poly/Filamesh.h>
+
+/* -------------------------------------------- */
+
+#define MESH_LOD_MAX_LEVELS 4
+#define MESH_LOD_TRIANGLE_RATIO 0.25f          /* Triangles of a level compared to the previous level. */
+#define MESH_LOD_MIN_REDUCTION 0.8f            /* A level must have less than this times the triangles of the previous one. */
+#define MESH_LOD_BASE_ERROR 0.01f              /* Simplification error of level 1, relative to the mesh extents; doubles per level. */
+#define MESH_LOD_SCREEN_SIZE 0.5f              /* Screen size (diameter / viewport height) below which we use level 1. */
+#define MESH_LOD_HYSTERESIS 0.15f
+
+/* -------------------------------------------- */
+
+namespace filament {
+  class Engine;
+  class IndexBuffer;
+}
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct MeshLodLevel {
+    std::vector<FilameshPart> parts;             /* Index range per part; level 0 points into the mesh, other levels into `MeshLods::indices`. */
+    uint32_t num_triangles;
+    float min_screen_size;                       /* We use this level down to this screen size; 0 for the last level. */
+  };
+
+  struct MeshLods {
+    std::vector<uint32_t> indices;               /* The triangles of level 1 and up. */
+    std::vector<MeshLodLevel> levels;
+    float center[3];                             /* Bounding sphere of the mesh. */
+    float radius;
+  };
+
+  /* -------------------------------------------- */
+
+  int mesh_generate_lods(const FilameshData& data, uint32_t max_levels, MeshLods& result);
+  int mesh_create_lod_buffer(filament::Engine* engine, const MeshLods& lods, uint32_t vertex_count, filament::IndexBuffer** ib);
+  float mesh_get_screen_size(const MeshLods& lods, const float position[3], float scale, const float camera_position[3], float projection_scale);
+  uint32_t mesh_select_lod(const MeshLods& lods, float screen_size, uint32_t current_level);
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
@@ -0,0 +1,133 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MESH OPTIMIZER
+  ==============
+
+  GENERAL INFO:
+
+    Runs meshoptimizer (which Filament ships and we already link)
+    over filamesh data, so the GPU transforms and fetches fewer
+    vertices without re-exporting the assets. `mesh_optimize()`:
+
+      - reorders the triangles of every part for the post
+        transform vertex cache (`meshopt_optimizeVertexCache`);
+      - reorders them again, within a small cache penalty, to
+        reduce overdraw (`meshopt_optimizeOverdraw`);
+      - reorders the vertices in the order they are first used
+        and drops unused ones (`meshopt_optimizeVertexFetch`);
+      - stores the indices as USHORT when the vertex count allows.
+
+    With `MESH_OPTIMIZE_COMPRESS` we also encode the vertex and
+    index streams with meshoptimizer's codecs and set
+    `FILAMESH_FLAG_COMPRESSION`; this is the layout of Filament's
+    `filamesh --compress`. The file gets a lot smaller, but it
+    must be decoded on load: `mesh_decompress()` decodes it into
+    the heap, which the async loader does on its workers; the
+    other zero-copy loaders hand it to `filamesh::MeshReader` and
+    the `MeshCache` doesn't accept it.
+
+    With `MESH_OPTIMIZE_QUANTIZE` we store the vertices in the
+    compact format of `poly/MeshQuantizer.h` instead; this can't
+    be combined with compression, Filament's `MeshReader` doesn't
+    know the quantized format.
+
+    `mesh_get_optimized()` caches the result on disk, next to
+    the source: `monkey.filamesh` becomes `monkey.opt.filamesh`
+    (or `monkey.optz.filamesh` when compressed and
+    `monkey.optq.filamesh` when quantized). We optimize
+    again when the source is newer than the cached file. Pass a
+    `MeshOptimizeResult` to get the statistics too; when the
+    cached file is up to date we optimize the source again, in
+    memory, to get them, so only ask for them when you report
+    them (e.g. in a benchmark).
+
+  USAGE:
+
+    std::string path;
+    mesh_get_optimized("./monkey.filamesh", MESH_OPTIMIZE_DEFAULT, path);
+
+    // `path` is the optimized file, or the source when we failed.
+    mesh_load_mapped(engine, path, registry, mesh);
+
+  IMPORTANT:
+
+    Positions must be HALF4, as written by Filament's `filamesh`
+    tool. Files that are already compressed can't be optimized.
+    `mesh_get_optimized()` may be called from multiple threads;
+    the cached file is written to a temporary file first and
+    then renamed.
+
+ */
+
+#ifndef POLY_MESH_OPTIMIZER_H
+#define POLY_MESH_OPTIMIZER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <poly/Filamesh.h>
+#include <poly/MeshQuantizer.h>
+
+/* -------------------------------------------- */
+
+#define MESH_OPTIMIZE_DEFAULT 0x00
+#define MESH_OPTIMIZE_COMPRESS 0x01                  /* Encode the vertex and index streams. */
+#define MESH_OPTIMIZE_QUANTIZE 0x02                  /* Store the vertices in the quantized format of `poly/MeshQuantizer.h`. */
+#define MESH_OPTIMIZE_OVERDRAW_THRESHOLD 1.05f       /* How much worse the vertex cache may get to reduce overdraw. */
+#define MESH_OPTIMIZE_CACHE_SIZE 16                  /* The vertex cache size we use to analyze the results. */
+#define MESH_OPTIMIZE_SUFFIX ".opt.filamesh"
+#define MESH_OPTIMIZE_COMPRESSED_SUFFIX ".optz.filamesh"
+#define MESH_OPTIMIZE_QUANTIZED_SUFFIX ".optq.filamesh"
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct MeshOptimizeResult {
+    FilameshHeader header;
+    std::vector<uint8_t> vertices;
+    std::vector<uint8_t> indices;
+    std::vector<FilameshPart> parts;
+
+    /* Statistics */
+    float acmr_before;                               /* Average number of transformed vertices per triangle. */
+    float acmr_after;
+    float overfetch_before;                          /* Fetched vertex bytes / vertex buffer size. */
+    float overfetch_after;
+    uint32_t vertex_count_before;
+    uint32_t vertex_count_after;
+    size_t num_bytes_before;                         /* Vertex and index data. */
+    size_t num_bytes_after;
+    MeshQuantizeStats quantize_stats;                /* Only set with `MESH_OPTIMIZE_QUANTIZE`. */
+  };
+
+  /* -------------------------------------------- */
+
+  int mesh_optimize(const FilameshData& input, uint32_t flags, MeshOptimizeResult& result);
+  int mesh_optimize_file(const std::string& filepath, const std::string& output, uint32_t flags, MeshOptimizeResult* result = nullptr);
+  int mesh_get_optimized(const std::string& filepath, uint32_t flags, std::string& result, MeshOptimizeResult* stats = nullptr);  /* Sets `result` to the cached file, or to `filepath` when we return < 0. */
+  std::string mesh_get_optimized_filepath(const std::string& filepath, uint32_t flags);
+  int mesh_decompress(const FilameshData& input, FilameshHeader& header, std::vector<uint8_t>& vertices, std::vector<uint8_t>& indices); /* Decodes a compressed mesh; `header` describes the decoded `vertices` and `indices`. */
+  void mesh_optimize_print(const MeshOptimizeResult& result);
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
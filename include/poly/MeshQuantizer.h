@@ -0,0 +1,125 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MESH QUANTIZER
+  ==============
+
+  GENERAL INFO:
+
+    Converts the vertex data of a filamesh into a more compact
+    format, `FILAMESH_FLAG_QUANTIZED` (see `poly/Filamesh.h`):
+
+      attribute     filamesh          quantized
+      ---------     --------          ---------
+      position      HALF4 (8)         SHORT4, normalized (8)
+      tangents      SHORT4 (8)        BYTE4, normalized (4)
+      color         UBYTE4 (4)        UBYTE4 (4)
+      uv0, uv1      HALF2/SHORT2 (4)  HALF2/SHORT2 (4)
+
+    Positions are stored relative to the bounding box of the
+    mesh: -1 and 1 are the minimum and maximum of the box on
+    each axis (but see the tangent frames below). This gives us 16 bits over the extent of the mesh
+    instead of the 11 bit mantissa of a half, so the quantized
+    positions are more precise than the source and not less.
+    The GPU has to map them back: the renderable (or instance)
+    transform must be multiplied with
+    `mesh_get_position_transform()`, which `mesh_create_renderable()`
+    does for you.
+
+    The tangent frame is a quaternion; we store it with 8 bits
+    per component, which is an error of about a degree in the
+    normal. The sign of `w` encodes the handedness of the
+    frame, so we make sure it never rounds to 0. UVs are
+    already 4 bytes in the filamesh format and are copied.
+
+    Because the position transform scales the axes differently,
+    and Filament transforms the normal and the tangent with its
+    inverse transpose, we store the frame in the scaled space
+    (both scaled by the half extent, the tangent made orthogonal
+    to the normal again) so the GPU ends up with the source
+    frame. The 8 bit error grows with the ratio of the axes, and
+    a tangent which doesn't lie along an axis ends up leaning
+    towards the normal. So when the largest half extent is more
+    than twice the smallest one, or when a tangent would lean
+    more than a quarter of a degree, we use the largest half
+    extent for all axes instead; the frames are then stored as
+    they are.
+
+    A vertex becomes 20 bytes instead of 24. `mesh_quantize()`
+    measures the position, normal and tangent errors of what the
+    GPU ends up with (after the position transform) against the
+    source; `mesh_quantize_print()` prints them.
+
+    Use `MESH_OPTIMIZE_QUANTIZE` to quantize the cached file of
+    `mesh_get_optimized()`; that's how the loaders use this.
+
+  USAGE:
+
+    MeshQuantizeResult result;
+    mesh_quantize(data, result);
+    mesh_quantize_print(result.stats);
+
+    // `result.header` and `result.vertices` replace the header
+    // and vertex data of `data`; the indices don't change.
+
+  IMPORTANT:
+
+    The input may not be compressed or quantized already.
+    Filament's `filamesh::MeshReader` can't read quantized files;
+    use our loaders (`poly/MeshLoader.h`).
+
+ */
+
+#ifndef POLY_MESH_QUANTIZER_H
+#define POLY_MESH_QUANTIZER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <poly/Filamesh.h>
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct MeshQuantizeStats {
+    float max_position_error;                        /* Distance between the source and quantized position, in mesh units. */
+    float rms_position_error;
+    float max_normal_error;                          /* Angle between the source and quantized normal after the position transform, in degrees. */
+    float mean_normal_error;
+    float max_tangent_error;                         /* Angle between the source and quantized tangent after the position transform, in degrees. */
+    size_t num_bytes_before;                         /* Vertex data. */
+    size_t num_bytes_after;
+  };
+
+  struct MeshQuantizeResult {
+    FilameshHeader header;
+    std::vector<uint8_t> vertices;
+    MeshQuantizeStats stats;
+  };
+
+  /* -------------------------------------------- */
+
+  int mesh_quantize(const FilameshData& input, MeshQuantizeResult& result);
+  void mesh_quantize_print(const MeshQuantizeStats& stats);
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
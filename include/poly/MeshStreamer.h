@@ -0,0 +1,191 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MESH STREAMER
+  =============
+
+  GENERAL INFO:
+
+    Streams the chunks of a scene which is too large to load
+    before the first frame. You add every chunk (a filamesh file,
+    the position where we place it and the radius of a sphere
+    around that position which contains it) and call `update()`
+    with the camera every frame. We then:
+
+      - unload the chunks which are further away than
+        `unload_distance` or became too small on screen;
+      - request the chunks within `load_distance` which are
+        large enough on screen, the largest on screen first, but
+        never more than `max_loading` at the same time;
+      - let the `AsyncMeshLoader` create the buffers of the
+        parsed chunks within the budget of this frame:
+        `max_upload_bytes` of vertex and index data and
+        `max_create_ms` of main thread time.
+
+    The size on screen is the same measure as the one we use to
+    select a level of detail (see `mesh_get_screen_size()`), so
+    the priority combines the distance and the size of a chunk:
+    a large building far away comes before a small one close by.
+    Because `unload_distance` is larger than `load_distance`, and
+    a chunk is only unloaded when its size drops well below
+    `min_screen_size`, a camera on the border doesn't make a
+    chunk load and unload every frame.
+
+    Loading uses the `AsyncMeshLoader` you pass into `init()`, so
+    the files are mapped and parsed on its workers. Create it
+    with `set_placeholders(false)`; otherwise every chunk shows a
+    placeholder cube while it loads. Chunks are added to and
+    removed from the scene with `Scene::addEntity()` and
+    `Scene::remove()`; unloading destroys the buffers and the
+    entity.
+
+  USAGE:
+
+    AsyncMeshLoader loader;
+    loader.set_placeholders(false);
+    loader.init(engine, scene, &registry);
+
+    MeshStreamer streamer;
+    streamer.init(engine, scene, &loader);
+    streamer.add_chunk("./city/chunk-0-0.filamesh", position, radius);
+
+    // every frame, instead of `loader.update()`
+    streamer.update(camera_position, camera->getProjectionMatrix()[1][1]);
+
+    // at exit
+    streamer.shutdown();
+    loader.shutdown();
+
+  IMPORTANT:
+
+    Export chunks relative to their position: far away from the
+    origin a float can't represent vertex positions precisely.
+    Call `shutdown()` before you shut down the loader; it waits
+    until the chunks which are loading are done.
+
+ */
+
+#ifndef POLY_MESH_STREAMER_H
+#define POLY_MESH_STREAMER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utils/Entity.h>
+
+/* -------------------------------------------- */
+
+#define MESH_STREAMER_CHUNK_UNLOADED 0
+#define MESH_STREAMER_CHUNK_LOADING 1        /* Requested from the loader; not drawn yet. */
+#define MESH_STREAMER_CHUNK_RESIDENT 2
+#define MESH_STREAMER_CHUNK_FAILED 3         /* We don't try again. */
+#define MESH_STREAMER_HYSTERESIS 0.5f        /* Unload when the size on screen drops below this times `min_screen_size`. */
+
+/* -------------------------------------------- */
+
+namespace filament {
+  class Engine;
+  class Scene;
+}
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  class AsyncMeshLoader;
+  struct AsyncMesh;
+
+  /* -------------------------------------------- */
+
+  struct MeshStreamerSettings {
+    float load_distance;                       /* Load chunks whose bounding sphere is closer than this. */
+    float unload_distance;                     /* Unload chunks whose bounding sphere is further than this. */
+    float min_screen_size;                     /* Don't load chunks which are smaller on screen, see `mesh_get_screen_size()`. */
+    uint32_t max_loading;                      /* Chunks requested from the loader at the same time. */
+    uint64_t max_upload_bytes;                 /* Vertex and index data per frame; 0 is no limit. */
+    double max_create_ms;                      /* Main thread time per frame to create buffers; 0 is no limit. */
+  };
+
+  struct MeshStreamerChunk {
+    std::string filepath;
+    float position[3];
+    float radius;
+    uint32_t state;                            /* One of the `MESH_STREAMER_CHUNK_*` values. */
+    float distance;                            /* From the camera to the bounding sphere, at the last `update()`. */
+    float screen_size;                         /* At the last `update()`. */
+    uint64_t num_bytes;                        /* Vertex and index data, when resident. */
+    utils::Entity entity;
+    AsyncMesh* mesh;                           /* While loading or resident. */
+  };
+
+  struct MeshStreamerStats {
+    uint32_t num_resident;
+    uint32_t num_loading;
+    uint32_t num_waiting;                      /* Parsed, waiting for a frame with budget left. */
+    uint64_t num_resident_bytes;
+    uint64_t num_upload_bytes;                 /* This frame. */
+    double create_ms;                          /* This frame. */
+    uint64_t num_loads;                        /* Since `init()`. */
+    uint64_t num_unloads;                      /* Since `init()`. */
+  };
+
+  /* -------------------------------------------- */
+
+  class MeshStreamer {
+  public:
+    MeshStreamer();
+    ~MeshStreamer();
+    int init(filament::Engine* engine, filament::Scene* scene, AsyncMeshLoader* loader);
+    int shutdown();                            /* Waits for the chunks which are loading and unloads everything. */
+    void set_settings(const MeshStreamerSettings& settings);
+    MeshStreamerSettings get_settings();
+    int add_chunk(const std::string& filepath, const float position[3], float radius); /* Returns the index of the chunk or < 0 on error. */
+    void update(const float camera_position[3], float projection_scale); /* Call once per frame, from the thread that uses the engine. */
+    const MeshStreamerStats& get_stats();
+    size_t get_num_chunks();
+    const MeshStreamerChunk* get_chunk(size_t index);
+
+  private:
+    void sync_chunk(MeshStreamerChunk* chunk);
+    void load_chunk(MeshStreamerChunk* chunk);
+    void unload_chunk(MeshStreamerChunk* chunk);
+    void set_transform(MeshStreamerChunk* chunk);
+
+  private:
+    filament::Engine* engine;
+    filament::Scene* scene;
+    AsyncMeshLoader* loader;
+    MeshStreamerSettings settings;
+    MeshStreamerStats stats;
+    std::vector<MeshStreamerChunk*> chunks;    /* Owned by us. */
+    std::vector<MeshStreamerChunk*> candidates; /* Scratch for `update()`, so it doesn't allocate every frame. */
+  };
+
+  /* -------------------------------------------- */
+
+  inline const MeshStreamerStats& MeshStreamer::get_stats() {
+    return stats;
+  }
+
+  inline size_t MeshStreamer::get_num_chunks() {
+    return chunks.size();
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
@@ -0,0 +1,148 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  SHADER MANAGER
+  ==============
+
+  GENERAL INFO:
+
+    Compiles and links the GL programs of the host (our own 2D
+    shaders, not Filament's) and caches the linked programs on
+    disk with `glGetProgramBinary()`. At the next start we load
+    the binary with `glProgramBinary()` instead of compiling the
+    sources, which is usually a lot faster.
+
+    A cached binary is only valid for the same sources and the
+    same driver, so every file starts with the hash of the
+    sources and the hash of the driver identity (`GL_VENDOR`,
+    `GL_RENDERER`, `GL_VERSION` and
+    `GL_SHADING_LANGUAGE_VERSION`). When one of those doesn't
+    match, or the driver rejects the binary anyway (which is
+    allowed, e.g. after an update), we compile from source and
+    write a new file.
+
+    When the driver supports `GL_KHR_parallel_shader_compile`
+    (or the ARB version), `add()` doesn't block: it submits the
+    compile and link and the driver works on them on its own
+    threads. `update()` polls `GL_COMPLETION_STATUS_KHR` and
+    finishes the programs which are done (checks the status,
+    prints the logs and saves the binary), so you can add
+    dozens of programs and do other work in the meantime.
+    `finish()` waits for all of them. Without the extension the
+    driver compiles when we ask for the status, i.e. in
+    `update()` or `finish()`.
+
+  USAGE:
+
+    ShaderManager shaders;
+    shaders.init("./");
+
+    ShaderProgram* composite = shaders.add("composite", VS, FS);
+    ...
+    shaders.finish();
+    shaders.print();
+
+    if (SHADER_PROGRAM_STATE_READY == composite->state) {
+      glUseProgram(composite->id);
+    }
+
+    shaders.shutdown();
+
+  IMPORTANT:
+
+    All functions must be called with the same GL context
+    current; the programs belong to that context (and the ones
+    that share with it). Pass an empty cache directory to
+    `init()` to disable the cache. The cache files are written
+    as `<cache_dir>/<name>.glprogram`, so use unique names.
+
+ */
+
+#ifndef POLY_SHADER_MANAGER_H
+#define POLY_SHADER_MANAGER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/* -------------------------------------------- */
+
+#define SHADER_PROGRAM_STATE_COMPILING 0     /* Submitted; the driver may still be compiling and linking. */
+#define SHADER_PROGRAM_STATE_READY 1
+#define SHADER_PROGRAM_STATE_FAILED 2
+
+#define SHADER_CACHE_MAGIC 0x42505350        /* "PSPB" */
+#define SHADER_CACHE_VERSION 1
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct ShaderProgram {
+    std::string name;
+    uint32_t id;                                 /* The GL program. */
+    uint32_t state;                              /* One of the `SHADER_PROGRAM_STATE_*` values. */
+    bool is_cached;                              /* Loaded from the program binary. */
+    double submit_ms;                            /* Spent in `add()`. */
+    double total_ms;                             /* From `add()` until it was ready or failed. */
+
+    /* Internal */
+    std::string vs;
+    std::string fs;
+    uint32_t vert;
+    uint32_t frag;
+    uint64_t source_hash;
+    uint64_t add_ns;
+  };
+
+  /* -------------------------------------------- */
+
+  class ShaderManager {
+  public:
+    ShaderManager();
+    ~ShaderManager();
+    int init(const std::string& cache_dir);     /* Call with the GL context current. */
+    int shutdown();                             /* Deletes all programs. */
+    ShaderProgram* add(const std::string& name, const std::string& vs, const std::string& fs);
+    void update();                              /* Finishes the programs which the driver completed; never blocks when parallel compiling is supported. */
+    int finish();                               /* Waits for all programs; returns < 0 when one of them failed. */
+    size_t get_num_pending();
+    void print();
+
+  private:
+    int load_binary(ShaderProgram* prog);
+    int save_binary(ShaderProgram* prog);
+    void compile(ShaderProgram* prog);
+    void complete(ShaderProgram* prog);
+    std::string get_cache_filepath(ShaderProgram* prog);
+
+  private:
+    std::string cache_dir;
+    std::vector<ShaderProgram*> programs;       /* All programs, owned by us. */
+    std::vector<ShaderProgram*> pending;
+    uint64_t driver_hash;
+    bool is_init;
+    bool is_cache_supported;                    /* The driver supports at least one binary format. */
+    bool is_parallel;                           /* `GL_KHR_parallel_shader_compile` or the ARB version. */
+  };
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
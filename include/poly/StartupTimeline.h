@@ -0,0 +1,120 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  STARTUP TIMELINE
+  ================
+
+  GENERAL INFO:
+
+    Records the steps of the startup as a small dependency graph
+    and prints them as a timeline. You add every task with the
+    tasks it depends on and the thread it runs on, then call
+    `begin()` and `end()` around the work. Tasks on different
+    threads overlap; `print()` shows when every task ran and the
+    critical path: starting at the task which ended last we walk
+    back through the dependency that ended last. The critical
+    path is what we have to make shorter to start faster; the
+    tasks which are not on it are hidden behind it.
+
+    Every task is also recorded with `trace_record()`, so it
+    shows up in the Chrome trace when profiling is enabled.
+
+    `save_json()` writes the same report as JSON, with the
+    begin and end of every task in milliseconds since the
+    timeline was created (we use the monotonic clock of
+    `trace_now()`). When the last task is the first presented
+    frame, `critical_path_ms` is the time to first frame, which
+    is the number to keep an eye on across releases.
+
+  USAGE:
+
+    StartupTimeline timeline;
+    int window = timeline.add_task("window", "main");
+    int engine = timeline.add_task("Engine::create", "engine", { window });
+
+    timeline.begin(window);
+    create_window();
+    timeline.end(window);
+
+    // on another thread
+    timeline.begin(engine);
+    ...
+    timeline.end(engine);
+
+    timeline.print();
+    timeline.save_json("startup.json");
+
+  IMPORTANT:
+
+    Add all tasks before you start any, from one thread. The
+    names must outlive the timeline, e.g. string literals; we
+    only store the pointers. `begin()` and `end()` may be called
+    from any thread.
+
+ */
+
+#ifndef POLY_STARTUP_TIMELINE_H
+#define POLY_STARTUP_TIMELINE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <initializer_list>
+
+/* -------------------------------------------- */
+
+#define STARTUP_TIMELINE_BAR_WIDTH 40
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct StartupTask {
+    const char* name;
+    const char* thread;
+    std::vector<int> dependencies;
+    std::atomic<uint64_t> begin_ns;            /* `trace_now()`; 0 until `begin()`. */
+    std::atomic<uint64_t> end_ns;              /* `trace_now()`; 0 until `end()`. */
+  };
+
+  /* -------------------------------------------- */
+
+  class StartupTimeline {
+  public:
+    StartupTimeline();
+    ~StartupTimeline();
+    int add_task(const char* name, const char* thread, std::initializer_list<int> dependencies = {}); /* Returns the index of the task or < 0 on error. */
+    void begin(int task);
+    void end(int task);
+    bool is_ended(int task);
+    double get_duration(int task);             /* In milliseconds; 0 when the task didn't end. */
+    double get_critical_path(std::vector<int>& path); /* Fills `path` from the first to the last task and returns the time until the last task ended, in ms. */
+    void print();
+    int save_json(const std::string& filepath); /* Returns 0 on success, < 0 when we can't write the file. */
+
+  private:
+    uint64_t start_ns;                         /* When the timeline was created; time 0. */
+    std::vector<StartupTask*> tasks;
+  };
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
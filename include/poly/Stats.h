@@ -0,0 +1,88 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  ROLLING STATS
+  =============
+
+  GENERAL INFO:
+
+    `RollingStats` keeps the last N samples (e.g. frame times in
+    milliseconds) in a fixed size ring buffer. We never allocate
+    after construction, so it's safe to call `add()` every frame.
+    `percentile()` copies the samples into a scratch buffer and
+    uses `std::nth_element()`; call it when you print/report, not
+    for every sample.
+
+    `Histogram` counts samples into fixed width buckets between
+    `min_value` and `max_value`; samples outside this range are
+    counted into the first or last bucket. It never forgets
+    samples, which makes it useful to show the distribution of
+    an entire session.
+
+ */
+
+#ifndef POLY_STATS_H
+#define POLY_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  class RollingStats {
+  public:
+    RollingStats(size_t capacity = 512);
+    void add(double value);
+    void reset();
+    double percentile(double p); /* `p` in the range [0, 100]. Returns 0.0 when there are no samples. */
+    double min();
+    double max();
+    double mean();
+    size_t size();
+
+  private:
+    std::vector<double> samples;
+    std::vector<double> scratch;
+    size_t write_dx;
+    size_t count;
+  };
+
+  /* -------------------------------------------- */
+
+  class Histogram {
+  public:
+    Histogram(double min_value = 0.0, double max_value = 100.0, size_t num_buckets = 50);
+    void add(double value);
+    void reset();
+    void print(const char* unit = "ms");  /* Prints one line per non-empty bucket. */
+    uint64_t get_count();
+
+  private:
+    std::vector<uint64_t> buckets;
+    double min_value;
+    double max_value;
+    double bucket_size;
+    uint64_t count;
+  };
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
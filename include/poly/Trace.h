@@ -0,0 +1,121 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  TRACE
+  =====
+
+  GENERAL INFO:
+
+    A tiny tracer that records scoped spans and writes them as a
+    Chrome trace-event JSON file, which you can open in
+    `chrome://tracing` or https://ui.perfetto.dev.
+
+    Each thread records into its own fixed size buffer. The
+    buffer is allocated and registered the first time a thread
+    records a span (this takes a lock, once). After that,
+    recording a span is a couple of stores and one atomic
+    increment; no locks and no allocations. Naming a thread
+    doesn't allocate its buffer, so threads cost nothing when the
+    tracing macros are compiled out. When a buffer is full we drop
+    the span and count it; `trace_save()` writes the number of
+    dropped spans into the `otherData` of the JSON.
+
+    The tracing macros are only compiled in when
+    `POLY_ENABLE_PROFILING` is defined, which happens when you
+    configure with `-DENABLE_PROFILING=On` (e.g. `./release.sh
+    profile`). Without it `POLY_TRACE_SCOPE()` expands to
+    nothing.
+
+  USAGE:
+
+    poly::trace_set_thread_name("main");
+
+    {
+      POLY_TRACE_SCOPE("render");
+      renderer->render(view);
+    }
+
+    poly::trace_save("trace.json");
+
+  IMPORTANT:
+
+    The `name` you pass must outlive the trace, e.g. a string
+    literal; we only store the pointer.
+
+ */
+
+#ifndef POLY_TRACE_H
+#define POLY_TRACE_H
+
+#include <stdint.h>
+#include <string>
+
+/* -------------------------------------------- */
+
+#define TRACE_MAX_EVENTS_PER_THREAD (64 * 1024)
+
+#define POLY_TRACE_CONCAT_IMPL(a, b) a##b
+#define POLY_TRACE_CONCAT(a, b) POLY_TRACE_CONCAT_IMPL(a, b)
+
+#if defined(POLY_ENABLE_PROFILING)
+#  define POLY_TRACE_SCOPE(name) poly::TraceScope POLY_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#else
+#  define POLY_TRACE_SCOPE(name)
+#endif
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  bool trace_is_available();                              /* Returns true when compiled with `POLY_ENABLE_PROFILING`. */
+  void trace_set_enabled(bool enabled);                   /* Recording is enabled by default. */
+  void trace_set_thread_name(const std::string& name);    /* Name shown for the calling thread in the trace viewer. */
+  uint64_t trace_now();                                   /* Nanoseconds since the tracer was loaded; also when profiling is off. */
+  double trace_to_ms(uint64_t begin_ns, uint64_t end_ns); /* Milliseconds between two `trace_now()` values; 0 when `end_ns` is before `begin_ns`. */
+  void trace_record(const char* name, uint64_t begin_ns, uint64_t end_ns);
+  int trace_save(const std::string& filepath);            /* Writes all recorded spans as Chrome trace-event JSON. */
+
+  /* -------------------------------------------- */
+
+  class TraceScope {
+  public:
+    TraceScope(const char* name);
+    ~TraceScope();
+
+  private:
+    const char* name;
+    uint64_t begin_ns;
+  };
+
+  /* -------------------------------------------- */
+
+  inline TraceScope::TraceScope(const char* name)
+    :name(name)
+    ,begin_ns(trace_now())
+  {
+  }
+
+  inline TraceScope::~TraceScope() {
+    trace_record(name, begin_ns, trace_now());
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
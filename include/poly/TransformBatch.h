@@ -0,0 +1,103 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  TRANSFORM BATCH
+  ===============
+
+  GENERAL INFO:
+
+    When a scene holds many entities, composing a `mat4f` per
+    entity (translation * rotation * scale, as three scalar 4x4
+    multiplications) and calling `TransformManager::setTransform()`
+    for each of them dominates the CPU time of a frame.
+
+    `TransformBatch` stores the positions, rotations (unit
+    quaternions) and scales of N entities as separate arrays
+    (SoA). `transform_batch_compose()` builds the matrices
+    directly from the quaternion, 4 entities at a time with SSE
+    or 8 at a time with AVX2 (+FMA); there is a scalar kernel for
+    other CPUs. We pick the best kernel at runtime, so the
+    library doesn't need to be compiled with `-mavx2`.
+
+    `transform_batch_commit()` sets all transforms inside one
+    `openLocalTransformTransaction()` /
+    `commitLocalTransformTransaction()` pair, so Filament updates
+    the world transforms once, instead of once per `setTransform()`.
+
+  USAGE:
+
+    TransformBatch batch;
+    transform_batch_resize(batch, num_entities);
+
+    for (size_t i = 0; i < num_entities; ++i) {
+      batch.px[i] = ...; // also py, pz, qx, qy, qz, qw, sx, sy, sz
+    }
+
+    transform_batch_compose(batch);
+    transform_batch_commit(batch, engine->getTransformManager(), instances);
+
+  IMPORTANT:
+
+    The arrays are padded to a multiple of 8 entries; only write
+    the first `count` entries. The padding holds the identity
+    transform.
+
+ */
+
+#ifndef POLY_TRANSFORM_BATCH_H
+#define POLY_TRANSFORM_BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <math/mat4.h>
+#include <filament/TransformManager.h>
+
+/* -------------------------------------------- */
+
+#define TRANSFORM_KERNEL_AUTO -1
+#define TRANSFORM_KERNEL_SCALAR 0
+#define TRANSFORM_KERNEL_SSE 1
+#define TRANSFORM_KERNEL_AVX2 2
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct TransformBatch {
+    size_t count;                                    /* Number of entities. */
+    std::vector<float> px, py, pz;                   /* Position. */
+    std::vector<float> qx, qy, qz, qw;               /* Rotation, a unit quaternion. */
+    std::vector<float> sx, sy, sz;                   /* Scale. */
+    std::vector<filament::math::mat4f> matrices;     /* Output of `transform_batch_compose()`. */
+  };
+
+  /* -------------------------------------------- */
+
+  void transform_batch_resize(TransformBatch& batch, size_t count);
+  int transform_batch_compose(TransformBatch& batch, int kernel = TRANSFORM_KERNEL_AUTO);  /* Returns the kernel that was used. */
+  void transform_batch_commit(TransformBatch& batch, filament::TransformManager& tm, const filament::TransformManager::Instance* instances);
+  void transform_batch_apply_local(TransformBatch& batch, const float offset[3], const float scale[3]);  /* Multiplies the composed matrices on the right with a translation and scale, e.g. `mesh_get_position_transform()`. */
+  int transform_get_best_kernel();
+  const char* transform_kernel_to_string(int kernel);
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
+
+#endif
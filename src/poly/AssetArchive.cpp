@@ -0,0 +1,507 @@
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <meshoptimizer.h>
+#include <poly/AssetArchive.h>
+#include <poly/Hash.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static int read_file(const std::string& filepath, std::vector<uint8_t>& result);
+  static uint64_t align_offset(uint64_t offset);
+
+  /* -------------------------------------------- */
+
+  AssetArchive::AssetArchive()
+    :header(nullptr)
+    ,entries(nullptr)
+    ,slots(nullptr)
+    ,names(nullptr)
+  {
+  }
+
+  AssetArchive::~AssetArchive() {
+
+    if (nullptr != header) {
+      printf("Error: the asset archive is destructed but `close()` hasn't been called.\n");
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  int AssetArchive::open(const std::string& filepath) {
+
+    const AssetArchiveHeader* hdr = nullptr;
+    const AssetArchiveEntry* ents = nullptr;
+    const uint32_t* table = nullptr;
+    const char* strings = nullptr;
+    const uint8_t* data = nullptr;
+    uint64_t index_size = 0;
+    uint32_t num_empty = 0;
+    size_t size = 0;
+
+    if (nullptr != header) {
+      printf("Error: cannot open `%s`, the archive is already open.\n", filepath.c_str());
+      return -1;
+    }
+
+    if (0 != file.open(filepath)) {
+      return -2;
+    }
+
+    data = file.get_data();
+    size = file.get_size();
+    hdr = (const AssetArchiveHeader*) data;
+
+    if (size < sizeof(AssetArchiveHeader)
+        || 0 != memcmp(hdr->magic, ASSET_ARCHIVE_MAGIC, ASSET_ARCHIVE_MAGIC_SIZE)
+        || ASSET_ARCHIVE_VERSION != hdr->version)
+      {
+        printf("Error: cannot open `%s`, it's not an asset archive or it has another version.\n", filepath.c_str());
+        file.close();
+        return -3;
+      }
+
+    if (hdr->size != size) {
+      printf("Error: cannot open `%s`, the archive should be %llu bytes but it's %zu bytes.\n", filepath.c_str(), (unsigned long long) hdr->size, size);
+      file.close();
+      return -4;
+    }
+
+    index_size = sizeof(AssetArchiveHeader)
+      + uint64_t(hdr->num_entries) * sizeof(AssetArchiveEntry)
+      + uint64_t(hdr->num_slots) * sizeof(uint32_t)
+      + hdr->names_size;
+
+    if (0 == hdr->num_slots
+        || 0 != (hdr->num_slots & (hdr->num_slots - 1))
+        || hdr->num_slots <= hdr->num_entries
+        || index_size > size)
+      {
+        printf("Error: cannot open `%s`, the index is invalid.\n", filepath.c_str());
+        file.close();
+        return -5;
+      }
+
+    ents = (const AssetArchiveEntry*) (data + sizeof(AssetArchiveHeader));
+    table = (const uint32_t*) (ents + hdr->num_entries);
+    strings = (const char*) (table + hdr->num_slots);
+
+    if (0 != hdr->num_entries
+        && (0 == hdr->names_size || '\0' != strings[hdr->names_size - 1]))
+      {
+        printf("Error: cannot open `%s`, the names are invalid.\n", filepath.c_str());
+        file.close();
+        return -6;
+      }
+
+    /* Validate once, so `find()` and `get()` can trust the index. */
+    for (uint32_t i = 0; i < hdr->num_entries; ++i) {
+
+      const AssetArchiveEntry& ent = ents[i];
+
+      if (ent.offset > size
+          || ent.size > size - ent.offset
+          || ent.name_offset >= hdr->names_size
+          || (ASSET_COMPRESSION_NONE != ent.compression && ASSET_COMPRESSION_MESHOPT != ent.compression)
+          || (ASSET_COMPRESSION_NONE == ent.compression && ent.size != ent.original_size))
+        {
+          printf("Error: cannot open `%s`, entry %u is invalid.\n", filepath.c_str(), i);
+          file.close();
+          return -7;
+        }
+    }
+
+    for (uint32_t i = 0; i < hdr->num_slots; ++i) {
+
+      if (ASSET_ARCHIVE_NO_ENTRY == table[i]) {
+        num_empty++;
+        continue;
+      }
+
+      if (table[i] >= hdr->num_entries) {
+        printf("Error: cannot open `%s`, slot %u is invalid.\n", filepath.c_str(), i);
+        file.close();
+        return -8;
+      }
+    }
+
+    /* `find()` probes until it hits an empty slot. */
+    if (0 == num_empty) {
+      printf("Error: cannot open `%s`, the hash table has no empty slot.\n", filepath.c_str());
+      file.close();
+      return -9;
+    }
+
+    header = hdr;
+    entries = ents;
+    slots = table;
+    names = strings;
+
+    return 0;
+  }
+
+  int AssetArchive::close() {
+
+    if (nullptr == header) {
+      return 0;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      decompressed.clear();
+    }
+
+    header = nullptr;
+    entries = nullptr;
+    slots = nullptr;
+    names = nullptr;
+
+    return file.close();
+  }
+
+  void AssetArchive::prefault() {
+    file.prefault();
+  }
+
+  /* -------------------------------------------- */
+
+  const AssetArchiveEntry* AssetArchive::find(const std::string& name) {
+
+    uint64_t hash = 0;
+    uint32_t mask = 0;
+    uint32_t slot = 0;
+
+    if (nullptr == header) {
+      printf("Error: cannot find `%s`, the archive is not open.\n", name.c_str());
+      return nullptr;
+    }
+
+    hash = hash_bytes(name.data(), name.size());
+    mask = header->num_slots - 1;
+    slot = uint32_t(hash & mask);
+
+    /* There is always an empty slot, so this ends. */
+    while (ASSET_ARCHIVE_NO_ENTRY != slots[slot]) {
+
+      const AssetArchiveEntry* entry = &entries[slots[slot]];
+
+      if (hash == entry->hash
+          && 0 == strcmp(names + entry->name_offset, name.c_str()))
+        {
+          return entry;
+        }
+
+      slot = (slot + 1) & mask;
+    }
+
+    return nullptr;
+  }
+
+  int AssetArchive::get(const std::string& name, const uint8_t** data, size_t* size) {
+
+    const AssetArchiveEntry* entry = find(name);
+
+    if (nullptr == entry) {
+      printf("Error: the archive has no entry `%s`.\n", name.c_str());
+      return -1;
+    }
+
+    return get(entry, data, size);
+  }
+
+  int AssetArchive::get(const AssetArchiveEntry* entry, const uint8_t** data, size_t* size) {
+
+    uint32_t index = 0;
+    size_t count = 0;
+
+    if (nullptr == data
+        || nullptr == size)
+      {
+        printf("Error: cannot get the entry, data or size is nullptr.\n");
+        return -1;
+      }
+
+    if (nullptr == header
+        || nullptr == entry
+        || entry < entries
+        || entry >= entries + header->num_entries)
+      {
+        printf("Error: cannot get the entry, the archive is not open or the entry isn't part of it.\n");
+        return -2;
+      }
+
+    if (ASSET_COMPRESSION_NONE == entry->compression) {
+      *data = file.get_data() + entry->offset;
+      *size = size_t(entry->size);
+      return 0;
+    }
+
+    index = uint32_t(entry - entries);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    std::unordered_map<uint32_t, std::vector<uint8_t>>::iterator it = decompressed.find(index);
+
+    if (it == decompressed.end()) {
+
+      /* The codec works on 4 byte "vertices"; the packer padded the data. */
+      std::vector<uint8_t>& buffer = decompressed[index];
+      count = size_t((entry->original_size + 3) / 4);
+      buffer.resize(count * 4);
+
+      if (0 != meshopt_decodeVertexBuffer(buffer.data(), count, 4, file.get_data() + entry->offset, size_t(entry->size))) {
+        printf("Error: failed to decompress `%s`.\n", names + entry->name_offset);
+        decompressed.erase(index);
+        return -3;
+      }
+
+      it = decompressed.find(index);
+    }
+
+    *data = it->second.data();
+    *size = size_t(entry->original_size);
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  const AssetArchiveEntry* AssetArchive::get_entry(uint32_t index) {
+
+    if (nullptr == header
+        || index >= header->num_entries)
+      {
+        return nullptr;
+      }
+
+    return &entries[index];
+  }
+
+  const char* AssetArchive::get_name(const AssetArchiveEntry* entry) {
+
+    if (nullptr == header
+        || nullptr == entry)
+      {
+        return nullptr;
+      }
+
+    return names + entry->name_offset;
+  }
+
+  /* -------------------------------------------- */
+
+  int asset_archive_write(const std::string& filepath, const std::vector<AssetArchiveInput>& inputs, uint32_t flags) {
+
+    static std::atomic<uint32_t> tmp_counter(0);
+
+    AssetArchiveHeader header = {};
+    std::vector<AssetArchiveEntry> entries(inputs.size());
+    std::vector<uint32_t> slots;
+    std::vector<uint8_t> content;
+    std::vector<uint8_t> encoded;
+    std::string names;
+    std::string tmp_filepath;
+    const uint8_t zeros[ASSET_ARCHIVE_ALIGNMENT] = {};
+    uint64_t index_size = 0;
+    uint64_t offset = 0;
+    uint32_t num_slots = 1;
+    FILE* fp = nullptr;
+    bool is_ok = true;
+
+    if (true == filepath.empty()) {
+      printf("Error: cannot write the archive, filepath is empty.\n");
+      return -1;
+    }
+
+    if (inputs.size() >= (ASSET_ARCHIVE_NO_ENTRY / 2)) {
+      printf("Error: cannot write the archive, too many entries.\n");
+      return -2;
+    }
+
+    /* At least twice the number of entries keeps the probe sequences short. */
+    while (num_slots < inputs.size() * 2) {
+      num_slots *= 2;
+    }
+
+    slots.assign(num_slots, ASSET_ARCHIVE_NO_ENTRY);
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+
+      const std::string& name = inputs[i].name;
+      uint64_t hash = hash_bytes(name.data(), name.size());
+      uint32_t slot = uint32_t(hash & (num_slots - 1));
+
+      if (true == name.empty()) {
+        printf("Error: cannot write the archive, input %zu has no name.\n", i);
+        return -3;
+      }
+
+      while (ASSET_ARCHIVE_NO_ENTRY != slots[slot]) {
+
+        const AssetArchiveEntry& other = entries[slots[slot]];
+
+        if (hash == other.hash
+            && 0 == strcmp(names.c_str() + other.name_offset, name.c_str()))
+          {
+            printf("Error: cannot write the archive, `%s` is added twice.\n", name.c_str());
+            return -4;
+          }
+
+        slot = (slot + 1) & (num_slots - 1);
+      }
+
+      slots[slot] = uint32_t(i);
+      entries[i].hash = hash;
+      entries[i].name_offset = uint32_t(names.size());
+      names += name;
+      names.push_back('\0');
+    }
+
+    memcpy(header.magic, ASSET_ARCHIVE_MAGIC, ASSET_ARCHIVE_MAGIC_SIZE);
+    header.version = ASSET_ARCHIVE_VERSION;
+    header.num_entries = uint32_t(entries.size());
+    header.num_slots = num_slots;
+    header.names_size = uint32_t(names.size());
+
+    index_size = sizeof(header)
+      + entries.size() * sizeof(AssetArchiveEntry)
+      + slots.size() * sizeof(uint32_t)
+      + names.size();
+
+    /* Another process may be reading `filepath`; it only ever sees a complete archive. */
+    tmp_filepath = filepath + ".tmp" + std::to_string(tmp_counter.fetch_add(1));
+
+    fp = fopen(tmp_filepath.c_str(), "wb");
+    if (nullptr == fp) {
+      printf("Error: cannot write the archive, failed to open `%s`.\n", tmp_filepath.c_str());
+      return -5;
+    }
+
+    /* The index is written last, once we know where the data is; reserve its space. */
+    for (uint64_t i = 0; i < index_size && true == is_ok; i += ASSET_ARCHIVE_ALIGNMENT) {
+      size_t n = size_t((index_size - i < ASSET_ARCHIVE_ALIGNMENT) ? (index_size - i) : ASSET_ARCHIVE_ALIGNMENT);
+      is_ok = (1 == fwrite(zeros, n, 1, fp));
+    }
+
+    offset = index_size;
+
+    for (size_t i = 0; i < inputs.size() && true == is_ok; ++i) {
+
+      AssetArchiveEntry& entry = entries[i];
+      const uint8_t* src = nullptr;
+      uint64_t aligned = align_offset(offset);
+
+      if (0 != read_file(inputs[i].filepath, content)) {
+        is_ok = false;
+        break;
+      }
+
+      is_ok = (aligned == offset) || (1 == fwrite(zeros, size_t(aligned - offset), 1, fp));
+      offset = aligned;
+
+      entry.offset = offset;
+      entry.size = content.size();
+      entry.original_size = content.size();
+      entry.compression = ASSET_COMPRESSION_NONE;
+
+      if (0 != (flags & ASSET_ARCHIVE_FLAG_COMPRESS)
+          && 0 != content.size())
+        {
+          size_t count = (content.size() + 3) / 4;
+          size_t num_bytes = 0;
+
+          content.resize(count * 4, 0);
+          encoded.resize(meshopt_encodeVertexBufferBound(count, 4));
+          num_bytes = meshopt_encodeVertexBuffer(encoded.data(), encoded.size(), content.data(), count, 4);
+
+          if (0 != num_bytes
+              && float(num_bytes) <= float(entry.original_size) * (1.0f - ASSET_ARCHIVE_MIN_SAVING))
+            {
+              entry.size = num_bytes;
+              entry.compression = ASSET_COMPRESSION_MESHOPT;
+            }
+        }
+
+      /* After the padding above, which may have reallocated `content`. */
+      src = (ASSET_COMPRESSION_MESHOPT == entry.compression) ? encoded.data() : content.data();
+
+      is_ok = is_ok && (0 == entry.size || 1 == fwrite(src, size_t(entry.size), 1, fp));
+      offset += entry.size;
+    }
+
+    header.size = offset;
+
+    if (true == is_ok) {
+      is_ok = (0 == fseek(fp, 0, SEEK_SET));
+      is_ok = is_ok && 1 == fwrite(&header, sizeof(header), 1, fp);
+      is_ok = is_ok && (0 == entries.size() || 1 == fwrite(entries.data(), entries.size() * sizeof(AssetArchiveEntry), 1, fp));
+      is_ok = is_ok && 1 == fwrite(slots.data(), slots.size() * sizeof(uint32_t), 1, fp);
+      is_ok = is_ok && (0 == names.size() || 1 == fwrite(names.data(), names.size(), 1, fp));
+    }
+
+    if (0 != fclose(fp)) {
+      is_ok = false;
+    }
+
+    if (false == is_ok) {
+      printf("Error: failed to write the archive `%s`.\n", filepath.c_str());
+      remove(tmp_filepath.c_str());
+      return -6;
+    }
+
+#if defined(_WIN32)
+    remove(filepath.c_str());
+#endif
+
+    if (0 != rename(tmp_filepath.c_str(), filepath.c_str())) {
+      printf("Error: failed to rename `%s` to `%s`.\n", tmp_filepath.c_str(), filepath.c_str());
+      remove(tmp_filepath.c_str());
+      return -7;
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  static int read_file(const std::string& filepath, std::vector<uint8_t>& result) {
+
+    FILE* fp = fopen(filepath.c_str(), "rb");
+    long size = 0;
+    bool is_ok = true;
+
+    result.clear();
+
+    if (nullptr == fp) {
+      printf("Error: cannot read `%s`.\n", filepath.c_str());
+      return -1;
+    }
+
+    is_ok = (0 == fseek(fp, 0, SEEK_END));
+    size = ftell(fp);
+    is_ok = is_ok && size >= 0 && 0 == fseek(fp, 0, SEEK_SET);
+
+    if (true == is_ok) {
+      result.resize(size_t(size));
+      is_ok = (0 == size || 1 == fread(result.data(), result.size(), 1, fp));
+    }
+
+    fclose(fp);
+
+    if (false == is_ok) {
+      printf("Error: failed to read `%s`.\n", filepath.c_str());
+      return -2;
+    }
+
+    return 0;
+  }
+
+  static uint64_t align_offset(uint64_t offset) {
+    return (offset + (ASSET_ARCHIVE_ALIGNMENT - 1)) & ~uint64_t(ASSET_ARCHIVE_ALIGNMENT - 1);
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
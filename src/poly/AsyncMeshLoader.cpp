@@ -0,0 +1,594 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <filament/Engine.h>
+#include <filament/Scene.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <filament/RenderableManager.h>
+#include <filament/Material.h>
+#include <filament/Box.h>
+#include <utils/EntityManager.h>
+#include <poly/AsyncMeshLoader.h>
+#include <poly/MeshLoader.h>
+#include <poly/Trace.h>
+
+using namespace filament;
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static void async_mesh_release(void* user);
+
+  /* -------------------------------------------- */
+
+  /* Position and tangent frame (a quaternion; the normal is its z-axis). */
+  struct PlaceholderVertex {
+    float position[3];
+    int16_t tangents[4];
+  };
+
+  /* A cube of 0.5 units with 4 vertices per face; the default material is lit, so every face needs its own tangent frame. */
+  static const PlaceholderVertex placeholder_vertices[] = {
+    { {  0.25f, -0.25f, -0.25f }, { 0, 23170, 0, 23170 } },
+    { {  0.25f,  0.25f, -0.25f }, { 0, 23170, 0, 23170 } },
+    { {  0.25f,  0.25f,  0.25f }, { 0, 23170, 0, 23170 } },
+    { {  0.25f, -0.25f,  0.25f }, { 0, 23170, 0, 23170 } },
+    { { -0.25f, -0.25f,  0.25f }, { 0, -23170, 0, 23170 } },
+    { { -0.25f,  0.25f,  0.25f }, { 0, -23170, 0, 23170 } },
+    { { -0.25f,  0.25f, -0.25f }, { 0, -23170, 0, 23170 } },
+    { { -0.25f, -0.25f, -0.25f }, { 0, -23170, 0, 23170 } },
+    { { -0.25f,  0.25f, -0.25f }, { -23170, 0, 0, 23170 } },
+    { { -0.25f,  0.25f,  0.25f }, { -23170, 0, 0, 23170 } },
+    { {  0.25f,  0.25f,  0.25f }, { -23170, 0, 0, 23170 } },
+    { {  0.25f,  0.25f, -0.25f }, { -23170, 0, 0, 23170 } },
+    { { -0.25f, -0.25f, -0.25f }, { 23170, 0, 0, 23170 } },
+    { {  0.25f, -0.25f, -0.25f }, { 23170, 0, 0, 23170 } },
+    { {  0.25f, -0.25f,  0.25f }, { 23170, 0, 0, 23170 } },
+    { { -0.25f, -0.25f,  0.25f }, { 23170, 0, 0, 23170 } },
+    { { -0.25f, -0.25f,  0.25f }, { 0, 0, 0, 32767 } },
+    { {  0.25f, -0.25f,  0.25f }, { 0, 0, 0, 32767 } },
+    { {  0.25f,  0.25f,  0.25f }, { 0, 0, 0, 32767 } },
+    { { -0.25f,  0.25f,  0.25f }, { 0, 0, 0, 32767 } },
+    { { -0.25f, -0.25f, -0.25f }, { 32767, 0, 0, 0 } },
+    { { -0.25f,  0.25f, -0.25f }, { 32767, 0, 0, 0 } },
+    { {  0.25f,  0.25f, -0.25f }, { 32767, 0, 0, 0 } },
+    { {  0.25f, -0.25f, -0.25f }, { 32767, 0, 0, 0 } },
+  };
+
+  static const uint16_t placeholder_indices[] = {
+    0, 1, 2, 0, 2, 3,
+    4, 5, 6, 4, 6, 7,
+    8, 9, 10, 8, 10, 11,
+    12, 13, 14, 12, 14, 15,
+    16, 17, 18, 16, 18, 19,
+    20, 21, 22, 20, 22, 23,
+  };
+
+  /* -------------------------------------------- */
+
+  AsyncMeshLoader::AsyncMeshLoader()
+    :engine(nullptr)
+    ,scene(nullptr)
+    ,materials(nullptr)
+    ,placeholder_vb(nullptr)
+    ,placeholder_ib(nullptr)
+    ,is_running(false)
+    ,optimize(false)
+    ,optimize_flags(MESH_OPTIMIZE_DEFAULT)
+    ,placeholders(true)
+    ,num_pending(0)
+    ,num_upload_bytes(0)
+    ,create_ms(0.0)
+  {
+  }
+
+  AsyncMeshLoader::~AsyncMeshLoader() {
+
+    if (nullptr != engine) {
+      printf("Error: the async mesh loader is destructed but `shutdown()` hasn't been called.\n");
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  int AsyncMeshLoader::init(filament::Engine* eng, filament::Scene* scn, filamesh::MeshReader::MaterialRegistry* reg, uint32_t num_threads) {
+
+    if (nullptr != engine) {
+      printf("Error: the async mesh loader is already initialized.\n");
+      return -1;
+    }
+
+    if (nullptr == eng
+        || nullptr == scn
+        || nullptr == reg)
+      {
+        printf("Error: cannot initialize the async mesh loader, engine, scene or material registry is nullptr.\n");
+        return -2;
+      }
+
+    if (0 == num_threads) {
+      printf("Error: cannot initialize the async mesh loader, we need at least one thread.\n");
+      return -3;
+    }
+
+    engine = eng;
+    scene = scn;
+    materials = reg;
+
+    if (0 != create_placeholder_geometry()) {
+      engine = nullptr;
+      scene = nullptr;
+      materials = nullptr;
+      return -4;
+    }
+
+    is_running = true;
+
+    for (uint32_t i = 0; i < num_threads; ++i) {
+      workers.push_back(std::thread(&AsyncMeshLoader::worker_main, this, i));
+    }
+
+    return 0;
+  }
+
+  int AsyncMeshLoader::shutdown() {
+
+    int r = 0;
+
+    if (nullptr == engine) {
+      return 0;
+    }
+
+    /* The workers parse everything that is still queued before they stop. */
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      is_running = false;
+    }
+
+    cv.notify_all();
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+      workers[i].join();
+    }
+
+    workers.clear();
+
+    /* Create the buffers of the last parsed meshes and wait until the driver released all data. */
+    update();
+    engine->flushAndWait();
+    update();
+
+    if (0 != num_pending) {
+      printf("Error: %zu meshes are still pending while shutting down the async mesh loader.\n", num_pending);
+      r = -1;
+    }
+
+    if (nullptr != placeholder_vb) {
+      engine->destroy(placeholder_vb);
+      placeholder_vb = nullptr;
+    }
+
+    if (nullptr != placeholder_ib) {
+      engine->destroy(placeholder_ib);
+      placeholder_ib = nullptr;
+    }
+
+    for (size_t i = 0; i < meshes.size(); ++i) {
+      meshes[i]->file.close();
+      delete meshes[i];
+    }
+
+    meshes.clear();
+    uploading.clear();
+    waiting.clear();
+    engine = nullptr;
+    scene = nullptr;
+    materials = nullptr;
+
+    return r;
+  }
+
+  /* -------------------------------------------- */
+
+  void AsyncMeshLoader::set_optimize(bool enabled, uint32_t flags) {
+
+    if (nullptr != engine) {
+      printf("Error: call `set_optimize()` before initializing the async mesh loader.\n");
+      return;
+    }
+
+    optimize = enabled;
+    optimize_flags = flags;
+  }
+
+  void AsyncMeshLoader::set_placeholders(bool enabled) {
+
+    if (nullptr != engine) {
+      printf("Error: call `set_placeholders()` before initializing the async mesh loader.\n");
+      return;
+    }
+
+    placeholders = enabled;
+  }
+
+  AsyncMesh* AsyncMeshLoader::load(const std::string& filepath, AsyncMeshCallback callback, void* user) {
+
+    AsyncMesh* mesh = nullptr;
+
+    if (nullptr == engine) {
+      printf("Error: cannot load `%s`, the async mesh loader is not initialized.\n", filepath.c_str());
+      return nullptr;
+    }
+
+    mesh = new AsyncMesh();
+    mesh->filepath = filepath;
+    mesh->state = ASYNC_MESH_STATE_LOADING;
+    mesh->callback = callback;
+    mesh->user = user;
+    mesh->queue_ms = 0.0;
+    mesh->parse_ms = 0.0;
+    mesh->create_ms = 0.0;
+    mesh->upload_ms = 0.0;
+    mesh->total_ms = 0.0;
+    mesh->result = 0;
+    mesh->load_ns = trace_now();
+    mesh->create_ns = 0;
+    mesh->released_ns = 0;
+
+    mesh->entity = utils::EntityManager::get().create();
+
+    /* Show the placeholder until the real geometry has been created. */
+    if (true == placeholders) {
+
+      Box aabb;
+      aabb.set({ -0.25f, -0.25f, -0.25f }, { 0.25f, 0.25f, 0.25f });
+
+      RenderableManager::Builder(1)
+        .boundingBox(aabb)
+        .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, placeholder_vb, placeholder_ib, 0, 36)
+        .material(0, engine->getDefaultMaterial()->getDefaultInstance())
+        .build(*engine, mesh->entity);
+
+      scene->addEntity(mesh->entity);
+    }
+
+    meshes.push_back(mesh);
+    num_pending++;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      todo.push_back(mesh);
+    }
+
+    cv.notify_one();
+
+    return mesh;
+  }
+
+  /* -------------------------------------------- */
+
+  int AsyncMeshLoader::release(AsyncMesh* mesh) {
+
+    if (nullptr == mesh) {
+      printf("Error: cannot release the mesh, it's nullptr.\n");
+      return -1;
+    }
+
+    if (ASYNC_MESH_STATE_READY != mesh->state
+        && ASYNC_MESH_STATE_FAILED != mesh->state)
+      {
+        printf("Error: cannot release `%s`, it's still loading.\n", mesh->filepath.c_str());
+        return -2;
+      }
+
+    for (size_t i = 0; i < meshes.size(); ++i) {
+
+      if (mesh != meshes[i]) {
+        continue;
+      }
+
+      mesh->file.close();
+      delete mesh;
+
+      meshes[i] = meshes.back();
+      meshes.pop_back();
+
+      return 0;
+    }
+
+    printf("Error: cannot release `%s`, it wasn't loaded by this loader.\n", mesh->filepath.c_str());
+
+    return -3;
+  }
+
+  /* -------------------------------------------- */
+
+  void AsyncMeshLoader::update() {
+    update(0, 0.0);
+  }
+
+  void AsyncMeshLoader::update(uint64_t max_upload_bytes, double max_create_ms) {
+
+    uint64_t start_ns = trace_now();
+    size_t num_created = 0;
+
+    if (nullptr == engine) {
+      return;
+    }
+
+    RenderableManager& rm = engine->getRenderableManager();
+
+    num_upload_bytes = 0;
+    create_ms = 0.0;
+
+    /* The meshes which didn't fit in the budget of a previous frame go first. */
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      waiting.insert(waiting.end(), parsed.begin(), parsed.end());
+      parsed.clear();
+    }
+
+    /* Replace the placeholders of the parsed meshes with the real geometry. */
+    while (false == waiting.empty()) {
+
+      AsyncMesh* mesh = waiting.front();
+      uint64_t num_bytes = 0;
+      int r = 0;
+
+      if (0 == mesh->result) {
+        num_bytes = uint64_t(mesh->data.header.vertex_size) + uint64_t(mesh->data.header.index_size);
+      }
+
+      /* Keep the rest for the next frame once we're over the budget; we always create at least one. */
+      if (0 != num_created
+          && 0 != num_bytes
+          && ((0 != max_upload_bytes && num_upload_bytes + num_bytes > max_upload_bytes)
+              || (max_create_ms > 0.0 && trace_to_ms(start_ns, trace_now()) >= max_create_ms)))
+        {
+          break;
+        }
+
+      waiting.pop_front();
+      num_upload_bytes += num_bytes;
+      num_created++;
+
+      POLY_TRACE_SCOPE("AsyncMeshLoader::create");
+
+      if (true == placeholders) {
+        scene->remove(mesh->entity);
+        rm.destroy(mesh->entity);
+      }
+
+      if (0 != mesh->result) {
+        printf("Error: failed to load `%s`.\n", mesh->filepath.c_str());
+        utils::EntityManager::get().destroy(mesh->entity);
+        mesh->entity = {};
+        mesh->state = ASYNC_MESH_STATE_FAILED;
+        finish(mesh);
+        continue;
+      }
+
+      mesh->create_ns = trace_now();
+      mesh->mesh.renderable = mesh->entity;
+
+      r = mesh_create(engine, mesh->data, async_mesh_release, mesh, *materials, mesh->mesh);
+      mesh->create_ms = trace_to_ms(mesh->create_ns, trace_now());
+
+      /*
+        When we fail after the buffers were created, the driver
+        still calls `async_mesh_release()` for them; we only mark
+        the mesh as failed (after which it may be released) once
+        it did.
+      */
+      if (0 != r) {
+        printf("Error: failed to create the buffers for `%s`.\n", mesh->filepath.c_str());
+        utils::EntityManager::get().destroy(mesh->entity);
+        mesh->entity = {};
+        mesh->mesh.renderable = {};
+        mesh->result = r;
+      }
+      else {
+        scene->addEntity(mesh->entity);
+      }
+
+      mesh->state = ASYNC_MESH_STATE_UPLOADING;
+      uploading.push_back(mesh);
+    }
+
+    create_ms = trace_to_ms(start_ns, trace_now());
+
+    /* Check which uploads have been consumed by the driver. */
+    for (size_t i = 0; i < uploading.size(); ) {
+
+      AsyncMesh* mesh = uploading[i];
+      uint64_t released_ns = mesh->released_ns.load(std::memory_order_acquire);
+
+      if (0 == released_ns) {
+        ++i;
+        continue;
+      }
+
+      mesh->upload_ms = trace_to_ms(mesh->create_ns, released_ns);
+      mesh->state = (0 == mesh->result) ? ASYNC_MESH_STATE_READY : ASYNC_MESH_STATE_FAILED;
+      uploading[i] = uploading.back();
+      uploading.pop_back();
+
+      finish(mesh);
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  size_t AsyncMeshLoader::get_num_pending() {
+    return num_pending;
+  }
+
+  size_t AsyncMeshLoader::get_num_waiting() {
+    return waiting.size();
+  }
+
+  uint64_t AsyncMeshLoader::get_num_upload_bytes() {
+    return num_upload_bytes;
+  }
+
+  double AsyncMeshLoader::get_create_ms() {
+    return create_ms;
+  }
+
+  void AsyncMeshLoader::print() {
+
+    const char* state_names[] = { "loading", "uploading", "ready", "failed" };
+
+    /* The workers set the timings of the meshes they parsed. */
+    std::lock_guard<std::mutex> lock(mutex);
+
+    printf("Async mesh loading (ms):\n");
+    printf("  %-9s %9s %9s %9s %9s %9s  %s\n", "state", "queue", "parse", "create", "upload", "total", "file");
+
+    for (size_t i = 0; i < meshes.size(); ++i) {
+      AsyncMesh* mesh = meshes[i];
+      printf("  %-9s %9.3f %9.3f %9.3f %9.3f %9.3f  %s\n",
+             state_names[mesh->state],
+             mesh->queue_ms,
+             mesh->parse_ms,
+             mesh->create_ms,
+             mesh->upload_ms,
+             mesh->total_ms,
+             mesh->filepath.c_str());
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  void AsyncMeshLoader::worker_main(uint32_t dx) {
+
+    trace_set_thread_name("mesh-loader-" + std::to_string(dx));
+
+    while (true) {
+
+      AsyncMesh* mesh = nullptr;
+      uint64_t start_ns = 0;
+      double queue_ms = 0.0;
+      double parse_ms = 0.0;
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return false == is_running || false == todo.empty(); });
+
+        if (true == todo.empty()) {
+          return;
+        }
+
+        mesh = todo.front();
+        todo.pop_front();
+      }
+
+      {
+        POLY_TRACE_SCOPE("AsyncMeshLoader::parse");
+
+        start_ns = trace_now();
+        queue_ms = trace_to_ms(mesh->load_ns, start_ns);
+        mesh->loaded_filepath = mesh->filepath;
+
+        /* Falls back to the source when we can't optimize it. */
+        if (true == optimize) {
+          mesh_get_optimized(mesh->filepath, optimize_flags, mesh->loaded_filepath);
+        }
+
+        mesh->result = mesh->file.open(mesh->loaded_filepath);
+
+        if (0 == mesh->result) {
+          mesh->result = filamesh_parse(mesh->file.get_data(), mesh->file.get_size(), mesh->data);
+        }
+
+        /* Compressed meshes are decoded here, into the heap; we don't need the mapping anymore after that. */
+        if (0 == mesh->result
+            && 0 != (mesh->data.header.flags & FILAMESH_FLAG_COMPRESSION))
+          {
+            FilameshHeader header;
+            mesh->result = mesh_decompress(mesh->data, header, mesh->decoded_vertices, mesh->decoded_indices);
+            mesh->data.header = header;
+            mesh->data.vertices = mesh->decoded_vertices.data();
+            mesh->data.indices = mesh->decoded_indices.data();
+            mesh->file.close();
+          }
+        /* Read the pages now so the driver thread doesn't stall on page faults during the upload. */
+        else if (0 == mesh->result) {
+          mesh->file.prefault();
+        }
+        else {
+          mesh->file.close();
+        }
+
+        parse_ms = trace_to_ms(start_ns, trace_now());
+      }
+
+      /* The timings are set under the lock, `print()` may read them at any time. */
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        mesh->queue_ms = queue_ms;
+        mesh->parse_ms = parse_ms;
+        parsed.push_back(mesh);
+      }
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  int AsyncMeshLoader::create_placeholder_geometry() {
+
+    placeholder_vb = VertexBuffer::Builder()
+      .vertexCount(24)
+      .bufferCount(1)
+      .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3, offsetof(PlaceholderVertex, position), sizeof(PlaceholderVertex))
+      .attribute(VertexAttribute::TANGENTS, 0, VertexBuffer::AttributeType::SHORT4, offsetof(PlaceholderVertex, tangents), sizeof(PlaceholderVertex))
+      .normalized(VertexAttribute::TANGENTS)
+      .build(*engine);
+
+    placeholder_ib = IndexBuffer::Builder()
+      .indexCount(36)
+      .bufferType(IndexBuffer::IndexType::USHORT)
+      .build(*engine);
+
+    if (nullptr == placeholder_vb
+        || nullptr == placeholder_ib)
+      {
+        printf("Error: failed to create the placeholder geometry.\n");
+        return -1;
+      }
+
+    /* The arrays are static, so we don't need a release callback. */
+    placeholder_vb->setBufferAt(*engine, 0, VertexBuffer::BufferDescriptor(placeholder_vertices, sizeof(placeholder_vertices)));
+    placeholder_ib->setBuffer(*engine, IndexBuffer::BufferDescriptor(placeholder_indices, sizeof(placeholder_indices)));
+
+    return 0;
+  }
+
+  void AsyncMeshLoader::finish(AsyncMesh* mesh) {
+
+    mesh->total_ms = trace_to_ms(mesh->load_ns, trace_now());
+    num_pending--;
+
+    if (nullptr != mesh->callback) {
+      mesh->callback(mesh, mesh->user);
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  /* Called from Filament's driver thread once it consumed all vertex and index data, or from `mesh_create()` when it fails. */
+  static void async_mesh_release(void* user) {
+
+    AsyncMesh* mesh = (AsyncMesh*) user;
+    uint64_t ns = trace_now();
+
+    mesh->file.close();
+    std::vector<uint8_t>().swap(mesh->decoded_vertices);
+    std::vector<uint8_t>().swap(mesh->decoded_indices);
+    mesh->released_ns.store((0 == ns) ? 1 : ns, std::memory_order_release);
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
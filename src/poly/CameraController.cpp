@@ -0,0 +1,101 @@
+#include <math.h>
+#include <poly/CameraController.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  CameraController::CameraController()
+    :yaw(0.0f)
+    ,pitch(0.0f)
+    ,distance(10.0f)
+    ,min_distance(1.0f)
+    ,max_distance(80.0f)
+    ,rotate_speed(0.005f)
+    ,zoom_speed(0.1f)
+    ,last_x(0.0)
+    ,last_y(0.0)
+    ,is_dragging(false)
+  {
+    target[0] = 0.0f;
+    target[1] = 0.0f;
+    target[2] = 0.0f;
+  }
+
+  /* -------------------------------------------- */
+
+  void CameraController::set_target(float x, float y, float z) {
+    target[0] = x;
+    target[1] = y;
+    target[2] = z;
+  }
+
+  void CameraController::set_distance(float dist) {
+    distance = fminf(fmaxf(dist, min_distance), max_distance);
+  }
+
+  /* -------------------------------------------- */
+
+  bool CameraController::on_cursor(double x, double y) {
+
+    if (false == is_dragging) {
+      last_x = x;
+      last_y = y;
+      return false;
+    }
+
+    const float pitch_limit = 1.55f; /* Just below 90 degrees so `lookAt()` keeps a valid up vector. */
+
+    yaw -= float(x - last_x) * rotate_speed;
+    pitch += float(y - last_y) * rotate_speed;
+    pitch = fminf(fmaxf(pitch, -pitch_limit), pitch_limit);
+
+    last_x = x;
+    last_y = y;
+
+    return true;
+  }
+
+  bool CameraController::on_button(bool is_pressed, double x, double y) {
+
+    is_dragging = is_pressed;
+    last_x = x;
+    last_y = y;
+
+    return false;
+  }
+
+  bool CameraController::on_scroll(double offset) {
+
+    if (0.0 == offset) {
+      return false;
+    }
+
+    set_distance(distance * (1.0f - float(offset) * zoom_speed));
+
+    return true;
+  }
+
+  /* -------------------------------------------- */
+
+  CameraPose CameraController::get_pose() {
+
+    CameraPose pose;
+    float cp = cosf(pitch);
+
+    pose.eye[0] = target[0] + distance * cp * sinf(yaw);
+    pose.eye[1] = target[1] + distance * sinf(pitch);
+    pose.eye[2] = target[2] + distance * cp * cosf(yaw);
+    pose.target[0] = target[0];
+    pose.target[1] = target[1];
+    pose.target[2] = target[2];
+    pose.up[0] = 0.0f;
+    pose.up[1] = 1.0f;
+    pose.up[2] = 0.0f;
+
+    return pose;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
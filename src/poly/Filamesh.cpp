@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <string.h>
+#include <poly/Filamesh.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static bool read_bytes(const uint8_t* data, size_t size, size_t& offset, void* dst, size_t nbytes);
+
+  /* -------------------------------------------- */
+
+  int filamesh_parse(const uint8_t* data, size_t size, FilameshData& result) {
+
+    size_t offset = 0;
+    uint32_t num_materials = 0;
+    uint64_t region_size = 0;
+
+    result.vertices = nullptr;
+    result.indices = nullptr;
+    result.parts.clear();
+    result.materials.clear();
+
+    if (nullptr == data) {
+      printf("Error: cannot parse filamesh, data is nullptr.\n");
+      return -1;
+    }
+
+    if (size < FILAMESH_MAGIC_SIZE
+        || 0 != memcmp(data, FILAMESH_MAGIC, FILAMESH_MAGIC_SIZE))
+      {
+        printf("Error: cannot parse filamesh, magic not found.\n");
+        return -2;
+      }
+
+    offset = FILAMESH_MAGIC_SIZE;
+
+    if (false == read_bytes(data, size, offset, &result.header, sizeof(result.header))) {
+      printf("Error: cannot parse filamesh, header is truncated.\n");
+      return -3;
+    }
+
+    /* Another version may have another header; we can't tell where anything is. */
+    if (FILAMESH_VERSION != result.header.version) {
+      printf("Error: cannot parse filamesh, unsupported version %u (we support %u).\n", result.header.version, FILAMESH_VERSION);
+      return -4;
+    }
+
+    /* The vertex and index regions are referenced, not copied. */
+    region_size = uint64_t(result.header.vertex_size) + uint64_t(result.header.index_size);
+    if (region_size > size - offset) {
+      printf("Error: cannot parse filamesh, vertex and index data is truncated.\n");
+      return -5;
+    }
+
+    result.vertices = data + offset;
+    offset += result.header.vertex_size;
+    result.indices = data + offset;
+    offset += result.header.index_size;
+
+    /* Parts are copied as they aren't necessarily aligned. */
+    if (uint64_t(result.header.parts) * sizeof(FilameshPart) > size - offset) {
+      printf("Error: cannot parse filamesh, parts are truncated.\n");
+      return -6;
+    }
+
+    result.parts.resize(result.header.parts);
+    if (0 != result.header.parts) {
+      read_bytes(data, size, offset, &result.parts[0], result.header.parts * sizeof(FilameshPart));
+    }
+
+    if (false == read_bytes(data, size, offset, &num_materials, sizeof(num_materials))) {
+      printf("Error: cannot parse filamesh, material count is missing.\n");
+      return -7;
+    }
+
+    for (uint32_t i = 0; i < num_materials; ++i) {
+
+      uint32_t len = 0;
+
+      if (false == read_bytes(data, size, offset, &len, sizeof(len))
+          || uint64_t(len) + 1 > size - offset)
+        {
+          printf("Error: cannot parse filamesh, material %u is truncated.\n", i);
+          return -8;
+        }
+
+      result.materials.push_back(std::string((const char*)(data + offset), len));
+      offset += len + 1;
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  int filamesh_write(
+    const std::string& filepath,
+    const FilameshHeader& header,
+    const uint8_t* vertices,
+    const uint8_t* indices,
+    const std::vector<FilameshPart>& parts,
+    const std::vector<std::string>& materials
+  )
+  {
+    FILE* fp = nullptr;
+    uint32_t num_materials = uint32_t(materials.size());
+    bool is_ok = true;
+
+    if (true == filepath.empty()) {
+      printf("Error: cannot write filamesh, filepath is empty.\n");
+      return -1;
+    }
+
+    if (parts.size() != header.parts) {
+      printf("Error: cannot write filamesh, the header says we have %u parts but we got %zu.\n", header.parts, parts.size());
+      return -2;
+    }
+
+    if ((0 != header.vertex_size && nullptr == vertices)
+        || (0 != header.index_size && nullptr == indices))
+      {
+        printf("Error: cannot write filamesh, vertex or index data is nullptr.\n");
+        return -3;
+      }
+
+    fp = fopen(filepath.c_str(), "wb");
+    if (nullptr == fp) {
+      printf("Error: cannot write filamesh, failed to open `%s`.\n", filepath.c_str());
+      return -4;
+    }
+
+    is_ok = is_ok && 1 == fwrite(FILAMESH_MAGIC, FILAMESH_MAGIC_SIZE, 1, fp);
+    is_ok = is_ok && 1 == fwrite(&header, sizeof(header), 1, fp);
+    is_ok = is_ok && (0 == header.vertex_size || 1 == fwrite(vertices, header.vertex_size, 1, fp));
+    is_ok = is_ok && (0 == header.index_size || 1 == fwrite(indices, header.index_size, 1, fp));
+    is_ok = is_ok && (0 == parts.size() || 1 == fwrite(&parts[0], sizeof(FilameshPart) * parts.size(), 1, fp));
+    is_ok = is_ok && 1 == fwrite(&num_materials, sizeof(num_materials), 1, fp);
+
+    for (size_t i = 0; i < materials.size(); ++i) {
+      uint32_t len = uint32_t(materials[i].size());
+      is_ok = is_ok && 1 == fwrite(&len, sizeof(len), 1, fp);
+      is_ok = is_ok && 1 == fwrite(materials[i].c_str(), len + 1, 1, fp);
+    }
+
+    if (0 != fclose(fp)) {
+      is_ok = false;
+    }
+
+    if (false == is_ok) {
+      printf("Error: failed to write `%s`.\n", filepath.c_str());
+      return -5;
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  int filamesh_decode_positions(const FilameshData& data, std::vector<float>& positions) {
+
+    const FilameshHeader& header = data.header;
+    uint32_t stride = (0 == header.stride_position) ? 8 : header.stride_position; /* 0 means tightly packed HALF4 or SHORT4. */
+    bool is_quantized = (0 != (header.flags & FILAMESH_FLAG_QUANTIZED));
+
+    if (0 != (header.flags & FILAMESH_FLAG_COMPRESSION)) {
+      printf("Error: cannot decode the positions of a compressed filamesh.\n");
+      return -1;
+    }
+
+    if (nullptr == data.vertices
+        || FILAMESH_NO_ATTRIBUTE == header.offset_position
+        || stride < 8
+        || uint64_t(header.offset_position) + uint64_t(stride) * header.vertex_count > header.vertex_size)
+      {
+        printf("Error: cannot decode the positions, they are not in the vertex data.\n");
+        return -2;
+      }
+
+    positions.resize(size_t(header.vertex_count) * 3);
+
+    for (size_t i = 0; i < header.vertex_count; ++i) {
+
+      const uint8_t* src = data.vertices + header.offset_position + i * stride;
+
+      if (true == is_quantized) {
+        int16_t q[3];
+        memcpy(q, src, sizeof(q));
+        for (size_t j = 0; j < 3; ++j) {
+          float v = float(q[j]) / 32767.0f;
+          positions[i * 3 + j] = header.aabb.center[j] + ((v < -1.0f) ? -1.0f : v) * header.aabb.half_extent[j];
+        }
+      }
+      else {
+        uint16_t half[3];
+        memcpy(half, src, sizeof(half));
+        positions[i * 3 + 0] = filamesh_half_to_float(half[0]);
+        positions[i * 3 + 1] = filamesh_half_to_float(half[1]);
+        positions[i * 3 + 2] = filamesh_half_to_float(half[2]);
+      }
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  /* Rounds to nearest; values outside the half range become +/- infinity. */
+  uint16_t filamesh_float_to_half(float value) {
+
+    uint32_t bits = 0;
+    uint32_t sign = 0;
+    int32_t exponent = 0;
+    uint32_t mantissa = 0;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    sign = (bits >> 16) & 0x8000;
+    exponent = int32_t((bits >> 23) & 0xFF) - 127 + 15;
+    mantissa = bits & 0x007FFFFF;
+
+    if (0xFF == ((bits >> 23) & 0xFF)) {
+      return uint16_t(sign | 0x7C00 | (0 != mantissa ? 0x200 : 0));
+    }
+
+    if (exponent >= 31) {
+      return uint16_t(sign | 0x7C00);
+    }
+
+    if (exponent <= 0) {
+      if (exponent < -10) {
+        return uint16_t(sign);
+      }
+      mantissa = (mantissa | 0x00800000) >> (1 - exponent);
+      return uint16_t(sign | ((mantissa + 0x1000) >> 13));
+    }
+
+    /* A carry out of the mantissa correctly bumps the exponent. */
+    return uint16_t(sign | ((uint32_t(exponent) << 10) + ((mantissa + 0x1000) >> 13)));
+  }
+
+  float filamesh_half_to_float(uint16_t value) {
+
+    uint32_t sign = uint32_t(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x3FF;
+    uint32_t bits = 0;
+    float result = 0.0f;
+
+    if (0 == exponent) {
+      if (0 == mantissa) {
+        bits = sign;
+      }
+      else {
+        exponent = 127 - 15 + 1;
+        while (0 == (mantissa & 0x400)) {
+          mantissa <<= 1;
+          exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+      }
+    }
+    else if (31 == exponent) {
+      bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else {
+      bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    memcpy(&result, &bits, sizeof(result));
+
+    return result;
+  }
+
+  /* -------------------------------------------- */
+
+  static bool read_bytes(const uint8_t* data, size_t size, size_t& offset, void* dst, size_t nbytes) {
+
+    if (offset > size || nbytes > size - offset) {
+      return false;
+    }
+
+    memcpy(dst, data + offset, nbytes);
+    offset += nbytes;
+
+    return true;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
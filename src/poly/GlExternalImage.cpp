@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <glad/glad.h>
+#include <poly/GlExternalImage.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static void close_fd(int fd);
+
+  /* -------------------------------------------- */
+
+  GlExternalImage::GlExternalImage()
+    :memory(0)
+    ,texture(0)
+    ,ready(0)
+    ,done(0)
+  {
+  }
+
+  GlExternalImage::~GlExternalImage() {
+
+    if (0 != texture) {
+      printf("Error: the GL external image is destructed but `shutdown()` hasn't been called.\n");
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  int GlExternalImage::init(const GlExternalImageSettings& cfg) {
+
+    GLint is_dedicated = (true == cfg.is_dedicated) ? GL_TRUE : GL_FALSE;
+
+    if (0 != texture) {
+      printf("Error: the GL external image is already initialized.\n");
+      return -1;
+    }
+
+    if (false == is_supported()) {
+      printf("Error: cannot import the image, the driver doesn't support GL_EXT_memory_object_fd and GL_EXT_semaphore_fd.\n");
+      return -2;
+    }
+
+    if (cfg.memory_fd < 0
+        || 0 == cfg.memory_size
+        || 0 == cfg.width
+        || 0 == cfg.height)
+      {
+        printf("Error: cannot import the image, we need a file descriptor, the size of the memory and the size of the image.\n");
+        return -3;
+      }
+
+    settings = cfg;
+
+    /* Errors of earlier calls would look like errors of the import. */
+    while (GL_NO_ERROR != glGetError()) { }
+
+    /*
+      From here on we own the file descriptors: a successful
+      import hands one to GL and when we fail we close the ones
+      that GL didn't take.
+    */
+    glCreateMemoryObjectsEXT(1, &memory);
+    glMemoryObjectParameterivEXT(memory, GL_DEDICATED_MEMORY_OBJECT_EXT, &is_dedicated);
+
+    if (GL_NO_ERROR == glGetError()) {
+      glImportMemoryFdEXT(memory, cfg.memory_size, GL_HANDLE_TYPE_OPAQUE_FD_EXT, cfg.memory_fd);
+    }
+
+    if (GL_NO_ERROR != glGetError()
+        || GL_FALSE == glIsMemoryObjectEXT(memory))
+      {
+        printf("Error: failed to import the memory of the image.\n");
+        close_fd(cfg.memory_fd);
+        close_fd(cfg.ready_fd);
+        close_fd(cfg.done_fd);
+        shutdown();
+        return -4;
+      }
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_TILING_EXT, GL_OPTIMAL_TILING_EXT);
+    glTexStorageMem2DEXT(GL_TEXTURE_2D, 1, cfg.internal_format, cfg.width, cfg.height, memory, cfg.memory_offset);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (GL_NO_ERROR != glGetError()) {
+      printf("Error: failed to create a texture of %u x %u on the imported memory.\n", cfg.width, cfg.height);
+      close_fd(cfg.ready_fd);
+      close_fd(cfg.done_fd);
+      shutdown();
+      return -5;
+    }
+
+    if (cfg.ready_fd >= 0) {
+      glGenSemaphoresEXT(1, &ready);
+      glImportSemaphoreFdEXT(ready, GL_HANDLE_TYPE_OPAQUE_FD_EXT, cfg.ready_fd);
+      if (GL_NO_ERROR != glGetError()) {
+        printf("Error: failed to import the ready semaphore.\n");
+        close_fd(cfg.ready_fd);
+        close_fd(cfg.done_fd);
+        shutdown();
+        return -6;
+      }
+    }
+
+    if (cfg.done_fd >= 0) {
+      glGenSemaphoresEXT(1, &done);
+      glImportSemaphoreFdEXT(done, GL_HANDLE_TYPE_OPAQUE_FD_EXT, cfg.done_fd);
+      if (GL_NO_ERROR != glGetError()) {
+        printf("Error: failed to import the done semaphore.\n");
+        close_fd(cfg.done_fd);
+        shutdown();
+        return -7;
+      }
+    }
+
+    return 0;
+  }
+
+  int GlExternalImage::shutdown() {
+
+    if (0 != ready) {
+      glDeleteSemaphoresEXT(1, &ready);
+      ready = 0;
+    }
+
+    if (0 != done) {
+      glDeleteSemaphoresEXT(1, &done);
+      done = 0;
+    }
+
+    if (0 != texture) {
+      glDeleteTextures(1, &texture);
+      texture = 0;
+    }
+
+    if (0 != memory) {
+      glDeleteMemoryObjectsEXT(1, &memory);
+      memory = 0;
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  int GlExternalImage::begin_read() {
+
+    GLenum layout = settings.read_layout;
+
+    if (0 == texture) {
+      printf("Error: cannot begin reading the external image, it's not initialized.\n");
+      return -1;
+    }
+
+    if (0 != ready) {
+      glWaitSemaphoreEXT(ready, 0, nullptr, 1, &texture, &layout);
+    }
+
+    return 0;
+  }
+
+  int GlExternalImage::end_read() {
+
+    GLenum layout = settings.release_layout;
+
+    if (0 == texture) {
+      printf("Error: cannot end reading the external image, it's not initialized.\n");
+      return -1;
+    }
+
+    /* The flush makes sure the signal reaches the GPU before Vulkan waits for it. */
+    if (0 != done) {
+      glSignalSemaphoreEXT(done, 0, nullptr, 1, &texture, &layout);
+      glFlush();
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  bool GlExternalImage::is_supported() {
+    return 0 != GLAD_GL_EXT_memory_object_fd
+      && 0 != GLAD_GL_EXT_semaphore_fd;
+  }
+
+  int GlExternalImage::get_uuids(uint8_t* device_uuid, uint8_t* driver_uuid) {
+
+    GLint num_devices = 0;
+
+    if (nullptr == device_uuid
+        || nullptr == driver_uuid)
+      {
+        printf("Error: cannot get the UUIDs, one of the buffers is nullptr.\n");
+        return -1;
+      }
+
+    if (0 == GLAD_GL_EXT_memory_object) {
+      printf("Error: cannot get the UUIDs, the driver doesn't support GL_EXT_memory_object.\n");
+      return -2;
+    }
+
+    glGetIntegerv(GL_NUM_DEVICE_UUIDS_EXT, &num_devices);
+    if (num_devices < 1) {
+      printf("Error: cannot get the UUIDs, the driver doesn't report a device.\n");
+      return -3;
+    }
+
+    glGetUnsignedBytei_vEXT(GL_DEVICE_UUID_EXT, 0, device_uuid);
+    glGetUnsignedBytevEXT(GL_DRIVER_UUID_EXT, driver_uuid);
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  static void close_fd(int fd) {
+
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
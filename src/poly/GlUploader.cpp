@@ -0,0 +1,516 @@
+#include <stdio.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <poly/GlUploader.h>
+#include <poly/Trace.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static int check_shader(uint32_t shader, const char* type);
+  static void delete_object(GlUpload* upload);
+  static bool drain_gl_errors();
+
+  /* -------------------------------------------- */
+
+  GlUploader::GlUploader()
+    :window(nullptr)
+    ,is_running(false)
+    ,num_pending(0)
+  {
+  }
+
+  GlUploader::~GlUploader() {
+
+    if (nullptr != window) {
+      printf("Error: the GL uploader is destructed but `shutdown()` hasn't been called.\n");
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  int GlUploader::init(GLFWwindow* main_window) {
+
+    if (nullptr != window) {
+      printf("Error: the GL uploader is already initialized.\n");
+      return -1;
+    }
+
+    if (nullptr == main_window) {
+      printf("Error: cannot initialize the GL uploader, the main window is nullptr.\n");
+      return -2;
+    }
+
+    /* We keep the other hints (e.g. the context version) of the main window. */
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    window = glfwCreateWindow(1, 1, "GL Uploader", nullptr, main_window);
+    glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+
+    if (nullptr == window) {
+      printf("Error: cannot initialize the GL uploader, failed to create the upload context.\n");
+      return -3;
+    }
+
+    is_running = true;
+    worker = std::thread(&GlUploader::worker_main, this);
+
+    return 0;
+  }
+
+  int GlUploader::shutdown() {
+
+    int r = 0;
+
+    if (nullptr == window) {
+      return 0;
+    }
+
+    /* The worker handles everything that is still queued and calls `glFinish()` before it stops. */
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      is_running = false;
+    }
+
+    cv.notify_all();
+    worker.join();
+
+    update();
+
+    if (0 != num_pending) {
+      printf("Error: %zu uploads are still pending while shutting down the GL uploader.\n", num_pending);
+      r = -1;
+    }
+
+    for (size_t i = 0; i < fenced.size(); ++i) {
+      glDeleteSync((GLsync)fenced[i]->fence);
+    }
+
+    for (size_t i = 0; i < uploads.size(); ++i) {
+      delete uploads[i];
+    }
+
+    uploads.clear();
+    fenced.clear();
+    todo.clear();
+    done.clear();
+    num_pending = 0;
+
+    glfwDestroyWindow(window);
+    window = nullptr;
+
+    return r;
+  }
+
+  /* -------------------------------------------- */
+
+  GlUpload* GlUploader::upload_texture(
+    uint32_t width,
+    uint32_t height,
+    uint32_t internal_format,
+    uint32_t format,
+    uint32_t data_type,
+    const void* pixels,
+    bool mipmaps,
+    GlUploadCallback callback,
+    void* user
+  )
+  {
+    GlUpload* upload = nullptr;
+
+    if (0 == width
+        || 0 == height
+        || nullptr == pixels)
+      {
+        printf("Error: cannot upload a texture without a size or pixels.\n");
+        return nullptr;
+      }
+
+    upload = new GlUpload();
+    upload->type = GL_UPLOAD_TYPE_TEXTURE;
+    upload->width = width;
+    upload->height = height;
+    upload->internal_format = internal_format;
+    upload->format = format;
+    upload->data_type = data_type;
+    upload->mipmaps = mipmaps;
+    upload->data = pixels;
+    upload->callback = callback;
+    upload->user = user;
+
+    return add(upload);
+  }
+
+  GlUpload* GlUploader::upload_buffer(uint32_t target, const void* data, size_t size, GlUploadCallback callback, void* user) {
+
+    GlUpload* upload = nullptr;
+
+    if (nullptr == data
+        || 0 == size)
+      {
+        printf("Error: cannot upload a buffer without data.\n");
+        return nullptr;
+      }
+
+    upload = new GlUpload();
+    upload->type = GL_UPLOAD_TYPE_BUFFER;
+    upload->target = target;
+    upload->data = data;
+    upload->size = size;
+    upload->callback = callback;
+    upload->user = user;
+
+    return add(upload);
+  }
+
+  GlUpload* GlUploader::compile_program(const std::string& vs, const std::string& fs, GlUploadCallback callback, void* user) {
+
+    GlUpload* upload = nullptr;
+
+    if (true == vs.empty()
+        || true == fs.empty())
+      {
+        printf("Error: cannot compile a program without a vertex and fragment shader.\n");
+        return nullptr;
+      }
+
+    upload = new GlUpload();
+    upload->type = GL_UPLOAD_TYPE_PROGRAM;
+    upload->vs = vs;
+    upload->fs = fs;
+    upload->callback = callback;
+    upload->user = user;
+
+    return add(upload);
+  }
+
+  /* Sets the common fields and hands the upload to the worker. */
+  GlUpload* GlUploader::add(GlUpload* upload) {
+
+    if (nullptr == window) {
+      printf("Error: cannot upload, the GL uploader is not initialized.\n");
+      delete upload;
+      return nullptr;
+    }
+
+    upload->state = GL_UPLOAD_STATE_QUEUED;
+    upload->id = 0;
+    upload->upload_ms = 0.0;
+    upload->total_ms = 0.0;
+    upload->fence = nullptr;
+    upload->request_ns = trace_now();
+
+    uploads.push_back(upload);
+    num_pending++;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      todo.push_back(upload);
+    }
+
+    cv.notify_one();
+
+    return upload;
+  }
+
+  /* -------------------------------------------- */
+
+  void GlUploader::update() {
+
+    POLY_TRACE_SCOPE("GlUploader::update");
+
+    std::deque<GlUpload*> handled;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      handled.swap(done);
+    }
+
+    for (size_t i = 0; i < handled.size(); ++i) {
+      if (nullptr == handled[i]->fence) {
+        handled[i]->state = GL_UPLOAD_STATE_FAILED;
+        handled[i]->total_ms = trace_to_ms(handled[i]->request_ns, trace_now());
+        num_pending--;
+        if (nullptr != handled[i]->callback) {
+          handled[i]->callback(handled[i], handled[i]->user);
+        }
+        continue;
+      }
+      handled[i]->state = GL_UPLOAD_STATE_FENCED;
+      fenced.push_back(handled[i]);
+    }
+
+    /* A timeout of 0 only checks the state of the fence. */
+    for (size_t i = 0; i < fenced.size(); ) {
+
+      GlUpload* upload = fenced[i];
+      GLenum status = glClientWaitSync((GLsync)upload->fence, 0, 0);
+
+      if (GL_TIMEOUT_EXPIRED == status) {
+        ++i;
+        continue;
+      }
+
+      glDeleteSync((GLsync)upload->fence);
+      upload->fence = nullptr;
+      upload->state = (GL_WAIT_FAILED == status) ? GL_UPLOAD_STATE_FAILED : GL_UPLOAD_STATE_READY;
+      upload->total_ms = trace_to_ms(upload->request_ns, trace_now());
+      fenced.erase(fenced.begin() + i);
+      num_pending--;
+
+      if (GL_UPLOAD_STATE_FAILED == upload->state) {
+        printf("Error: failed to wait for the fence of an upload.\n");
+      }
+
+      if (nullptr != upload->callback) {
+        upload->callback(upload, upload->user);
+      }
+    }
+  }
+
+  int GlUploader::release(GlUpload* upload) {
+
+    if (nullptr == upload) {
+      printf("Error: cannot release the upload, it's nullptr.\n");
+      return -1;
+    }
+
+    if (GL_UPLOAD_STATE_READY != upload->state
+        && GL_UPLOAD_STATE_FAILED != upload->state)
+      {
+        printf("Error: cannot release an upload which is still pending.\n");
+        return -2;
+      }
+
+    for (size_t i = 0; i < uploads.size(); ++i) {
+      if (upload == uploads[i]) {
+        uploads.erase(uploads.begin() + i);
+        delete upload;
+        return 0;
+      }
+    }
+
+    printf("Error: cannot release the upload, it's not one of ours.\n");
+
+    return -3;
+  }
+
+  size_t GlUploader::get_num_pending() {
+    return num_pending;
+  }
+
+  /* -------------------------------------------- */
+
+  void GlUploader::worker_main() {
+
+    trace_set_thread_name("gl-uploader");
+    glfwMakeContextCurrent(window);
+
+    while (true) {
+
+      GlUpload* upload = nullptr;
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]() { return false == is_running || false == todo.empty(); });
+
+        if (true == todo.empty()) {
+          break;
+        }
+
+        upload = todo.front();
+        todo.pop_front();
+      }
+
+      uint64_t start_ns = trace_now();
+
+      if (0 == handle(upload)) {
+        /* The flush makes sure the fence gets signaled without another GL call in this context. */
+        upload->fence = (void*)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        /* Without a fence the upload fails, so nobody would delete the object. */
+        if (nullptr == upload->fence) {
+          printf("Error: failed to create the fence of an upload.\n");
+          delete_object(upload);
+        }
+      }
+
+      upload->upload_ms = trace_to_ms(start_ns, trace_now());
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.push_back(upload);
+      }
+    }
+
+    glFinish();
+    glfwMakeContextCurrent(nullptr);
+  }
+
+  /* Issues the GL calls of an upload; on error we delete the object we created. */
+  int GlUploader::handle(GlUpload* upload) {
+
+    POLY_TRACE_SCOPE("GlUploader::handle");
+
+    /* Errors are sticky per flag; don't blame this upload for an earlier call. */
+    drain_gl_errors();
+
+    switch (upload->type) {
+
+      case GL_UPLOAD_TYPE_TEXTURE: {
+
+        glGenTextures(1, &upload->id);
+        glBindTexture(GL_TEXTURE_2D, upload->id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, upload->internal_format, upload->width, upload->height, 0, upload->format, upload->data_type, upload->data);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (true == upload->mipmaps) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        if (true == upload->mipmaps) {
+          glGenerateMipmap(GL_TEXTURE_2D);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        if (true == drain_gl_errors()) {
+          printf("Error: failed to upload a texture of %u x %u.\n", upload->width, upload->height);
+          glDeleteTextures(1, &upload->id);
+          upload->id = 0;
+          return -1;
+        }
+
+        return 0;
+      }
+
+      case GL_UPLOAD_TYPE_BUFFER: {
+
+        glGenBuffers(1, &upload->id);
+        glBindBuffer(upload->target, upload->id);
+        glBufferData(upload->target, GLsizeiptr(upload->size), upload->data, GL_STATIC_DRAW);
+        glBindBuffer(upload->target, 0);
+
+        if (true == drain_gl_errors()) {
+          printf("Error: failed to upload a buffer of %zu bytes.\n", upload->size);
+          glDeleteBuffers(1, &upload->id);
+          upload->id = 0;
+          return -2;
+        }
+
+        return 0;
+      }
+
+      case GL_UPLOAD_TYPE_PROGRAM: {
+
+        const char* vss = upload->vs.c_str();
+        const char* fss = upload->fs.c_str();
+        uint32_t vert = glCreateShader(GL_VERTEX_SHADER);
+        uint32_t frag = glCreateShader(GL_FRAGMENT_SHADER);
+        GLint is_linked = GL_FALSE;
+        int r = 0;
+
+        glShaderSource(vert, 1, &vss, nullptr);
+        glCompileShader(vert);
+        glShaderSource(frag, 1, &fss, nullptr);
+        glCompileShader(frag);
+
+        upload->id = glCreateProgram();
+        glAttachShader(upload->id, vert);
+        glAttachShader(upload->id, frag);
+        glLinkProgram(upload->id);
+
+        r |= check_shader(vert, "vertex");
+        r |= check_shader(frag, "fragment");
+
+        glGetProgramiv(upload->id, GL_LINK_STATUS, &is_linked);
+        if (GL_TRUE != is_linked) {
+          printf("Error: failed to link a program on the upload context.\n");
+          r = -1;
+        }
+
+        glDetachShader(upload->id, vert);
+        glDetachShader(upload->id, frag);
+        glDeleteShader(vert);
+        glDeleteShader(frag);
+
+        if (0 != r) {
+          glDeleteProgram(upload->id);
+          upload->id = 0;
+          return -3;
+        }
+
+        return 0;
+      }
+
+      default: {
+        printf("Error: unknown upload type %u.\n", upload->type);
+        return -4;
+      }
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  static int check_shader(uint32_t shader, const char* type) {
+
+    GLint is_compiled = GL_FALSE;
+    GLint count = 0;
+    std::vector<GLchar> log;
+
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &is_compiled);
+    if (GL_TRUE == is_compiled) {
+      return 0;
+    }
+
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &count);
+    log.resize(size_t(count) + 1, 0);
+
+    if (count > 0) {
+      glGetShaderInfoLog(shader, count, nullptr, log.data());
+    }
+
+    printf("Error: failed to compile a %s shader on the upload context.\n", type);
+    printf("--------------------------------------------------------\n");
+    printf("%s\n", log.data());
+    printf("--------------------------------------------------------\n");
+
+    return -1;
+  }
+
+  static void delete_object(GlUpload* upload) {
+
+    switch (upload->type) {
+      case GL_UPLOAD_TYPE_TEXTURE: {
+        glDeleteTextures(1, &upload->id);
+        break;
+      }
+      case GL_UPLOAD_TYPE_BUFFER: {
+        glDeleteBuffers(1, &upload->id);
+        break;
+      }
+      case GL_UPLOAD_TYPE_PROGRAM: {
+        glDeleteProgram(upload->id);
+        break;
+      }
+    }
+
+    upload->id = 0;
+  }
+
+  /* Reads every pending error flag; returns true when there was one. */
+  static bool drain_gl_errors() {
+
+    bool has_error = false;
+
+    while (GL_NO_ERROR != glGetError()) {
+      has_error = true;
+    }
+
+    return has_error;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
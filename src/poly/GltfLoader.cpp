@@ -0,0 +1,646 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filament/Engine.h>
+#include <filament/Scene.h>
+#include <gltfio/AssetLoader.h>
+#include <gltfio/FilamentAsset.h>
+#include <gltfio/MaterialProvider.h>
+#include <gltfio/ResourceLoader.h>
+#include <poly/GltfLoader.h>
+#include <poly/Trace.h>
+
+/* -------------------------------------------- */
+
+#define GLTF_ADD_BATCH_SIZE 64              /* Entities we add to the scene before we check the budget again. */
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static std::string get_directory(const std::string& filepath);
+  static void gltf_resource_release(void* buffer, size_t size, void* user);
+
+  /* -------------------------------------------- */
+
+  GltfLoader::GltfLoader()
+    :engine(nullptr)
+    ,scene(nullptr)
+    ,materials(nullptr)
+    ,asset_loader(nullptr)
+    ,is_running(false)
+    ,num_pending(0)
+  {
+  }
+
+  GltfLoader::~GltfLoader() {
+
+    if (nullptr != engine) {
+      printf("Error: the glTF loader is destructed but `shutdown()` hasn't been called.\n");
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  int GltfLoader::init(filament::Engine* eng, filament::Scene* scn, uint32_t num_threads) {
+
+    if (nullptr != engine) {
+      printf("Error: the glTF loader is already initialized.\n");
+      return -1;
+    }
+
+    if (nullptr == eng
+        || nullptr == scn)
+      {
+        printf("Error: cannot initialize the glTF loader, engine or scene is nullptr.\n");
+        return -2;
+      }
+
+    if (0 == num_threads) {
+      printf("Error: cannot initialize the glTF loader, we need at least one thread.\n");
+      return -3;
+    }
+
+    materials = gltfio::createMaterialGenerator(eng);
+    if (nullptr == materials) {
+      printf("Error: cannot initialize the glTF loader, failed to create the material generator.\n");
+      return -4;
+    }
+
+    gltfio::AssetConfiguration config = {};
+    config.engine = eng;
+    config.materials = materials;
+
+    asset_loader = gltfio::AssetLoader::create(config);
+    if (nullptr == asset_loader) {
+      printf("Error: cannot initialize the glTF loader, failed to create the asset loader.\n");
+      delete materials;
+      materials = nullptr;
+      return -5;
+    }
+
+    engine = eng;
+    scene = scn;
+    is_running = true;
+
+    for (uint32_t i = 0; i < num_threads; ++i) {
+      workers.push_back(std::thread(&GltfLoader::worker_main, this, i));
+    }
+
+    return 0;
+  }
+
+  int GltfLoader::shutdown() {
+
+    if (nullptr == engine) {
+      return 0;
+    }
+
+    /* The workers keep running; an asset we create in `update()` may still have to be fetched. */
+    while (0 != num_pending) {
+      engine->flushAndWait();
+      update();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      is_running = false;
+    }
+
+    cv.notify_all();
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+      workers[i].join();
+    }
+
+    workers.clear();
+
+    while (false == assets.empty()) {
+      destroy(assets.back());
+    }
+
+    materials->destroyMaterials();
+    delete materials;
+    materials = nullptr;
+
+    gltfio::AssetLoader::destroy(&asset_loader);
+    asset_loader = nullptr;
+
+    loading.clear();
+    beginning.clear();
+    engine = nullptr;
+    scene = nullptr;
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  GltfAsset* GltfLoader::load(const std::string& filepath, GltfAssetCallback callback, void* user) {
+
+    GltfAsset* asset = nullptr;
+
+    if (nullptr == engine) {
+      printf("Error: cannot load `%s`, the glTF loader is not initialized.\n", filepath.c_str());
+      return nullptr;
+    }
+
+    asset = new GltfAsset();
+    asset->filepath = filepath;
+    asset->asset = nullptr;
+    asset->state = GLTF_ASSET_STATE_READING;
+    asset->callback = callback;
+    asset->user = user;
+    asset->queue_ms = 0.0;
+    asset->read_ms = 0.0;
+    asset->create_ms = 0.0;
+    asset->fetch_ms = 0.0;
+    asset->begin_ms = 0.0;
+    asset->textures_ms = 0.0;
+    asset->textures_main_ms = 0.0;
+    asset->add_ms = 0.0;
+    asset->main_ms = 0.0;
+    asset->total_ms = 0.0;
+    asset->num_resource_bytes = 0;
+    asset->result = 0;
+    asset->resource_loader = nullptr;
+    asset->num_added = 0;
+    asset->load_ns = trace_now();
+    asset->stage_ns = asset->load_ns;
+
+    assets.push_back(asset);
+    num_pending++;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      todo.push_back(asset);
+    }
+
+    cv.notify_one();
+
+    return asset;
+  }
+
+  int GltfLoader::destroy(GltfAsset* asset) {
+
+    if (nullptr == asset) {
+      printf("Error: cannot destroy the glTF asset, it's nullptr.\n");
+      return -1;
+    }
+
+    if (GLTF_ASSET_STATE_READY != asset->state
+        && GLTF_ASSET_STATE_FAILED != asset->state)
+      {
+        printf("Error: cannot destroy `%s`, it's still loading.\n", asset->filepath.c_str());
+        return -2;
+      }
+
+    for (size_t i = 0; i < assets.size(); ++i) {
+
+      if (asset != assets[i]) {
+        continue;
+      }
+
+      if (nullptr != asset->asset) {
+
+        const utils::Entity* entities = asset->asset->getEntities();
+
+        for (size_t j = 0; j < asset->num_added; ++j) {
+          scene->remove(entities[j]);
+        }
+      }
+
+      /* Releases the resource data, which calls `gltf_resource_release()`. */
+      if (nullptr != asset->resource_loader) {
+        delete asset->resource_loader;
+        asset->resource_loader = nullptr;
+      }
+
+      if (nullptr != asset->asset) {
+        asset_loader->destroyAsset(asset->asset);
+        asset->asset = nullptr;
+      }
+
+      asset->file.close();
+      delete asset;
+
+      assets[i] = assets.back();
+      assets.pop_back();
+
+      return 0;
+    }
+
+    printf("Error: cannot destroy `%s`, it wasn't loaded by this loader.\n", asset->filepath.c_str());
+
+    return -3;
+  }
+
+  /* -------------------------------------------- */
+
+  void GltfLoader::update() {
+    update(0.0);
+  }
+
+  void GltfLoader::update(double max_main_ms) {
+
+    std::deque<GltfAsset*> ready;
+    uint64_t start_ns = trace_now();
+    bool has_added = false;
+
+    if (nullptr == engine) {
+      return;
+    }
+
+    POLY_TRACE_SCOPE("GltfLoader::update");
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ready.swap(done);
+    }
+
+    /* Assets which were read or fetched by a worker. */
+    for (size_t i = 0; i < ready.size(); ++i) {
+
+      GltfAsset* asset = ready[i];
+
+      if (0 != asset->result) {
+        printf("Error: failed to %s `%s`.\n", (GLTF_ASSET_STATE_READING == asset->state) ? "read" : "fetch the resources of", asset->filepath.c_str());
+        fail(asset);
+        continue;
+      }
+
+      if (GLTF_ASSET_STATE_READING == asset->state) {
+        create(asset);
+        continue;
+      }
+
+      asset->state = GLTF_ASSET_STATE_BEGINNING;
+      beginning.push_back(asset);
+    }
+
+    /* The vertex and index data is uploaded when we begin; one asset per frame. */
+    if (false == beginning.empty()) {
+      GltfAsset* asset = beginning.front();
+      beginning.pop_front();
+      begin(asset);
+    }
+
+    for (size_t i = 0; i < loading.size(); ) {
+
+      GltfAsset* asset = loading[i];
+
+      if (GLTF_ASSET_STATE_TEXTURES == asset->state) {
+
+        uint64_t update_ns = trace_now();
+        float progress = 0.0f;
+
+        {
+          POLY_TRACE_SCOPE("GltfLoader::textures");
+          asset->resource_loader->asyncUpdateLoad();
+          progress = asset->resource_loader->asyncGetLoadProgress();
+        }
+
+        double ms = trace_to_ms(update_ns, trace_now());
+        asset->textures_main_ms += ms;
+        asset->main_ms += ms;
+
+        if (progress < 1.0f) {
+          ++i;
+          continue;
+        }
+
+        asset->asset->releaseSourceData();
+        asset->textures_ms = trace_to_ms(asset->stage_ns, trace_now());
+        asset->stage_ns = trace_now();
+        asset->state = GLTF_ASSET_STATE_ADDING;
+      }
+
+      /* Add the entities in batches until we're over the budget; at least one batch per frame. */
+      if (GLTF_ASSET_STATE_ADDING == asset->state) {
+
+        const utils::Entity* entities = asset->asset->getEntities();
+        size_t num_entities = asset->asset->getEntityCount();
+
+        while (asset->num_added < num_entities) {
+
+          if (true == has_added
+              && max_main_ms > 0.0
+              && trace_to_ms(start_ns, trace_now()) >= max_main_ms)
+            {
+              break;
+            }
+
+          uint64_t add_ns = trace_now();
+          size_t count = std::min<size_t>(GLTF_ADD_BATCH_SIZE, num_entities - asset->num_added);
+
+          scene->addEntities(entities + asset->num_added, count);
+          asset->num_added += count;
+          asset->main_ms += trace_to_ms(add_ns, trace_now());
+          has_added = true;
+        }
+
+        if (asset->num_added < num_entities) {
+          ++i;
+          continue;
+        }
+
+        asset->add_ms = trace_to_ms(asset->stage_ns, trace_now());
+        asset->state = GLTF_ASSET_STATE_READY;
+        loading[i] = loading.back();
+        loading.pop_back();
+
+        finish(asset);
+        continue;
+      }
+
+      ++i;
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  size_t GltfLoader::get_num_pending() {
+    return num_pending;
+  }
+
+  void GltfLoader::print() {
+
+    const char* state_names[] = { "reading", "fetching", "beginning", "textures", "adding", "ready", "failed" };
+
+    /* The workers write the read and fetch stats under this lock. */
+    std::lock_guard<std::mutex> lock(mutex);
+
+    printf("glTF loading (ms):\n");
+    printf("  %-9s %9s %9s %9s %9s %9s %9s %9s %9s %9s %9s  %s\n", "state", "queue", "read", "create", "fetch", "begin", "textures", "add", "main", "total", "MB", "file");
+
+    for (size_t i = 0; i < assets.size(); ++i) {
+      GltfAsset* asset = assets[i];
+      printf("  %-9s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f %9.2f  %s\n",
+             state_names[asset->state],
+             asset->queue_ms,
+             asset->read_ms,
+             asset->create_ms,
+             asset->fetch_ms,
+             asset->begin_ms,
+             asset->textures_ms,
+             asset->add_ms,
+             asset->main_ms,
+             asset->total_ms,
+             double(asset->num_resource_bytes) / (1024.0 * 1024.0),
+             asset->filepath.c_str());
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  void GltfLoader::worker_main(uint32_t dx) {
+
+    trace_set_thread_name("gltf-loader-" + std::to_string(dx));
+
+    while (true) {
+
+      GltfAsset* asset = nullptr;
+      uint64_t start_ns = 0;
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return false == is_running || false == todo.empty(); });
+
+        if (true == todo.empty()) {
+          return;
+        }
+
+        asset = todo.front();
+        todo.pop_front();
+      }
+
+      start_ns = trace_now();
+
+      /* The stats are read by `print()`, so we only store them under the lock. */
+      int result = 0;
+      double queue_ms = asset->queue_ms;
+      double read_ms = asset->read_ms;
+      double fetch_ms = asset->fetch_ms;
+      uint64_t num_resource_bytes = 0;
+
+      if (GLTF_ASSET_STATE_READING == asset->state) {
+
+        POLY_TRACE_SCOPE("GltfLoader::read");
+
+        queue_ms = trace_to_ms(asset->load_ns, start_ns);
+        result = asset->file.open(asset->filepath);
+
+        if (0 == result) {
+          asset->file.prefault();
+        }
+
+        read_ms = trace_to_ms(start_ns, trace_now());
+      }
+      else {
+
+        POLY_TRACE_SCOPE("GltfLoader::fetch");
+
+        std::string dir = get_directory(asset->filepath);
+
+        for (size_t i = 0; i < asset->uris.size(); ++i) {
+
+          MappedFile* file = new MappedFile();
+          std::string filepath = dir + asset->uris[i];
+
+          if (0 != file->open(filepath)) {
+            delete file;
+            result = -1;
+            break;
+          }
+
+          file->prefault();
+          num_resource_bytes += file->get_size();
+          asset->resources.push_back(file);
+        }
+
+        fetch_ms = trace_to_ms(start_ns, trace_now());
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        asset->result = result;
+        asset->queue_ms = queue_ms;
+        asset->read_ms = read_ms;
+        asset->fetch_ms = fetch_ms;
+        asset->num_resource_bytes += num_resource_bytes;
+        done.push_back(asset);
+      }
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  void GltfLoader::create(GltfAsset* asset) {
+
+    uint64_t start_ns = trace_now();
+    const uint8_t* data = asset->file.get_data();
+    size_t size = asset->file.get_size();
+
+    POLY_TRACE_SCOPE("GltfLoader::create");
+
+    if (size > UINT32_MAX) {
+      printf("Error: cannot load `%s`, it's too large.\n", asset->filepath.c_str());
+      fail(asset);
+      return;
+    }
+
+    /* A binary glTF starts with the magic `glTF`. */
+    if (size >= 4
+        && 0 == memcmp(data, "glTF", 4))
+      {
+        asset->asset = asset_loader->createAssetFromBinary(data, uint32_t(size));
+      }
+    else {
+      asset->asset = asset_loader->createAssetFromJson(data, uint32_t(size));
+    }
+
+    /*
+      gltfio copies the GLB data and parses the JSON into its own
+      structures, so we don't have to keep the file mapped.
+    */
+    asset->file.close();
+    asset->create_ms = trace_to_ms(start_ns, trace_now());
+    asset->main_ms += asset->create_ms;
+
+    if (nullptr == asset->asset) {
+      printf("Error: failed to create the asset for `%s`.\n", asset->filepath.c_str());
+      fail(asset);
+      return;
+    }
+
+    /* Data URIs are decoded by gltfio. */
+    const char* const* uris = asset->asset->getResourceUris();
+    size_t num_uris = asset->asset->getResourceUriCount();
+
+    for (size_t i = 0; i < num_uris; ++i) {
+      if (0 != strncmp(uris[i], "data:", 5)) {
+        asset->uris.push_back(uris[i]);
+      }
+    }
+
+    asset->stage_ns = trace_now();
+
+    if (true == asset->uris.empty()) {
+      asset->state = GLTF_ASSET_STATE_BEGINNING;
+      beginning.push_back(asset);
+      return;
+    }
+
+    asset->state = GLTF_ASSET_STATE_FETCHING;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      todo.push_back(asset);
+    }
+
+    cv.notify_one();
+  }
+
+  void GltfLoader::begin(GltfAsset* asset) {
+
+    uint64_t start_ns = trace_now();
+    gltfio::ResourceConfiguration config = {};
+
+    POLY_TRACE_SCOPE("GltfLoader::begin");
+
+    /* Relative URIs are resolved against this path. */
+    config.engine = engine;
+    config.gltfPath = asset->filepath.c_str();
+    config.normalizeSkinningWeights = true;
+    config.recomputeBoundingBoxes = false;
+
+    asset->resource_loader = new gltfio::ResourceLoader(config);
+
+    /* The resource loader releases the mapped files when it's destroyed. */
+    for (size_t i = 0; i < asset->resources.size(); ++i) {
+      MappedFile* file = asset->resources[i];
+      asset->resource_loader->addResourceData(
+        asset->uris[i].c_str(),
+        gltfio::ResourceLoader::BufferDescriptor(file->get_data(), file->get_size(), gltf_resource_release, file)
+      );
+    }
+
+    asset->resources.clear();
+
+    if (false == asset->resource_loader->asyncBeginLoad(asset->asset)) {
+      printf("Error: failed to begin loading the resources of `%s`.\n", asset->filepath.c_str());
+      fail(asset);
+      return;
+    }
+
+    asset->begin_ms = trace_to_ms(start_ns, trace_now());
+    asset->main_ms += asset->begin_ms;
+    asset->stage_ns = trace_now();
+    asset->state = GLTF_ASSET_STATE_TEXTURES;
+
+    loading.push_back(asset);
+  }
+
+  void GltfLoader::fail(GltfAsset* asset) {
+
+    if (nullptr != asset->resource_loader) {
+      delete asset->resource_loader;
+      asset->resource_loader = nullptr;
+    }
+
+    for (size_t i = 0; i < asset->resources.size(); ++i) {
+      asset->resources[i]->close();
+      delete asset->resources[i];
+    }
+
+    asset->resources.clear();
+
+    if (nullptr != asset->asset) {
+      asset_loader->destroyAsset(asset->asset);
+      asset->asset = nullptr;
+    }
+
+    asset->file.close();
+    asset->state = GLTF_ASSET_STATE_FAILED;
+
+    finish(asset);
+  }
+
+  void GltfLoader::finish(GltfAsset* asset) {
+
+    asset->total_ms = trace_to_ms(asset->load_ns, trace_now());
+    num_pending--;
+
+    if (nullptr != asset->callback) {
+      asset->callback(asset, asset->user);
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  /* Returns the directory of `filepath`, including the trailing separator. */
+  static std::string get_directory(const std::string& filepath) {
+
+    size_t dx = filepath.find_last_of("/\\");
+
+    if (std::string::npos == dx) {
+      return "";
+    }
+
+    return filepath.substr(0, dx + 1);
+  }
+
+  /* Called by the resource loader when it doesn't need the data of an external resource anymore. */
+  static void gltf_resource_release(void* buffer, size_t size, void* user) {
+
+    MappedFile* file = (MappedFile*) user;
+
+    file->close();
+    delete file;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <string.h>
+#include <glad/glad.h>
+#include <poly/GpuTimer.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  GpuTimer::GpuTimer(size_t num_samples)
+    :frame_index(0)
+    ,num_dropped_frames(0)
+    ,num_samples(num_samples)
+    ,is_init(false)
+  {
+    memset(frames, 0x00, sizeof(frames));
+    add_section("frame");
+  }
+
+  GpuTimer::~GpuTimer() {
+
+    if (true == is_init) {
+      printf("Error: the GpuTimer is destructed, but you didn't call `shutdown()`; we're leaking query objects.\n");
+    }
+
+    for (size_t i = 0; i < sections.size(); ++i) {
+      delete sections[i];
+    }
+
+    sections.clear();
+  }
+
+  /* -------------------------------------------- */
+
+  int GpuTimer::add_section(const std::string& name) {
+
+    if (true == is_init) {
+      printf("Error: cannot add a section to the GpuTimer after calling `init()`.\n");
+      return -1;
+    }
+
+    if (sections.size() >= GPU_TIMER_MAX_SECTIONS) {
+      printf("Error: cannot add another GpuTimer section; the max is %d.\n", GPU_TIMER_MAX_SECTIONS);
+      return -2;
+    }
+
+    GpuTimerSection* sec = new GpuTimerSection();
+    sec->name = name;
+    sec->cpu_ms = RollingStats(num_samples);
+    sec->gpu_ms = RollingStats(num_samples);
+    sections.push_back(sec);
+
+    return int(sections.size() - 1);
+  }
+
+  /* -------------------------------------------- */
+
+  int GpuTimer::init() {
+
+    if (true == is_init) {
+      printf("Error: trying to initialize the GpuTimer, but it's already initialized.\n");
+      return -1;
+    }
+
+    if (0 == GLAD_GL_VERSION_3_3
+        && 0 == GLAD_GL_ARB_timer_query)
+      {
+        printf("Error: cannot initialize the GpuTimer; GL_ARB_timer_query is not supported.\n");
+        return -2;
+      }
+
+    for (int i = 0; i < GPU_TIMER_NUM_FRAMES; ++i) {
+      glGenQueries(GPU_TIMER_MAX_SECTIONS * 2, frames[i].queries);
+      frames[i].used = 0;
+      frames[i].is_pending = false;
+    }
+
+    frame_index = 0;
+    num_dropped_frames = 0;
+    is_init = true;
+
+    return 0;
+  }
+
+  int GpuTimer::shutdown() {
+
+    if (false == is_init) {
+      printf("Error: trying to shutdown the GpuTimer, but it's not initialized.\n");
+      return -1;
+    }
+
+    for (int i = 0; i < GPU_TIMER_NUM_FRAMES; ++i) {
+      glDeleteQueries(GPU_TIMER_MAX_SECTIONS * 2, frames[i].queries);
+      memset(frames[i].queries, 0x00, sizeof(frames[i].queries));
+      frames[i].used = 0;
+      frames[i].is_pending = false;
+    }
+
+    is_init = false;
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  void GpuTimer::begin_frame() {
+
+    if (false == is_init) {
+      return;
+    }
+
+    /* Before we reuse the slot we collect the results of the frame that used it. */
+    GpuTimerFrame& frame = frames[frame_index % GPU_TIMER_NUM_FRAMES];
+    if (true == frame.is_pending) {
+      read_results(frame);
+    }
+
+    frame.used = 0;
+    frame.is_pending = false;
+
+    begin(get_frame_section());
+  }
+
+  void GpuTimer::end_frame() {
+
+    if (false == is_init) {
+      return;
+    }
+
+    end(get_frame_section());
+
+    frames[frame_index % GPU_TIMER_NUM_FRAMES].is_pending = true;
+    frame_index++;
+  }
+
+  /* -------------------------------------------- */
+
+  void GpuTimer::begin(int section) {
+
+    if (false == is_init) {
+      return;
+    }
+
+    if (section < 0 || section >= int(sections.size())) {
+      return;
+    }
+
+    GpuTimerFrame& frame = frames[frame_index % GPU_TIMER_NUM_FRAMES];
+    glQueryCounter(frame.queries[section * 2 + 0], GL_TIMESTAMP);
+    cpu_begin[section] = std::chrono::steady_clock::now();
+  }
+
+  void GpuTimer::end(int section) {
+
+    if (false == is_init) {
+      return;
+    }
+
+    if (section < 0 || section >= int(sections.size())) {
+      return;
+    }
+
+    GpuTimerFrame& frame = frames[frame_index % GPU_TIMER_NUM_FRAMES];
+    std::chrono::duration<double, std::milli> cpu_dt = std::chrono::steady_clock::now() - cpu_begin[section];
+
+    glQueryCounter(frame.queries[section * 2 + 1], GL_TIMESTAMP);
+    frame.cpu_ms[section] = cpu_dt.count();
+    frame.used |= (1u << section);
+  }
+
+  /* -------------------------------------------- */
+
+  void GpuTimer::reset() {
+
+    for (int i = 0; i < GPU_TIMER_NUM_FRAMES; ++i) {
+      frames[i].is_pending = false;
+    }
+
+    for (size_t i = 0; i < sections.size(); ++i) {
+      sections[i]->cpu_ms.reset();
+      sections[i]->gpu_ms.reset();
+    }
+
+    num_dropped_frames = 0;
+  }
+
+  /* 
+     We read the frames in the order they were submitted; the 
+     oldest one lives in the slot that we will use next.
+  */
+  void GpuTimer::finish() {
+
+    if (false == is_init) {
+      return;
+    }
+
+    glFinish();
+
+    for (uint64_t i = 0; i < GPU_TIMER_NUM_FRAMES; ++i) {
+      GpuTimerFrame& frame = frames[(frame_index + i) % GPU_TIMER_NUM_FRAMES];
+      if (true == frame.is_pending) {
+        read_results(frame);
+        frame.is_pending = false;
+      }
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  /*
+    We only have to check the availability of the last query
+    that was issued for the frame (the end of the "frame"
+    section); queries complete in order so when this one is
+    available all the others are too.
+  */
+  void GpuTimer::read_results(GpuTimerFrame& frame) {
+
+    GLint is_available = 0;
+    GLuint64 ts_begin = 0;
+    GLuint64 ts_end = 0;
+    uint32_t last_query = frame.queries[get_frame_section() * 2 + 1];
+
+    if (0 == (frame.used & (1u << get_frame_section()))) {
+      return;
+    }
+
+    glGetQueryObjectiv(last_query, GL_QUERY_RESULT_AVAILABLE, &is_available);
+    if (GL_FALSE == is_available) {
+      num_dropped_frames++;
+      return;
+    }
+
+    for (size_t i = 0; i < sections.size(); ++i) {
+
+      if (0 == (frame.used & (1u << i))) {
+        continue;
+      }
+
+      glGetQueryObjectui64v(frame.queries[i * 2 + 0], GL_QUERY_RESULT, &ts_begin);
+      glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &ts_end);
+
+      if (ts_end >= ts_begin) {
+        sections[i]->gpu_ms.add(double(ts_end - ts_begin) / 1e6);
+      }
+
+      sections[i]->cpu_ms.add(frame.cpu_ms[i]);
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  GpuTimerSection* GpuTimer::get_section(int section) {
+
+    if (section < 0 || section >= int(sections.size())) {
+      return nullptr;
+    }
+
+    return sections[section];
+  }
+
+  /* -------------------------------------------- */
+
+  void GpuTimer::print() {
+
+    printf("GpuTimer (ms), dropped frames: %llu\n", (unsigned long long)num_dropped_frames);
+
+    for (size_t i = 0; i < sections.size(); ++i) {
+      GpuTimerSection* sec = sections[i];
+      printf("  %-12s cpu p50: %6.3f, p95: %6.3f, p99: %6.3f | gpu p50: %6.3f, p95: %6.3f, p99: %6.3f\n",
+             sec->name.c_str(),
+             sec->cpu_ms.percentile(50.0),
+             sec->cpu_ms.percentile(95.0),
+             sec->cpu_ms.percentile(99.0),
+             sec->gpu_ms.percentile(50.0),
+             sec->gpu_ms.percentile(95.0),
+             sec->gpu_ms.percentile(99.0));
+    }
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
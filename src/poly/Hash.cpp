@@ -0,0 +1,51 @@
+#include <string.h>
+#include <poly/Hash.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static uint64_t hash_mix(uint64_t h);
+
+  /* -------------------------------------------- */
+
+  uint64_t hash_bytes(const void* data, size_t nbytes, uint64_t seed) {
+
+    const uint64_t prime = 0x100000001b3ULL;
+    const uint8_t* ptr = (const uint8_t*) data;
+    uint64_t h = seed ^ (uint64_t(nbytes) * prime);
+    uint64_t word = 0;
+    size_t i = 0;
+
+    for (i = 0; i + 8 <= nbytes; i += 8) {
+      memcpy(&word, ptr + i, 8);
+      h = (h ^ word) * prime;
+      h ^= h >> 29;
+    }
+
+    if (i < nbytes) {
+      word = 0;
+      memcpy(&word, ptr + i, nbytes - i);
+      h = (h ^ word) * prime;
+    }
+
+    return hash_mix(h);
+  }
+
+  /* -------------------------------------------- */
+
+  /* The finalizer of MurmurHash3. */
+  static uint64_t hash_mix(uint64_t h) {
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
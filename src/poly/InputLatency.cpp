@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <chrono>
+#include <poly/InputLatency.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static const char* input_latency_stage_names[INPUT_LATENCY_NUM_STAGES] = {
+    "camera",
+    "submit",
+    "composite",
+    "present"
+  };
+
+  /* -------------------------------------------- */
+
+  InputLatency::InputLatency()
+    :pending_input_ns(0)
+    ,frame_input_ns(0)
+    ,num_events(0)
+    ,num_frames_with_input(0)
+  {
+    for (int i = 0; i < INPUT_LATENCY_NUM_STAGES; ++i) {
+      histograms[i] = Histogram(0.0, 100.0, 50);
+      stats[i] = RollingStats(4096);
+      stage_ns[i] = 0;
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  void InputLatency::on_input() {
+    on_input(get_time_ns());
+  }
+
+  void InputLatency::on_input(uint64_t arrival_ns) {
+
+    if (0 == pending_input_ns
+        || arrival_ns < pending_input_ns)
+      {
+        pending_input_ns = arrival_ns;
+      }
+
+    num_events++;
+  }
+
+  /* -------------------------------------------- */
+
+  void InputLatency::begin_frame() {
+
+    frame_input_ns = pending_input_ns;
+    pending_input_ns = 0;
+
+    for (int i = 0; i < INPUT_LATENCY_NUM_STAGES; ++i) {
+      stage_ns[i] = 0;
+    }
+  }
+
+  /*
+     The frame keeps the arrival time of its oldest input. When
+     it had no input yet, the stages that it marked before this
+     call aren't used for the late input, because `mark()`
+     ignored them.
+  */
+  void InputLatency::consume_late_input() {
+
+    if (0 == pending_input_ns) {
+      return;
+    }
+
+    if (0 == frame_input_ns
+        || pending_input_ns < frame_input_ns)
+      {
+        frame_input_ns = pending_input_ns;
+      }
+
+    pending_input_ns = 0;
+  }
+
+  /* We give the input of this frame back, so the next `begin_frame()` picks it up with its original arrival time. */
+  void InputLatency::skip_frame() {
+
+    if (0 != frame_input_ns
+        && (0 == pending_input_ns || frame_input_ns < pending_input_ns))
+      {
+        pending_input_ns = frame_input_ns;
+      }
+
+    frame_input_ns = 0;
+
+    for (int i = 0; i < INPUT_LATENCY_NUM_STAGES; ++i) {
+      stage_ns[i] = 0;
+    }
+  }
+
+  void InputLatency::mark(int stage) {
+
+    if (stage < 0 || stage >= INPUT_LATENCY_NUM_STAGES) {
+      return;
+    }
+
+    if (0 == frame_input_ns) {
+      return;
+    }
+
+    stage_ns[stage] = get_time_ns();
+  }
+
+  /*
+     A stage that wasn't marked (e.g. there is no composite stage
+     when Filament presents directly) is not added to the stats.
+  */
+  void InputLatency::end_frame() {
+
+    if (0 == frame_input_ns) {
+      return;
+    }
+
+    for (int i = 0; i < INPUT_LATENCY_NUM_STAGES; ++i) {
+
+      if (0 == stage_ns[i]) {
+        continue;
+      }
+
+      double latency_ms = double(stage_ns[i] - frame_input_ns) / 1e6;
+      histograms[i].add(latency_ms);
+      stats[i].add(latency_ms);
+    }
+
+    frame_input_ns = 0;
+    num_frames_with_input++;
+  }
+
+  /* -------------------------------------------- */
+
+  void InputLatency::print() {
+
+    printf("Input latency, events: %llu, frames with input: %llu\n",
+           (unsigned long long)num_events,
+           (unsigned long long)num_frames_with_input);
+
+    for (int i = 0; i < INPUT_LATENCY_NUM_STAGES; ++i) {
+
+      if (0 == histograms[i].get_count()) {
+        continue;
+      }
+
+      printf("  input -> %-10s p50: %6.2f ms, p95: %6.2f ms, p99: %6.2f ms, max: %6.2f ms\n",
+             input_latency_stage_names[i],
+             stats[i].percentile(50.0),
+             stats[i].percentile(95.0),
+             stats[i].percentile(99.0),
+             stats[i].max());
+
+      histograms[i].print("ms");
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  uint64_t InputLatency::get_time_ns() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
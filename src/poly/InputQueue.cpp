@@ -0,0 +1,144 @@
+#include <poly/InputQueue.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static bool input_event_is_mergeable(uint32_t type);
+
+  /* -------------------------------------------- */
+
+  InputQueue::InputQueue()
+    :head(0)
+    ,tail(0)
+    ,open(INPUT_QUEUE_OPEN_NONE)
+    ,last_type(0)
+    ,num_dropped(0)
+    ,num_merged(0)
+  {
+  }
+
+  /* -------------------------------------------- */
+
+  bool InputQueue::push(const InputEvent& ev) {
+
+    uint32_t h = head.load(std::memory_order_relaxed);
+
+    /* Try to merge into the newest event when the consumer didn't close it. */
+    if (true == input_event_is_mergeable(ev.type)
+        && ev.type == last_type)
+      {
+        uint32_t expected = (h - 1) & INPUT_QUEUE_INDEX_MASK;
+        if (true == open.compare_exchange_strong(expected, INPUT_QUEUE_OPEN_BUSY, std::memory_order_acquire)) {
+
+          InputEvent& newest = events[(h - 1) & (INPUT_QUEUE_CAPACITY - 1)];
+
+          if (INPUT_EVENT_CURSOR == ev.type) {
+            newest.x = ev.x;
+            newest.y = ev.y;
+          }
+          else {
+            newest.x += ev.x;
+            newest.y += ev.y;
+          }
+
+          newest.mods = ev.mods;
+          newest.num_merged += 1;
+
+          /* Only reopen it when the consumer didn't close it while we merged. */
+          uint32_t busy = INPUT_QUEUE_OPEN_BUSY;
+          open.compare_exchange_strong(busy, (h - 1) & INPUT_QUEUE_INDEX_MASK, std::memory_order_release, std::memory_order_relaxed);
+          num_merged++;
+
+          return true;
+        }
+      }
+
+    if ((h - tail.load(std::memory_order_acquire)) >= INPUT_QUEUE_CAPACITY) {
+      num_dropped++;
+      return false;
+    }
+
+    InputEvent& slot = events[h & (INPUT_QUEUE_CAPACITY - 1)];
+    slot = ev;
+    slot.num_merged = 1;
+    last_type = ev.type;
+
+    /*
+      We open the new event before we publish it; when the
+      consumer drains in between it closes the event, which only
+      means that we can't merge into it.
+    */
+    open.store((true == input_event_is_mergeable(ev.type)) ? (h & INPUT_QUEUE_INDEX_MASK) : INPUT_QUEUE_OPEN_NONE, std::memory_order_release);
+    head.store(h + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  /* -------------------------------------------- */
+
+  uint32_t InputQueue::drain(InputEvent* out, uint32_t max_events) {
+
+    if (nullptr == out || 0 == max_events) {
+      return 0;
+    }
+
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_acquire);
+    uint32_t o = open.load(std::memory_order_acquire);
+
+    /*
+      Close the newest event so the producer can't merge into it
+      while we copy it. When the producer is merging we leave it
+      busy and skip the last event we saw; the busy event is that
+      one or a newer one, so we never read it. We pick it up next
+      time. There may be nothing to skip when the producer
+      published and claimed an event after we read `head`.
+    */
+    while (true) {
+
+      if (INPUT_QUEUE_OPEN_BUSY == o) {
+        if (h > t) {
+          h = h - 1;
+        }
+        break;
+      }
+
+      if (true == open.compare_exchange_weak(o, INPUT_QUEUE_OPEN_NONE, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        break;
+      }
+    }
+
+    uint32_t count = h - t;
+    if (count > max_events) {
+      count = max_events;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+      out[i] = events[(t + i) & (INPUT_QUEUE_CAPACITY - 1)];
+    }
+
+    tail.store(t + count, std::memory_order_release);
+
+    return count;
+  }
+
+  /* -------------------------------------------- */
+
+  uint64_t InputQueue::get_num_dropped() {
+    return num_dropped;
+  }
+
+  uint64_t InputQueue::get_num_merged() {
+    return num_merged;
+  }
+
+  /* -------------------------------------------- */
+
+  static bool input_event_is_mergeable(uint32_t type) {
+    return (INPUT_EVENT_CURSOR == type || INPUT_EVENT_SCROLL == type);
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
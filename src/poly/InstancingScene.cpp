@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <filament/Engine.h>
+#include <filament/Scene.h>
+#include <filament/Camera.h>
+#include <math/mat4.h>
+#include <poly/InstancingScene.h>
+#include <poly/MeshCache.h>
+#include <poly/MeshLoader.h>
+#include <poly/Trace.h>
+
+using namespace filament;
+using namespace filament::math;
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  InstancingScene::InstancingScene()
+    :engine(nullptr)
+    ,scene(nullptr)
+    ,cache(nullptr)
+    ,mesh(nullptr)
+    ,scale(1.0f)
+    ,batched(true)
+    ,transform_ms(1024)
+    ,lod_ms(1024)
+    ,num_triangles(0)
+    ,num_lod_switches(0)
+  {
+  }
+
+  InstancingScene::~InstancingScene() {
+
+    if (nullptr != engine) {
+      printf("Error: the instancing scene is destructed but `shutdown()` hasn't been called.\n");
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  int InstancingScene::init(
+    filament::Engine* eng,
+    filament::Scene* scn,
+    MeshCache* meshes,
+    const std::string& filepath,
+    uint32_t num_instances,
+    float extent
+  )
+  {
+    uint32_t num_columns = 0;
+    float spacing = 0.0f;
+
+    if (nullptr != engine) {
+      printf("Error: the instancing scene is already initialized.\n");
+      return -1;
+    }
+
+    if (nullptr == eng
+        || nullptr == scn
+        || nullptr == meshes)
+      {
+        printf("Error: cannot initialize the instancing scene, engine, scene or cache is nullptr.\n");
+        return -2;
+      }
+
+    if (0 == num_instances) {
+      printf("Error: cannot initialize the instancing scene, we need at least one instance.\n");
+      return -3;
+    }
+
+    engine = eng;
+    scene = scn;
+    cache = meshes;
+
+    TransformManager& tm = engine->getTransformManager();
+
+    num_columns = uint32_t(ceilf(sqrtf(float(num_instances))));
+    spacing = extent / float(num_columns);
+    scale = spacing * 0.4f;
+
+    entities.reserve(num_instances);
+    transforms.reserve(num_instances);
+    positions.reserve(num_instances * 3);
+    phases.reserve(num_instances);
+
+    for (uint32_t i = 0; i < num_instances; ++i) {
+
+      utils::Entity ent = cache->create_instance(filepath);
+      if (true == ent.isNull()) {
+        printf("Error: failed to create instance %u of `%s`.\n", i, filepath.c_str());
+        shutdown();
+        return -4;
+      }
+
+      /* Instances of quantized meshes already have their transform. */
+      if (false == tm.hasComponent(ent)) {
+        tm.create(ent);
+      }
+
+      entities.push_back(ent);
+      transforms.push_back(tm.getInstance(ent));
+      positions.push_back(-0.5f * extent + (float(i % num_columns) + 0.5f) * spacing);
+      positions.push_back(-1.0f);
+      positions.push_back(-0.5f * extent + (float(i / num_columns) + 0.5f) * spacing);
+      phases.push_back(float(i) * 0.618034f * 6.283185f);
+    }
+
+    /* All instances share the same entry, and so the same lods. */
+    mesh = cache->get_instance_entry(entities[0]);
+    lod_levels.assign(num_instances, 0);
+    num_lod_switches = 0;
+
+    /* Positions and scales don't change; `update()` only writes the rotations. */
+    transform_batch_resize(batch, num_instances);
+
+    for (uint32_t i = 0; i < num_instances; ++i) {
+      batch.px[i] = positions[i * 3 + 0];
+      batch.py[i] = positions[i * 3 + 1];
+      batch.pz[i] = positions[i * 3 + 2];
+      batch.sx[i] = scale;
+      batch.sy[i] = scale;
+      batch.sz[i] = scale;
+    }
+
+    scene->addEntities(entities.data(), entities.size());
+
+    return 0;
+  }
+
+  int InstancingScene::shutdown() {
+
+    if (nullptr == engine) {
+      return 0;
+    }
+
+    /* `destroy_instance()` destroys all components, including the transform. */
+    for (size_t i = 0; i < entities.size(); ++i) {
+      scene->remove(entities[i]);
+      cache->destroy_instance(entities[i]);
+    }
+
+    entities.clear();
+    transforms.clear();
+    positions.clear();
+    phases.clear();
+    lod_levels.clear();
+    transform_batch_resize(batch, 0);
+    mesh = nullptr;
+    engine = nullptr;
+    scene = nullptr;
+    cache = nullptr;
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  void InstancingScene::update(double time) {
+
+    if (nullptr == engine) {
+      return;
+    }
+
+    POLY_TRACE_SCOPE("InstancingScene::update");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    float angle = float(fmod(time, 6.283185307179586));
+
+    if (true == batched) {
+      update_batched(angle);
+    }
+    else {
+      update_scalar(angle);
+    }
+
+    transform_ms.add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  /* -------------------------------------------- */
+
+  void InstancingScene::update_lods(const filament::Camera& camera) {
+
+    if (nullptr == engine
+        || nullptr == mesh)
+      {
+        return;
+      }
+
+    POLY_TRACE_SCOPE("InstancingScene::update_lods");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const MeshLods& lods = mesh->lods;
+
+    if (lods.levels.size() <= 1) {
+
+      uint64_t triangles_per_instance = 0;
+
+      for (size_t i = 0; i < mesh->data.parts.size(); ++i) {
+        triangles_per_instance += mesh->data.parts[i].index_count / 3;
+      }
+
+      num_triangles = triangles_per_instance * entities.size();
+    }
+    else {
+
+      float3 eye = camera.getPosition();
+      float eye_position[3] = { eye.x, eye.y, eye.z };
+      float projection_scale = float(camera.getProjectionMatrix()[1][1]);
+
+      num_triangles = 0;
+
+      for (size_t i = 0; i < entities.size(); ++i) {
+
+        float size = mesh_get_screen_size(lods, &positions[i * 3], scale, eye_position, projection_scale);
+        uint32_t level = mesh_select_lod(lods, size, lod_levels[i]);
+
+        if (level != lod_levels[i]) {
+          cache->set_instance_lod(entities[i], level);
+          lod_levels[i] = uint8_t(level);
+          num_lod_switches++;
+        }
+
+        num_triangles += lods.levels[level].num_triangles;
+      }
+    }
+
+    lod_ms.add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  uint32_t InstancingScene::get_num_lod_levels() {
+
+    if (nullptr == mesh
+        || mesh->lods.levels.size() <= 1)
+      {
+        return 1;
+      }
+
+    return uint32_t(mesh->lods.levels.size());
+  }
+
+  uint32_t InstancingScene::get_num_vertex_bytes() {
+
+    if (nullptr == mesh) {
+      return 0;
+    }
+
+    return mesh->data.header.vertex_size;
+  }
+
+  void InstancingScene::reset_stats() {
+    transform_ms.reset();
+    lod_ms.reset();
+    num_lod_switches = 0;
+  }
+
+  /* -------------------------------------------- */
+
+  void InstancingScene::update_scalar(float angle) {
+
+    TransformManager& tm = engine->getTransformManager();
+    mat4f scaling = mat4f::scaling(float3{ scale, scale, scale }) * mesh_get_position_transform(mesh->data.header);
+
+    for (size_t i = 0; i < transforms.size(); ++i) {
+      const float* pos = &positions[i * 3];
+      mat4f m = mat4f::translation(float3{ pos[0], pos[1], pos[2] })
+        * mat4f::rotation(angle + phases[i], float3{ 0.0f, 1.0f, 0.0f })
+        * scaling;
+      tm.setTransform(transforms[i], m);
+    }
+  }
+
+  void InstancingScene::update_batched(float angle) {
+
+    /* A rotation around Y: q = (0, sin(a/2), 0, cos(a/2)). */
+    for (size_t i = 0; i < transforms.size(); ++i) {
+      float half = 0.5f * (angle + phases[i]);
+      batch.qy[i] = sinf(half);
+      batch.qw[i] = cosf(half);
+    }
+
+    transform_batch_compose(batch);
+
+    if (0 != (mesh->data.header.flags & FILAMESH_FLAG_QUANTIZED)) {
+      transform_batch_apply_local(batch, mesh->data.header.aabb.center, mesh->data.header.aabb.half_extent);
+    }
+
+    transform_batch_commit(batch, engine->getTransformManager(), transforms.data());
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
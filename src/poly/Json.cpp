@@ -0,0 +1,30 @@
+#include <stdio.h>
+#include <poly/Json.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  void json_write_string(FILE* fp, const char* str) {
+
+    fputc('"', fp);
+
+    for (const char* c = str; nullptr != c && '\0' != *c; ++c) {
+      if ('"' == *c || '\\' == *c) {
+        fputc('\\', fp);
+        fputc(*c, fp);
+      }
+      else if ((unsigned char)*c < 0x20) {
+        fprintf(fp, "\\u%04x", (unsigned int)*c);
+      }
+      else {
+        fputc(*c, fp);
+      }
+    }
+
+    fputc('"', fp);
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <poly/MappedFile.h>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  MappedFile::MappedFile()
+    :data(nullptr)
+    ,size(0)
+#if defined(_WIN32)
+    ,file_handle(nullptr)
+    ,map_handle(nullptr)
+#endif
+  {
+  }
+
+  MappedFile::~MappedFile() {
+
+    if (nullptr != data) {
+      printf("Error: the mapped file hasn't been closed; we're leaking the mapping.\n");
+    }
+  }
+
+  /* -------------------------------------------- */
+
+#if defined(_WIN32)
+
+  int MappedFile::open(const std::string& filepath) {
+
+    LARGE_INTEGER file_size = {};
+
+    if (nullptr != data) {
+      printf("Error: cannot open `%s`, we already mapped a file; close it first.\n", filepath.c_str());
+      return -1;
+    }
+
+    file_handle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (INVALID_HANDLE_VALUE == file_handle) {
+      printf("Error: cannot open `%s` for mapping.\n", filepath.c_str());
+      file_handle = nullptr;
+      return -2;
+    }
+
+    if (FALSE == GetFileSizeEx(file_handle, &file_size)
+        || 0 == file_size.QuadPart)
+      {
+        printf("Error: cannot map `%s`, failed to get the size or the file is empty.\n", filepath.c_str());
+        close();
+        return -3;
+      }
+
+    map_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (nullptr == map_handle) {
+      printf("Error: cannot create a file mapping for `%s`.\n", filepath.c_str());
+      close();
+      return -4;
+    }
+
+    data = (const uint8_t*) MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0);
+    if (nullptr == data) {
+      printf("Error: cannot map a view of `%s`.\n", filepath.c_str());
+      close();
+      return -5;
+    }
+
+    size = size_t(file_size.QuadPart);
+
+    return 0;
+  }
+
+  int MappedFile::close() {
+
+    if (nullptr != data) {
+      UnmapViewOfFile(data);
+      data = nullptr;
+    }
+
+    if (nullptr != map_handle) {
+      CloseHandle(map_handle);
+      map_handle = nullptr;
+    }
+
+    if (nullptr != file_handle) {
+      CloseHandle(file_handle);
+      file_handle = nullptr;
+    }
+
+    size = 0;
+
+    return 0;
+  }
+
+#else
+
+  int MappedFile::open(const std::string& filepath) {
+
+    struct stat info = {};
+    void* ptr = nullptr;
+    int fd = -1;
+
+    if (nullptr != data) {
+      printf("Error: cannot open `%s`, we already mapped a file; close it first.\n", filepath.c_str());
+      return -1;
+    }
+
+    fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+      printf("Error: cannot open `%s` for mapping.\n", filepath.c_str());
+      return -2;
+    }
+
+    if (0 != fstat(fd, &info)
+        || 0 == info.st_size)
+      {
+        printf("Error: cannot map `%s`, failed to get the size or the file is empty.\n", filepath.c_str());
+        ::close(fd);
+        return -3;
+      }
+
+    ptr = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+    /* The mapping keeps a reference to the file. */
+    ::close(fd);
+
+    if (MAP_FAILED == ptr) {
+      printf("Error: cannot map `%s`.\n", filepath.c_str());
+      return -4;
+    }
+
+    /* We read the vertex and index regions once, front to back. */
+    madvise(ptr, size_t(info.st_size), MADV_SEQUENTIAL);
+
+    data = (const uint8_t*) ptr;
+    size = size_t(info.st_size);
+
+    return 0;
+  }
+
+  int MappedFile::close() {
+
+    if (nullptr == data) {
+      return 0;
+    }
+
+    if (0 != munmap((void*) data, size)) {
+      printf("Error: failed to unmap the file.\n");
+      return -1;
+    }
+
+    data = nullptr;
+    size = 0;
+
+    return 0;
+  }
+
+#endif
+
+  /* -------------------------------------------- */
+
+  void MappedFile::prefault() {
+
+    volatile uint8_t sum = 0;
+    const size_t page_size = 4096;
+
+    if (nullptr == data) {
+      return;
+    }
+
+#if !defined(_WIN32)
+    madvise((void*) data, size, MADV_WILLNEED);
+#endif
+
+    for (size_t i = 0; i < size; i += page_size) {
+      sum += data[i];
+    }
+
+    sum += data[size - 1];
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
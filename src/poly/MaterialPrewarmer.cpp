@@ -0,0 +1,461 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <filament/Engine.h>
+#include <filament/Renderer.h>
+#include <filament/SwapChain.h>
+#include <filament/Scene.h>
+#include <filament/View.h>
+#include <filament/Viewport.h>
+#include <filament/Camera.h>
+#include <filament/Texture.h>
+#include <filament/RenderTarget.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <filament/RenderableManager.h>
+#include <filament/LightManager.h>
+#include <filament/Material.h>
+#include <filament/MaterialInstance.h>
+#include <filament/Box.h>
+#include <utils/EntityManager.h>
+#include <gltfio/FilamentAsset.h>
+#include <poly/MaterialPrewarmer.h>
+#include <poly/Trace.h>
+
+using namespace filament;
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  /* Position, tangent frame (a quaternion; the normal points to +z) and uv. */
+  struct PrewarmVertex {
+    float position[3];
+    int16_t tangents[4];
+    float uv[2];
+  };
+
+  static const PrewarmVertex prewarm_vertices[] = {
+    { { -1.0f, -1.0f, 0.0f }, { 0, 0, 0, 32767 }, { 0.0f, 0.0f } },
+    { {  1.0f, -1.0f, 0.0f }, { 0, 0, 0, 32767 }, { 1.0f, 0.0f } },
+    { {  1.0f,  1.0f, 0.0f }, { 0, 0, 0, 32767 }, { 1.0f, 1.0f } },
+    { { -1.0f,  1.0f, 0.0f }, { 0, 0, 0, 32767 }, { 0.0f, 1.0f } },
+  };
+
+  static const uint16_t prewarm_indices[] = {
+    0, 1, 2, 0, 2, 3,
+  };
+
+  /* -------------------------------------------- */
+
+  MaterialPrewarmer::MaterialPrewarmer()
+    :engine(nullptr)
+    ,scene(nullptr)
+    ,view(nullptr)
+    ,camera(nullptr)
+    ,color(nullptr)
+    ,depth(nullptr)
+    ,render_target(nullptr)
+    ,vb(nullptr)
+    ,ib(nullptr)
+    ,baseline_ms(0.0)
+    ,total_ms(0.0)
+  {
+  }
+
+  MaterialPrewarmer::~MaterialPrewarmer() {
+
+    if (nullptr != engine) {
+      printf("Error: the material prewarmer is destructed but `shutdown()` hasn't been called.\n");
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  int MaterialPrewarmer::init(filament::Engine* eng) {
+
+    if (nullptr != engine) {
+      printf("Error: the material prewarmer is already initialized.\n");
+      return -1;
+    }
+
+    if (nullptr == eng) {
+      printf("Error: cannot initialize the material prewarmer, the engine is nullptr.\n");
+      return -2;
+    }
+
+    engine = eng;
+    scene = engine->createScene();
+    view = engine->createView();
+    camera = engine->createCamera();
+
+    color = Texture::Builder()
+      .width(MATERIAL_PREWARM_TARGET_SIZE)
+      .height(MATERIAL_PREWARM_TARGET_SIZE)
+      .levels(1)
+      .usage(Texture::Usage::COLOR_ATTACHMENT | Texture::Usage::SAMPLEABLE)
+      .format(Texture::InternalFormat::RGBA8)
+      .build(*engine);
+
+    depth = Texture::Builder()
+      .width(MATERIAL_PREWARM_TARGET_SIZE)
+      .height(MATERIAL_PREWARM_TARGET_SIZE)
+      .levels(1)
+      .usage(Texture::Usage::DEPTH_ATTACHMENT)
+      .format(Texture::InternalFormat::DEPTH24)
+      .build(*engine);
+
+    vb = VertexBuffer::Builder()
+      .vertexCount(4)
+      .bufferCount(1)
+      .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3, offsetof(PrewarmVertex, position), sizeof(PrewarmVertex))
+      .attribute(VertexAttribute::TANGENTS, 0, VertexBuffer::AttributeType::SHORT4, offsetof(PrewarmVertex, tangents), sizeof(PrewarmVertex))
+      .normalized(VertexAttribute::TANGENTS)
+      .attribute(VertexAttribute::UV0, 0, VertexBuffer::AttributeType::FLOAT2, offsetof(PrewarmVertex, uv), sizeof(PrewarmVertex))
+      .build(*engine);
+
+    ib = IndexBuffer::Builder()
+      .indexCount(6)
+      .bufferType(IndexBuffer::IndexType::USHORT)
+      .build(*engine);
+
+    if (nullptr == scene
+        || nullptr == view
+        || nullptr == camera
+        || nullptr == color
+        || nullptr == depth
+        || nullptr == vb
+        || nullptr == ib)
+      {
+        printf("Error: failed to create the objects of the material prewarmer.\n");
+        shutdown();
+        return -3;
+      }
+
+    render_target = RenderTarget::Builder()
+      .texture(RenderTarget::AttachmentPoint::COLOR, color)
+      .texture(RenderTarget::AttachmentPoint::DEPTH, depth)
+      .build(*engine);
+
+    if (nullptr == render_target) {
+      printf("Error: failed to create the render target of the material prewarmer.\n");
+      shutdown();
+      return -4;
+    }
+
+    /* The arrays are static, so we don't need a release callback. */
+    vb->setBufferAt(*engine, 0, VertexBuffer::BufferDescriptor(prewarm_vertices, sizeof(prewarm_vertices)));
+    ib->setBuffer(*engine, IndexBuffer::BufferDescriptor(prewarm_indices, sizeof(prewarm_indices)));
+
+    camera->setProjection(Camera::Projection::ORTHO, -1.0, 1.0, -1.0, 1.0, 0.1, 10.0);
+    camera->lookAt({ 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+
+    view->setName("material-prewarm");
+    view->setScene(scene);
+    view->setCamera(camera);
+    view->setRenderTarget(render_target);
+    view->setViewport({ 0, 0, MATERIAL_PREWARM_TARGET_SIZE, MATERIAL_PREWARM_TARGET_SIZE });
+
+    return 0;
+  }
+
+  int MaterialPrewarmer::shutdown() {
+
+    if (nullptr == engine) {
+      return 0;
+    }
+
+    if (false == light.isNull()) {
+      engine->destroy(light);
+      utils::EntityManager::get().destroy(light);
+      light = utils::Entity();
+    }
+
+    if (nullptr != view) {
+      engine->destroy(view);
+      view = nullptr;
+    }
+
+    if (nullptr != scene) {
+      engine->destroy(scene);
+      scene = nullptr;
+    }
+
+    if (nullptr != camera) {
+      engine->destroy(camera);
+      camera = nullptr;
+    }
+
+    if (nullptr != render_target) {
+      engine->destroy(render_target);
+      render_target = nullptr;
+    }
+
+    if (nullptr != color) {
+      engine->destroy(color);
+      color = nullptr;
+    }
+
+    if (nullptr != depth) {
+      engine->destroy(depth);
+      depth = nullptr;
+    }
+
+    if (nullptr != vb) {
+      engine->destroy(vb);
+      vb = nullptr;
+    }
+
+    if (nullptr != ib) {
+      engine->destroy(ib);
+      ib = nullptr;
+    }
+
+    entries.clear();
+    engine = nullptr;
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  int MaterialPrewarmer::add(const filament::MaterialInstance* instance, const std::string& name) {
+
+    MaterialPrewarmEntry entry = {};
+
+    if (nullptr == instance) {
+      printf("Error: cannot add the material `%s` to the prewarmer, the instance is nullptr.\n", name.c_str());
+      return -1;
+    }
+
+    /* The programs belong to the material, so one instance is enough. */
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (instance->getMaterial() == entries[i].material) {
+        return 0;
+      }
+    }
+
+    entry.name = name;
+    entry.material = instance->getMaterial();
+    entry.instance = instance;
+    entry.is_prewarmed = false;
+    entry.frame_ms = 0.0;
+
+    entries.push_back(entry);
+
+    return 0;
+  }
+
+  int MaterialPrewarmer::add(filamesh::MeshReader::MaterialRegistry& registry) {
+
+    size_t num_materials = registry.numRegistered();
+    std::vector<filament::MaterialInstance*> instances(num_materials, nullptr);
+    std::vector<utils::CString> names(num_materials);
+
+    if (0 == num_materials) {
+      return 0;
+    }
+
+    registry.getRegisteredMaterials(instances.data(), names.data());
+
+    for (size_t i = 0; i < num_materials; ++i) {
+      if (0 != add(instances[i], names[i].c_str())) {
+        return -1;
+      }
+    }
+
+    return 0;
+  }
+
+  int MaterialPrewarmer::add(const gltfio::FilamentAsset* asset) {
+
+    if (nullptr == asset) {
+      printf("Error: cannot add the materials of a glTF asset to the prewarmer, the asset is nullptr.\n");
+      return -1;
+    }
+
+    const filament::MaterialInstance* const* instances = asset->getMaterialInstances();
+    size_t num_instances = asset->getMaterialInstanceCount();
+
+    for (size_t i = 0; i < num_instances; ++i) {
+      if (0 != add(instances[i], instances[i]->getMaterial()->getName())) {
+        return -2;
+      }
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  int MaterialPrewarmer::prewarm(filament::Renderer* renderer, filament::SwapChain* swap_chain, const MaterialPrewarmFeatures& features) {
+
+    POLY_TRACE_SCOPE("MaterialPrewarmer::prewarm");
+
+    uint64_t start_ns = trace_now();
+    int r = 0;
+
+    if (nullptr == engine) {
+      printf("Error: cannot prewarm, the material prewarmer is not initialized.\n");
+      return -1;
+    }
+
+    if (nullptr == renderer
+        || nullptr == swap_chain)
+      {
+        printf("Error: cannot prewarm the materials, the renderer or swap chain is nullptr.\n");
+        return -2;
+      }
+
+    /* Called after every load; don't render the baseline frame when nothing new was added. */
+    if (0 == get_num_pending()) {
+      return 0;
+    }
+
+    view->setPostProcessingEnabled(features.post_processing);
+    view->setShadowsEnabled(features.shadows);
+
+    if (true == features.directional_light
+        && true == light.isNull())
+      {
+        light = utils::EntityManager::get().create();
+
+        LightManager::Builder(LightManager::Type::SUN)
+          .color({ 1.0f, 1.0f, 1.0f })
+          .intensity(100000.0f)
+          .direction({ 0.0f, -1.0f, -1.0f })
+          .castShadows(features.shadows)
+          .build(*engine, light);
+
+        scene->addEntity(light);
+      }
+    else if (false == features.directional_light
+             && false == light.isNull())
+      {
+        scene->remove(light);
+        engine->destroy(light);
+        utils::EntityManager::get().destroy(light);
+        light = utils::Entity();
+      }
+
+    /* This frame only compiles what the view itself needs. */
+    if (0 != render_frame(renderer, swap_chain, baseline_ms)) {
+      return -3;
+    }
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+
+      MaterialPrewarmEntry& entry = entries[i];
+      utils::Entity entity;
+      Box aabb;
+
+      if (true == entry.is_prewarmed) {
+        continue;
+      }
+
+      aabb.set({ -1.0f, -1.0f, -0.01f }, { 1.0f, 1.0f, 0.01f });
+      entity = utils::EntityManager::get().create();
+
+      RenderableManager::Builder(1)
+        .boundingBox(aabb)
+        .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vb, ib, 0, 6)
+        .material(0, entry.instance)
+        .culling(false)
+        .castShadows(features.shadows)
+        .receiveShadows(features.shadows)
+        .build(*engine, entity);
+
+      scene->addEntity(entity);
+
+      if (0 != render_frame(renderer, swap_chain, entry.frame_ms)) {
+        r = -4;
+      }
+      else {
+        entry.is_prewarmed = true;
+      }
+
+      scene->remove(entity);
+      engine->getRenderableManager().destroy(entity);
+      utils::EntityManager::get().destroy(entity);
+
+      if (0 != r) {
+        break;
+      }
+    }
+
+    total_ms += trace_to_ms(start_ns, trace_now());
+
+    return r;
+  }
+
+  /* -------------------------------------------- */
+
+  size_t MaterialPrewarmer::get_num_pending() {
+
+    size_t num_pending = 0;
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (false == entries[i].is_prewarmed) {
+        num_pending++;
+      }
+    }
+
+    return num_pending;
+  }
+
+  double MaterialPrewarmer::get_total_ms() {
+    return total_ms;
+  }
+
+  void MaterialPrewarmer::print() {
+
+    printf("Material prewarming: %zu materials in %.3f ms, a frame without materials took %.3f ms.\n",
+           entries.size(),
+           total_ms,
+           baseline_ms);
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+
+      const MaterialPrewarmEntry& entry = entries[i];
+
+      if (false == entry.is_prewarmed) {
+        printf("  %-32s not prewarmed\n", entry.name.c_str());
+        continue;
+      }
+
+      printf("  %-32s %8.3f ms (%.3f ms more than without materials)\n",
+             entry.name.c_str(),
+             entry.frame_ms,
+             (entry.frame_ms > baseline_ms) ? (entry.frame_ms - baseline_ms) : 0.0);
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  /* Renders one frame with our view and waits until the driver executed it; that's where the programs are compiled. */
+  int MaterialPrewarmer::render_frame(filament::Renderer* renderer, filament::SwapChain* swap_chain, double& ms) {
+
+    uint64_t start_ns = trace_now();
+    uint32_t num_skipped = 0;
+
+    while (false == renderer->beginFrame(swap_chain)) {
+
+      if (++num_skipped >= MATERIAL_PREWARM_MAX_SKIPPED) {
+        printf("Error: cannot prewarm the materials, the renderer keeps skipping frames.\n");
+        return -1;
+      }
+
+      engine->flushAndWait();
+    }
+
+    renderer->render(view);
+    renderer->endFrame();
+    engine->flushAndWait();
+
+    ms = trace_to_ms(start_ns, trace_now());
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
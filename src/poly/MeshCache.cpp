@@ -0,0 +1,511 @@
+#include <stdio.h>
+#include <sys/stat.h>
+#include <filament/Engine.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <filament/RenderableManager.h>
+#include <filament/Material.h>
+#include <filament/MaterialInstance.h>
+#include <utils/EntityManager.h>
+#include <poly/MeshCache.h>
+#include <poly/MeshLoader.h>
+#include <poly/MappedFile.h>
+#include <poly/MeshOptimizer.h>
+#include <poly/Hash.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static int get_file_info(const std::string& filepath, MeshCacheFileInfo& info);
+
+  /* -------------------------------------------- */
+
+  MeshCache::MeshCache()
+    :engine(nullptr)
+    ,materials(nullptr)
+    ,budget(MESH_CACHE_DEFAULT_BUDGET)
+    ,optimize(false)
+    ,optimize_flags(MESH_OPTIMIZE_DEFAULT)
+    ,num_lods(0)
+    ,num_bytes(0)
+    ,tick(0)
+    ,num_hits(0)
+    ,num_content_hits(0)
+    ,num_misses(0)
+    ,num_evictions(0)
+  {
+  }
+
+  MeshCache::~MeshCache() {
+
+    if (nullptr != engine) {
+      printf("Error: the mesh cache is destructed but `shutdown()` hasn't been called.\n");
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  int MeshCache::init(filament::Engine* eng, filamesh::MeshReader::MaterialRegistry* reg, size_t max_bytes) {
+
+    if (nullptr != engine) {
+      printf("Error: the mesh cache is already initialized.\n");
+      return -1;
+    }
+
+    if (nullptr == eng
+        || nullptr == reg)
+      {
+        printf("Error: cannot initialize the mesh cache, engine or material registry is nullptr.\n");
+        return -2;
+      }
+
+    engine = eng;
+    materials = reg;
+    budget = max_bytes;
+
+    return 0;
+  }
+
+  int MeshCache::shutdown() {
+
+    std::unordered_map<uint64_t, MeshCacheEntry*>::iterator it;
+    std::unordered_map<uint32_t, MeshCacheEntry*>::iterator iit;
+    std::unordered_map<std::string, filament::MaterialInstance*>::iterator mit;
+    uint32_t num_acquired = 0;
+
+    if (nullptr == engine) {
+      return 0;
+    }
+
+    for (iit = instances.begin(); iit != instances.end(); ++iit) {
+      utils::Entity entity = utils::Entity::import(iit->first);
+      engine->destroy(entity);
+      utils::EntityManager::get().destroy(entity);
+      iit->second->refcount--;
+    }
+
+    for (it = entries.begin(); it != entries.end(); ++it) {
+      MeshCacheEntry* entry = it->second;
+      num_acquired += entry->refcount;
+      engine->destroy(entry->vb);
+      engine->destroy(entry->ib);
+      if (nullptr != entry->lod_ib) {
+        engine->destroy(entry->lod_ib);
+      }
+      delete entry;
+    }
+
+    /* After the renderables, which use them. */
+    for (mit = material_instances.begin(); mit != material_instances.end(); ++mit) {
+      engine->destroy(mit->second);
+    }
+
+    if (0 != num_acquired) {
+      printf("Error: shutting down the mesh cache while %u meshes are still acquired.\n", num_acquired);
+    }
+
+    entries.clear();
+    files.clear();
+    instances.clear();
+    material_instances.clear();
+    num_bytes = 0;
+    engine = nullptr;
+    materials = nullptr;
+
+    return (0 == num_acquired) ? 0 : -1;
+  }
+
+  MeshCache& MeshCache::get() {
+    static MeshCache cache;
+    return cache;
+  }
+
+  /* -------------------------------------------- */
+
+  MeshCacheEntry* MeshCache::acquire(const std::string& filepath) {
+
+    MeshCacheFileInfo info = {};
+    MeshCacheEntry* entry = nullptr;
+    std::unordered_map<std::string, MeshCacheFileInfo>::iterator fit;
+    std::unordered_map<uint64_t, MeshCacheEntry*>::iterator eit;
+
+    if (nullptr == engine) {
+      printf("Error: cannot acquire `%s`, the mesh cache is not initialized.\n", filepath.c_str());
+      return nullptr;
+    }
+
+    if (0 != get_file_info(filepath, info)) {
+      printf("Error: cannot acquire `%s`, failed to stat the file.\n", filepath.c_str());
+      return nullptr;
+    }
+
+    /* When the file didn't change we know its hash without reading it. */
+    fit = files.find(filepath);
+    if (fit != files.end()
+        && fit->second.size == info.size
+        && fit->second.mtime == info.mtime)
+      {
+        eit = entries.find(fit->second.hash);
+        if (eit != entries.end()) {
+          entry = eit->second;
+          num_hits++;
+        }
+      }
+
+    if (nullptr == entry) {
+      entry = load(filepath, info);
+      if (nullptr == entry) {
+        return nullptr;
+      }
+      files[filepath] = info;
+    }
+
+    entry->refcount++;
+    entry->last_used = ++tick;
+
+    /* Make room for a newly loaded entry. */
+    evict();
+
+    return entry;
+  }
+
+  void MeshCache::release(MeshCacheEntry* entry) {
+
+    if (nullptr == entry) {
+      return;
+    }
+
+    if (0 == entry->refcount) {
+      printf("Error: releasing `%s` which isn't acquired.\n", entry->filepath.c_str());
+      return;
+    }
+
+    entry->refcount--;
+    entry->last_used = ++tick;
+
+    evict();
+  }
+
+  /* -------------------------------------------- */
+
+  utils::Entity MeshCache::create_instance(const std::string& filepath) {
+
+    MeshCacheEntry* entry = acquire(filepath);
+    utils::Entity entity;
+
+    if (nullptr == entry) {
+      return entity;
+    }
+
+    entity = utils::EntityManager::get().create();
+
+    if (0 != mesh_create_renderable(engine, entry->data, entry->vb, entry->ib, entry->materials, entity)) {
+      printf("Error: failed to create an instance of `%s`.\n", filepath.c_str());
+      utils::EntityManager::get().destroy(entity);
+      release(entry);
+      return utils::Entity();
+    }
+
+    instances[entity.getId()] = entry;
+
+    return entity;
+  }
+
+  int MeshCache::destroy_instance(utils::Entity entity) {
+
+    std::unordered_map<uint32_t, MeshCacheEntry*>::iterator it = instances.find(entity.getId());
+    MeshCacheEntry* entry = nullptr;
+
+    if (it == instances.end()) {
+      printf("Error: cannot destroy the instance, the entity wasn't created by the mesh cache.\n");
+      return -1;
+    }
+
+    entry = it->second;
+    instances.erase(it);
+
+    engine->destroy(entity);
+    utils::EntityManager::get().destroy(entity);
+    release(entry);
+
+    return 0;
+  }
+
+  MeshCacheEntry* MeshCache::get_instance_entry(utils::Entity entity) {
+
+    std::unordered_map<uint32_t, MeshCacheEntry*>::iterator it = instances.find(entity.getId());
+
+    if (it == instances.end()) {
+      return nullptr;
+    }
+
+    return it->second;
+  }
+
+  int MeshCache::set_instance_lod(utils::Entity entity, uint32_t level) {
+
+    MeshCacheEntry* entry = get_instance_entry(entity);
+    filament::IndexBuffer* ib = nullptr;
+
+    if (nullptr == entry) {
+      printf("Error: cannot set the lod, the entity wasn't created by the mesh cache.\n");
+      return -1;
+    }
+
+    if (level >= entry->lods.levels.size()) {
+      printf("Error: cannot set lod %u of `%s`, it has %zu levels.\n", level, entry->filepath.c_str(), entry->lods.levels.size());
+      return -2;
+    }
+
+    filament::RenderableManager& rm = engine->getRenderableManager();
+    filament::RenderableManager::Instance ri = rm.getInstance(entity);
+    const MeshLodLevel& lod = entry->lods.levels[level];
+
+    ib = (0 == level) ? entry->ib : entry->lod_ib;
+
+    for (size_t i = 0; i < lod.parts.size(); ++i) {
+      rm.setGeometryAt(ri, i, filament::RenderableManager::PrimitiveType::TRIANGLES, entry->vb, ib, lod.parts[i].offset, lod.parts[i].index_count);
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  void MeshCache::set_budget(size_t max_bytes) {
+    budget = max_bytes;
+    evict();
+  }
+
+  void MeshCache::set_optimize(bool enabled, uint32_t flags) {
+
+    /* We upload the data straight from the mapping, so it can't be compressed. */
+    if (0 != (flags & MESH_OPTIMIZE_COMPRESS)) {
+      printf("Error: the mesh cache can't use compressed meshes, we ignore `MESH_OPTIMIZE_COMPRESS`.\n");
+      flags &= ~MESH_OPTIMIZE_COMPRESS;
+    }
+
+    optimize = enabled;
+    optimize_flags = flags;
+  }
+
+  void MeshCache::set_lods(uint32_t num_levels) {
+    num_lods = num_levels;
+  }
+
+  size_t MeshCache::get_num_entries() {
+    return entries.size();
+  }
+
+  size_t MeshCache::get_num_bytes() {
+    return num_bytes;
+  }
+
+  void MeshCache::print() {
+
+    std::unordered_map<uint64_t, MeshCacheEntry*>::iterator it;
+
+    printf("Mesh cache: %zu entries, %zu instances, %zu materials, %.2f of %.2f MB, hits: %llu, content hits: %llu, misses: %llu, evictions: %llu\n",
+           entries.size(),
+           instances.size(),
+           material_instances.size(),
+           double(num_bytes) / (1024.0 * 1024.0),
+           double(budget) / (1024.0 * 1024.0),
+           (unsigned long long)num_hits,
+           (unsigned long long)num_content_hits,
+           (unsigned long long)num_misses,
+           (unsigned long long)num_evictions);
+
+    for (it = entries.begin(); it != entries.end(); ++it) {
+      MeshCacheEntry* entry = it->second;
+      printf("  %016llx  refs: %4u  %9.2f KB  %s\n",
+             (unsigned long long)entry->hash,
+             entry->refcount,
+             double(entry->num_bytes) / 1024.0,
+             entry->filepath.c_str());
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  MeshCacheEntry* MeshCache::load(const std::string& filepath, MeshCacheFileInfo& info) {
+
+    MappedFile* file = new MappedFile();
+    MeshCacheEntry* entry = nullptr;
+    std::unordered_map<uint64_t, MeshCacheEntry*>::iterator it;
+    std::string load_filepath = filepath;
+    FilameshData data;
+
+    /* Falls back to the source when we can't optimize it. */
+    if (true == optimize) {
+      mesh_get_optimized(filepath, optimize_flags, load_filepath);
+    }
+
+    if (0 != file->open(load_filepath)) {
+      delete file;
+      return nullptr;
+    }
+
+    info.hash = hash_bytes(file->get_data(), file->get_size());
+
+    /* Another path with the same contents. */
+    it = entries.find(info.hash);
+    if (it != entries.end()) {
+      mesh_unmap_file(file);
+      num_content_hits++;
+      return it->second;
+    }
+
+    if (0 != filamesh_parse(file->get_data(), file->get_size(), data)) {
+      printf("Error: cannot cache `%s`, it's not a valid filamesh.\n", filepath.c_str());
+      mesh_unmap_file(file);
+      return nullptr;
+    }
+
+    if (0 != (data.header.flags & FILAMESH_FLAG_COMPRESSION)) {
+      printf("Error: cannot cache `%s`, compressed filamesh files are not supported.\n", filepath.c_str());
+      mesh_unmap_file(file);
+      return nullptr;
+    }
+
+    entry = new MeshCacheEntry();
+    entry->hash = info.hash;
+    entry->filepath = filepath;
+    entry->vb = nullptr;
+    entry->ib = nullptr;
+    entry->lod_ib = nullptr;
+    entry->refcount = 0;
+    entry->last_used = 0;
+    entry->num_bytes = size_t(data.header.vertex_size) + size_t(data.header.index_size);
+
+    /* The lods are built from the mapped data, so before we hand it to the buffers. */
+    if (num_lods > 1) {
+      if (0 != mesh_generate_lods(data, num_lods, entry->lods)
+          || 0 != mesh_create_lod_buffer(engine, entry->lods, data.header.vertex_count, &entry->lod_ib))
+        {
+          printf("Error: failed to generate the lods of `%s`, we only use the full mesh.\n", filepath.c_str());
+          entry->lods = MeshLods();
+          entry->lod_ib = nullptr;
+        }
+      entry->num_bytes += entry->lods.indices.size() * ((data.header.vertex_count <= 65536) ? 2 : 4);
+    }
+
+    /* From here on the mapping is owned by the buffer descriptors. */
+    if (0 != mesh_create_buffers(engine, data, mesh_unmap_file, file, &entry->vb, &entry->ib)) {
+      printf("Error: cannot cache `%s`, failed to create the buffers.\n", filepath.c_str());
+      if (nullptr != entry->lod_ib) {
+        engine->destroy(entry->lod_ib);
+      }
+      delete entry;
+      return nullptr;
+    }
+
+    get_materials(data, entry->materials);
+
+    entry->data = data;
+    entry->data.vertices = nullptr;
+    entry->data.indices = nullptr;
+
+    entries[entry->hash] = entry;
+    num_bytes += entry->num_bytes;
+    num_misses++;
+
+    return entry;
+  }
+
+  /* One material instance per part; shared with the other entries that use the same name. */
+  void MeshCache::get_materials(const FilameshData& data, std::vector<const filament::MaterialInstance*>& result) {
+
+    std::unordered_map<std::string, filament::MaterialInstance*>::iterator it;
+
+    result.clear();
+
+    for (size_t i = 0; i < data.parts.size(); ++i) {
+
+      const FilameshPart& part = data.parts[i];
+      const filament::MaterialInstance* mat = nullptr;
+      std::string name;
+
+      if (part.material_id < data.materials.size()) {
+        name = data.materials[part.material_id];
+        mat = materials->getMaterialInstance(utils::CString(name.c_str(), name.size()));
+      }
+
+      if (nullptr == mat) {
+        it = material_instances.find(name);
+        if (it == material_instances.end()) {
+          it = material_instances.insert(std::make_pair(name, engine->getDefaultMaterial()->createInstance())).first;
+        }
+        mat = it->second;
+      }
+
+      result.push_back(mat);
+    }
+  }
+
+  /* Evicts the least recently used, unreferenced entries until we're within budget. */
+  void MeshCache::evict() {
+
+    std::unordered_map<uint64_t, MeshCacheEntry*>::iterator it;
+
+    while (num_bytes > budget) {
+
+      MeshCacheEntry* oldest = nullptr;
+
+      for (it = entries.begin(); it != entries.end(); ++it) {
+        MeshCacheEntry* entry = it->second;
+        if (0 != entry->refcount) {
+          continue;
+        }
+        if (nullptr == oldest
+            || entry->last_used < oldest->last_used)
+          {
+            oldest = entry;
+          }
+      }
+
+      if (nullptr == oldest) {
+        break;
+      }
+
+      destroy_entry(oldest);
+      num_evictions++;
+    }
+  }
+
+  void MeshCache::destroy_entry(MeshCacheEntry* entry) {
+
+    entries.erase(entry->hash);
+    num_bytes -= entry->num_bytes;
+
+    engine->destroy(entry->vb);
+    engine->destroy(entry->ib);
+
+    if (nullptr != entry->lod_ib) {
+      engine->destroy(entry->lod_ib);
+    }
+
+    delete entry;
+  }
+
+  /* -------------------------------------------- */
+
+  static int get_file_info(const std::string& filepath, MeshCacheFileInfo& info) {
+
+    struct stat st = {};
+
+    if (0 != stat(filepath.c_str(), &st)) {
+      return -1;
+    }
+
+    info.size = uint64_t(st.st_size);
+    info.mtime = int64_t(st.st_mtime);
+    info.hash = 0;
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
@@ -0,0 +1,522 @@
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+#include <filament/Engine.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <filament/RenderableManager.h>
+#include <filament/TransformManager.h>
+#include <filament/Material.h>
+#include <filament/Box.h>
+#include <utils/EntityManager.h>
+#include <utils/Path.h>
+#include <utils/CString.h>
+#include <poly/MeshLoader.h>
+#include <poly/MappedFile.h>
+#include <poly/AssetArchive.h>
+
+using namespace filament;
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  /*
+     Shared by the buffer descriptors of one mesh. We hold one
+     reference while creating the buffers and every descriptor
+     that we hand to Filament holds one.
+  */
+  struct MeshRelease {
+    std::atomic<uint32_t> refs;
+    MeshReleaseCallback callback;
+    void* user;
+  };
+
+  /* -------------------------------------------- */
+
+  static void mesh_release_ref(MeshRelease* rel);
+  static void mesh_buffer_callback(void* buffer, size_t size, void* user);
+  static bool is_attribute_in_range(const FilameshHeader& header, uint32_t offset, uint64_t nbytes);
+  static bool is_attribute_in_vertex(const FilameshHeader& header, uint32_t offset, uint32_t stride, uint32_t nbytes);
+
+  /* -------------------------------------------- */
+
+  int mesh_create_buffers(
+    filament::Engine* engine,
+    const FilameshData& data,
+    MeshReleaseCallback release,
+    void* user,
+    filament::VertexBuffer** vb,
+    filament::IndexBuffer** ib
+  )
+  {
+    const FilameshHeader& header = data.header;
+    bool is_interleaved = (0 != (header.flags & FILAMESH_FLAG_INTERLEAVED));
+    bool is_snorm_uv = (0 != (header.flags & FILAMESH_FLAG_TEXCOORD_SNORM16));
+    bool has_uv1 = (FILAMESH_NO_ATTRIBUTE != header.offset_uv1);
+    bool is_quantized = (0 != (header.flags & FILAMESH_FLAG_QUANTIZED));
+    uint32_t uv_size = 4; /* SHORT2 and HALF2 are both 4 bytes. */
+    uint32_t tangents_size = (true == is_quantized) ? 4 : 8;
+    uint64_t vertex_count = header.vertex_count;
+    uint8_t num_buffers = 0;
+    MeshRelease* rel = nullptr;
+    VertexBuffer::AttributeType uv_type = (true == is_snorm_uv) ? VertexBuffer::AttributeType::SHORT2 : VertexBuffer::AttributeType::HALF2;
+    VertexBuffer::AttributeType position_type = (true == is_quantized) ? VertexBuffer::AttributeType::SHORT4 : VertexBuffer::AttributeType::HALF4;
+    VertexBuffer::AttributeType tangents_type = (true == is_quantized) ? VertexBuffer::AttributeType::BYTE4 : VertexBuffer::AttributeType::SHORT4;
+    IndexBuffer::IndexType index_type = (FILAMESH_INDEX_TYPE_USHORT == header.index_type) ? IndexBuffer::IndexType::USHORT : IndexBuffer::IndexType::UINT;
+    uint32_t index_stride = (IndexBuffer::IndexType::USHORT == index_type) ? 2 : 4;
+
+    rel = new MeshRelease();
+    rel->refs = 1;
+    rel->callback = release;
+    rel->user = user;
+
+    if (nullptr == engine
+        || nullptr == vb
+        || nullptr == ib)
+      {
+        printf("Error: cannot create the mesh, engine, vb or ib is nullptr.\n");
+        mesh_release_ref(rel);
+        return -1;
+      }
+
+    *vb = nullptr;
+    *ib = nullptr;
+
+    if (0 != (header.flags & FILAMESH_FLAG_COMPRESSION)) {
+      printf("Error: cannot create the mesh, the data is compressed.\n");
+      mesh_release_ref(rel);
+      return -2;
+    }
+
+    if (0 == header.vertex_count
+        || 0 == header.index_count
+        || 0 == header.parts
+        || data.parts.size() != header.parts
+        || uint64_t(header.index_count) * index_stride > header.index_size)
+      {
+        printf("Error: cannot create the mesh, the header is invalid.\n");
+        mesh_release_ref(rel);
+        return -3;
+      }
+
+    /* Make sure all attributes are inside the vertex region. */
+    if (true == is_interleaved) {
+      if (vertex_count * header.stride_position > header.vertex_size) {
+        printf("Error: cannot create the mesh, the interleaved vertices don't fit the vertex data.\n");
+        mesh_release_ref(rel);
+        return -4;
+      }
+      /* One buffer with one stride, which Filament stores in 8 bits; every attribute must fit in it. */
+      if (header.stride_position > 255
+          || false == is_attribute_in_vertex(header, header.offset_position, header.stride_position, 8)
+          || false == is_attribute_in_vertex(header, header.offset_tangents, header.stride_tangents, tangents_size)
+          || false == is_attribute_in_vertex(header, header.offset_color, header.stride_color, 4)
+          || false == is_attribute_in_vertex(header, header.offset_uv0, header.stride_uv0, uv_size)
+          || (true == has_uv1 && false == is_attribute_in_vertex(header, header.offset_uv1, header.stride_uv1, 4)))
+        {
+          printf("Error: cannot create the mesh, an interleaved attribute is outside the stride.\n");
+          mesh_release_ref(rel);
+          return -4;
+        }
+    }
+    else {
+      if (false == is_attribute_in_range(header, header.offset_position, vertex_count * 8)
+          || false == is_attribute_in_range(header, header.offset_tangents, vertex_count * tangents_size)
+          || false == is_attribute_in_range(header, header.offset_color, vertex_count * 4)
+          || false == is_attribute_in_range(header, header.offset_uv0, vertex_count * uv_size)
+          || (true == has_uv1 && false == is_attribute_in_range(header, header.offset_uv1, vertex_count * 4)))
+        {
+          printf("Error: cannot create the mesh, an attribute is outside the vertex data.\n");
+          mesh_release_ref(rel);
+          return -5;
+        }
+    }
+
+    /* Create the vertex buffer; this follows the layout that `MeshReader` uses. */
+    {
+      VertexBuffer::Builder vbb;
+      vbb.vertexCount(header.vertex_count);
+
+      if (true == is_interleaved) {
+        num_buffers = 1;
+        vbb.bufferCount(num_buffers)
+          .attribute(VertexAttribute::POSITION, 0, position_type, header.offset_position, uint8_t(header.stride_position))
+          .attribute(VertexAttribute::TANGENTS, 0, tangents_type, header.offset_tangents, uint8_t(header.stride_tangents))
+          .attribute(VertexAttribute::COLOR, 0, VertexBuffer::AttributeType::UBYTE4, header.offset_color, uint8_t(header.stride_color))
+          .attribute(VertexAttribute::UV0, 0, uv_type, header.offset_uv0, uint8_t(header.stride_uv0));
+        if (true == has_uv1) {
+          vbb.attribute(VertexAttribute::UV1, 0, VertexBuffer::AttributeType::HALF2, header.offset_uv1, uint8_t(header.stride_uv1));
+        }
+      }
+      else {
+        num_buffers = (true == has_uv1) ? 5 : 4;
+        vbb.bufferCount(num_buffers)
+          .attribute(VertexAttribute::POSITION, 0, position_type)
+          .attribute(VertexAttribute::TANGENTS, 1, tangents_type)
+          .attribute(VertexAttribute::COLOR, 2, VertexBuffer::AttributeType::UBYTE4)
+          .attribute(VertexAttribute::UV0, 3, uv_type);
+        if (true == has_uv1) {
+          vbb.attribute(VertexAttribute::UV1, 4, VertexBuffer::AttributeType::HALF2);
+        }
+      }
+
+      vbb.normalized(VertexAttribute::TANGENTS)
+        .normalized(VertexAttribute::COLOR);
+
+      if (true == is_snorm_uv) {
+        vbb.normalized(VertexAttribute::UV0);
+      }
+
+      if (true == is_quantized) {
+        vbb.normalized(VertexAttribute::POSITION);
+      }
+
+      *vb = vbb.build(*engine);
+      if (nullptr == *vb) {
+        printf("Error: cannot create the mesh, failed to create the vertex buffer.\n");
+        mesh_release_ref(rel);
+        return -6;
+      }
+    }
+
+    *ib = IndexBuffer::Builder()
+      .indexCount(header.index_count)
+      .bufferType(index_type)
+      .build(*engine);
+
+    if (nullptr == *ib) {
+      printf("Error: cannot create the mesh, failed to create the index buffer.\n");
+      engine->destroy(*vb);
+      *vb = nullptr;
+      mesh_release_ref(rel);
+      return -7;
+    }
+
+    /* Hand the regions to Filament; every descriptor holds a reference. */
+    if (true == is_interleaved) {
+      rel->refs++;
+      (*vb)->setBufferAt(*engine, 0, VertexBuffer::BufferDescriptor(data.vertices, header.vertex_size, mesh_buffer_callback, rel));
+    }
+    else {
+      const uint32_t offsets[] = { header.offset_position, header.offset_tangents, header.offset_color, header.offset_uv0, header.offset_uv1 };
+      const uint32_t sizes[] = { 8, tangents_size, 4, uv_size, 4 };
+      for (uint8_t i = 0; i < num_buffers; ++i) {
+        rel->refs++;
+        (*vb)->setBufferAt(*engine, i, VertexBuffer::BufferDescriptor(data.vertices + offsets[i], size_t(vertex_count * sizes[i]), mesh_buffer_callback, rel));
+      }
+    }
+
+    rel->refs++;
+    (*ib)->setBuffer(*engine, IndexBuffer::BufferDescriptor(data.indices, size_t(header.index_count) * index_stride, mesh_buffer_callback, rel));
+
+    mesh_release_ref(rel);
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  int mesh_get_materials(
+    filament::Engine* engine,
+    const FilameshData& data,
+    filamesh::MeshReader::MaterialRegistry& registry,
+    std::vector<const filament::MaterialInstance*>& result
+  )
+  {
+    const MaterialInstance* default_material = nullptr;
+
+    result.clear();
+
+    if (nullptr == engine) {
+      printf("Error: cannot get the materials, engine is nullptr.\n");
+      return -1;
+    }
+
+    default_material = engine->getDefaultMaterial()->getDefaultInstance();
+
+    for (size_t i = 0; i < data.parts.size(); ++i) {
+
+      const FilameshPart& part = data.parts[i];
+      const MaterialInstance* mat = nullptr;
+
+      if (part.material_id < data.materials.size()) {
+        const std::string& name = data.materials[part.material_id];
+        mat = registry.getMaterialInstance(utils::CString(name.c_str(), name.size()));
+      }
+
+      if (nullptr == mat) {
+        mat = default_material;
+      }
+
+      result.push_back(mat);
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  int mesh_create_renderable(
+    filament::Engine* engine,
+    const FilameshData& data,
+    filament::VertexBuffer* vb,
+    filament::IndexBuffer* ib,
+    const std::vector<const filament::MaterialInstance*>& materials,
+    utils::Entity entity
+  )
+  {
+    const FilameshHeader& header = data.header;
+    filament::math::float3 center = { header.aabb.center[0], header.aabb.center[1], header.aabb.center[2] };
+    filament::math::float3 half_extent = { header.aabb.half_extent[0], header.aabb.half_extent[1], header.aabb.half_extent[2] };
+    Box aabb;
+
+    if (nullptr == engine
+        || nullptr == vb
+        || nullptr == ib)
+      {
+        printf("Error: cannot create the renderable, engine, vb or ib is nullptr.\n");
+        return -1;
+      }
+
+    if (true == entity.isNull()) {
+      printf("Error: cannot create the renderable, the entity is null.\n");
+      return -2;
+    }
+
+    if (materials.size() != data.parts.size()) {
+      printf("Error: cannot create the renderable, we need one material per part.\n");
+      return -3;
+    }
+
+    RenderableManager::Builder builder(data.parts.size());
+
+    /* The bounding box is in the space of the vertices; quantized positions are always inside [-1, 1]. */
+    if (0 != (header.flags & FILAMESH_FLAG_QUANTIZED)) {
+      center = filament::math::float3{ 0.0f, 0.0f, 0.0f };
+      half_extent = filament::math::float3{ 1.0f, 1.0f, 1.0f };
+    }
+
+    aabb.set(center - half_extent, center + half_extent);
+    builder.boundingBox(aabb);
+
+    for (size_t i = 0; i < data.parts.size(); ++i) {
+      const FilameshPart& part = data.parts[i];
+      builder.geometry(i, RenderableManager::PrimitiveType::TRIANGLES, vb, ib, part.offset, part.min_index, part.max_index, part.index_count);
+      builder.material(i, materials[i]);
+    }
+
+    if (RenderableManager::Builder::Result::Success != builder.build(*engine, entity)) {
+      printf("Error: failed to build the renderable.\n");
+      return -4;
+    }
+
+    /* Quantized positions are mapped back into the box of the mesh by the transform. */
+    if (0 != (header.flags & FILAMESH_FLAG_QUANTIZED)) {
+
+      TransformManager& tm = engine->getTransformManager();
+      filament::math::mat4f local = mesh_get_position_transform(header);
+
+      if (false == tm.hasComponent(entity)) {
+        tm.create(entity, TransformManager::Instance(), local);
+      }
+      else {
+        TransformManager::Instance ti = tm.getInstance(entity);
+        tm.setTransform(ti, tm.getTransform(ti) * local);
+      }
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  filament::math::mat4f mesh_get_position_transform(const FilameshHeader& header) {
+
+    const FilameshBox& box = header.aabb;
+
+    if (0 == (header.flags & FILAMESH_FLAG_QUANTIZED)) {
+      return filament::math::mat4f();
+    }
+
+    return filament::math::mat4f::translation(filament::math::float3{ box.center[0], box.center[1], box.center[2] })
+      * filament::math::mat4f::scaling(filament::math::float3{ box.half_extent[0], box.half_extent[1], box.half_extent[2] });
+  }
+
+  void mesh_unmap_file(void* user) {
+
+    MappedFile* file = (MappedFile*) user;
+
+    file->close();
+    delete file;
+  }
+
+  /* -------------------------------------------- */
+
+  int mesh_create(
+    filament::Engine* engine,
+    const FilameshData& data,
+    MeshReleaseCallback release,
+    void* user,
+    filamesh::MeshReader::MaterialRegistry& materials,
+    filamesh::MeshReader::Mesh& result
+  )
+  {
+    std::vector<const MaterialInstance*> instances;
+    bool is_new_entity = false;
+    int r = 0;
+
+    r = mesh_create_buffers(engine, data, release, user, &result.vertexBuffer, &result.indexBuffer);
+    if (0 != r) {
+      return r;
+    }
+
+    mesh_get_materials(engine, data, materials, instances);
+
+    if (true == result.renderable.isNull()) {
+      result.renderable = utils::EntityManager::get().create();
+      is_new_entity = true;
+    }
+
+    /* Parts without a registered material use the default one. */
+    r = mesh_create_renderable(engine, data, result.vertexBuffer, result.indexBuffer, instances, result.renderable);
+    if (0 != r) {
+      if (true == is_new_entity) {
+        utils::EntityManager::get().destroy(result.renderable);
+        result.renderable = utils::Entity();
+      }
+      engine->destroy(result.vertexBuffer);
+      engine->destroy(result.indexBuffer);
+      result.vertexBuffer = nullptr;
+      result.indexBuffer = nullptr;
+      return -10;
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  int mesh_load_mapped(
+    filament::Engine* engine,
+    const std::string& filepath,
+    filamesh::MeshReader::MaterialRegistry& materials,
+    filamesh::MeshReader::Mesh& result
+  )
+  {
+    MappedFile* file = nullptr;
+    FilameshData data;
+    int r = 0;
+
+    if (nullptr == engine) {
+      printf("Error: cannot load the mesh, engine is nullptr.\n");
+      return -1;
+    }
+
+    file = new MappedFile();
+
+    r = file->open(filepath);
+    if (0 != r) {
+      delete file;
+      return -2;
+    }
+
+    r = filamesh_parse(file->get_data(), file->get_size(), data);
+    if (0 != r) {
+      printf("Error: cannot load the mesh, `%s` is not a valid filamesh.\n", filepath.c_str());
+      mesh_unmap_file(file);
+      return -3;
+    }
+
+    /* Compressed meshes have to be decoded into the heap anyway. */
+    if (0 != (data.header.flags & FILAMESH_FLAG_COMPRESSION)) {
+      mesh_unmap_file(file);
+      result = filamesh::MeshReader::loadMeshFromFile(engine, utils::Path(filepath.c_str()), materials);
+      return (nullptr == result.vertexBuffer) ? -4 : 0;
+    }
+
+    /* From here on the mapping is owned by the buffer descriptors. */
+    r = mesh_create(engine, data, mesh_unmap_file, file, materials, result);
+    if (0 != r) {
+      printf("Error: cannot load the mesh from `%s`.\n", filepath.c_str());
+      return -5;
+    }
+
+    return 0;
+  }
+
+  int mesh_load_archive(
+    filament::Engine* engine,
+    AssetArchive& archive,
+    const std::string& name,
+    filamesh::MeshReader::MaterialRegistry& materials,
+    filamesh::MeshReader::Mesh& result
+  )
+  {
+    const uint8_t* ptr = nullptr;
+    size_t size = 0;
+    FilameshData data;
+    int r = 0;
+
+    if (nullptr == engine) {
+      printf("Error: cannot load the mesh, engine is nullptr.\n");
+      return -1;
+    }
+
+    r = archive.get(name, &ptr, &size);
+    if (0 != r) {
+      return -2;
+    }
+
+    r = filamesh_parse(ptr, size, data);
+    if (0 != r) {
+      printf("Error: cannot load the mesh, `%s` is not a valid filamesh.\n", name.c_str());
+      return -3;
+    }
+
+    if (0 != (data.header.flags & FILAMESH_FLAG_COMPRESSION)) {
+      result = filamesh::MeshReader::loadMeshFromBuffer(engine, ptr, nullptr, nullptr, materials);
+      return (nullptr == result.vertexBuffer) ? -4 : 0;
+    }
+
+    /* The archive owns the memory, so there is nothing to release. */
+    r = mesh_create(engine, data, nullptr, nullptr, materials, result);
+    if (0 != r) {
+      printf("Error: cannot load the mesh `%s` from the archive.\n", name.c_str());
+      return -5;
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  static void mesh_release_ref(MeshRelease* rel) {
+
+    if (1 != rel->refs.fetch_sub(1, std::memory_order_acq_rel)) {
+      return;
+    }
+
+    if (nullptr != rel->callback) {
+      rel->callback(rel->user);
+    }
+
+    delete rel;
+  }
+
+  /* Called by Filament, on the backend thread, once it uploaded the buffer. */
+  static void mesh_buffer_callback(void* buffer, size_t size, void* user) {
+    mesh_release_ref((MeshRelease*) user);
+  }
+
+  static bool is_attribute_in_range(const FilameshHeader& header, uint32_t offset, uint64_t nbytes) {
+    return uint64_t(offset) + nbytes <= header.vertex_size;
+  }
+
+  static bool is_attribute_in_vertex(const FilameshHeader& header, uint32_t offset, uint32_t stride, uint32_t nbytes) {
+    return stride == header.stride_position && uint64_t(offset) + nbytes <= stride;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <meshoptimizer.h>
+#include <filament/Engine.h>
+#include <filament/IndexBuffer.h>
+#include <poly/MeshLod.h>
+
+using namespace filament;
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static void mesh_lod_free(void* buffer, size_t size, void* user);
+
+  /* -------------------------------------------- */
+
+  int mesh_generate_lods(const FilameshData& data, uint32_t max_levels, MeshLods& result) {
+
+    const FilameshHeader& header = data.header;
+    std::vector<std::vector<uint32_t> > prev_indices;
+    std::vector<uint32_t> simplified;
+    std::vector<float> positions;
+    float error = MESH_LOD_BASE_ERROR;
+
+    result.indices.clear();
+    result.levels.clear();
+
+    if (nullptr == data.indices
+        || 0 == data.parts.size())
+      {
+        printf("Error: cannot generate lods, the mesh has no indices or parts.\n");
+        return -1;
+      }
+
+    if (0 != filamesh_decode_positions(data, positions)) {
+      return -2;
+    }
+
+    result.center[0] = header.aabb.center[0];
+    result.center[1] = header.aabb.center[1];
+    result.center[2] = header.aabb.center[2];
+    result.radius = sqrtf(header.aabb.half_extent[0] * header.aabb.half_extent[0]
+                          + header.aabb.half_extent[1] * header.aabb.half_extent[1]
+                          + header.aabb.half_extent[2] * header.aabb.half_extent[2]);
+
+    /* Level 0 is the mesh itself. */
+    result.levels.resize(1);
+    result.levels[0].parts = data.parts;
+    result.levels[0].num_triangles = 0;
+    prev_indices.resize(data.parts.size());
+
+    for (size_t i = 0; i < data.parts.size(); ++i) {
+
+      const FilameshPart& part = data.parts[i];
+
+      if (uint64_t(part.offset) + part.index_count > header.index_count) {
+        printf("Error: cannot generate lods, part %zu has an invalid index range.\n", i);
+        result.levels.clear();
+        return -3;
+      }
+
+      prev_indices[i].resize(part.index_count);
+
+      for (size_t j = 0; j < part.index_count; ++j) {
+        prev_indices[i][j] = (FILAMESH_INDEX_TYPE_USHORT == header.index_type)
+          ? uint32_t(((const uint16_t*) data.indices)[part.offset + j])
+          : ((const uint32_t*) data.indices)[part.offset + j];
+      }
+
+      result.levels[0].num_triangles += part.index_count / 3;
+    }
+
+    /* Every level is simplified from the previous one. */
+    for (uint32_t level = 1; level < max_levels && level < MESH_LOD_MAX_LEVELS; ++level) {
+
+      MeshLodLevel lod;
+      size_t start = result.indices.size();
+
+      lod.parts = data.parts;
+      lod.num_triangles = 0;
+
+      for (size_t i = 0; i < data.parts.size(); ++i) {
+
+        std::vector<uint32_t>& src = prev_indices[i];
+        size_t target = size_t(float(src.size() / 3) * MESH_LOD_TRIANGLE_RATIO) * 3;
+        size_t count = 0;
+
+        simplified.resize(src.size());
+
+        if (0 != src.size()) {
+          count = meshopt_simplify(simplified.data(), src.data(), src.size(), positions.data(), header.vertex_count, sizeof(float) * 3, target, error);
+        }
+
+        /* Keep the previous triangles instead of letting a part disappear. */
+        if (0 == count) {
+          simplified = src;
+          count = src.size();
+        }
+
+        lod.parts[i].offset = uint32_t(result.indices.size());
+        lod.parts[i].index_count = uint32_t(count);
+        lod.parts[i].min_index = 0;
+        lod.parts[i].max_index = header.vertex_count - 1;
+        lod.num_triangles += uint32_t(count / 3);
+
+        result.indices.insert(result.indices.end(), simplified.begin(), simplified.begin() + count);
+        src.assign(simplified.begin(), simplified.begin() + count);
+      }
+
+      if (float(lod.num_triangles) >= float(result.levels.back().num_triangles) * MESH_LOD_MIN_REDUCTION) {
+        result.indices.resize(start);
+        break;
+      }
+
+      result.levels.push_back(lod);
+      error *= 2.0f;
+    }
+
+    /* Level i is used down to half the screen size of level i - 1. */
+    for (size_t i = 0; i < result.levels.size(); ++i) {
+      result.levels[i].min_screen_size = (i + 1 == result.levels.size()) ? 0.0f : MESH_LOD_SCREEN_SIZE * powf(0.5f, float(i));
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  int mesh_create_lod_buffer(filament::Engine* engine, const MeshLods& lods, uint32_t vertex_count, filament::IndexBuffer** ib) {
+
+    bool is_short = (vertex_count <= 65536);
+    size_t num_bytes = lods.indices.size() * (is_short ? 2 : 4);
+    uint8_t* data = nullptr;
+
+    if (nullptr == engine
+        || nullptr == ib)
+      {
+        printf("Error: cannot create the lod index buffer, engine or ib is nullptr.\n");
+        return -1;
+      }
+
+    *ib = nullptr;
+
+    if (0 == lods.indices.size()) {
+      return 0;
+    }
+
+    data = (uint8_t*) malloc(num_bytes);
+    if (nullptr == data) {
+      printf("Error: cannot create the lod index buffer, failed to allocate %zu bytes.\n", num_bytes);
+      return -2;
+    }
+
+    if (true == is_short) {
+      uint16_t* dst = (uint16_t*) data;
+      for (size_t i = 0; i < lods.indices.size(); ++i) {
+        dst[i] = uint16_t(lods.indices[i]);
+      }
+    }
+    else {
+      memcpy(data, lods.indices.data(), num_bytes);
+    }
+
+    *ib = IndexBuffer::Builder()
+      .indexCount(uint32_t(lods.indices.size()))
+      .bufferType(is_short ? IndexBuffer::IndexType::USHORT : IndexBuffer::IndexType::UINT)
+      .build(*engine);
+
+    if (nullptr == *ib) {
+      printf("Error: failed to create the lod index buffer.\n");
+      free(data);
+      return -3;
+    }
+
+    (*ib)->setBuffer(*engine, IndexBuffer::BufferDescriptor(data, num_bytes, mesh_lod_free, nullptr));
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  /* Returns the diameter of the bounding sphere relative to the viewport height; `projection_scale` is `projection[1][1]`. */
+  float mesh_get_screen_size(const MeshLods& lods, const float position[3], float scale, const float camera_position[3], float projection_scale) {
+
+    float dx = position[0] + lods.center[0] * scale - camera_position[0];
+    float dy = position[1] + lods.center[1] * scale - camera_position[1];
+    float dz = position[2] + lods.center[2] * scale - camera_position[2];
+    float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+    float radius = lods.radius * scale;
+
+    /* The camera is inside the sphere. */
+    if (distance <= radius) {
+      return 1e6f;
+    }
+
+    return (radius * projection_scale) / distance;
+  }
+
+  uint32_t mesh_select_lod(const MeshLods& lods, float screen_size, uint32_t current_level) {
+
+    uint32_t num_levels = uint32_t(lods.levels.size());
+    uint32_t level = current_level;
+
+    if (0 == num_levels) {
+      return 0;
+    }
+
+    if (level >= num_levels) {
+      level = num_levels - 1;
+    }
+
+    while (level > 0
+           && screen_size > lods.levels[level - 1].min_screen_size * (1.0f + MESH_LOD_HYSTERESIS))
+      {
+        level--;
+      }
+
+    while (level + 1 < num_levels
+           && screen_size < lods.levels[level].min_screen_size * (1.0f - MESH_LOD_HYSTERESIS))
+      {
+        level++;
+      }
+
+    return level;
+  }
+
+  /* -------------------------------------------- */
+
+  static void mesh_lod_free(void* buffer, size_t size, void* user) {
+    free(buffer);
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
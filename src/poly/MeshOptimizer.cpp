@@ -0,0 +1,629 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <algorithm>
+#include <meshoptimizer.h>
+#include <poly/MeshOptimizer.h>
+#include <poly/MeshQuantizer.h>
+#include <poly/MappedFile.h>
+
+/* -------------------------------------------- */
+
+#define MESH_NUM_ATTRIBUTES 5
+#define MESH_POSITION_SIZE 8                 /* HALF4 */
+#define MESH_TANGENTS_SIZE 8                 /* SHORT4 */
+#define MESH_COLOR_SIZE 4                    /* UBYTE4 */
+#define MESH_UV_SIZE 4                       /* SHORT2 or HALF2 */
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  /* Where an attribute lives in the vertex data; interleaved data is one stream. */
+  struct MeshStream {
+    uint32_t offset;
+    uint32_t stride;                         /* Never 0; a stride of 0 in the header means tightly packed. */
+  };
+
+  /* -------------------------------------------- */
+
+  static int get_streams(const FilameshHeader& header, std::vector<MeshStream>& streams);
+  static int get_mtime(const std::string& filepath, int64_t& mtime);
+  static int optimize_source(const std::string& filepath, uint32_t flags, MeshOptimizeResult& result, std::vector<std::string>& materials);
+
+  /* -------------------------------------------- */
+
+  int mesh_optimize(const FilameshData& input, uint32_t flags, MeshOptimizeResult& result) {
+
+    const FilameshHeader& hdr = input.header;
+    std::vector<MeshStream> streams;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> scratch;
+    std::vector<uint32_t> remap;
+    std::vector<float> positions;
+    size_t vertex_size = 0;
+    size_t num_vertices = 0;
+    size_t offset = 0;
+    uint32_t* offsets[MESH_NUM_ATTRIBUTES] = {
+      &result.header.offset_position,
+      &result.header.offset_tangents,
+      &result.header.offset_color,
+      &result.header.offset_uv0,
+      &result.header.offset_uv1
+    };
+
+    memset(&result.quantize_stats, 0, sizeof(result.quantize_stats));
+
+    if (0 != (hdr.flags & FILAMESH_FLAG_COMPRESSION)) {
+      printf("Error: cannot optimize a mesh which is already compressed.\n");
+      return -1;
+    }
+
+    if (0 != (hdr.flags & FILAMESH_FLAG_QUANTIZED)) {
+      printf("Error: cannot optimize a mesh which is already quantized; optimize the source instead.\n");
+      return -10;
+    }
+
+    if (0 != (flags & MESH_OPTIMIZE_COMPRESS)
+        && 0 != (flags & MESH_OPTIMIZE_QUANTIZE))
+      {
+        printf("Error: cannot compress and quantize a mesh; Filament can't decode compressed quantized meshes.\n");
+        return -11;
+      }
+
+    if (nullptr == input.vertices
+        || nullptr == input.indices
+        || 0 == hdr.vertex_count
+        || 0 == hdr.index_count
+        || 0 != (hdr.index_count % 3))
+      {
+        printf("Error: cannot optimize the mesh, it has no vertices or its indices are not a triangle list.\n");
+        return -2;
+      }
+
+    if (0 != get_streams(hdr, streams)) {
+      return -3;
+    }
+
+    if (0 != (flags & MESH_OPTIMIZE_COMPRESS)
+        && 0 != (hdr.flags & FILAMESH_FLAG_INTERLEAVED))
+      {
+        printf("Error: cannot compress the mesh, interleaved vertex data can't be compressed.\n");
+        return -4;
+      }
+
+    for (size_t i = 0; i < streams.size(); ++i) {
+      vertex_size += streams[i].stride;
+    }
+
+    /* Indices as 32-bit, which is what meshoptimizer works with. */
+    indices.resize(hdr.index_count);
+
+    if (FILAMESH_INDEX_TYPE_USHORT == hdr.index_type) {
+      const uint16_t* src = (const uint16_t*) input.indices;
+      for (size_t i = 0; i < indices.size(); ++i) {
+        indices[i] = src[i];
+      }
+    }
+    else {
+      memcpy(indices.data(), input.indices, indices.size() * sizeof(uint32_t));
+    }
+
+    for (size_t i = 0; i < indices.size(); ++i) {
+      if (indices[i] >= hdr.vertex_count) {
+        printf("Error: cannot optimize the mesh, index %zu refers to vertex %u which doesn't exist.\n", i, indices[i]);
+        return -5;
+      }
+    }
+
+    /* The overdraw optimizer needs float positions. */
+    if (0 != filamesh_decode_positions(input, positions)) {
+      return -6;
+    }
+
+    result.vertex_count_before = hdr.vertex_count;
+    result.num_bytes_before = size_t(hdr.vertex_size) + size_t(hdr.index_size);
+    result.acmr_before = meshopt_analyzeVertexCache(indices.data(), indices.size(), hdr.vertex_count, MESH_OPTIMIZE_CACHE_SIZE, 0, 0).acmr;
+    result.overfetch_before = meshopt_analyzeVertexFetch(indices.data(), indices.size(), hdr.vertex_count, vertex_size).overfetch;
+
+    /* Triangle order, per part, as every part is a separate draw. */
+    for (size_t i = 0; i < input.parts.size(); ++i) {
+
+      const FilameshPart& part = input.parts[i];
+
+      if (size_t(part.offset) + size_t(part.index_count) > indices.size()
+          || 0 != (part.index_count % 3))
+        {
+          printf("Error: cannot optimize the mesh, part %zu has an invalid index range.\n", i);
+          return -7;
+        }
+
+      if (0 == part.index_count) {
+        continue;
+      }
+
+      uint32_t* part_indices = &indices[part.offset];
+
+      scratch.resize(part.index_count);
+      meshopt_optimizeVertexCache(scratch.data(), part_indices, part.index_count, hdr.vertex_count);
+      meshopt_optimizeOverdraw(part_indices, scratch.data(), part.index_count, positions.data(), hdr.vertex_count, sizeof(float) * 3, MESH_OPTIMIZE_OVERDRAW_THRESHOLD);
+    }
+
+    /* Vertex order, over all parts; unused vertices are dropped. */
+    remap.resize(hdr.vertex_count);
+    num_vertices = meshopt_optimizeVertexFetchRemap(remap.data(), indices.data(), indices.size(), hdr.vertex_count);
+    meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
+
+    result.header = hdr;
+    result.header.vertex_count = uint32_t(num_vertices);
+    result.header.vertex_size = uint32_t(num_vertices * vertex_size);
+    result.vertices.resize(result.header.vertex_size);
+
+    if (0 != (hdr.flags & FILAMESH_FLAG_INTERLEAVED)) {
+      meshopt_remapVertexBuffer(result.vertices.data(), input.vertices, hdr.vertex_count, vertex_size, remap.data());
+    }
+    else {
+
+      /* Every attribute is remapped on its own and stored right after the previous one. */
+      for (size_t i = 0, dx = 0; i < MESH_NUM_ATTRIBUTES; ++i) {
+
+        if (FILAMESH_NO_ATTRIBUTE == *offsets[i]) {
+          continue;
+        }
+
+        meshopt_remapVertexBuffer(result.vertices.data() + offset, input.vertices + streams[dx].offset, hdr.vertex_count, streams[dx].stride, remap.data());
+
+        *offsets[i] = uint32_t(offset);
+        offset += num_vertices * streams[dx].stride;
+        dx++;
+      }
+    }
+
+    /* The parts keep their index ranges, but their vertex range changed. */
+    result.parts = input.parts;
+
+    for (size_t i = 0; i < result.parts.size(); ++i) {
+
+      FilameshPart& part = result.parts[i];
+
+      if (0 == part.index_count) {
+        continue;
+      }
+
+      part.min_index = UINT32_MAX;
+      part.max_index = 0;
+
+      for (size_t j = part.offset; j < size_t(part.offset) + part.index_count; ++j) {
+        part.min_index = (indices[j] < part.min_index) ? indices[j] : part.min_index;
+        part.max_index = (indices[j] > part.max_index) ? indices[j] : part.max_index;
+      }
+    }
+
+    result.vertex_count_after = uint32_t(num_vertices);
+    result.acmr_after = meshopt_analyzeVertexCache(indices.data(), indices.size(), num_vertices, MESH_OPTIMIZE_CACHE_SIZE, 0, 0).acmr;
+    result.overfetch_after = meshopt_analyzeVertexFetch(indices.data(), indices.size(), num_vertices, vertex_size).overfetch;
+
+    /* Smaller vertices; the order of the vertices and so the indices don't change. */
+    if (0 != (flags & MESH_OPTIMIZE_QUANTIZE)) {
+
+      FilameshData reordered;
+      MeshQuantizeResult quantized;
+
+      reordered.header = result.header;
+      reordered.vertices = result.vertices.data();
+      reordered.indices = nullptr;
+
+      if (0 != mesh_quantize(reordered, quantized)) {
+        return -12;
+      }
+
+      result.header = quantized.header;
+      result.vertices.swap(quantized.vertices);
+      result.quantize_stats = quantized.stats;
+    }
+
+    /* Half the index bandwidth when we can. */
+    result.header.index_type = (num_vertices <= 65536) ? FILAMESH_INDEX_TYPE_USHORT : FILAMESH_INDEX_TYPE_UINT;
+
+    if (0 != (flags & MESH_OPTIMIZE_COMPRESS)) {
+
+      /*
+        The layout of `filamesh --compress`: the sizes of the
+        position, tangent, color, uv0 and uv1 streams (0 when not
+        used), followed by the encoded streams. The offsets in the
+        header describe the decoded data.
+      */
+      std::vector<uint8_t> encoded;
+      uint32_t* compression = nullptr;
+      size_t num_bytes = 0;
+
+      encoded.resize(sizeof(uint32_t) * MESH_NUM_ATTRIBUTES);
+
+      for (size_t i = 0, dx = 0; i < MESH_NUM_ATTRIBUTES; ++i) {
+
+        size_t start = encoded.size();
+        uint32_t attr_offset = 0;
+        uint32_t attr_stride = 0;
+
+        compression = (uint32_t*) encoded.data();
+        compression[i] = 0;
+
+        if (FILAMESH_NO_ATTRIBUTE == *offsets[i]) {
+          continue;
+        }
+
+        attr_offset = *offsets[i];
+        attr_stride = streams[dx++].stride;
+
+        encoded.resize(start + meshopt_encodeVertexBufferBound(num_vertices, attr_stride));
+        num_bytes = meshopt_encodeVertexBuffer(encoded.data() + start, encoded.size() - start, result.vertices.data() + attr_offset, num_vertices, attr_stride);
+
+        if (0 == num_bytes) {
+          printf("Error: failed to encode vertex attribute %zu.\n", i);
+          return -8;
+        }
+
+        encoded.resize(start + num_bytes);
+        compression = (uint32_t*) encoded.data();
+        compression[i] = uint32_t(num_bytes);
+      }
+
+      result.vertices.swap(encoded);
+      result.header.vertex_size = uint32_t(result.vertices.size());
+
+      result.indices.resize(meshopt_encodeIndexBufferBound(indices.size(), num_vertices));
+      num_bytes = meshopt_encodeIndexBuffer(result.indices.data(), result.indices.size(), indices.data(), indices.size());
+
+      if (0 == num_bytes) {
+        printf("Error: failed to encode the index buffer.\n");
+        return -9;
+      }
+
+      result.indices.resize(num_bytes);
+      result.header.index_size = uint32_t(num_bytes);
+      result.header.flags |= FILAMESH_FLAG_COMPRESSION;
+    }
+    else if (FILAMESH_INDEX_TYPE_USHORT == result.header.index_type) {
+
+      uint16_t* dst = nullptr;
+
+      result.indices.resize(indices.size() * sizeof(uint16_t));
+      dst = (uint16_t*) result.indices.data();
+
+      for (size_t i = 0; i < indices.size(); ++i) {
+        dst[i] = uint16_t(indices[i]);
+      }
+
+      result.header.index_size = uint32_t(result.indices.size());
+    }
+    else {
+      result.indices.resize(indices.size() * sizeof(uint32_t));
+      memcpy(result.indices.data(), indices.data(), result.indices.size());
+      result.header.index_size = uint32_t(result.indices.size());
+    }
+
+    result.num_bytes_after = result.vertices.size() + result.indices.size();
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  int mesh_optimize_file(const std::string& filepath, const std::string& output, uint32_t flags, MeshOptimizeResult* result) {
+
+    static std::atomic<uint32_t> tmp_counter(0);
+
+    MeshOptimizeResult optimized;
+    std::vector<std::string> materials;
+    std::string tmp_filepath;
+
+    if (0 != optimize_source(filepath, flags, optimized, materials)) {
+      return -1;
+    }
+
+    /* Another thread or process may be reading `output`; it only ever sees a complete file. */
+    tmp_filepath = output + ".tmp" + std::to_string(tmp_counter.fetch_add(1));
+
+    if (0 != filamesh_write(tmp_filepath, optimized.header, optimized.vertices.data(), optimized.indices.data(), optimized.parts, materials)) {
+      remove(tmp_filepath.c_str());
+      return -2;
+    }
+
+#if defined(_WIN32)
+    remove(output.c_str());
+#endif
+
+    if (0 != rename(tmp_filepath.c_str(), output.c_str())) {
+      printf("Error: failed to rename `%s` to `%s`.\n", tmp_filepath.c_str(), output.c_str());
+      remove(tmp_filepath.c_str());
+      return -3;
+    }
+
+    if (nullptr != result) {
+      *result = optimized;
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  int mesh_get_optimized(const std::string& filepath, uint32_t flags, std::string& result, MeshOptimizeResult* stats) {
+
+    std::string output = mesh_get_optimized_filepath(filepath, flags);
+    std::vector<std::string> materials;
+    int64_t source_mtime = 0;
+    int64_t output_mtime = 0;
+
+    result = filepath;
+
+    if (0 != get_mtime(filepath, source_mtime)) {
+      printf("Error: cannot optimize `%s`, failed to stat the file.\n", filepath.c_str());
+      return -1;
+    }
+
+    if (0 == get_mtime(output, output_mtime)
+        && output_mtime >= source_mtime)
+      {
+        /* The cached file doesn't store the statistics; we optimize the source again, in memory. */
+        if (nullptr != stats
+            && 0 != optimize_source(filepath, flags, *stats, materials))
+          {
+            return -2;
+          }
+        result = output;
+        return 0;
+      }
+
+    if (0 != mesh_optimize_file(filepath, output, flags, stats)) {
+      return -3;
+    }
+
+    result = output;
+
+    return 0;
+  }
+
+  std::string mesh_get_optimized_filepath(const std::string& filepath, uint32_t flags) {
+
+    const char* suffix = MESH_OPTIMIZE_SUFFIX;
+    const std::string ext = ".filamesh";
+    std::string stem = filepath;
+
+    if (0 != (flags & MESH_OPTIMIZE_COMPRESS)) {
+      suffix = MESH_OPTIMIZE_COMPRESSED_SUFFIX;
+    }
+    else if (0 != (flags & MESH_OPTIMIZE_QUANTIZE)) {
+      suffix = MESH_OPTIMIZE_QUANTIZED_SUFFIX;
+    }
+
+    if (stem.size() > ext.size()
+        && 0 == stem.compare(stem.size() - ext.size(), ext.size(), ext))
+      {
+        stem.resize(stem.size() - ext.size());
+      }
+
+    return stem + suffix;
+  }
+
+  int mesh_decompress(const FilameshData& input, FilameshHeader& header, std::vector<uint8_t>& vertices, std::vector<uint8_t>& indices) {
+
+    const FilameshHeader hdr = input.header;
+    uint32_t compression[MESH_NUM_ATTRIBUTES] = {};
+    uint32_t index_stride = (FILAMESH_INDEX_TYPE_USHORT == hdr.index_type) ? 2 : 4;
+    uint64_t src_offset = sizeof(uint32_t) * MESH_NUM_ATTRIBUTES;
+    uint64_t vertex_size = 0;
+
+    const uint32_t offsets[MESH_NUM_ATTRIBUTES] = {
+      hdr.offset_position,
+      hdr.offset_tangents,
+      hdr.offset_color,
+      hdr.offset_uv0,
+      hdr.offset_uv1
+    };
+
+    const uint32_t strides[MESH_NUM_ATTRIBUTES] = {
+      (0 == hdr.stride_position) ? MESH_POSITION_SIZE : hdr.stride_position,
+      (0 == hdr.stride_tangents) ? MESH_TANGENTS_SIZE : hdr.stride_tangents,
+      (0 == hdr.stride_color) ? MESH_COLOR_SIZE : hdr.stride_color,
+      (0 == hdr.stride_uv0) ? MESH_UV_SIZE : hdr.stride_uv0,
+      (0 == hdr.stride_uv1) ? MESH_UV_SIZE : hdr.stride_uv1
+    };
+
+    if (0 == (hdr.flags & FILAMESH_FLAG_COMPRESSION)) {
+      printf("Error: cannot decompress the mesh, it isn't compressed.\n");
+      return -1;
+    }
+
+    if (nullptr == input.vertices
+        || nullptr == input.indices
+        || hdr.vertex_size < src_offset)
+      {
+        printf("Error: cannot decompress the mesh, it has no vertex or index data.\n");
+        return -2;
+      }
+
+    /* The sizes of the encoded streams; the vertex data doesn't have to be aligned. */
+    memcpy(compression, input.vertices, sizeof(compression));
+
+    /* The offsets in the header describe the decoded data. */
+    for (size_t i = 0; i < MESH_NUM_ATTRIBUTES; ++i) {
+      if (FILAMESH_NO_ATTRIBUTE != offsets[i]) {
+        vertex_size = std::max(vertex_size, uint64_t(offsets[i]) + uint64_t(strides[i]) * hdr.vertex_count);
+      }
+    }
+
+    if (vertex_size > UINT32_MAX) {
+      printf("Error: cannot decompress the mesh, the vertex data is too large.\n");
+      return -3;
+    }
+
+    vertices.resize(size_t(vertex_size));
+    indices.resize(size_t(hdr.index_count) * index_stride);
+
+    for (size_t i = 0; i < MESH_NUM_ATTRIBUTES; ++i) {
+
+      if (FILAMESH_NO_ATTRIBUTE == offsets[i]) {
+        continue;
+      }
+
+      if (src_offset + compression[i] > hdr.vertex_size
+          || 0 != meshopt_decodeVertexBuffer(vertices.data() + offsets[i], hdr.vertex_count, strides[i], input.vertices + src_offset, compression[i]))
+        {
+          printf("Error: cannot decompress the mesh, failed to decode vertex attribute %zu.\n", i);
+          return -4;
+        }
+
+      src_offset += compression[i];
+    }
+
+    if (0 != meshopt_decodeIndexBuffer(indices.data(), hdr.index_count, index_stride, input.indices, hdr.index_size)) {
+      printf("Error: cannot decompress the mesh, failed to decode the indices.\n");
+      return -5;
+    }
+
+    header = hdr;
+    header.flags &= ~uint32_t(FILAMESH_FLAG_COMPRESSION);
+    header.vertex_size = uint32_t(vertices.size());
+    header.index_size = uint32_t(indices.size());
+
+    return 0;
+  }
+
+  void mesh_optimize_print(const MeshOptimizeResult& result) {
+
+    printf("Mesh optimization: ACMR %.3f -> %.3f, overfetch %.3f -> %.3f, vertices %u -> %u, %.2f KB -> %.2f KB\n",
+           result.acmr_before,
+           result.acmr_after,
+           result.overfetch_before,
+           result.overfetch_after,
+           result.vertex_count_before,
+           result.vertex_count_after,
+           double(result.num_bytes_before) / 1024.0,
+           double(result.num_bytes_after) / 1024.0);
+
+    if (0 != (result.header.flags & FILAMESH_FLAG_QUANTIZED)) {
+      mesh_quantize_print(result.quantize_stats);
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  /* Returns the attribute streams in the order position, tangents, color, uv0, uv1. */
+  static int get_streams(const FilameshHeader& header, std::vector<MeshStream>& streams) {
+
+    const uint32_t offsets[MESH_NUM_ATTRIBUTES] = {
+      header.offset_position,
+      header.offset_tangents,
+      header.offset_color,
+      header.offset_uv0,
+      header.offset_uv1
+    };
+
+    const uint32_t strides[MESH_NUM_ATTRIBUTES] = {
+      header.stride_position,
+      header.stride_tangents,
+      header.stride_color,
+      header.stride_uv0,
+      header.stride_uv1
+    };
+
+    const uint32_t sizes[MESH_NUM_ATTRIBUTES] = {
+      MESH_POSITION_SIZE,
+      MESH_TANGENTS_SIZE,
+      MESH_COLOR_SIZE,
+      MESH_UV_SIZE,
+      MESH_UV_SIZE
+    };
+
+    streams.clear();
+
+    if (FILAMESH_NO_ATTRIBUTE == header.offset_position) {
+      printf("Error: cannot optimize the mesh, it has no positions.\n");
+      return -1;
+    }
+
+    if (0 != (header.flags & FILAMESH_FLAG_INTERLEAVED)) {
+
+      MeshStream stream = { 0, header.stride_position };
+
+      if (uint64_t(stream.stride) * header.vertex_count > header.vertex_size
+          || uint64_t(header.offset_position) + MESH_POSITION_SIZE > stream.stride)
+        {
+          printf("Error: cannot optimize the mesh, the interleaved vertex data is too small.\n");
+          return -2;
+        }
+
+      streams.push_back(stream);
+      return 0;
+    }
+
+    for (size_t i = 0; i < MESH_NUM_ATTRIBUTES; ++i) {
+
+      MeshStream stream = { offsets[i], (0 == strides[i]) ? sizes[i] : strides[i] };
+
+      if (FILAMESH_NO_ATTRIBUTE == stream.offset) {
+        continue;
+      }
+
+      if (stream.stride < sizes[i]
+          || uint64_t(stream.offset) + uint64_t(stream.stride) * header.vertex_count > header.vertex_size)
+        {
+          printf("Error: cannot optimize the mesh, attribute %zu is outside the vertex data.\n", i);
+          return -3;
+        }
+
+      streams.push_back(stream);
+    }
+
+    return 0;
+  }
+
+  static int get_mtime(const std::string& filepath, int64_t& mtime) {
+
+    struct stat st = {};
+
+    if (0 != stat(filepath.c_str(), &st)) {
+      return -1;
+    }
+
+    mtime = int64_t(st.st_mtime);
+
+    return 0;
+  }
+
+  /* Optimizes a file in memory; `materials` gets the material names, which `mesh_optimize()` doesn't touch. */
+  static int optimize_source(const std::string& filepath, uint32_t flags, MeshOptimizeResult& result, std::vector<std::string>& materials) {
+
+    FilameshData data;
+    MappedFile file;
+    int r = 0;
+
+    if (0 != file.open(filepath)) {
+      return -1;
+    }
+
+    if (0 != filamesh_parse(file.get_data(), file.get_size(), data)) {
+      printf("Error: cannot optimize `%s`, it's not a valid filamesh.\n", filepath.c_str());
+      file.close();
+      return -2;
+    }
+
+    r = mesh_optimize(data, flags, result);
+    materials = data.materials;
+    file.close();
+
+    if (0 != r) {
+      printf("Error: failed to optimize `%s`.\n", filepath.c_str());
+      return -3;
+    }
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
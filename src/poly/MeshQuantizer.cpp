@@ -0,0 +1,489 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <poly/MeshQuantizer.h>
+
+/* -------------------------------------------- */
+
+#define MESH_NUM_ATTRIBUTES 5
+#define MESH_MIN_TANGENT_W (1.0f / 127.0f)   /* Smallest |w| we store, so the sign of `w` (the handedness) survives. */
+#define MESH_RAD_TO_DEG 57.29577951f
+#define MESH_MAX_ANISOTROPY 2.0f             /* Above this ratio between the largest and smallest half extent we use one scale for all axes. */
+#define MESH_MAX_TANGENT_SKEW 0.25f          /* Above this angle (degrees) that the scaled space bends a tangent we use one scale for all axes. */
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static float clamp_snorm(float v);
+  static void quat_to_frame(const float q[4], float normal[3], float tangent[3]);
+  static void frame_to_quat(const float normal[3], const float tangent[3], float q[4]);
+  static void normalize(float v[3]);
+  static float get_angle(const float a[3], const float b[3]);
+  static void scale_frame(const float normal[3], const float tangent[3], const float scale[3], float dst_normal[3], float dst_tangent[3]);
+
+  /* -------------------------------------------- */
+
+  int mesh_quantize(const FilameshData& input, MeshQuantizeResult& result) {
+
+    const FilameshHeader& hdr = input.header;
+    MeshQuantizeStats& stats = result.stats;
+    std::vector<float> positions;
+    std::vector<float> src_frames;                       /* Normal and tangent per vertex. */
+    std::vector<uint8_t> src_reflected;
+    double sum_position_error = 0.0;
+    double sum_normal_error = 0.0;
+    float bmin[3] = { 0.0f, 0.0f, 0.0f };
+    float bmax[3] = { 0.0f, 0.0f, 0.0f };
+    float center[3] = { 0.0f, 0.0f, 0.0f };
+    float half_extent[3] = { 1.0f, 1.0f, 1.0f };
+    size_t num_vertices = hdr.vertex_count;
+    size_t offset = 0;
+
+    const uint32_t src_offsets[MESH_NUM_ATTRIBUTES] = {
+      hdr.offset_position,
+      hdr.offset_tangents,
+      hdr.offset_color,
+      hdr.offset_uv0,
+      hdr.offset_uv1
+    };
+
+    const uint32_t src_strides[MESH_NUM_ATTRIBUTES] = {
+      hdr.stride_position,
+      hdr.stride_tangents,
+      hdr.stride_color,
+      hdr.stride_uv0,
+      hdr.stride_uv1
+    };
+
+    const uint32_t src_sizes[MESH_NUM_ATTRIBUTES] = { 8, 8, 4, 4, 4 };  /* HALF4, SHORT4, UBYTE4, HALF2/SHORT2, HALF2 */
+    const uint32_t dst_sizes[MESH_NUM_ATTRIBUTES] = { 8, 4, 4, 4, 4 };  /* SHORT4, BYTE4, UBYTE4, HALF2/SHORT2, HALF2 */
+
+    uint32_t* dst_offsets[MESH_NUM_ATTRIBUTES] = {
+      &result.header.offset_position,
+      &result.header.offset_tangents,
+      &result.header.offset_color,
+      &result.header.offset_uv0,
+      &result.header.offset_uv1
+    };
+
+    uint32_t* dst_strides[MESH_NUM_ATTRIBUTES] = {
+      &result.header.stride_position,
+      &result.header.stride_tangents,
+      &result.header.stride_color,
+      &result.header.stride_uv0,
+      &result.header.stride_uv1
+    };
+
+    memset(&stats, 0, sizeof(stats));
+    result.vertices.clear();
+
+    if (0 != (hdr.flags & FILAMESH_FLAG_COMPRESSION)) {
+      printf("Error: cannot quantize a mesh which is compressed.\n");
+      return -1;
+    }
+
+    if (0 != (hdr.flags & FILAMESH_FLAG_QUANTIZED)) {
+      printf("Error: cannot quantize a mesh which is already quantized.\n");
+      return -2;
+    }
+
+    if (nullptr == input.vertices
+        || 0 == num_vertices)
+      {
+        printf("Error: cannot quantize the mesh, it has no vertices.\n");
+        return -3;
+      }
+
+    for (size_t i = 0; i < MESH_NUM_ATTRIBUTES; ++i) {
+
+      uint64_t stride = (0 == src_strides[i]) ? src_sizes[i] : src_strides[i];
+
+      if (FILAMESH_NO_ATTRIBUTE == src_offsets[i]) {
+        continue;
+      }
+
+      if (stride < src_sizes[i]
+          || uint64_t(src_offsets[i]) + stride * (num_vertices - 1) + src_sizes[i] > hdr.vertex_size)
+        {
+          printf("Error: cannot quantize the mesh, attribute %zu is outside the vertex data.\n", i);
+          return -4;
+        }
+    }
+
+    if (0 != filamesh_decode_positions(input, positions)) {
+      return -5;
+    }
+
+    if (FILAMESH_NO_ATTRIBUTE != src_offsets[1]) {
+
+      uint32_t stride = (0 == src_strides[1]) ? src_sizes[1] : src_strides[1];
+
+      src_frames.resize(num_vertices * 6);
+      src_reflected.resize(num_vertices);
+
+      for (size_t i = 0; i < num_vertices; ++i) {
+
+        int16_t src[4];
+        float q[4];
+
+        memcpy(src, input.vertices + src_offsets[1] + i * stride, sizeof(src));
+
+        for (size_t j = 0; j < 4; ++j) {
+          q[j] = fmaxf(float(src[j]) / 32767.0f, -1.0f);
+        }
+
+        quat_to_frame(q, &src_frames[i * 6 + 0], &src_frames[i * 6 + 3]);
+        src_reflected[i] = (q[3] < 0.0f) ? 1 : 0;
+      }
+    }
+
+    /* The box of the vertices themselves; the box in the header may be larger, which would waste precision. */
+    for (size_t j = 0; j < 3; ++j) {
+      bmin[j] = positions[j];
+      bmax[j] = positions[j];
+    }
+
+    for (size_t i = 1; i < num_vertices; ++i) {
+      for (size_t j = 0; j < 3; ++j) {
+        bmin[j] = fminf(bmin[j], positions[i * 3 + j]);
+        bmax[j] = fmaxf(bmax[j], positions[i * 3 + j]);
+      }
+    }
+
+    for (size_t j = 0; j < 3; ++j) {
+      center[j] = 0.5f * (bmin[j] + bmax[j]);
+      half_extent[j] = 0.5f * (bmax[j] - bmin[j]);
+      if (half_extent[j] <= 0.0f) {
+        half_extent[j] = 1.0f; /* A flat mesh; all values on this axis become 0. */
+      }
+    }
+
+    /*
+      The tangent frames are stored in the scaled space (see
+      below), which bends the normals towards the long axes; with
+      8 bits per component the error grows with the ratio of the
+      axes. The scaled normal and tangent are also only
+      orthogonal when the tangent lies along an axis or in the
+      plane of two axes with the same scale; otherwise the
+      tangent that the GPU ends up with leans towards the normal.
+      For thin or long meshes, or when a tangent would lean more
+      than `MESH_MAX_TANGENT_SKEW`, we give up some precision on
+      the short axes and scale all axes the same, which doesn't
+      change the frames at all.
+    */
+    {
+      float min_extent = fminf(fminf(half_extent[0], half_extent[1]), half_extent[2]);
+      float max_extent = fmaxf(fmaxf(half_extent[0], half_extent[1]), half_extent[2]);
+      bool is_uniform = (max_extent > MESH_MAX_ANISOTROPY * min_extent);
+
+      for (size_t i = 0; i < src_reflected.size() && false == is_uniform; ++i) {
+
+        float normal[3], tangent[3];
+
+        scale_frame(&src_frames[i * 6 + 0], &src_frames[i * 6 + 3], half_extent, normal, tangent);
+
+        /* Map the tangent back like the GPU does: with the inverse of the scale. */
+        for (size_t j = 0; j < 3; ++j) {
+          tangent[j] /= half_extent[j];
+        }
+
+        if (get_angle(&src_frames[i * 6 + 3], tangent) > MESH_MAX_TANGENT_SKEW) {
+          is_uniform = true;
+        }
+      }
+
+      if (true == is_uniform) {
+        half_extent[0] = max_extent;
+        half_extent[1] = max_extent;
+        half_extent[2] = max_extent;
+      }
+    }
+
+    /* The header box is the dequantization transform. */
+    result.header = hdr;
+    result.header.flags = (hdr.flags & FILAMESH_FLAG_TEXCOORD_SNORM16) | FILAMESH_FLAG_QUANTIZED;
+
+    for (size_t j = 0; j < 3; ++j) {
+      result.header.aabb.center[j] = center[j];
+      result.header.aabb.half_extent[j] = half_extent[j];
+    }
+
+    /* One tightly packed stream per attribute. */
+    for (size_t i = 0; i < MESH_NUM_ATTRIBUTES; ++i) {
+
+      if (FILAMESH_NO_ATTRIBUTE == src_offsets[i]) {
+        *dst_offsets[i] = FILAMESH_NO_ATTRIBUTE;
+        *dst_strides[i] = FILAMESH_NO_ATTRIBUTE;
+        continue;
+      }
+
+      *dst_offsets[i] = uint32_t(offset);
+      *dst_strides[i] = 0;
+      offset += dst_sizes[i] * num_vertices;
+    }
+
+    if (offset > UINT32_MAX) {
+      printf("Error: cannot quantize the mesh, the vertex data is too large.\n");
+      return -6;
+    }
+
+    result.header.vertex_size = uint32_t(offset);
+    result.vertices.resize(offset);
+
+    /* Positions: SHORT4 normalized in the box, w = 1. */
+    {
+      int16_t* dst = (int16_t*) (result.vertices.data() + result.header.offset_position);
+
+      for (size_t i = 0; i < num_vertices; ++i) {
+
+        float error = 0.0f;
+
+        for (size_t j = 0; j < 3; ++j) {
+          float src = positions[i * 3 + j];
+          int16_t q = int16_t(lrintf(clamp_snorm((src - center[j]) / half_extent[j]) * 32767.0f));
+          float decoded = center[j] + fmaxf(float(q) / 32767.0f, -1.0f) * half_extent[j];
+          dst[i * 4 + j] = q;
+          error += (decoded - src) * (decoded - src);
+        }
+
+        dst[i * 4 + 3] = 32767;
+
+        error = sqrtf(error);
+        stats.max_position_error = fmaxf(stats.max_position_error, error);
+        sum_position_error += double(error) * double(error);
+      }
+    }
+
+    /*
+      Tangent frames: the SHORT4 quaternion becomes a BYTE4
+      quaternion. The positions are scaled by `half_extent` (S)
+      on the GPU and Filament transforms both the normal and the
+      tangent with the normal matrix, the inverse transpose
+      (S^-1). So we store the frame of the quantized space,
+      n' = S n and t' = S t, which the GPU maps back to n and t.
+      The quaternion needs an orthonormal frame, so we remove
+      the part of t' along n' (see `scale_frame()`).
+    */
+    if (FILAMESH_NO_ATTRIBUTE != src_offsets[1]) {
+
+      int8_t* dst = (int8_t*) (result.vertices.data() + result.header.offset_tangents);
+
+      for (size_t i = 0; i < num_vertices; ++i) {
+
+        float q[4];
+        float decoded[4];
+        const float* src_normal = &src_frames[i * 6 + 0];
+        const float* src_tangent = &src_frames[i * 6 + 3];
+        float normal[3], tangent[3];
+        float dst_normal[3], dst_tangent[3];
+        float error = 0.0f;
+        bool is_reflected = (1 == src_reflected[i]);
+
+        scale_frame(src_normal, src_tangent, half_extent, normal, tangent);
+        frame_to_quat(normal, tangent, q);
+
+        /* The sign of `w` is the handedness of the frame; S has a positive determinant and keeps it. */
+        if ((q[3] < 0.0f) != is_reflected) {
+          for (size_t j = 0; j < 4; ++j) {
+            q[j] = -q[j];
+          }
+        }
+
+        /* Keep |w| large enough so it doesn't round to 0 and lose its sign. */
+        if (fabsf(q[3]) < MESH_MIN_TANGENT_W) {
+
+          float sign = (q[3] < 0.0f) ? -1.0f : 1.0f;
+          float len = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+          float s = (len > 0.0f) ? sqrtf(1.0f - MESH_MIN_TANGENT_W * MESH_MIN_TANGENT_W) / len : 0.0f;
+
+          q[0] *= s;
+          q[1] *= s;
+          q[2] *= s;
+          q[3] = sign * MESH_MIN_TANGENT_W;
+        }
+
+        for (size_t j = 0; j < 4; ++j) {
+          dst[i * 4 + j] = int8_t(lrintf(clamp_snorm(q[j]) * 127.0f));
+          decoded[j] = fmaxf(float(dst[i * 4 + j]) / 127.0f, -1.0f);
+        }
+
+        /* Compare what the GPU ends up with: the decoded frame mapped back by the normal matrix. */
+        quat_to_frame(decoded, dst_normal, dst_tangent);
+
+        for (size_t j = 0; j < 3; ++j) {
+          dst_normal[j] /= half_extent[j];
+          dst_tangent[j] /= half_extent[j];
+        }
+
+        error = get_angle(src_normal, dst_normal);
+        stats.max_normal_error = fmaxf(stats.max_normal_error, error);
+        stats.max_tangent_error = fmaxf(stats.max_tangent_error, get_angle(src_tangent, dst_tangent));
+        sum_normal_error += error;
+      }
+    }
+
+    /* Colors and UVs are copied. */
+    for (size_t i = 2; i < MESH_NUM_ATTRIBUTES; ++i) {
+
+      uint32_t stride = (0 == src_strides[i]) ? src_sizes[i] : src_strides[i];
+      uint8_t* dst = nullptr;
+      const uint8_t* src = nullptr;
+
+      if (FILAMESH_NO_ATTRIBUTE == src_offsets[i]) {
+        continue;
+      }
+
+      dst = result.vertices.data() + *dst_offsets[i];
+      src = input.vertices + src_offsets[i];
+
+      for (size_t j = 0; j < num_vertices; ++j) {
+        memcpy(dst + j * dst_sizes[i], src + j * stride, dst_sizes[i]);
+      }
+    }
+
+    stats.rms_position_error = float(sqrt(sum_position_error / double(num_vertices)));
+    stats.mean_normal_error = float(sum_normal_error / double(num_vertices));
+    stats.num_bytes_before = hdr.vertex_size;
+    stats.num_bytes_after = result.vertices.size();
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  void mesh_quantize_print(const MeshQuantizeStats& stats) {
+
+    printf("Mesh quantization: position error max %.6f rms %.6f, normal error max %.2f mean %.2f deg, tangent error max %.2f deg, %.2f KB -> %.2f KB\n",
+           stats.max_position_error,
+           stats.rms_position_error,
+           stats.max_normal_error,
+           stats.mean_normal_error,
+           stats.max_tangent_error,
+           double(stats.num_bytes_before) / 1024.0,
+           double(stats.num_bytes_after) / 1024.0);
+  }
+
+  /* -------------------------------------------- */
+
+  static float clamp_snorm(float v) {
+    return fminf(fmaxf(v, -1.0f), 1.0f);
+  }
+
+  /* Same as `toTangentFrame()` in Filament's shaders; `q` doesn't have to be normalized. */
+  static void quat_to_frame(const float q[4], float normal[3], float tangent[3]) {
+
+    float x = q[0];
+    float y = q[1];
+    float z = q[2];
+    float w = q[3];
+
+    normal[0] = 2.0f * (x * z + y * w);
+    normal[1] = 2.0f * (y * z - x * w);
+    normal[2] = 1.0f - 2.0f * (x * x + y * y);
+
+    tangent[0] = 1.0f - 2.0f * (y * y + z * z);
+    tangent[1] = 2.0f * (x * y + z * w);
+    tangent[2] = 2.0f * (x * z - y * w);
+  }
+
+  /* The inverse of `quat_to_frame()`; `normal` and `tangent` must be orthonormal. The bitangent is `normal x tangent`. */
+  static void frame_to_quat(const float normal[3], const float tangent[3], float q[4]) {
+
+    /* The columns of the rotation are the tangent, bitangent and normal. */
+    float m00 = tangent[0], m01 = normal[1] * tangent[2] - normal[2] * tangent[1], m02 = normal[0];
+    float m10 = tangent[1], m11 = normal[2] * tangent[0] - normal[0] * tangent[2], m12 = normal[1];
+    float m20 = tangent[2], m21 = normal[0] * tangent[1] - normal[1] * tangent[0], m22 = normal[2];
+    float trace = m00 + m11 + m22;
+    float s = 0.0f;
+
+    if (trace > 0.0f) {
+      s = 2.0f * sqrtf(trace + 1.0f);
+      q[0] = (m21 - m12) / s;
+      q[1] = (m02 - m20) / s;
+      q[2] = (m10 - m01) / s;
+      q[3] = 0.25f * s;
+    }
+    else if (m00 > m11
+             && m00 > m22)
+      {
+        s = 2.0f * sqrtf(1.0f + m00 - m11 - m22);
+        q[0] = 0.25f * s;
+        q[1] = (m01 + m10) / s;
+        q[2] = (m02 + m20) / s;
+        q[3] = (m21 - m12) / s;
+      }
+    else if (m11 > m22) {
+      s = 2.0f * sqrtf(1.0f + m11 - m00 - m22);
+      q[0] = (m01 + m10) / s;
+      q[1] = 0.25f * s;
+      q[2] = (m12 + m21) / s;
+      q[3] = (m02 - m20) / s;
+    }
+    else {
+      s = 2.0f * sqrtf(1.0f + m22 - m00 - m11);
+      q[0] = (m02 + m20) / s;
+      q[1] = (m12 + m21) / s;
+      q[2] = 0.25f * s;
+      q[3] = (m10 - m01) / s;
+    }
+  }
+
+  static void normalize(float v[3]) {
+
+    float len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+    if (len > 0.0f) {
+      v[0] /= len;
+      v[1] /= len;
+      v[2] /= len;
+    }
+  }
+
+  /* Returns the angle between `a` and `b` in degrees. */
+  static float get_angle(const float a[3], const float b[3]) {
+
+    float la = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    float lb = sqrtf(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+    float d = 0.0f;
+
+    if (0.0f == la
+        || 0.0f == lb)
+      {
+        return 0.0f;
+      }
+
+    d = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) / (la * lb);
+
+    return acosf(fminf(fmaxf(d, -1.0f), 1.0f)) * MESH_RAD_TO_DEG;
+  }
+
+  /*
+    Returns the orthonormal frame of the space scaled by `scale`:
+    the normal is `scale * normal` and the tangent is
+    `scale * tangent` without its part along the normal.
+  */
+  static void scale_frame(const float normal[3], const float tangent[3], const float scale[3], float dst_normal[3], float dst_tangent[3]) {
+
+    float d = 0.0f;
+
+    for (size_t j = 0; j < 3; ++j) {
+      dst_normal[j] = normal[j] * scale[j];
+      dst_tangent[j] = tangent[j] * scale[j];
+    }
+
+    normalize(dst_normal);
+    d = dst_normal[0] * dst_tangent[0] + dst_normal[1] * dst_tangent[1] + dst_normal[2] * dst_tangent[2];
+
+    for (size_t j = 0; j < 3; ++j) {
+      dst_tangent[j] -= d * dst_normal[j];
+    }
+
+    normalize(dst_tangent);
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <filament/Engine.h>
+#include <filament/Scene.h>
+#include <filament/TransformManager.h>
+#include <utils/EntityManager.h>
+#include <math/mat4.h>
+#include <poly/MeshStreamer.h>
+#include <poly/AsyncMeshLoader.h>
+#include <poly/Trace.h>
+
+using namespace filament;
+using namespace filament::math;
+
+/* -------------------------------------------- */
+
+#define MESH_STREAMER_DEFAULT_LOAD_DISTANCE 50.0f
+#define MESH_STREAMER_DEFAULT_UNLOAD_DISTANCE 60.0f
+#define MESH_STREAMER_DEFAULT_MIN_SCREEN_SIZE 0.01f
+#define MESH_STREAMER_DEFAULT_MAX_LOADING 8
+#define MESH_STREAMER_DEFAULT_MAX_UPLOAD_BYTES (4 * 1024 * 1024)
+#define MESH_STREAMER_DEFAULT_MAX_CREATE_MS 2.0
+
+/* -------------------------------------------- */
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static bool is_larger_on_screen(const MeshStreamerChunk* a, const MeshStreamerChunk* b);
+
+  /* -------------------------------------------- */
+
+  MeshStreamer::MeshStreamer()
+    :engine(nullptr)
+    ,scene(nullptr)
+    ,loader(nullptr)
+  {
+    settings.load_distance = MESH_STREAMER_DEFAULT_LOAD_DISTANCE;
+    settings.unload_distance = MESH_STREAMER_DEFAULT_UNLOAD_DISTANCE;
+    settings.min_screen_size = MESH_STREAMER_DEFAULT_MIN_SCREEN_SIZE;
+    settings.max_loading = MESH_STREAMER_DEFAULT_MAX_LOADING;
+    settings.max_upload_bytes = MESH_STREAMER_DEFAULT_MAX_UPLOAD_BYTES;
+    settings.max_create_ms = MESH_STREAMER_DEFAULT_MAX_CREATE_MS;
+    stats = {};
+  }
+
+  MeshStreamer::~MeshStreamer() {
+
+    if (nullptr != engine) {
+      printf("Error: the mesh streamer is destructed but `shutdown()` hasn't been called.\n");
+    }
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      delete chunks[i];
+    }
+
+    chunks.clear();
+  }
+
+  /* -------------------------------------------- */
+
+  int MeshStreamer::init(filament::Engine* eng, filament::Scene* scn, AsyncMeshLoader* ldr) {
+
+    if (nullptr != engine) {
+      printf("Error: the mesh streamer is already initialized.\n");
+      return -1;
+    }
+
+    if (nullptr == eng
+        || nullptr == scn
+        || nullptr == ldr)
+      {
+        printf("Error: cannot initialize the mesh streamer, engine, scene or loader is nullptr.\n");
+        return -2;
+      }
+
+    engine = eng;
+    scene = scn;
+    loader = ldr;
+    stats = {};
+
+    return 0;
+  }
+
+  int MeshStreamer::shutdown() {
+
+    if (nullptr == engine) {
+      return 0;
+    }
+
+    /* We can't cancel a load; wait until the loader is done with our chunks. */
+    while (0 != loader->get_num_pending()) {
+      engine->flushAndWait();
+      loader->update();
+    }
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+
+      MeshStreamerChunk* chunk = chunks[i];
+
+      sync_chunk(chunk);
+
+      if (MESH_STREAMER_CHUNK_RESIDENT == chunk->state) {
+        unload_chunk(chunk);
+      }
+    }
+
+    engine = nullptr;
+    scene = nullptr;
+    loader = nullptr;
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  void MeshStreamer::set_settings(const MeshStreamerSettings& s) {
+
+    settings = s;
+
+    if (settings.unload_distance < settings.load_distance) {
+      printf("Error: the unload distance of the mesh streamer must be >= the load distance; we use the load distance.\n");
+      settings.unload_distance = settings.load_distance;
+    }
+
+    if (0 == settings.max_loading) {
+      printf("Error: the mesh streamer must be able to load at least one chunk at a time; we use 1.\n");
+      settings.max_loading = 1;
+    }
+  }
+
+  MeshStreamerSettings MeshStreamer::get_settings() {
+    return settings;
+  }
+
+  int MeshStreamer::add_chunk(const std::string& filepath, const float position[3], float radius) {
+
+    MeshStreamerChunk* chunk = nullptr;
+
+    if (true == filepath.empty()) {
+      printf("Error: cannot add a chunk to the mesh streamer, the filepath is empty.\n");
+      return -1;
+    }
+
+    if (nullptr == position
+        || radius <= 0.0f)
+      {
+        printf("Error: cannot add `%s` to the mesh streamer, it needs a position and a radius > 0.\n", filepath.c_str());
+        return -2;
+      }
+
+    chunk = new MeshStreamerChunk();
+    chunk->filepath = filepath;
+    chunk->position[0] = position[0];
+    chunk->position[1] = position[1];
+    chunk->position[2] = position[2];
+    chunk->radius = radius;
+    chunk->state = MESH_STREAMER_CHUNK_UNLOADED;
+    chunk->distance = 0.0f;
+    chunk->screen_size = 0.0f;
+    chunk->num_bytes = 0;
+    chunk->mesh = nullptr;
+
+    chunks.push_back(chunk);
+
+    return int(chunks.size() - 1);
+  }
+
+  const MeshStreamerChunk* MeshStreamer::get_chunk(size_t index) {
+
+    if (index >= chunks.size()) {
+      return nullptr;
+    }
+
+    return chunks[index];
+  }
+
+  /* -------------------------------------------- */
+
+  void MeshStreamer::update(const float camera_position[3], float projection_scale) {
+
+    float min_screen_size = settings.min_screen_size * MESH_STREAMER_HYSTERESIS;
+
+    if (nullptr == engine) {
+      return;
+    }
+
+    POLY_TRACE_SCOPE("MeshStreamer::update");
+
+    /* Create the buffers of the chunks which were parsed, within the budget of this frame. */
+    loader->update(settings.max_upload_bytes, settings.max_create_ms);
+
+    stats.num_resident = 0;
+    stats.num_loading = 0;
+    stats.num_resident_bytes = 0;
+    candidates.clear();
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+
+      MeshStreamerChunk* chunk = chunks[i];
+      float dx = chunk->position[0] - camera_position[0];
+      float dy = chunk->position[1] - camera_position[1];
+      float dz = chunk->position[2] - camera_position[2];
+      float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+      /* Same as `mesh_get_screen_size()`; the camera may be inside the sphere. */
+      chunk->distance = std::max(distance - chunk->radius, 0.0f);
+      chunk->screen_size = (distance <= chunk->radius) ? 1e6f : (chunk->radius * projection_scale) / distance;
+
+      sync_chunk(chunk);
+
+      if (MESH_STREAMER_CHUNK_RESIDENT == chunk->state
+          && (chunk->distance > settings.unload_distance || chunk->screen_size < min_screen_size))
+        {
+          unload_chunk(chunk);
+        }
+
+      if (MESH_STREAMER_CHUNK_UNLOADED == chunk->state
+          && chunk->distance <= settings.load_distance
+          && chunk->screen_size >= settings.min_screen_size)
+        {
+          candidates.push_back(chunk);
+        }
+
+      if (MESH_STREAMER_CHUNK_RESIDENT == chunk->state) {
+        stats.num_resident++;
+        stats.num_resident_bytes += chunk->num_bytes;
+      }
+      else if (MESH_STREAMER_CHUNK_LOADING == chunk->state) {
+        stats.num_loading++;
+      }
+    }
+
+    /* Request the largest chunks on screen first. */
+    if (stats.num_loading < settings.max_loading
+        && false == candidates.empty())
+      {
+        size_t num_requests = std::min(size_t(settings.max_loading - stats.num_loading), candidates.size());
+
+        std::partial_sort(candidates.begin(), candidates.begin() + num_requests, candidates.end(), is_larger_on_screen);
+
+        for (size_t i = 0; i < num_requests; ++i) {
+          load_chunk(candidates[i]);
+        }
+      }
+
+    stats.num_waiting = uint32_t(loader->get_num_waiting());
+    stats.num_upload_bytes = loader->get_num_upload_bytes();
+    stats.create_ms = loader->get_create_ms();
+  }
+
+  /* -------------------------------------------- */
+
+  /* Picks up the result of a chunk that was loading. */
+  void MeshStreamer::sync_chunk(MeshStreamerChunk* chunk) {
+
+    TransformManager& tm = engine->getTransformManager();
+
+    if (MESH_STREAMER_CHUNK_LOADING != chunk->state) {
+      return;
+    }
+
+    if (ASYNC_MESH_STATE_FAILED == chunk->mesh->state) {
+
+      /* The loader destroyed the entity; the transform component we created is ours. */
+      tm.destroy(chunk->entity);
+
+      loader->release(chunk->mesh);
+      chunk->mesh = nullptr;
+      chunk->entity = {};
+      chunk->state = MESH_STREAMER_CHUNK_FAILED;
+      return;
+    }
+
+    if (ASYNC_MESH_STATE_READY != chunk->mesh->state) {
+      return;
+    }
+
+    /* Compressed files are loaded on a new entity, without our transform. */
+    if (chunk->entity != chunk->mesh->entity) {
+      tm.destroy(chunk->entity);
+      chunk->entity = chunk->mesh->entity;
+      set_transform(chunk);
+    }
+
+    chunk->num_bytes = uint64_t(chunk->mesh->data.header.vertex_size) + uint64_t(chunk->mesh->data.header.index_size);
+    chunk->state = MESH_STREAMER_CHUNK_RESIDENT;
+  }
+
+  void MeshStreamer::load_chunk(MeshStreamerChunk* chunk) {
+
+    AsyncMesh* mesh = loader->load(chunk->filepath);
+
+    if (nullptr == mesh) {
+      chunk->state = MESH_STREAMER_CHUNK_FAILED;
+      return;
+    }
+
+    /* Before the mesh is created, so `mesh_create_renderable()` can add the transform of quantized meshes. */
+    chunk->mesh = mesh;
+    chunk->entity = mesh->entity;
+    chunk->state = MESH_STREAMER_CHUNK_LOADING;
+    set_transform(chunk);
+
+    stats.num_loads++;
+  }
+
+  void MeshStreamer::unload_chunk(MeshStreamerChunk* chunk) {
+
+    AsyncMesh* mesh = chunk->mesh;
+
+    scene->remove(chunk->entity);
+
+    if (nullptr != mesh->mesh.vertexBuffer) {
+      engine->destroy(mesh->mesh.vertexBuffer);
+    }
+
+    if (nullptr != mesh->mesh.indexBuffer) {
+      engine->destroy(mesh->mesh.indexBuffer);
+    }
+
+    engine->destroy(chunk->entity);
+    utils::EntityManager::get().destroy(chunk->entity);
+    loader->release(mesh);
+
+    chunk->mesh = nullptr;
+    chunk->entity = {};
+    chunk->num_bytes = 0;
+    chunk->state = MESH_STREAMER_CHUNK_UNLOADED;
+
+    stats.num_unloads++;
+  }
+
+  void MeshStreamer::set_transform(MeshStreamerChunk* chunk) {
+
+    TransformManager& tm = engine->getTransformManager();
+    mat4f transform = mat4f::translation(float3{ chunk->position[0], chunk->position[1], chunk->position[2] });
+
+    if (true == tm.hasComponent(chunk->entity)) {
+      tm.setTransform(tm.getInstance(chunk->entity), transform);
+      return;
+    }
+
+    tm.create(chunk->entity, {}, transform);
+  }
+
+  /* -------------------------------------------- */
+
+  static bool is_larger_on_screen(const MeshStreamerChunk* a, const MeshStreamerChunk* b) {
+    return a->screen_size > b->screen_size;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
@@ -0,0 +1,570 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include <poly/ShaderManager.h>
+#include <poly/Hash.h>
+#include <poly/Trace.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static uint64_t hash_string(const char* str, uint64_t seed);
+  static int print_shader_info(uint32_t shader, const std::string& name, const char* type);
+  static int print_program_info(uint32_t program, const std::string& name);
+  static int read_cache_file(const std::string& filepath, ShaderProgram* prog, uint64_t driver_hash, uint32_t& format, std::vector<uint8_t>& binary);
+
+  /* -------------------------------------------- */
+
+  ShaderManager::ShaderManager()
+    :driver_hash(0)
+    ,is_init(false)
+    ,is_cache_supported(false)
+    ,is_parallel(false)
+  {
+  }
+
+  ShaderManager::~ShaderManager() {
+
+    if (true == is_init) {
+      printf("Error: the shader manager is destructed but `shutdown()` hasn't been called; we're leaking GL programs.\n");
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  int ShaderManager::init(const std::string& dir) {
+
+    const char* vendor = nullptr;
+    const char* renderer = nullptr;
+    const char* version = nullptr;
+    const char* glsl_version = nullptr;
+    GLint num_formats = 0;
+
+    if (true == is_init) {
+      printf("Error: the shader manager is already initialized.\n");
+      return -1;
+    }
+
+    vendor = (const char*)glGetString(GL_VENDOR);
+    renderer = (const char*)glGetString(GL_RENDERER);
+    version = (const char*)glGetString(GL_VERSION);
+    glsl_version = (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION);
+
+    if (nullptr == vendor
+        || nullptr == renderer
+        || nullptr == version
+        || nullptr == glsl_version)
+      {
+        printf("Error: cannot initialize the shader manager, is there a current GL context?\n");
+        return -2;
+      }
+
+    /* A binary is only valid for the driver that created it. */
+    driver_hash = hash_string(vendor, HASH_SEED);
+    driver_hash = hash_string(renderer, driver_hash);
+    driver_hash = hash_string(version, driver_hash);
+    driver_hash = hash_string(glsl_version, driver_hash);
+
+    if (0 != GLAD_GL_VERSION_4_1
+        || 0 != GLAD_GL_ARB_get_program_binary)
+      {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+      }
+
+    cache_dir = dir;
+    is_cache_supported = (false == cache_dir.empty() && num_formats > 0);
+
+    /* Let the driver use as many threads as it wants. */
+    if (0 != GLAD_GL_KHR_parallel_shader_compile) {
+      glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+      is_parallel = true;
+    }
+    else if (0 != GLAD_GL_ARB_parallel_shader_compile) {
+      glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+      is_parallel = true;
+    }
+    else {
+      is_parallel = false;
+    }
+
+    is_init = true;
+
+    return 0;
+  }
+
+  int ShaderManager::shutdown() {
+
+    if (false == is_init) {
+      return 0;
+    }
+
+    for (size_t i = 0; i < programs.size(); ++i) {
+
+      ShaderProgram* prog = programs[i];
+
+      if (0 != prog->vert) {
+        glDeleteShader(prog->vert);
+      }
+
+      if (0 != prog->frag) {
+        glDeleteShader(prog->frag);
+      }
+
+      if (0 != prog->id) {
+        glDeleteProgram(prog->id);
+      }
+
+      delete prog;
+    }
+
+    programs.clear();
+    pending.clear();
+    cache_dir.clear();
+    driver_hash = 0;
+    is_cache_supported = false;
+    is_parallel = false;
+    is_init = false;
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  ShaderProgram* ShaderManager::add(const std::string& name, const std::string& vs, const std::string& fs) {
+
+    POLY_TRACE_SCOPE("ShaderManager::add");
+
+    ShaderProgram* prog = nullptr;
+    uint64_t vs_size = vs.size();
+    uint64_t fs_size = fs.size();
+
+    if (false == is_init) {
+      printf("Error: cannot add the shader program `%s`, the shader manager is not initialized.\n", name.c_str());
+      return nullptr;
+    }
+
+    if (true == name.empty()) {
+      printf("Error: cannot add a shader program without a name.\n");
+      return nullptr;
+    }
+
+    prog = new ShaderProgram();
+    prog->name = name;
+    prog->id = 0;
+    prog->state = SHADER_PROGRAM_STATE_COMPILING;
+    prog->is_cached = false;
+    prog->submit_ms = 0.0;
+    prog->total_ms = 0.0;
+    prog->vs = vs;
+    prog->fs = fs;
+    prog->vert = 0;
+    prog->frag = 0;
+    prog->add_ns = trace_now();
+
+    /* We include the sizes so moving text between the two sources changes the hash. */
+    prog->source_hash = hash_bytes(&vs_size, sizeof(vs_size));
+    prog->source_hash = hash_bytes(vs.data(), vs.size(), prog->source_hash);
+    prog->source_hash = hash_bytes(&fs_size, sizeof(fs_size), prog->source_hash);
+    prog->source_hash = hash_bytes(fs.data(), fs.size(), prog->source_hash);
+
+    programs.push_back(prog);
+
+    if (true == is_cache_supported
+        && 0 == load_binary(prog))
+      {
+        prog->is_cached = true;
+        prog->state = SHADER_PROGRAM_STATE_READY;
+        prog->submit_ms = trace_to_ms(prog->add_ns, trace_now());
+        prog->total_ms = prog->submit_ms;
+        return prog;
+      }
+
+    compile(prog);
+    pending.push_back(prog);
+
+    prog->submit_ms = trace_to_ms(prog->add_ns, trace_now());
+
+    return prog;
+  }
+
+  /* -------------------------------------------- */
+
+  void ShaderManager::update() {
+
+    GLint is_done = GL_TRUE;
+
+    for (size_t i = 0; i < pending.size(); ) {
+
+      ShaderProgram* prog = pending[i];
+
+      /* Without parallel compiling, asking for the link status blocks until it's done. */
+      if (true == is_parallel) {
+        glGetProgramiv(prog->id, GL_COMPLETION_STATUS_KHR, &is_done);
+      }
+
+      if (GL_FALSE == is_done) {
+        ++i;
+        continue;
+      }
+
+      complete(prog);
+      pending.erase(pending.begin() + i);
+    }
+  }
+
+  int ShaderManager::finish() {
+
+    POLY_TRACE_SCOPE("ShaderManager::finish");
+
+    for (size_t i = 0; i < pending.size(); ++i) {
+      complete(pending[i]);
+    }
+
+    pending.clear();
+
+    for (size_t i = 0; i < programs.size(); ++i) {
+      if (SHADER_PROGRAM_STATE_FAILED == programs[i]->state) {
+        return -1;
+      }
+    }
+
+    return 0;
+  }
+
+  size_t ShaderManager::get_num_pending() {
+    return pending.size();
+  }
+
+  /* -------------------------------------------- */
+
+  void ShaderManager::print() {
+
+    printf("Shader programs: %zu, parallel compiling %s, program binary cache %s.\n",
+           programs.size(),
+           (true == is_parallel) ? "enabled" : "not supported",
+           (true == is_cache_supported) ? "enabled" : "disabled");
+
+    for (size_t i = 0; i < programs.size(); ++i) {
+
+      ShaderProgram* prog = programs[i];
+      const char* state = "compiling";
+
+      if (SHADER_PROGRAM_STATE_READY == prog->state) {
+        state = (true == prog->is_cached) ? "cached" : "compiled";
+      }
+      else if (SHADER_PROGRAM_STATE_FAILED == prog->state) {
+        state = "failed";
+      }
+
+      printf("  %-24s %-10s submit %8.3f ms, total %8.3f ms\n",
+             prog->name.c_str(),
+             state,
+             prog->submit_ms,
+             prog->total_ms);
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  /* Submits the compile and link; with parallel compiling none of these calls wait for the driver. */
+  void ShaderManager::compile(ShaderProgram* prog) {
+
+    const char* vss = prog->vs.c_str();
+    const char* fss = prog->fs.c_str();
+
+    prog->vert = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(prog->vert, 1, &vss, nullptr);
+    glCompileShader(prog->vert);
+
+    prog->frag = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(prog->frag, 1, &fss, nullptr);
+    glCompileShader(prog->frag);
+
+    prog->id = glCreateProgram();
+
+    if (true == is_cache_supported) {
+      glProgramParameteri(prog->id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    glAttachShader(prog->id, prog->vert);
+    glAttachShader(prog->id, prog->frag);
+    glLinkProgram(prog->id);
+  }
+
+  /* Checks the result of `compile()`; this blocks until the driver is done. */
+  void ShaderManager::complete(ShaderProgram* prog) {
+
+    GLint is_linked = GL_FALSE;
+    int r = 0;
+
+    r |= print_shader_info(prog->vert, prog->name, "vertex");
+    r |= print_shader_info(prog->frag, prog->name, "fragment");
+
+    glGetProgramiv(prog->id, GL_LINK_STATUS, &is_linked);
+    if (GL_TRUE != is_linked) {
+      print_program_info(prog->id, prog->name);
+      r = -1;
+    }
+
+    glDetachShader(prog->id, prog->vert);
+    glDetachShader(prog->id, prog->frag);
+    glDeleteShader(prog->vert);
+    glDeleteShader(prog->frag);
+
+    prog->vert = 0;
+    prog->frag = 0;
+
+    if (0 != r) {
+      prog->state = SHADER_PROGRAM_STATE_FAILED;
+    }
+    else {
+      prog->state = SHADER_PROGRAM_STATE_READY;
+      if (true == is_cache_supported) {
+        save_binary(prog);
+      }
+    }
+
+    prog->total_ms = trace_to_ms(prog->add_ns, trace_now());
+  }
+
+  /* -------------------------------------------- */
+
+  /*
+    The cache file:
+
+      uint32_t    magic, `SHADER_CACHE_MAGIC`
+      uint32_t    version, `SHADER_CACHE_VERSION`
+      uint64_t    driver hash
+      uint64_t    source hash
+      uint32_t    binary format
+      uint32_t    binary size
+      uint8_t     x binary size
+
+    `load_binary()` returns < 0 when there is no valid binary;
+    the caller then compiles from source.
+  */
+  int ShaderManager::load_binary(ShaderProgram* prog) {
+
+    std::string filepath = get_cache_filepath(prog);
+    std::vector<uint8_t> binary;
+    uint32_t format = 0;
+    GLint is_linked = GL_FALSE;
+
+    if (0 != read_cache_file(filepath, prog, driver_hash, format, binary)) {
+      return -1;
+    }
+
+    prog->id = glCreateProgram();
+    glProgramBinary(prog->id, format, binary.data(), GLsizei(binary.size()));
+    glGetProgramiv(prog->id, GL_LINK_STATUS, &is_linked);
+
+    /* The driver may reject a binary it created itself, e.g. after an update that didn't change the version string. */
+    if (GL_TRUE != is_linked) {
+      while (GL_NO_ERROR != glGetError()) { } /* An unsupported format raises GL_INVALID_ENUM; don't leave it for the next check. */
+      printf("The driver rejected the program binary of `%s`; we compile it from source.\n", prog->name.c_str());
+      glDeleteProgram(prog->id);
+      prog->id = 0;
+      return -2;
+    }
+
+    return 0;
+  }
+
+  int ShaderManager::save_binary(ShaderProgram* prog) {
+
+    std::string filepath = get_cache_filepath(prog);
+    std::string tmp_filepath = filepath + ".tmp";
+    std::vector<uint8_t> binary;
+    GLint size = 0;
+    GLenum format = 0;
+    uint32_t magic = SHADER_CACHE_MAGIC;
+    uint32_t version = SHADER_CACHE_VERSION;
+    uint32_t file_format = 0;
+    uint32_t file_size = 0;
+    FILE* fp = nullptr;
+    int r = 0;
+
+    glGetProgramiv(prog->id, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) {
+      printf("Error: the driver didn't give us a program binary for `%s`.\n", prog->name.c_str());
+      return -1;
+    }
+
+    binary.resize(size_t(size));
+    glGetProgramBinary(prog->id, size, &size, &format, binary.data());
+
+    file_format = uint32_t(format);
+    file_size = uint32_t(size);
+
+    /* Another instance may be loading `filepath`; it only ever sees a complete file. */
+    fp = fopen(tmp_filepath.c_str(), "wb");
+    if (nullptr == fp) {
+      printf("Error: cannot open `%s` to save the program binary of `%s`.\n", tmp_filepath.c_str(), prog->name.c_str());
+      return -2;
+    }
+
+    if (1 != fwrite(&magic, sizeof(magic), 1, fp)
+        || 1 != fwrite(&version, sizeof(version), 1, fp)
+        || 1 != fwrite(&driver_hash, sizeof(driver_hash), 1, fp)
+        || 1 != fwrite(&prog->source_hash, sizeof(prog->source_hash), 1, fp)
+        || 1 != fwrite(&file_format, sizeof(file_format), 1, fp)
+        || 1 != fwrite(&file_size, sizeof(file_size), 1, fp)
+        || 1 != fwrite(binary.data(), file_size, 1, fp))
+      {
+        printf("Error: failed to write the program binary `%s`.\n", tmp_filepath.c_str());
+        r = -3;
+      }
+
+    fclose(fp);
+
+    if (0 != r) {
+      remove(tmp_filepath.c_str());
+      return r;
+    }
+
+#if defined(_WIN32)
+    remove(filepath.c_str());
+#endif
+
+    if (0 != rename(tmp_filepath.c_str(), filepath.c_str())) {
+      printf("Error: failed to rename `%s` to `%s`.\n", tmp_filepath.c_str(), filepath.c_str());
+      remove(tmp_filepath.c_str());
+      return -4;
+    }
+
+    return 0;
+  }
+
+  std::string ShaderManager::get_cache_filepath(ShaderProgram* prog) {
+
+    std::string filepath = cache_dir;
+
+    if ('/' != filepath.back()
+        && '\\' != filepath.back())
+      {
+        filepath += "/";
+      }
+
+    return filepath + prog->name + ".glprogram";
+  }
+
+  /* -------------------------------------------- */
+
+  /* Includes the terminating zero, so the strings are separated. */
+  static uint64_t hash_string(const char* str, uint64_t seed) {
+    return hash_bytes(str, strlen(str) + 1, seed);
+  }
+
+  /* Reads the binary when the file exists and matches the driver and sources. */
+  static int read_cache_file(const std::string& filepath, ShaderProgram* prog, uint64_t driver_hash, uint32_t& format, std::vector<uint8_t>& binary) {
+
+    FILE* fp = nullptr;
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t file_driver_hash = 0;
+    uint64_t file_source_hash = 0;
+    uint32_t size = 0;
+
+    fp = fopen(filepath.c_str(), "rb");
+    if (nullptr == fp) {
+      return -1;
+    }
+
+    if (1 != fread(&magic, sizeof(magic), 1, fp)
+        || 1 != fread(&version, sizeof(version), 1, fp)
+        || 1 != fread(&file_driver_hash, sizeof(file_driver_hash), 1, fp)
+        || 1 != fread(&file_source_hash, sizeof(file_source_hash), 1, fp)
+        || 1 != fread(&format, sizeof(format), 1, fp)
+        || 1 != fread(&size, sizeof(size), 1, fp))
+      {
+        printf("Error: the program binary `%s` is truncated; we compile `%s` from source.\n", filepath.c_str(), prog->name.c_str());
+        fclose(fp);
+        return -2;
+      }
+
+    if (SHADER_CACHE_MAGIC != magic
+        || SHADER_CACHE_VERSION != version)
+      {
+        printf("Error: `%s` is not a program binary we can read; we compile `%s` from source.\n", filepath.c_str(), prog->name.c_str());
+        fclose(fp);
+        return -3;
+      }
+
+    if (driver_hash != file_driver_hash) {
+      printf("The program binary of `%s` was created by another driver; we compile it from source.\n", prog->name.c_str());
+      fclose(fp);
+      return -4;
+    }
+
+    if (prog->source_hash != file_source_hash) {
+      printf("The sources of `%s` changed; we compile it from source.\n", prog->name.c_str());
+      fclose(fp);
+      return -5;
+    }
+
+    binary.resize(size);
+
+    if (0 == size
+        || 1 != fread(binary.data(), size, 1, fp))
+      {
+        printf("Error: the program binary `%s` is truncated; we compile `%s` from source.\n", filepath.c_str(), prog->name.c_str());
+        fclose(fp);
+        return -6;
+      }
+
+    fclose(fp);
+
+    return 0;
+  }
+
+  static int print_shader_info(uint32_t shader, const std::string& name, const char* type) {
+
+    GLint is_compiled = GL_FALSE;
+    GLint count = 0;
+    std::vector<GLchar> log;
+
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &is_compiled);
+    if (GL_TRUE == is_compiled) {
+      return 0;
+    }
+
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &count);
+    log.resize(size_t(count) + 1, 0);
+
+    if (count > 0) {
+      glGetShaderInfoLog(shader, count, nullptr, log.data());
+    }
+
+    printf("Error: failed to compile the %s shader of `%s`.\n", type, name.c_str());
+    printf("--------------------------------------------------------\n");
+    printf("%s\n", log.data());
+    printf("--------------------------------------------------------\n");
+
+    return -1;
+  }
+
+  static int print_program_info(uint32_t program, const std::string& name) {
+
+    GLint count = 0;
+    std::vector<GLchar> log;
+
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &count);
+    log.resize(size_t(count) + 1, 0);
+
+    if (count > 0) {
+      glGetProgramInfoLog(program, count, nullptr, log.data());
+    }
+
+    printf("Error: failed to link the program `%s`.\n", name.c_str());
+    printf("--------------------------------------------------------\n");
+    printf("%s\n", log.data());
+    printf("--------------------------------------------------------\n");
+
+    return -1;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <poly/StartupTimeline.h>
+#include <poly/Trace.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  StartupTimeline::StartupTimeline()
+    :start_ns(trace_now())
+  {
+  }
+
+  StartupTimeline::~StartupTimeline() {
+
+    for (size_t i = 0; i < tasks.size(); ++i) {
+      delete tasks[i];
+    }
+
+    tasks.clear();
+  }
+
+  /* -------------------------------------------- */
+
+  int StartupTimeline::add_task(const char* name, const char* thread, std::initializer_list<int> dependencies) {
+
+    StartupTask* task = nullptr;
+
+    if (nullptr == name
+        || nullptr == thread)
+      {
+        printf("Error: cannot add a startup task without a name or thread.\n");
+        return -1;
+      }
+
+    for (int dep : dependencies) {
+      if (dep < 0 || dep >= int(tasks.size())) {
+        printf("Error: cannot add the startup task `%s`, it depends on an unknown task.\n", name);
+        return -2;
+      }
+    }
+
+    task = new StartupTask();
+    task->name = name;
+    task->thread = thread;
+    task->dependencies = dependencies;
+    task->begin_ns = 0;
+    task->end_ns = 0;
+
+    tasks.push_back(task);
+
+    return int(tasks.size() - 1);
+  }
+
+  void StartupTimeline::begin(int task) {
+
+    if (task < 0 || task >= int(tasks.size())) {
+      return;
+    }
+
+    tasks[task]->begin_ns.store(trace_now(), std::memory_order_release);
+  }
+
+  void StartupTimeline::end(int task) {
+
+    uint64_t begin_ns = 0;
+    uint64_t end_ns = trace_now();
+
+    if (task < 0 || task >= int(tasks.size())) {
+      return;
+    }
+
+    begin_ns = tasks[task]->begin_ns.load(std::memory_order_acquire);
+    if (0 == begin_ns) {
+      printf("Error: the startup task `%s` ended but it never began.\n", tasks[task]->name);
+      return;
+    }
+
+    tasks[task]->end_ns.store(end_ns, std::memory_order_release);
+    trace_record(tasks[task]->name, begin_ns, end_ns);
+  }
+
+  bool StartupTimeline::is_ended(int task) {
+
+    if (task < 0 || task >= int(tasks.size())) {
+      return false;
+    }
+
+    return 0 != tasks[task]->end_ns.load();
+  }
+
+  double StartupTimeline::get_duration(int task) {
+
+    if (task < 0 || task >= int(tasks.size())) {
+      return 0.0;
+    }
+
+    return trace_to_ms(tasks[task]->begin_ns.load(), tasks[task]->end_ns.load());
+  }
+
+  /* -------------------------------------------- */
+
+  /*
+    A task waits for its dependencies, but also for the task
+    before it on the same thread. We walk back from the task that
+    ended last and every time take the one of those which ended
+    last; that's the one the task was waiting for.
+  */
+  double StartupTimeline::get_critical_path(std::vector<int>& path) {
+
+    int current = -1;
+    uint64_t last_ns = 0;
+
+    path.clear();
+
+    for (size_t i = 0; i < tasks.size(); ++i) {
+      uint64_t end_ns = tasks[i]->end_ns.load();
+      if (end_ns > last_ns) {
+        last_ns = end_ns;
+        current = int(i);
+      }
+    }
+
+    while (current >= 0) {
+
+      StartupTask* task = tasks[current];
+      uint64_t begin_ns = task->begin_ns.load();
+      uint64_t gate_ns = 0;
+      int gate = -1;
+
+      path.push_back(current);
+
+      for (size_t i = 0; i < tasks.size(); ++i) {
+
+        StartupTask* other = tasks[i];
+        uint64_t end_ns = other->end_ns.load();
+        bool is_dependency = (task->dependencies.end() != std::find(task->dependencies.begin(), task->dependencies.end(), int(i)));
+        bool is_before_on_thread = (int(i) != current && 0 == strcmp(other->thread, task->thread) && 0 != end_ns && end_ns <= begin_ns);
+
+        if (false == is_dependency
+            && false == is_before_on_thread)
+          {
+            continue;
+          }
+
+        if (end_ns > gate_ns) {
+          gate_ns = end_ns;
+          gate = int(i);
+        }
+      }
+
+      current = gate;
+    }
+
+    std::reverse(path.begin(), path.end());
+
+    return trace_to_ms(start_ns, last_ns);
+  }
+
+  /* -------------------------------------------- */
+
+  void StartupTimeline::print() {
+
+    std::vector<int> path;
+    double total_ms = get_critical_path(path);
+    double sum_ms = 0.0;
+    char bar[STARTUP_TIMELINE_BAR_WIDTH + 1];
+
+    printf("Startup timeline (ms):\n");
+    printf("  %-24s %-14s %9s %9s %9s  %s\n", "task", "thread", "begin", "end", "duration", "timeline");
+
+    for (size_t i = 0; i < tasks.size(); ++i) {
+
+      StartupTask* task = tasks[i];
+      uint64_t begin_ns = task->begin_ns.load();
+      uint64_t end_ns = task->end_ns.load();
+      bool is_critical = (path.end() != std::find(path.begin(), path.end(), int(i)));
+
+      if (0 == begin_ns
+          || 0 == end_ns)
+        {
+          printf("  %-24s %-14s %9s %9s %9s\n", task->name, task->thread, "-", "-", "-");
+          continue;
+        }
+
+      double begin_ms = trace_to_ms(start_ns, begin_ns);
+      double end_ms = trace_to_ms(start_ns, end_ns);
+      size_t first = (total_ms > 0.0) ? size_t(STARTUP_TIMELINE_BAR_WIDTH * begin_ms / total_ms) : 0;
+      size_t last = (total_ms > 0.0) ? size_t(STARTUP_TIMELINE_BAR_WIDTH * end_ms / total_ms) : 0;
+
+      first = std::min<size_t>(first, STARTUP_TIMELINE_BAR_WIDTH - 1);
+      last = std::min<size_t>(std::max(last, first + 1), STARTUP_TIMELINE_BAR_WIDTH);
+
+      for (size_t j = 0; j < STARTUP_TIMELINE_BAR_WIDTH; ++j) {
+        bar[j] = (j >= first && j < last) ? '#' : '.';
+      }
+
+      bar[STARTUP_TIMELINE_BAR_WIDTH] = '\0';
+      sum_ms += end_ms - begin_ms;
+
+      printf("  %-24s %-14s %9.3f %9.3f %9.3f  %s%s\n",
+             task->name,
+             task->thread,
+             begin_ms,
+             end_ms,
+             end_ms - begin_ms,
+             bar,
+             (true == is_critical) ? " *" : "");
+    }
+
+    printf("  Critical path (*): ");
+
+    for (size_t i = 0; i < path.size(); ++i) {
+      printf("%s%s", (0 == i) ? "" : " > ", tasks[path[i]]->name);
+    }
+
+    printf(" = %.3f ms; one after the other the tasks take %.3f ms.\n", total_ms, sum_ms);
+  }
+
+  int StartupTimeline::save_json(const std::string& filepath) {
+
+    std::vector<int> path;
+    double total_ms = get_critical_path(path);
+    double sum_ms = 0.0;
+    FILE* fp = nullptr;
+
+    fp = fopen(filepath.c_str(), "w");
+    if (nullptr == fp) {
+      printf("Error: failed to open `%s` to save the startup timeline.\n", filepath.c_str());
+      return -1;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"tasks\": [\n");
+
+    for (size_t i = 0; i < tasks.size(); ++i) {
+
+      StartupTask* task = tasks[i];
+      uint64_t begin_ns = task->begin_ns.load();
+      uint64_t end_ns = task->end_ns.load();
+      bool is_critical = (path.end() != std::find(path.begin(), path.end(), int(i)));
+      bool is_complete = (0 != begin_ns && 0 != end_ns);
+      double begin_ms = (true == is_complete) ? trace_to_ms(start_ns, begin_ns) : 0.0;
+      double end_ms = (true == is_complete) ? trace_to_ms(start_ns, end_ns) : 0.0;
+
+      if (true == is_complete) {
+        sum_ms += end_ms - begin_ms;
+      }
+
+      fprintf(fp, "    { \"name\": \"%s\", \"thread\": \"%s\", \"complete\": %s, \"begin_ms\": %.3f, \"end_ms\": %.3f, \"duration_ms\": %.3f, \"critical\": %s, \"dependencies\": [",
+              task->name,
+              task->thread,
+              (true == is_complete) ? "true" : "false",
+              begin_ms,
+              end_ms,
+              end_ms - begin_ms,
+              (true == is_critical) ? "true" : "false");
+
+      for (size_t j = 0; j < task->dependencies.size(); ++j) {
+        fprintf(fp, "%s\"%s\"", (0 == j) ? "" : ", ", tasks[task->dependencies[j]]->name);
+      }
+
+      fprintf(fp, "] }%s\n", (i + 1 == tasks.size()) ? "" : ",");
+    }
+
+    fprintf(fp, "  ],\n");
+    fprintf(fp, "  \"critical_path\": [");
+
+    for (size_t i = 0; i < path.size(); ++i) {
+      fprintf(fp, "%s\"%s\"", (0 == i) ? "" : ", ", tasks[path[i]]->name);
+    }
+
+    fprintf(fp, "],\n");
+    fprintf(fp, "  \"critical_path_ms\": %.3f,\n", total_ms);
+    fprintf(fp, "  \"serial_ms\": %.3f\n", sum_ms);
+    fprintf(fp, "}\n");
+    fclose(fp);
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
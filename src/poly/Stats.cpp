@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <algorithm>
+#include <poly/Stats.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  RollingStats::RollingStats(size_t capacity)
+    :write_dx(0)
+    ,count(0)
+  {
+    if (0 == capacity) {
+      capacity = 1;
+    }
+
+    samples.resize(capacity, 0.0);
+    scratch.reserve(capacity);
+  }
+
+  void RollingStats::add(double value) {
+
+    samples[write_dx] = value;
+    write_dx = (write_dx + 1) % samples.size();
+
+    if (count < samples.size()) {
+      count++;
+    }
+  }
+
+  void RollingStats::reset() {
+    write_dx = 0;
+    count = 0;
+  }
+
+  double RollingStats::percentile(double p) {
+
+    if (0 == count) {
+      return 0.0;
+    }
+
+    if (p < 0.0) {
+      p = 0.0;
+    }
+
+    if (p > 100.0) {
+      p = 100.0;
+    }
+
+    scratch.assign(samples.begin(), samples.begin() + count);
+
+    size_t dx = size_t((p / 100.0) * double(count - 1) + 0.5);
+    std::nth_element(scratch.begin(), scratch.begin() + dx, scratch.end());
+
+    return scratch[dx];
+  }
+
+  double RollingStats::min() {
+
+    if (0 == count) {
+      return 0.0;
+    }
+
+    return *std::min_element(samples.begin(), samples.begin() + count);
+  }
+
+  double RollingStats::max() {
+
+    if (0 == count) {
+      return 0.0;
+    }
+
+    return *std::max_element(samples.begin(), samples.begin() + count);
+  }
+
+  double RollingStats::mean() {
+
+    if (0 == count) {
+      return 0.0;
+    }
+
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+      sum += samples[i];
+    }
+
+    return sum / double(count);
+  }
+
+  size_t RollingStats::size() {
+    return count;
+  }
+
+  /* -------------------------------------------- */
+
+  Histogram::Histogram(double min_value, double max_value, size_t num_buckets)
+    :min_value(min_value)
+    ,max_value(max_value)
+    ,bucket_size(1.0)
+    ,count(0)
+  {
+    if (0 == num_buckets) {
+      num_buckets = 1;
+    }
+
+    if (max_value <= min_value) {
+      max_value = min_value + 1.0;
+    }
+
+    this->max_value = max_value;
+    bucket_size = (max_value - min_value) / double(num_buckets);
+    buckets.resize(num_buckets, 0);
+  }
+
+  void Histogram::add(double value) {
+
+    double dx = (value - min_value) / bucket_size;
+    if (dx < 0.0) {
+      dx = 0.0;
+    }
+
+    if (dx >= double(buckets.size())) {
+      dx = double(buckets.size() - 1);
+    }
+
+    buckets[size_t(dx)]++;
+    count++;
+  }
+
+  void Histogram::reset() {
+    std::fill(buckets.begin(), buckets.end(), 0);
+    count = 0;
+  }
+
+  void Histogram::print(const char* unit) {
+
+    if (0 == count) {
+      printf("    (no samples)\n");
+      return;
+    }
+
+    uint64_t max_count = *std::max_element(buckets.begin(), buckets.end());
+
+    for (size_t i = 0; i < buckets.size(); ++i) {
+
+      if (0 == buckets[i]) {
+        continue;
+      }
+
+      double from = min_value + bucket_size * double(i);
+      double to = from + bucket_size;
+      int bar_len = int((40 * buckets[i]) / max_count);
+      
+      printf("    %7.2f - %7.2f %s%s: %-40.*s %llu\n",
+             from,
+             to,
+             unit,
+             (i == buckets.size() - 1) ? "+" : " ",
+             bar_len,
+             "########################################",
+             (unsigned long long)buckets[i]);
+    }
+  }
+
+  uint64_t Histogram::get_count() {
+    return count;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <poly/Trace.h>
+#include <poly/Json.h>
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  struct TraceEvent {
+    const char* name;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+  };
+
+  /*
+    Only the owning thread writes `events` and `count`. The
+    thread that saves the trace reads `count` with acquire
+    semantics and only touches the events below it, which were
+    completely written before `count` was incremented.
+  */
+  struct TraceBuffer {
+    TraceEvent events[TRACE_MAX_EVENTS_PER_THREAD];
+    std::atomic<uint32_t> count;
+    std::atomic<uint64_t> num_dropped;
+    std::string thread_name;
+    uint32_t thread_id;
+  };
+
+  /* -------------------------------------------- */
+
+  static std::mutex trace_mutex;
+  static std::vector<TraceBuffer*> trace_buffers;
+  static std::atomic<bool> trace_enabled(true);
+  static const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+  static thread_local TraceBuffer* trace_buffer = nullptr;
+  static thread_local std::string trace_thread_name;       /* Kept until the thread records its first span. */
+
+  /* -------------------------------------------- */
+
+  static TraceBuffer* trace_get_buffer();
+
+  /* -------------------------------------------- */
+
+  bool trace_is_available() {
+#if defined(POLY_ENABLE_PROFILING)
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  void trace_set_enabled(bool enabled) {
+    trace_enabled.store(enabled, std::memory_order_relaxed);
+  }
+
+  /* We don't allocate the buffer here; a thread that never records (e.g. when profiling is off) costs nothing. */
+  void trace_set_thread_name(const std::string& name) {
+
+    trace_thread_name = name;
+
+    if (nullptr == trace_buffer) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    trace_buffer->thread_name = name;
+  }
+
+  uint64_t trace_now() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_epoch).count());
+  }
+
+  double trace_to_ms(uint64_t begin_ns, uint64_t end_ns) {
+    return (end_ns > begin_ns) ? double(end_ns - begin_ns) / 1e6 : 0.0;
+  }
+
+  /* -------------------------------------------- */
+
+  void trace_record(const char* name, uint64_t begin_ns, uint64_t end_ns) {
+
+    if (false == trace_enabled.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    TraceBuffer* buf = trace_get_buffer();
+    uint32_t dx = buf->count.load(std::memory_order_relaxed);
+
+    if (dx >= TRACE_MAX_EVENTS_PER_THREAD) {
+      if (0 == buf->num_dropped.fetch_add(1, std::memory_order_relaxed)) {
+        printf("Warning: the trace buffer of thread %u is full; we drop its next spans.\n", buf->thread_id);
+      }
+      return;
+    }
+
+    TraceEvent& ev = buf->events[dx];
+    ev.name = name;
+    ev.begin_ns = begin_ns;
+    ev.end_ns = end_ns;
+
+    buf->count.store(dx + 1, std::memory_order_release);
+  }
+
+  /* -------------------------------------------- */
+
+  int trace_save(const std::string& filepath) {
+
+    if (0 == filepath.size()) {
+      printf("Error: cannot save the trace, empty filepath.\n");
+      return -1;
+    }
+
+    FILE* fp = fopen(filepath.c_str(), "wb");
+    if (nullptr == fp) {
+      printf("Error: cannot save the trace, failed to open `%s`.\n", filepath.c_str());
+      return -2;
+    }
+
+    std::lock_guard<std::mutex> lock(trace_mutex);
+
+    uint64_t num_events = 0;
+    uint64_t num_dropped = 0;
+    bool is_first = true;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (size_t i = 0; i < trace_buffers.size(); ++i) {
+
+      TraceBuffer* buf = trace_buffers[i];
+      uint32_t count = buf->count.load(std::memory_order_acquire);
+
+      if (0 != buf->thread_name.size()) {
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", (is_first) ? "" : ",\n", buf->thread_id);
+        json_write_string(fp, buf->thread_name.c_str());
+        fprintf(fp, "}}");
+        is_first = false;
+      }
+
+      for (uint32_t j = 0; j < count; ++j) {
+        const TraceEvent& ev = buf->events[j];
+        fprintf(fp, "%s{\"name\":", (is_first) ? "" : ",\n");
+        json_write_string(fp, ev.name);
+        fprintf(fp, ",\"cat\":\"poly\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                buf->thread_id,
+                double(ev.begin_ns) / 1e3,
+                double(ev.end_ns - ev.begin_ns) / 1e3);
+        is_first = false;
+      }
+
+      num_events += count;
+      num_dropped += buf->num_dropped.load(std::memory_order_relaxed);
+    }
+
+    /* The viewers show `otherData` in the metadata of the trace, so a truncated trace can't pass for a complete one. */
+    fprintf(fp, "\n],\"otherData\":{\"num_events\":%llu,\"num_dropped\":%llu}}\n",
+            (unsigned long long)num_events,
+            (unsigned long long)num_dropped);
+    fclose(fp);
+
+    printf("Saved trace with %llu events (%llu dropped) into `%s`.\n",
+           (unsigned long long)num_events,
+           (unsigned long long)num_dropped,
+           filepath.c_str());
+
+    return 0;
+  }
+
+  /* -------------------------------------------- */
+
+  /*
+    The buffers are never freed; threads might still record into
+    them while we exit and the memory is released with the
+    process.
+  */
+  static TraceBuffer* trace_get_buffer() {
+
+    if (nullptr != trace_buffer) {
+      return trace_buffer;
+    }
+
+    TraceBuffer* buf = new TraceBuffer();
+    buf->count.store(0);
+    buf->num_dropped.store(0);
+    buf->thread_name = trace_thread_name;
+
+    {
+      std::lock_guard<std::mutex> lock(trace_mutex);
+      buf->thread_id = uint32_t(trace_buffers.size() + 1);
+      trace_buffers.push_back(buf);
+    }
+
+    trace_buffer = buf;
+
+    return buf;
+  }
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
@@ -0,0 +1,387 @@
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define POLY_TRANSFORM_X86 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+#endif
+
+#if defined(_MSC_VER)
+#  define POLY_TARGET_AVX2
+#else
+#  define POLY_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+#include <stdio.h>
+#include <poly/TransformBatch.h>
+
+using namespace filament;
+using namespace filament::math;
+
+namespace poly {
+
+  /* -------------------------------------------- */
+
+  static void compose_scalar(TransformBatch& batch);
+
+#if defined(POLY_TRANSFORM_X86)
+  static void compose_sse(TransformBatch& batch);
+  static void compose_avx2(TransformBatch& batch);
+  static bool cpu_has_avx2();
+#endif
+
+  /* -------------------------------------------- */
+
+  void transform_batch_resize(TransformBatch& batch, size_t count) {
+
+    /* Padded so the SIMD kernels never need a tail loop. */
+    size_t padded = (count + 7) & ~size_t(7);
+
+    batch.count = count;
+    batch.px.resize(padded, 0.0f);
+    batch.py.resize(padded, 0.0f);
+    batch.pz.resize(padded, 0.0f);
+    batch.qx.resize(padded, 0.0f);
+    batch.qy.resize(padded, 0.0f);
+    batch.qz.resize(padded, 0.0f);
+    batch.qw.resize(padded, 1.0f);
+    batch.sx.resize(padded, 1.0f);
+    batch.sy.resize(padded, 1.0f);
+    batch.sz.resize(padded, 1.0f);
+    batch.matrices.resize(padded);
+  }
+
+  /* -------------------------------------------- */
+
+  int transform_batch_compose(TransformBatch& batch, int kernel) {
+
+    if (TRANSFORM_KERNEL_AUTO == kernel) {
+      kernel = transform_get_best_kernel();
+    }
+
+    if (kernel > transform_get_best_kernel()) {
+      printf("Error: the `%s` transform kernel is not supported on this CPU, falling back to `%s`.\n",
+             transform_kernel_to_string(kernel),
+             transform_kernel_to_string(transform_get_best_kernel()));
+      kernel = transform_get_best_kernel();
+    }
+
+    switch (kernel) {
+#if defined(POLY_TRANSFORM_X86)
+      case TRANSFORM_KERNEL_AVX2: {
+        compose_avx2(batch);
+        break;
+      }
+      case TRANSFORM_KERNEL_SSE: {
+        compose_sse(batch);
+        break;
+      }
+#endif
+      default: {
+        kernel = TRANSFORM_KERNEL_SCALAR;
+        compose_scalar(batch);
+        break;
+      }
+    }
+
+    return kernel;
+  }
+
+  void transform_batch_commit(
+    TransformBatch& batch,
+    filament::TransformManager& tm,
+    const filament::TransformManager::Instance* instances
+  )
+  {
+    if (nullptr == instances) {
+      printf("Error: cannot commit the transform batch, instances is nullptr.\n");
+      return;
+    }
+
+    /* The world transforms are updated once, in `commitLocalTransformTransaction()`. */
+    tm.openLocalTransformTransaction();
+
+    for (size_t i = 0; i < batch.count; ++i) {
+      tm.setTransform(instances[i], batch.matrices[i]);
+    }
+
+    tm.commitLocalTransformTransaction();
+  }
+
+  /* M * translation(offset) * scaling(scale), without the full matrix product. */
+  void transform_batch_apply_local(TransformBatch& batch, const float offset[3], const float scale[3]) {
+
+    for (size_t i = 0; i < batch.count; ++i) {
+
+      float* m = &batch.matrices[i][0][0];
+
+      for (size_t r = 0; r < 4; ++r) {
+        m[12 + r] += m[r] * offset[0] + m[4 + r] * offset[1] + m[8 + r] * offset[2];
+        m[r] *= scale[0];
+        m[4 + r] *= scale[1];
+        m[8 + r] *= scale[2];
+      }
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  int transform_get_best_kernel() {
+
+#if defined(POLY_TRANSFORM_X86)
+    static const int best = cpu_has_avx2() ? TRANSFORM_KERNEL_AVX2 : TRANSFORM_KERNEL_SSE;
+    return best;
+#else
+    return TRANSFORM_KERNEL_SCALAR;
+#endif
+  }
+
+  const char* transform_kernel_to_string(int kernel) {
+
+    switch (kernel) {
+      case TRANSFORM_KERNEL_AUTO:   { return "auto";    }
+      case TRANSFORM_KERNEL_SCALAR: { return "scalar";  }
+      case TRANSFORM_KERNEL_SSE:    { return "sse";     }
+      case TRANSFORM_KERNEL_AVX2:   { return "avx2";    }
+      default:                      { return "unknown"; }
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  /*
+    All kernels compute M = T * R(q) * S directly, with the
+    rotation matrix built from the unit quaternion and the
+    columns multiplied by the scale. Filament matrices are
+    column-major, so each entity gets 4 consecutive columns.
+  */
+  static void compose_scalar(TransformBatch& batch) {
+
+    for (size_t i = 0; i < batch.count; ++i) {
+
+      float x = batch.qx[i];
+      float y = batch.qy[i];
+      float z = batch.qz[i];
+      float w = batch.qw[i];
+      float sx = batch.sx[i];
+      float sy = batch.sy[i];
+      float sz = batch.sz[i];
+      float* dst = &batch.matrices[i][0][0];
+
+      dst[0]  = (1.0f - 2.0f * (y * y + z * z)) * sx;
+      dst[1]  = (2.0f * (x * y + w * z)) * sx;
+      dst[2]  = (2.0f * (x * z - w * y)) * sx;
+      dst[3]  = 0.0f;
+
+      dst[4]  = (2.0f * (x * y - w * z)) * sy;
+      dst[5]  = (1.0f - 2.0f * (x * x + z * z)) * sy;
+      dst[6]  = (2.0f * (y * z + w * x)) * sy;
+      dst[7]  = 0.0f;
+
+      dst[8]  = (2.0f * (x * z + w * y)) * sz;
+      dst[9]  = (2.0f * (y * z - w * x)) * sz;
+      dst[10] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+      dst[11] = 0.0f;
+
+      dst[12] = batch.px[i];
+      dst[13] = batch.py[i];
+      dst[14] = batch.pz[i];
+      dst[15] = 1.0f;
+    }
+  }
+
+  /* -------------------------------------------- */
+
+#if defined(POLY_TRANSFORM_X86)
+
+  /* Transposes one column of 4 entities (one component per register) into 4 consecutive matrices. */
+  static inline void store_column(__m128 cx, __m128 cy, __m128 cz, __m128 cw, float* dst) {
+
+    _MM_TRANSPOSE4_PS(cx, cy, cz, cw);
+
+    _mm_storeu_ps(dst + 0,  cx);
+    _mm_storeu_ps(dst + 16, cy);
+    _mm_storeu_ps(dst + 32, cz);
+    _mm_storeu_ps(dst + 48, cw);
+  }
+
+  static void compose_sse(TransformBatch& batch) {
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (size_t i = 0; i < batch.count; i += 4) {
+
+      __m128 x = _mm_loadu_ps(&batch.qx[i]);
+      __m128 y = _mm_loadu_ps(&batch.qy[i]);
+      __m128 z = _mm_loadu_ps(&batch.qz[i]);
+      __m128 w = _mm_loadu_ps(&batch.qw[i]);
+      __m128 sx = _mm_loadu_ps(&batch.sx[i]);
+      __m128 sy = _mm_loadu_ps(&batch.sy[i]);
+      __m128 sz = _mm_loadu_ps(&batch.sz[i]);
+
+      __m128 x2 = _mm_mul_ps(x, two);
+      __m128 y2 = _mm_mul_ps(y, two);
+      __m128 z2 = _mm_mul_ps(z, two);
+      __m128 xx = _mm_mul_ps(x, x2);
+      __m128 yy = _mm_mul_ps(y, y2);
+      __m128 zz = _mm_mul_ps(z, z2);
+      __m128 xy = _mm_mul_ps(x, y2);
+      __m128 xz = _mm_mul_ps(x, z2);
+      __m128 yz = _mm_mul_ps(y, z2);
+      __m128 wx = _mm_mul_ps(w, x2);
+      __m128 wy = _mm_mul_ps(w, y2);
+      __m128 wz = _mm_mul_ps(w, z2);
+
+      float* dst = &batch.matrices[i][0][0];
+
+      store_column(
+        _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx),
+        _mm_mul_ps(_mm_add_ps(xy, wz), sx),
+        _mm_mul_ps(_mm_sub_ps(xz, wy), sx),
+        zero,
+        dst + 0
+      );
+
+      store_column(
+        _mm_mul_ps(_mm_sub_ps(xy, wz), sy),
+        _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy),
+        _mm_mul_ps(_mm_add_ps(yz, wx), sy),
+        zero,
+        dst + 4
+      );
+
+      store_column(
+        _mm_mul_ps(_mm_add_ps(xz, wy), sz),
+        _mm_mul_ps(_mm_sub_ps(yz, wx), sz),
+        _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz),
+        zero,
+        dst + 8
+      );
+
+      store_column(
+        _mm_loadu_ps(&batch.px[i]),
+        _mm_loadu_ps(&batch.py[i]),
+        _mm_loadu_ps(&batch.pz[i]),
+        one,
+        dst + 12
+      );
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  /* Splits the 8 lanes in two halves and stores them as 8 consecutive matrices. */
+  POLY_TARGET_AVX2 static inline void store_column_avx2(__m256 cx, __m256 cy, __m256 cz, __m256 cw, float* dst) {
+
+    __m128 lx = _mm256_castps256_ps128(cx);
+    __m128 ly = _mm256_castps256_ps128(cy);
+    __m128 lz = _mm256_castps256_ps128(cz);
+    __m128 lw = _mm256_castps256_ps128(cw);
+    __m128 hx = _mm256_extractf128_ps(cx, 1);
+    __m128 hy = _mm256_extractf128_ps(cy, 1);
+    __m128 hz = _mm256_extractf128_ps(cz, 1);
+    __m128 hw = _mm256_extractf128_ps(cw, 1);
+
+    _MM_TRANSPOSE4_PS(lx, ly, lz, lw);
+    _MM_TRANSPOSE4_PS(hx, hy, hz, hw);
+
+    _mm_storeu_ps(dst + 0,   lx);
+    _mm_storeu_ps(dst + 16,  ly);
+    _mm_storeu_ps(dst + 32,  lz);
+    _mm_storeu_ps(dst + 48,  lw);
+    _mm_storeu_ps(dst + 64,  hx);
+    _mm_storeu_ps(dst + 80,  hy);
+    _mm_storeu_ps(dst + 96,  hz);
+    _mm_storeu_ps(dst + 112, hw);
+  }
+
+  POLY_TARGET_AVX2 static void compose_avx2(TransformBatch& batch) {
+
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    for (size_t i = 0; i < batch.count; i += 8) {
+
+      __m256 x = _mm256_loadu_ps(&batch.qx[i]);
+      __m256 y = _mm256_loadu_ps(&batch.qy[i]);
+      __m256 z = _mm256_loadu_ps(&batch.qz[i]);
+      __m256 w = _mm256_loadu_ps(&batch.qw[i]);
+      __m256 sx = _mm256_loadu_ps(&batch.sx[i]);
+      __m256 sy = _mm256_loadu_ps(&batch.sy[i]);
+      __m256 sz = _mm256_loadu_ps(&batch.sz[i]);
+
+      __m256 x2 = _mm256_mul_ps(x, two);
+      __m256 y2 = _mm256_mul_ps(y, two);
+      __m256 z2 = _mm256_mul_ps(z, two);
+      __m256 xx = _mm256_mul_ps(x, x2);
+      __m256 xy = _mm256_mul_ps(x, y2);
+      __m256 xz = _mm256_mul_ps(x, z2);
+      __m256 yy = _mm256_mul_ps(y, y2);
+      __m256 yz = _mm256_mul_ps(y, z2);
+      __m256 zz = _mm256_mul_ps(z, z2);
+
+      /* The diagonal is (1 - a) - b; the products with w are fused into the sums of the other elements. */
+      __m256 c0x = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(one, yy), zz), sx);
+      __m256 c0y = _mm256_mul_ps(_mm256_fmadd_ps(w, z2, xy), sx);
+      __m256 c0z = _mm256_mul_ps(_mm256_fnmadd_ps(w, y2, xz), sx);
+      __m256 c1x = _mm256_mul_ps(_mm256_fnmadd_ps(w, z2, xy), sy);
+      __m256 c1y = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(one, xx), zz), sy);
+      __m256 c1z = _mm256_mul_ps(_mm256_fmadd_ps(w, x2, yz), sy);
+      __m256 c2x = _mm256_mul_ps(_mm256_fmadd_ps(w, y2, xz), sz);
+      __m256 c2y = _mm256_mul_ps(_mm256_fnmadd_ps(w, x2, yz), sz);
+      __m256 c2z = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(one, xx), yy), sz);
+
+      float* dst = &batch.matrices[i][0][0];
+
+      store_column_avx2(c0x, c0y, c0z, zero, dst + 0);
+      store_column_avx2(c1x, c1y, c1z, zero, dst + 4);
+      store_column_avx2(c2x, c2y, c2z, zero, dst + 8);
+      store_column_avx2(
+        _mm256_loadu_ps(&batch.px[i]),
+        _mm256_loadu_ps(&batch.py[i]),
+        _mm256_loadu_ps(&batch.pz[i]),
+        one,
+        dst + 12
+      );
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  static bool cpu_has_avx2() {
+
+#if defined(_MSC_VER)
+    int info[4] = { 0 };
+
+    __cpuid(info, 1);
+
+    /* FMA, OSXSAVE and AVX. */
+    if ((info[2] & (1 << 12)) == 0
+        || (info[2] & (1 << 27)) == 0
+        || (info[2] & (1 << 28)) == 0)
+      {
+        return false;
+      }
+
+    /* The OS saves the YMM registers. */
+    if ((_xgetbv(0) & 0x6) != 0x6) {
+      return false;
+    }
+
+    __cpuidex(info, 7, 0);
+
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+  }
+
+#endif /* POLY_TRANSFORM_X86 */
+
+  /* -------------------------------------------- */
+
+} /* namespace poly */
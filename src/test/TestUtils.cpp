@@ -0,0 +1,274 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "TestUtils.h"
+
+/* -------------------------------------------- */
+
+TestArgs::TestArgs(int argc, char* argv[])
+  :has_error(false)
+{
+  program = (argc > 0) ? argv[0] : "test";
+
+  for (int i = 1; i < argc; ++i) {
+    args.push_back(argv[i]);
+    is_used.push_back(false);
+  }
+}
+
+bool TestArgs::has(const char* flag) {
+
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (args[i] == flag) {
+      is_used[i] = true;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool TestArgs::get(const char* name, std::string& value) {
+
+  const char* str = find(name);
+
+  if (nullptr == str) {
+    return false;
+  }
+
+  value = str;
+
+  return true;
+}
+
+bool TestArgs::get(const char* name, uint32_t& value) {
+
+  std::vector<uint64_t> values;
+
+  if (false == get_list(name, values, UINT32_MAX)) {
+    return false;
+  }
+
+  if (1 != values.size()) {
+    printf("Error: `%s` takes one number.\n", name);
+    has_error = true;
+    return false;
+  }
+
+  value = uint32_t(values[0]);
+
+  return true;
+}
+
+bool TestArgs::get(const char* name, uint64_t& value) {
+
+  std::vector<uint64_t> values;
+
+  if (false == get_list(name, values, UINT64_MAX)) {
+    return false;
+  }
+
+  if (1 != values.size()) {
+    printf("Error: `%s` takes one number.\n", name);
+    has_error = true;
+    return false;
+  }
+
+  value = values[0];
+
+  return true;
+}
+
+bool TestArgs::get(const char* name, float& value) {
+
+  const char* str = find(name);
+  char* end = nullptr;
+
+  if (nullptr == str) {
+    return false;
+  }
+
+  value = strtof(str, &end);
+
+  if (end == str
+      || '\0' != *end)
+    {
+      printf("Error: `%s%s` is not a number.\n", name, str);
+      has_error = true;
+      return false;
+    }
+
+  return true;
+}
+
+bool TestArgs::get(const char* name, std::vector<std::string>& values) {
+
+  const char* str = find(name);
+
+  if (nullptr == str) {
+    return false;
+  }
+
+  values.clear();
+
+  while ('\0' != *str) {
+
+    const char* end = strchr(str, ',');
+
+    if (nullptr == end) {
+      values.push_back(str);
+      break;
+    }
+
+    if (end != str) {
+      values.push_back(std::string(str, end - str));
+    }
+
+    str = end + 1;
+  }
+
+  return true;
+}
+
+bool TestArgs::get(const char* name, std::vector<uint32_t>& values) {
+
+  std::vector<uint64_t> list;
+
+  if (false == get_list(name, list, UINT32_MAX)) {
+    return false;
+  }
+
+  values.assign(list.begin(), list.end());
+
+  return true;
+}
+
+bool TestArgs::get(const char* name, std::vector<uint64_t>& values) {
+  return get_list(name, values, UINT64_MAX);
+}
+
+int TestArgs::check(const char* usage) {
+
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (false == is_used[i]) {
+      printf("Error: unknown argument `%s`.\n", args[i].c_str());
+      has_error = true;
+    }
+  }
+
+  if (true == has_error) {
+    printf("Usage: %s %s\n", program.c_str(), usage);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+const char* TestArgs::find(const char* name) {
+
+  size_t len = strlen(name);
+
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (0 == strncmp(args[i].c_str(), name, len)) {
+      is_used[i] = true;
+      return args[i].c_str() + len;
+    }
+  }
+
+  return nullptr;
+}
+
+/* Every value must be a number; `--cores=1,x` or `--cores=` is an error and not an empty list. */
+bool TestArgs::get_list(const char* name, std::vector<uint64_t>& values, uint64_t max_value) {
+
+  const char* str = find(name);
+  std::vector<uint64_t> result;
+
+  if (nullptr == str) {
+    return false;
+  }
+
+  for (const char* s = str; ; ) {
+
+    char* end = nullptr;
+    unsigned long long value = 0;
+
+    if (0 == isdigit((unsigned char)*s)) {
+      printf("Error: `%s%s` is not a number or a comma separated list of numbers.\n", name, str);
+      has_error = true;
+      return false;
+    }
+
+    value = strtoull(s, &end, 10);
+
+    if (value > max_value
+        || (',' != *end && '\0' != *end))
+      {
+        printf("Error: `%s%s` is not a number or a comma separated list of numbers.\n", name, str);
+        has_error = true;
+        return false;
+      }
+
+    result.push_back(uint64_t(value));
+
+    if ('\0' == *end) {
+      break;
+    }
+
+    s = end + 1;
+  }
+
+  values = result;
+
+  return true;
+}
+
+/* -------------------------------------------- */
+
+FILE* test_open_output(const std::string& filepath) {
+
+  if (true == filepath.empty()) {
+    return stdout;
+  }
+
+  FILE* fp = fopen(filepath.c_str(), "w");
+  if (nullptr == fp) {
+    printf("Error: failed to open `%s`.\n", filepath.c_str());
+    return nullptr;
+  }
+
+  return fp;
+}
+
+void test_close_output(FILE* fp) {
+
+  if (nullptr == fp
+      || stdout == fp)
+    {
+      return;
+    }
+
+  fclose(fp);
+}
+
+void test_write_stats_json(FILE* fp, poly::RollingStats& stats) {
+  fprintf(fp, "{ \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"min\": %.3f, \"max\": %.3f }",
+          stats.percentile(50.0),
+          stats.percentile(95.0),
+          stats.percentile(99.0),
+          stats.min(),
+          stats.max());
+}
+
+void test_check(bool is_ok, const char* what, uint32_t& num_failed) {
+
+  printf("%s: %s\n", (true == is_ok) ? "ok    " : "FAILED", what);
+
+  if (false == is_ok) {
+    num_failed++;
+  }
+}
+
+/* -------------------------------------------- */
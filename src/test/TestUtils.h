@@ -0,0 +1,99 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  TEST UTILS
+  ==========
+
+  GENERAL INFO:
+
+    What the tests and benchmarks in this directory share: the
+    parsing of the command line, writing the results either into
+    the `--output=` file or to stdout, and the checks that make a
+    test return non-zero.
+
+    `TestArgs` parses arguments of the form `--name=value` and
+    `--flag`; lists are comma separated, e.g. `--sizes=1,16,128`.
+    A list replaces the default values of the test. `check()`
+    prints the usage and returns < 0 when an argument wasn't
+    asked for by the test or couldn't be parsed, so pass the
+    usage of every argument you `get()`.
+
+  USAGE:
+
+    TestArgs args(argc, argv);
+    args.get("--runs=", num_runs);
+    args.get("--sizes=", sizes_mb);
+    args.get("--output=", output);
+    evict = (false == args.has("--warm"));
+
+    if (0 != args.check("[--runs=3] [--sizes=1,16] [--warm] [--output=results.json]")) {
+      exit(EXIT_FAILURE);
+    }
+
+    FILE* fp = test_open_output(output);
+    fprintf(fp, "{ \"load_ms\": ");
+    test_write_stats_json(fp, load_ms);
+    fprintf(fp, " }\n");
+    test_close_output(fp);
+
+ */
+
+#ifndef POLY_TEST_UTILS_H
+#define POLY_TEST_UTILS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <poly/Stats.h>
+#include <poly/Json.h>
+
+/* -------------------------------------------- */
+
+class TestArgs {
+public:
+  TestArgs(int argc, char* argv[]);
+  bool has(const char* flag);                                     /* E.g. `--warm`; returns true when given. */
+  bool get(const char* name, std::string& value);                 /* E.g. `--dir=`; returns true when given, `value` is kept otherwise. */
+  bool get(const char* name, uint32_t& value);
+  bool get(const char* name, uint64_t& value);
+  bool get(const char* name, float& value);
+  bool get(const char* name, std::vector<std::string>& values);   /* Comma separated. */
+  bool get(const char* name, std::vector<uint32_t>& values);
+  bool get(const char* name, std::vector<uint64_t>& values);
+  int check(const char* usage);                                   /* Returns < 0 when an argument is unknown or invalid. */
+
+private:
+  const char* find(const char* name);                             /* Returns the value after `name`, or nullptr. */
+  bool get_list(const char* name, std::vector<uint64_t>& values, uint64_t max_value);
+
+private:
+  std::string program;
+  std::vector<std::string> args;
+  std::vector<bool> is_used;
+  bool has_error;
+};
+
+/* -------------------------------------------- */
+
+FILE* test_open_output(const std::string& filepath);              /* Returns stdout when `filepath` is empty, nullptr on error. */
+void test_close_output(FILE* fp);
+void test_write_stats_json(FILE* fp, poly::RollingStats& stats);  /* Writes `{ "p50": .., "p95": .., "p99": .., "min": .., "max": .. }`. */
+void test_check(bool is_ok, const char* what, uint32_t& num_failed);
+
+/* -------------------------------------------- */
+
+#endif
@@ -0,0 +1,386 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  ASSET ARCHIVE BENCHMARK
+  =======================
+
+  GENERAL INFO:
+
+    Writes `--files` synthetic asset files of `--size` bytes,
+    packs them into an archive (see `poly/AssetArchive.h`) and
+    measures how long it takes to read all of them, once as
+    loose files with `fopen()` / `fread()` and once through the
+    archive with `open()`, `prefault()` and a `get()` per name.
+    Before every run we evict the files and the archive from the
+    page cache (unless `--warm` is given) so we measure a cold
+    start. The results are printed as JSON.
+
+    The files contain a repeating pattern with some noise so
+    `--compress` has something to work with, like vertex data.
+
+  USAGE:
+
+    ./test-asset-archive --files=1000 --size=65536 --runs=3 --dir=/tmp --output=archive.json
+    ./test-asset-archive --files=1000 --size=65536 --compress
+
+  IMPORTANT:
+
+    Evicting pages uses `posix_fadvise()`, which only works on
+    Linux; elsewhere use `--warm` or drop the caches by hand.
+    On a fast SSD the difference is small; run it on the disk
+    you ship to.
+
+ */
+
+#if defined(__linux)
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <poly/AssetArchive.h>
+#include <poly/Stats.h>
+#include "TestUtils.h"
+
+/* -------------------------------------------- */
+
+struct ArchiveResult {
+  std::string method;
+  poly::RollingStats load_ms;
+  uint64_t num_bytes;           /* On disk. */
+  uint64_t checksum;            /* Of all the data we read; must be the same for both methods. */
+};
+
+/* -------------------------------------------- */
+
+static int write_asset_files(const std::string& dir, uint32_t num_files, uint32_t file_size, std::vector<poly::AssetArchiveInput>& inputs);
+static int load_loose(const std::vector<poly::AssetArchiveInput>& inputs, uint64_t& checksum);
+static int load_archive(const std::string& filepath, const std::vector<poly::AssetArchiveInput>& inputs, uint64_t& checksum);
+static uint64_t get_checksum(const uint8_t* data, size_t size);
+static uint64_t get_file_size(const std::string& filepath);
+static void evict_file(const std::string& filepath);
+static void print_results_json(FILE* fp, uint32_t num_files, uint32_t file_size, bool compress, std::vector<ArchiveResult>& results);
+
+/* -------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+
+  std::vector<poly::AssetArchiveInput> inputs;
+  std::vector<ArchiveResult> results;
+  std::string dir = "/tmp";
+  std::string output;
+  std::string archive_path;
+  uint32_t num_files = 1000;
+  uint32_t file_size = 65536;
+  uint32_t num_runs = 3;
+  uint32_t flags = 0;
+  bool evict = true;
+  bool keep_files = false;
+  TestArgs args(argc, argv);
+
+  args.get("--files=", num_files);
+  args.get("--size=", file_size);
+  args.get("--runs=", num_runs);
+  args.get("--dir=", dir);
+  args.get("--output=", output);
+  flags = (true == args.has("--compress")) ? ASSET_ARCHIVE_FLAG_COMPRESS : 0;
+  evict = (false == args.has("--warm"));
+  keep_files = args.has("--keep");
+
+  if (0 != args.check("[--files=1000] [--size=65536] [--runs=3] [--dir=/tmp] [--compress] [--warm] [--keep] [--output=archive.json]")) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 == num_runs
+      || 0 == num_files
+      || 0 == file_size)
+    {
+      printf("Error: we need at least one run, one file and one byte.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  /* -------------------------------------------- */
+
+  printf("Writing %u files of %u bytes into %s\n", num_files, file_size, dir.c_str());
+
+  if (0 != write_asset_files(dir, num_files, file_size, inputs)) {
+    exit(EXIT_FAILURE);
+  }
+
+  archive_path = dir + "/asset-bench.pack";
+
+  if (0 != poly::asset_archive_write(archive_path, inputs, flags)) {
+    exit(EXIT_FAILURE);
+  }
+
+  results.resize(2);
+  results[0].method = "loose";
+  results[0].num_bytes = uint64_t(num_files) * file_size;
+  results[0].checksum = 0;
+  results[1].method = "archive";
+  results[1].num_bytes = get_file_size(archive_path);
+  results[1].checksum = 0;
+
+#if defined(__linux)
+  /* The pages we just wrote are dirty and can't be evicted until they are written back. */
+  sync();
+#endif
+
+  for (uint32_t run = 0; run < num_runs; ++run) {
+
+    for (size_t i = 0; i < results.size(); ++i) {
+
+      ArchiveResult& res = results[i];
+      uint64_t checksum = 0;
+      int r = 0;
+
+      if (true == evict) {
+        for (size_t j = 0; j < inputs.size(); ++j) {
+          evict_file(inputs[j].filepath);
+        }
+        evict_file(archive_path);
+      }
+
+      auto start = std::chrono::steady_clock::now();
+
+      r = (0 == i) ? load_loose(inputs, checksum) : load_archive(archive_path, inputs, checksum);
+
+      auto end = std::chrono::steady_clock::now();
+
+      if (0 != r) {
+        exit(EXIT_FAILURE);
+      }
+
+      res.load_ms.add(std::chrono::duration<double, std::milli>(end - start).count());
+      res.checksum = checksum;
+    }
+
+    if (results[0].checksum != results[1].checksum) {
+      printf("Error: the archive returned different data than the loose files.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    printf("%-8s %10.2f KB: p50 %9.3f ms\n",
+           results[i].method.c_str(),
+           double(results[i].num_bytes) / 1024.0,
+           results[i].load_ms.percentile(50.0));
+  }
+
+  if (false == keep_files) {
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      remove(inputs[i].filepath.c_str());
+    }
+    remove(archive_path.c_str());
+  }
+
+  /* -------------------------------------------- */
+
+  FILE* fp = test_open_output(output);
+  if (nullptr == fp) {
+    exit(EXIT_FAILURE);
+  }
+
+  print_results_json(fp, num_files, file_size, (0 != flags), results);
+  test_close_output(fp);
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+static int write_asset_files(const std::string& dir, uint32_t num_files, uint32_t file_size, std::vector<poly::AssetArchiveInput>& inputs) {
+
+  std::vector<uint8_t> content(file_size);
+  uint32_t seed = 0x9e3779b9;
+
+  inputs.clear();
+
+  for (uint32_t i = 0; i < num_files; ++i) {
+
+    poly::AssetArchiveInput input;
+    FILE* fp = nullptr;
+
+    /* Slowly changing values with noise in the low bits, like positions. */
+    for (uint32_t j = 0; j < file_size; ++j) {
+      seed = seed * 1664525u + 1013904223u;
+      content[j] = (0 == (j & 3)) ? uint8_t(seed >> 28) : uint8_t((i + j / 64) & 0xFF);
+    }
+
+    input.name = "asset-" + std::to_string(i) + ".bin";
+    input.filepath = dir + "/asset-bench-" + std::to_string(i) + ".bin";
+
+    fp = fopen(input.filepath.c_str(), "wb");
+    if (nullptr == fp) {
+      printf("Error: failed to open `%s` for writing.\n", input.filepath.c_str());
+      return -1;
+    }
+
+    if (1 != fwrite(content.data(), content.size(), 1, fp)) {
+      printf("Error: failed to write `%s`.\n", input.filepath.c_str());
+      fclose(fp);
+      return -2;
+    }
+
+    fclose(fp);
+    inputs.push_back(input);
+  }
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+/* Reads every file into a buffer, the way we load loose assets. */
+static int load_loose(const std::vector<poly::AssetArchiveInput>& inputs, uint64_t& checksum) {
+
+  std::vector<uint8_t> buffer;
+
+  for (size_t i = 0; i < inputs.size(); ++i) {
+
+    FILE* fp = fopen(inputs[i].filepath.c_str(), "rb");
+    long size = 0;
+
+    if (nullptr == fp) {
+      printf("Error: failed to open `%s`.\n", inputs[i].filepath.c_str());
+      return -1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    buffer.resize(size);
+
+    if (size > 0
+        && 1 != fread(buffer.data(), size, 1, fp))
+      {
+        printf("Error: failed to read `%s`.\n", inputs[i].filepath.c_str());
+        fclose(fp);
+        return -2;
+      }
+
+    fclose(fp);
+    checksum += get_checksum(buffer.data(), buffer.size());
+  }
+
+  return 0;
+}
+
+/* Opens the archive and looks up every file by name. */
+static int load_archive(const std::string& filepath, const std::vector<poly::AssetArchiveInput>& inputs, uint64_t& checksum) {
+
+  poly::AssetArchive archive;
+
+  if (0 != archive.open(filepath)) {
+    return -1;
+  }
+
+  archive.prefault();
+
+  for (size_t i = 0; i < inputs.size(); ++i) {
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    if (0 != archive.get(inputs[i].name, &data, &size)) {
+      printf("Error: the archive has no `%s`.\n", inputs[i].name.c_str());
+      archive.close();
+      return -2;
+    }
+
+    checksum += get_checksum(data, size);
+  }
+
+  archive.close();
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+/* Makes sure we actually touch every byte. */
+static uint64_t get_checksum(const uint8_t* data, size_t size) {
+
+  uint64_t result = 0;
+
+  for (size_t i = 0; i < size; ++i) {
+    result = result * 31 + data[i];
+  }
+
+  return result;
+}
+
+static uint64_t get_file_size(const std::string& filepath) {
+
+  FILE* fp = fopen(filepath.c_str(), "rb");
+  uint64_t result = 0;
+
+  if (nullptr == fp) {
+    return 0;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  result = (uint64_t)ftell(fp);
+  fclose(fp);
+
+  return result;
+}
+
+/* Drops the (clean) pages of the file from the page cache. */
+static void evict_file(const std::string& filepath) {
+
+#if defined(__linux)
+  int fd = open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+#endif
+}
+
+/* -------------------------------------------- */
+
+static void print_results_json(FILE* fp, uint32_t num_files, uint32_t file_size, bool compress, std::vector<ArchiveResult>& results) {
+
+  fprintf(fp, "{\n  \"files\": %u,\n  \"file_size\": %u,\n  \"compress\": %s,\n  \"results\": [\n",
+          num_files,
+          file_size,
+          (true == compress) ? "true" : "false");
+
+  for (size_t i = 0; i < results.size(); ++i) {
+
+    ArchiveResult& res = results[i];
+
+    fprintf(fp, "    { \"method\": ");
+    poly::json_write_string(fp, res.method.c_str());
+    fprintf(fp, ", \"bytes\": %llu, \"load_ms\": ", (unsigned long long)res.num_bytes);
+    test_write_stats_json(fp, res.load_ms);
+    fprintf(fp, " }%s\n", (i + 1 == results.size()) ? "" : ",");
+  }
+
+  fprintf(fp, "  ]\n}\n");
+}
+
+/* -------------------------------------------- */
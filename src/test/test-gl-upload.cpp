@@ -0,0 +1,328 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  GL UPLOAD BENCHMARK
+  ===================
+
+  GENERAL INFO:
+
+    Runs a clear and swap loop (without vsync) in a hidden
+    window and meanwhile uploads `--textures` RGBA8 textures of
+    `--size` x `--size`, `--per-frame` per frame. With
+    `--mode=main` we call `glTexImage2D()` in the loop, like the
+    host used to do; with `--mode=worker` we hand them to
+    `poly/GlUploader.h`, which uploads them on its own context.
+    We print the percentiles of the frame times and the time
+    until all textures were ready as JSON.
+
+      ./test-gl-upload --mode=main
+      ./test-gl-upload --mode=worker
+
+    In the main mode a texture is ready when the fence that we
+    insert after the uploads of the frame was signaled, so both
+    modes measure the same.
+
+  USAGE:
+
+    ./test-gl-upload --mode=worker --textures=64 --size=1024 --per-frame=4 --frames=300 --output=upload.json
+
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <poly/GlUploader.h>
+#include <poly/Stats.h>
+
+/* -------------------------------------------- */
+
+struct UploadBench {
+  std::vector<uint32_t> textures;
+  uint32_t num_ready;
+  uint32_t num_failed;
+};
+
+/* -------------------------------------------- */
+
+static void error_callback(int err, const char* desc);
+static void on_uploaded(poly::GlUpload* upload, void* user);
+static void print_stats_json(FILE* fp, const char* name, poly::RollingStats& stats, bool is_last);
+
+/* -------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+
+  std::string mode = "worker";
+  std::string output;
+  uint32_t num_textures = 64;
+  uint32_t tex_size = 1024;
+  uint32_t per_frame = 4;
+  uint32_t num_frames = 300;
+
+  for (int i = 1; i < argc; ++i) {
+    if (0 == strncmp(argv[i], "--mode=", 7)) {
+      mode = argv[i] + 7;
+    }
+    else if (0 == strncmp(argv[i], "--textures=", 11)) {
+      num_textures = (uint32_t)atoi(argv[i] + 11);
+    }
+    else if (0 == strncmp(argv[i], "--size=", 7)) {
+      tex_size = (uint32_t)atoi(argv[i] + 7);
+    }
+    else if (0 == strncmp(argv[i], "--per-frame=", 12)) {
+      per_frame = (uint32_t)atoi(argv[i] + 12);
+    }
+    else if (0 == strncmp(argv[i], "--frames=", 9)) {
+      num_frames = (uint32_t)atoi(argv[i] + 9);
+    }
+    else if (0 == strncmp(argv[i], "--output=", 9)) {
+      output = argv[i] + 9;
+    }
+    else {
+      printf("Usage: %s [--mode=main|worker] [--textures=64] [--size=1024] [--per-frame=4] [--frames=300] [--output=upload.json]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if ("main" != mode
+      && "worker" != mode)
+    {
+      printf("Error: the mode must be `main` or `worker`.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  if (0 == num_textures
+      || 0 == tex_size
+      || 0 == per_frame
+      || 0 == num_frames)
+    {
+      printf("Error: we need at least one texture, a size, one upload per frame and one frame.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  /* -------------------------------------------- */
+
+  glfwSetErrorCallback(error_callback);
+
+  if (!glfwInit()) {
+    printf("Error: cannot setup glfw.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  glfwWindowHint(GLFW_SAMPLES, 0);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_FALSE);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+  GLFWwindow* win = glfwCreateWindow(256, 256, "GL Upload Benchmark", NULL, NULL);
+  if (!win) {
+    glfwTerminate();
+    exit(EXIT_FAILURE);
+  }
+
+  glfwMakeContextCurrent(win);
+  glfwSwapInterval(0);
+
+  if (!gladLoadGL()) {
+    printf("Cannot load GL.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* -------------------------------------------- */
+
+  /* All uploads use the same pixels; they stay valid until the end. */
+  std::vector<uint8_t> pixels(size_t(tex_size) * tex_size * 4);
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    pixels[i] = uint8_t(i * 31);
+  }
+
+  poly::GlUploader uploader;
+  UploadBench bench;
+  bench.num_ready = 0;
+  bench.num_failed = 0;
+
+  if ("worker" == mode
+      && 0 != uploader.init(win))
+    {
+      exit(EXIT_FAILURE);
+    }
+
+  poly::RollingStats frame_ms(num_frames);
+  std::vector<GLsync> fences;
+  std::vector<uint32_t> fence_counts;
+  uint32_t num_requested = 0;
+  double ready_ms = -1.0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < num_frames; ++i) {
+
+    auto frame_start = std::chrono::steady_clock::now();
+
+    /* Request the uploads of this frame. */
+    uint32_t count = 0;
+    while (num_requested < num_textures
+           && count < per_frame)
+      {
+        if ("worker" == mode) {
+          uploader.upload_texture(tex_size, tex_size, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data(), false, on_uploaded, &bench);
+        }
+        else {
+          uint32_t tex = 0;
+          glGenTextures(1, &tex);
+          glBindTexture(GL_TEXTURE_2D, tex);
+          glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+          glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, tex_size, tex_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+          bench.textures.push_back(tex);
+        }
+        count++;
+        num_requested++;
+      }
+
+    if ("main" == mode
+        && count > 0)
+      {
+        fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+        fence_counts.push_back(count);
+      }
+
+    /* Check which uploads are ready. */
+    if ("worker" == mode) {
+      uploader.update();
+    }
+    else {
+      while (false == fences.empty()
+             && GL_TIMEOUT_EXPIRED != glClientWaitSync(fences.front(), 0, 0))
+        {
+          glDeleteSync(fences.front());
+          bench.num_ready += fence_counts.front();
+          fences.erase(fences.begin());
+          fence_counts.erase(fence_counts.begin());
+        }
+    }
+
+    if (ready_ms < 0.0
+        && num_textures == bench.num_ready + bench.num_failed)
+      {
+        ready_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      }
+
+    /* The work of the composite loop. */
+    float t = float(i % 60) / 60.0f;
+    glClearColor(t, 0.2f, 1.0f - t, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glfwSwapBuffers(win);
+    glfwPollEvents();
+
+    frame_ms.add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
+  }
+
+  printf("%s: frame p50 %.3f ms, p99 %.3f ms, max %.3f ms; %u of %u textures ready after %.3f ms.\n",
+         mode.c_str(),
+         frame_ms.percentile(50.0),
+         frame_ms.percentile(99.0),
+         frame_ms.max(),
+         bench.num_ready,
+         num_textures,
+         ready_ms);
+
+  /* -------------------------------------------- */
+
+  FILE* fp = stdout;
+
+  if (false == output.empty()) {
+    fp = fopen(output.c_str(), "w");
+    if (nullptr == fp) {
+      printf("Error: failed to open `%s`.\n", output.c_str());
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"mode\": \"%s\",\n", mode.c_str());
+  fprintf(fp, "  \"textures\": %u,\n", num_textures);
+  fprintf(fp, "  \"size\": %u,\n", tex_size);
+  fprintf(fp, "  \"per_frame\": %u,\n", per_frame);
+  fprintf(fp, "  \"frames\": %u,\n", num_frames);
+  fprintf(fp, "  \"ready\": %u,\n", bench.num_ready);
+  fprintf(fp, "  \"failed\": %u,\n", bench.num_failed);
+  fprintf(fp, "  \"all_ready_ms\": %.3f,\n", ready_ms);
+  print_stats_json(fp, "frame_ms", frame_ms, true);
+  fprintf(fp, "}\n");
+
+  if (stdout != fp) {
+    fclose(fp);
+  }
+
+  /* -------------------------------------------- */
+
+  if ("worker" == mode) {
+    uploader.shutdown();
+  }
+
+  for (size_t i = 0; i < fences.size(); ++i) {
+    glDeleteSync(fences[i]);
+  }
+
+  if (false == bench.textures.empty()) {
+    glDeleteTextures(GLsizei(bench.textures.size()), bench.textures.data());
+  }
+
+  glfwDestroyWindow(win);
+  glfwTerminate();
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+static void error_callback(int err, const char* desc) {
+  printf("GLFW error: %s (%d)\n", desc, err);
+}
+
+/* Called from `GlUploader::update()` on the main thread. */
+static void on_uploaded(poly::GlUpload* upload, void* user) {
+
+  UploadBench* bench = static_cast<UploadBench*>(user);
+
+  if (GL_UPLOAD_STATE_READY == upload->state) {
+    bench->textures.push_back(upload->id);
+    bench->num_ready++;
+  }
+  else {
+    bench->num_failed++;
+  }
+}
+
+static void print_stats_json(FILE* fp, const char* name, poly::RollingStats& stats, bool is_last) {
+  fprintf(fp, "  \"%s\": { \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f }%s\n",
+         name,
+         stats.percentile(50.0),
+         stats.percentile(95.0),
+         stats.percentile(99.0),
+         stats.max(),
+         (true == is_last) ? "" : ",");
+}
+
+/* -------------------------------------------- */
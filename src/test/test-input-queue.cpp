@@ -0,0 +1,265 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  INPUT QUEUE TEST
+  ================
+
+  GENERAL INFO:
+
+    Stress test of `poly::InputQueue`: a producer thread pushes
+    `--events` cursor, scroll and button events as fast as it
+    can while the main thread drains them, so pushes, merges and
+    drains interleave in every possible way. We check that:
+
+      - a drain never returns more than the capacity of the ring,
+        i.e. the tail never passes the head;
+      - every event we read is one that was pushed: cursor
+        positions only increase, every scroll offset equals the
+        number of merged scroll events and buttons arrive in
+        order without gaps;
+      - no event is lost: every pushed event was either read
+        (directly or merged) or counted as dropped.
+
+    Returns non-zero when one of the checks fails.
+
+  USAGE:
+
+    ./test-input-queue --events=10000000
+
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <poly/InputQueue.h>
+#include "TestUtils.h"
+
+/* -------------------------------------------- */
+
+#define DRAIN_MAX_EVENTS (INPUT_QUEUE_CAPACITY * 4)  /* More than fits, so a tail that passes the head shows up. */
+
+/* -------------------------------------------- */
+
+struct ProducerCounts {
+  uint64_t num_pushed[INPUT_EVENT_CHAR + 1];
+  uint64_t num_dropped[INPUT_EVENT_CHAR + 1];
+};
+
+struct ConsumerCounts {
+  uint64_t num_read;                             /* Device events, i.e. including the merged ones. */
+  uint64_t num_buttons;
+  double scroll_sum;
+  double last_cursor_x;
+  int32_t last_button;
+  uint64_t num_errors;
+};
+
+/* -------------------------------------------- */
+
+static void produce(poly::InputQueue* queue, uint64_t num_events, ProducerCounts* counts, std::atomic<bool>* is_done);
+static void consume(const poly::InputEvent* events, uint32_t count, ConsumerCounts& counts);
+
+/* -------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+
+  uint64_t num_events = 10000000;
+  uint32_t num_failed = 0;
+  uint64_t num_too_many = 0;
+  uint64_t num_drains = 0;
+  std::atomic<bool> is_done(false);
+  std::vector<poly::InputEvent> events(DRAIN_MAX_EVENTS);
+  poly::InputQueue* queue = new poly::InputQueue();
+  ProducerCounts produced = {};
+  ConsumerCounts consumed = {};
+  TestArgs args(argc, argv);
+
+  args.get("--events=", num_events);
+
+  if (0 != args.check("[--events=10000000]")) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 == num_events) {
+    printf("Error: we need at least one event.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  consumed.last_cursor_x = -1.0;
+  consumed.last_button = -1;
+
+  /* -------------------------------------------- */
+
+  std::thread producer(produce, queue, num_events, &produced, &is_done);
+
+  /* Drain until the producer is done and the ring is empty. */
+  while (true) {
+
+    bool was_done = is_done.load(std::memory_order_acquire);
+    uint32_t count = queue->drain(events.data(), DRAIN_MAX_EVENTS);
+
+    num_drains++;
+
+    if (count > INPUT_QUEUE_CAPACITY) {
+      num_too_many++;
+      count = INPUT_QUEUE_CAPACITY;
+    }
+
+    consume(events.data(), count, consumed);
+
+    if (true == was_done
+        && 0 == count)
+      {
+        break;
+      }
+  }
+
+  producer.join();
+
+  /* -------------------------------------------- */
+
+  uint64_t num_pushed = 0;
+  uint64_t num_dropped = 0;
+
+  for (uint32_t i = 0; i <= INPUT_EVENT_CHAR; ++i) {
+    num_pushed += produced.num_pushed[i];
+    num_dropped += produced.num_dropped[i];
+  }
+
+  printf("Pushed %llu events, read %llu in %llu drains, %llu merged, %llu dropped.\n",
+         (unsigned long long) num_pushed,
+         (unsigned long long) consumed.num_read,
+         (unsigned long long) num_drains,
+         (unsigned long long) queue->get_num_merged(),
+         (unsigned long long) num_dropped);
+
+  test_check(0 == num_too_many, "a drain never returns more than the capacity (the tail never passes the head)", num_failed);
+  test_check(0 == consumed.num_errors, "every event we read was pushed", num_failed);
+  test_check(num_dropped == queue->get_num_dropped(), "the queue counts every dropped event", num_failed);
+  test_check(num_pushed == consumed.num_read + num_dropped, "every event was read or dropped", num_failed);
+  test_check(produced.num_pushed[INPUT_EVENT_BUTTON] - produced.num_dropped[INPUT_EVENT_BUTTON] == consumed.num_buttons, "no button event was lost", num_failed);
+  test_check(double(produced.num_pushed[INPUT_EVENT_SCROLL] - produced.num_dropped[INPUT_EVENT_SCROLL]) == consumed.scroll_sum, "no scroll offset was lost", num_failed);
+
+  delete queue;
+  queue = nullptr;
+
+  if (0 != num_failed) {
+    printf("Error: %u checks failed.\n", num_failed);
+    return EXIT_FAILURE;
+  }
+
+  printf("All checks passed.\n");
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+/*
+  Mostly cursor events with runs of scroll events and a button
+  every 64 events, so both kinds of merges happen and get
+  interrupted. Cursor positions and button codes count up.
+*/
+static void produce(poly::InputQueue* queue, uint64_t num_events, ProducerCounts* counts, std::atomic<bool>* is_done) {
+
+  int32_t button = 0;
+
+  for (uint64_t i = 0; i < num_events; ++i) {
+
+    poly::InputEvent ev = {};
+
+    if (0 == (i % 64)) {
+      ev.type = INPUT_EVENT_BUTTON;
+      ev.button = button;
+    }
+    else if (0 == ((i / 16) % 4)) {
+      ev.type = INPUT_EVENT_SCROLL;
+      ev.x = 1.0;
+    }
+    else {
+      ev.type = INPUT_EVENT_CURSOR;
+      ev.x = double(i);
+    }
+
+    counts->num_pushed[ev.type]++;
+
+    if (false == queue->push(ev)) {
+      counts->num_dropped[ev.type]++;
+      continue;
+    }
+
+    if (INPUT_EVENT_BUTTON == ev.type) {
+      button++;
+    }
+  }
+
+  is_done->store(true, std::memory_order_release);
+}
+
+static void consume(const poly::InputEvent* events, uint32_t count, ConsumerCounts& counts) {
+
+  for (uint32_t i = 0; i < count; ++i) {
+
+    const poly::InputEvent& ev = events[i];
+
+    if (0 == ev.num_merged) {
+      counts.num_errors++;
+      continue;
+    }
+
+    counts.num_read += ev.num_merged;
+
+    switch (ev.type) {
+
+      case INPUT_EVENT_CURSOR: {
+        if (ev.x <= counts.last_cursor_x) {
+          counts.num_errors++;
+        }
+        counts.last_cursor_x = ev.x;
+        break;
+      }
+
+      case INPUT_EVENT_SCROLL: {
+        if (double(ev.num_merged) != ev.x) {
+          counts.num_errors++;
+        }
+        counts.scroll_sum += ev.x;
+        break;
+      }
+
+      case INPUT_EVENT_BUTTON: {
+        if (ev.button != counts.last_button + 1
+            || 1 != ev.num_merged)
+          {
+            counts.num_errors++;
+          }
+        counts.last_button = ev.button;
+        counts.num_buttons++;
+        break;
+      }
+
+      default: {
+        counts.num_errors++;
+        break;
+      }
+    }
+  }
+}
+
+/* -------------------------------------------- */
@@ -0,0 +1,209 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MESH CACHE TEST
+  ===============
+
+  GENERAL INFO:
+
+    Checks that `poly::MeshCache::get()` loads a mesh only once:
+    we acquire the same path twice, a copy of the file under
+    another path and create two instances, and check that they
+    all share one entry with the same buffers and material
+    instances and that the reference count follows every acquire
+    and release. Finally we release everything, set the budget
+    to 0 and check that the entry was evicted.
+
+    We use the NOOP backend, so this runs without a display.
+    Returns non-zero when one of the checks fails.
+
+  USAGE:
+
+    ./test-mesh-cache --input=monkey.filamesh --dir=/tmp
+
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <filament/Engine.h>
+#include <filament/Material.h>
+#include <filameshio/MeshReader.h>
+#include <utils/Entity.h>
+#include <poly/MeshCache.h>
+#include "TestUtils.h"
+
+/* -------------------------------------------- */
+
+static int copy_file(const std::string& from, const std::string& to);
+
+/* -------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+
+  std::string input = "monkey.filamesh";
+  std::string dir = "/tmp";
+  std::string copy_path;
+  uint32_t num_failed = 0;
+  TestArgs args(argc, argv);
+
+  args.get("--input=", input);
+  args.get("--dir=", dir);
+
+  if (0 != args.check("[--input=monkey.filamesh] [--dir=/tmp]")) {
+    exit(EXIT_FAILURE);
+  }
+
+  copy_path = dir + "/test-mesh-cache-copy.filamesh";
+
+  if (0 != copy_file(input, copy_path)) {
+    exit(EXIT_FAILURE);
+  }
+
+  /* -------------------------------------------- */
+
+  filament::Engine* engine = filament::Engine::create(filament::backend::Backend::NOOP);
+  if (nullptr == engine) {
+    printf("Error: failed to create the engine.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  filamesh::MeshReader::MaterialRegistry registry;
+  poly::MeshCache& cache = poly::MeshCache::get();
+
+  if (0 != cache.init(engine, &registry)) {
+    exit(EXIT_FAILURE);
+  }
+
+  /* The same path twice. */
+  poly::MeshCacheEntry* first = cache.acquire(input);
+  poly::MeshCacheEntry* second = cache.acquire(input);
+
+  if (nullptr == first
+      || nullptr == second)
+    {
+      printf("Error: failed to acquire `%s`.\n", input.c_str());
+      exit(EXIT_FAILURE);
+    }
+
+  test_check(first == second, "the same path shares the entry", num_failed);
+  test_check(first->vb == second->vb && first->ib == second->ib, "the same path shares the buffers", num_failed);
+  test_check(false == first->materials.empty() && engine->getDefaultMaterial()->getDefaultInstance() != first->materials[0], "unregistered materials get an instance of the cache", num_failed);
+  test_check(2 == first->refcount, "two acquires give a reference count of 2", num_failed);
+  test_check(1 == cache.get_num_entries(), "the cache has one entry", num_failed);
+
+  /* Another path with the same contents. */
+  poly::MeshCacheEntry* copy = cache.acquire(copy_path);
+
+  test_check(first == copy, "a copy of the file shares the entry", num_failed);
+  test_check(3 == first->refcount, "a copy increments the reference count", num_failed);
+  test_check(1 == cache.get_num_entries(), "a copy doesn't add an entry", num_failed);
+
+  /* Instances. */
+  utils::Entity a = cache.create_instance(input);
+  utils::Entity b = cache.create_instance(copy_path);
+
+  test_check(false == a.isNull() && false == b.isNull(), "instances can be created", num_failed);
+  test_check(first == cache.get_instance_entry(a) && first == cache.get_instance_entry(b), "instances use the shared entry", num_failed);
+  test_check(5 == first->refcount, "instances increment the reference count", num_failed);
+
+  cache.print();
+
+  /* Release everything; unreferenced entries stay until they're over the budget. */
+  cache.destroy_instance(a);
+  cache.destroy_instance(b);
+  test_check(3 == first->refcount, "destroying the instances decrements the reference count", num_failed);
+
+  cache.release(copy);
+  cache.release(second);
+  test_check(1 == first->refcount, "releasing decrements the reference count", num_failed);
+
+  cache.set_budget(0);
+  test_check(1 == cache.get_num_entries(), "a referenced entry is not evicted", num_failed);
+
+  cache.release(first);
+  test_check(0 == cache.get_num_entries(), "an unreferenced entry over the budget is evicted", num_failed);
+
+  /* -------------------------------------------- */
+
+  cache.shutdown();
+  filament::Engine::destroy(&engine);
+  remove(copy_path.c_str());
+
+  if (0 != num_failed) {
+    printf("Error: %u checks failed.\n", num_failed);
+    return EXIT_FAILURE;
+  }
+
+  printf("All checks passed.\n");
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+static int copy_file(const std::string& from, const std::string& to) {
+
+  std::vector<uint8_t> data;
+  FILE* fp = nullptr;
+  long size = 0;
+  bool is_ok = true;
+
+  fp = fopen(from.c_str(), "rb");
+  if (nullptr == fp) {
+    printf("Error: failed to open `%s`.\n", from.c_str());
+    return -1;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  if (size > 0) {
+    data.resize(size_t(size));
+    is_ok = 1 == fread(data.data(), data.size(), 1, fp);
+  }
+
+  fclose(fp);
+
+  if (false == is_ok
+      || true == data.empty())
+    {
+      printf("Error: failed to read `%s`.\n", from.c_str());
+      return -2;
+    }
+
+  fp = fopen(to.c_str(), "wb");
+  if (nullptr == fp) {
+    printf("Error: failed to open `%s` for writing.\n", to.c_str());
+    return -3;
+  }
+
+  is_ok = 1 == fwrite(data.data(), data.size(), 1, fp);
+
+  if (0 != fclose(fp)
+      || false == is_ok)
+    {
+      printf("Error: failed to write `%s`.\n", to.c_str());
+      return -4;
+    }
+
+  return 0;
+}
+
+/* -------------------------------------------- */
@@ -0,0 +1,499 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MESH LOADING BENCHMARK
+  ======================
+
+  GENERAL INFO:
+
+    Compares `filamesh::MeshReader::loadMeshFromFile()`, which
+    reads the file into the heap, with `poly::mesh_load_mapped()`,
+    which maps the file and passes the vertex and index regions
+    directly to Filament. We write synthetic meshes (a grid with
+    the same attribute layout as `monkey.filamesh`) of the given
+    sizes, load each of them a couple of times with both loaders
+    and print the load time and the peak resident set size as
+    JSON.
+
+    The load time includes `Engine::flushAndWait()`, so the data
+    has been handed to the backend and the release callbacks have
+    been called. Before every run we evict the file from the page
+    cache (unless `--warm` is given) so we measure a cold load.
+
+    By default we create the engine with the OpenGL backend, so
+    the driver copies the vertex and index data into GL buffers
+    and every page of the mapped file is read; this needs a
+    display (e.g. run it with `xvfb-run`). With `--backend=noop`
+    nothing reads the buffers, so a mapped load would never
+    touch the file. In that case we prefault a mapping of the
+    file ourselves before we stop the timer, which costs the
+    same page faults and resident pages as the copy of a driver.
+
+  USAGE:
+
+    ./test-mesh-loading --sizes=1,16,128,1024 --runs=3 --dir=/tmp --output=loading.json
+
+  IMPORTANT:
+
+    The peak RSS is read from `/proc/self/status` and reset by
+    writing to `/proc/self/clear_refs`, which only works on Linux.
+    Pages of the mapped file that we touched count as resident
+    too, but they belong to the page cache and can be dropped by
+    the kernel at any time; heap pages can not.
+
+ */
+
+#if defined(__linux)
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <filament/Engine.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <filameshio/MeshReader.h>
+#include <utils/Path.h>
+#include <utils/EntityManager.h>
+#include <poly/Filamesh.h>
+#include <poly/MeshLoader.h>
+#include <poly/MappedFile.h>
+#include <poly/Stats.h>
+#include "TestUtils.h"
+
+/* -------------------------------------------- */
+
+#define LOADER_HEAP 0
+#define LOADER_MAPPED 1
+#define GRID_COLUMNS 1024
+
+/* -------------------------------------------- */
+
+struct LoadResult {
+  std::string loader;
+  uint64_t file_size;
+  poly::RollingStats load_ms;
+  int64_t peak_rss_kb;          /* Largest growth of the peak RSS over all runs. */
+};
+
+/* -------------------------------------------- */
+
+static int write_synthetic_mesh(const std::string& filepath, uint64_t target_size);
+static int run_loader(filament::Engine* engine, filament::backend::Backend backend, int loader, const std::string& filepath, bool evict, double& load_ms, int64_t& peak_rss_kb);
+static void evict_file(const std::string& filepath);
+static void reset_peak_rss();
+static int64_t read_status_kb(const char* field);
+static void print_results_json(FILE* fp, std::vector<LoadResult>& results);
+
+/* -------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+
+  std::vector<uint64_t> sizes_mb = { 1, 16, 128, 1024 };
+  filament::backend::Backend backend = filament::backend::Backend::OPENGL;
+  std::string dir = "/tmp";
+  std::string output;
+  uint32_t num_runs = 3;
+  bool evict = true;
+  std::string backend_name = "opengl";
+  bool keep_files = false;
+  TestArgs args(argc, argv);
+
+  args.get("--sizes=", sizes_mb);
+  args.get("--runs=", num_runs);
+  args.get("--dir=", dir);
+  args.get("--output=", output);
+  args.get("--backend=", backend_name);
+  evict = (false == args.has("--warm"));
+  keep_files = args.has("--keep");
+
+  if (0 != args.check("[--sizes=1,16,128,1024] [--runs=3] [--dir=/tmp] [--backend=opengl|noop] [--warm] [--keep] [--output=loading.json]")) {
+    exit(EXIT_FAILURE);
+  }
+
+  if ("opengl" == backend_name) {
+    backend = filament::backend::Backend::OPENGL;
+  }
+  else if ("noop" == backend_name) {
+    backend = filament::backend::Backend::NOOP;
+  }
+  else {
+    printf("Error: unknown backend `%s`, use `opengl` or `noop`.\n", backend_name.c_str());
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 == num_runs
+      || true == sizes_mb.empty())
+    {
+      printf("Error: we need at least one run and one size.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  /* -------------------------------------------- */
+
+  filament::Engine* engine = filament::Engine::create(backend);
+  if (nullptr == engine) {
+    printf("Error: failed to create the engine.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  std::vector<LoadResult> results;
+  const char* loader_names[] = { "loadMeshFromFile", "mesh_load_mapped" };
+
+  for (size_t i = 0; i < sizes_mb.size(); ++i) {
+
+    std::string filepath = dir + "/synthetic-" + std::to_string(sizes_mb[i]) + "mb.filamesh";
+
+    printf("Writing %s\n", filepath.c_str());
+
+    if (0 != write_synthetic_mesh(filepath, sizes_mb[i] * 1024 * 1024)) {
+      exit(EXIT_FAILURE);
+    }
+
+    for (int loader = LOADER_HEAP; loader <= LOADER_MAPPED; ++loader) {
+
+      LoadResult res;
+      res.loader = loader_names[loader];
+      res.file_size = sizes_mb[i] * 1024 * 1024;
+      res.peak_rss_kb = 0;
+
+      for (uint32_t run = 0; run < num_runs; ++run) {
+
+        double load_ms = 0.0;
+        int64_t peak_rss_kb = 0;
+
+        if (0 != run_loader(engine, backend, loader, filepath, evict, load_ms, peak_rss_kb)) {
+          exit(EXIT_FAILURE);
+        }
+
+        res.load_ms.add(load_ms);
+        res.peak_rss_kb = std::max(res.peak_rss_kb, peak_rss_kb);
+      }
+
+      printf("%-18s %6llu MB: p50 %9.3f ms, peak RSS +%lld KB\n",
+             res.loader.c_str(),
+             (unsigned long long)sizes_mb[i],
+             res.load_ms.percentile(50.0),
+             (long long)res.peak_rss_kb);
+
+      results.push_back(res);
+    }
+
+    if (false == keep_files) {
+      remove(filepath.c_str());
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  FILE* fp = test_open_output(output);
+  if (nullptr == fp) {
+    exit(EXIT_FAILURE);
+  }
+
+  print_results_json(fp, results);
+  test_close_output(fp);
+
+  filament::Engine::destroy(&engine);
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+/*
+  Writes a grid of `GRID_COLUMNS` vertices wide, with as many
+  rows as we need to get close to `target_size` bytes. We use the
+  same non-interleaved layout as `monkey.filamesh`: 24 bytes of
+  vertex data per vertex and two triangles of 32-bit indices per
+  quad, so every vertex costs about 48 bytes. The data is
+  streamed to disk one row at a time so we don't need gigabytes
+  of memory to write a gigabyte.
+*/
+static int write_synthetic_mesh(const std::string& filepath, uint64_t target_size) {
+
+  poly::FilameshHeader header = {};
+  poly::FilameshPart part = {};
+  const char* material_name = "DefaultMaterial";
+  uint32_t material_len = (uint32_t)strlen(material_name);
+  uint32_t num_materials = 1;
+  uint64_t num_rows = std::max<uint64_t>(2, target_size / (48 * GRID_COLUMNS));
+  uint64_t vertex_count = num_rows * GRID_COLUMNS;
+  uint64_t index_count = (num_rows - 1) * (GRID_COLUMNS - 1) * 6;
+  std::vector<uint8_t> row;
+  FILE* fp = nullptr;
+  bool is_ok = true;
+
+  if (vertex_count * 24 > UINT32_MAX
+      || index_count * 4 > UINT32_MAX)
+    {
+      printf("Error: a synthetic mesh of %llu bytes is too big for the filamesh format.\n", (unsigned long long)target_size);
+      return -1;
+    }
+
+  header.version = FILAMESH_VERSION;
+  header.parts = 1;
+  header.aabb.half_extent[0] = 1.0f;
+  header.aabb.half_extent[1] = 1.0f;
+  header.aabb.half_extent[2] = 0.01f;
+  header.flags = FILAMESH_FLAG_TEXCOORD_SNORM16;
+  header.offset_position = 0;
+  header.offset_tangents = uint32_t(vertex_count * 8);
+  header.offset_color = uint32_t(vertex_count * 16);
+  header.offset_uv0 = uint32_t(vertex_count * 20);
+  header.offset_uv1 = FILAMESH_NO_ATTRIBUTE;
+  header.stride_uv1 = FILAMESH_NO_ATTRIBUTE;
+  header.vertex_count = uint32_t(vertex_count);
+  header.vertex_size = uint32_t(vertex_count * 24);
+  header.index_type = FILAMESH_INDEX_TYPE_UINT;
+  header.index_count = uint32_t(index_count);
+  header.index_size = uint32_t(index_count * 4);
+
+  part.offset = 0;
+  part.index_count = header.index_count;
+  part.min_index = 0;
+  part.max_index = header.vertex_count - 1;
+  part.material_id = 0;
+  part.aabb = header.aabb;
+
+  fp = fopen(filepath.c_str(), "wb");
+  if (nullptr == fp) {
+    printf("Error: failed to open `%s` for writing.\n", filepath.c_str());
+    return -2;
+  }
+
+  is_ok = is_ok && 1 == fwrite(FILAMESH_MAGIC, FILAMESH_MAGIC_SIZE, 1, fp);
+  is_ok = is_ok && 1 == fwrite(&header, sizeof(header), 1, fp);
+
+  /* Positions (HALF4), in the XY-plane [-1, 1]. */
+  row.resize(GRID_COLUMNS * 8);
+  for (uint64_t y = 0; is_ok && y < num_rows; ++y) {
+    uint16_t* dst = (uint16_t*) row.data();
+    for (uint32_t x = 0; x < GRID_COLUMNS; ++x) {
+      dst[x * 4 + 0] = poly::filamesh_float_to_half(-1.0f + 2.0f * float(x) / float(GRID_COLUMNS - 1));
+      dst[x * 4 + 1] = poly::filamesh_float_to_half(-1.0f + 2.0f * float(y) / float(num_rows - 1));
+      dst[x * 4 + 2] = 0;
+      dst[x * 4 + 3] = poly::filamesh_float_to_half(1.0f);
+    }
+    is_ok = 1 == fwrite(row.data(), row.size(), 1, fp);
+  }
+
+  /* Tangent frames (SHORT4); the identity quaternion, the normal points along +Z. */
+  for (uint32_t x = 0; x < GRID_COLUMNS; ++x) {
+    int16_t* dst = (int16_t*) row.data();
+    dst[x * 4 + 0] = 0;
+    dst[x * 4 + 1] = 0;
+    dst[x * 4 + 2] = 0;
+    dst[x * 4 + 3] = 32767;
+  }
+  for (uint64_t y = 0; is_ok && y < num_rows; ++y) {
+    is_ok = 1 == fwrite(row.data(), row.size(), 1, fp);
+  }
+
+  /* Colors (UBYTE4), white. */
+  row.assign(GRID_COLUMNS * 4, 0xFF);
+  for (uint64_t y = 0; is_ok && y < num_rows; ++y) {
+    is_ok = 1 == fwrite(row.data(), row.size(), 1, fp);
+  }
+
+  /* Texture coordinates (SHORT2, normalized). */
+  for (uint64_t y = 0; is_ok && y < num_rows; ++y) {
+    int16_t* dst = (int16_t*) row.data();
+    for (uint32_t x = 0; x < GRID_COLUMNS; ++x) {
+      dst[x * 2 + 0] = int16_t(32767 * x / (GRID_COLUMNS - 1));
+      dst[x * 2 + 1] = int16_t(32767 * y / (num_rows - 1));
+    }
+    is_ok = 1 == fwrite(row.data(), row.size(), 1, fp);
+  }
+
+  /* Indices (UINT), two triangles per quad. */
+  row.resize((GRID_COLUMNS - 1) * 6 * 4);
+  for (uint64_t y = 0; is_ok && y < (num_rows - 1); ++y) {
+    uint32_t* dst = (uint32_t*) row.data();
+    for (uint32_t x = 0; x < (GRID_COLUMNS - 1); ++x) {
+      uint32_t a = uint32_t(y * GRID_COLUMNS + x);
+      uint32_t b = a + 1;
+      uint32_t c = a + GRID_COLUMNS;
+      uint32_t d = c + 1;
+      dst[x * 6 + 0] = a;
+      dst[x * 6 + 1] = b;
+      dst[x * 6 + 2] = d;
+      dst[x * 6 + 3] = a;
+      dst[x * 6 + 4] = d;
+      dst[x * 6 + 5] = c;
+    }
+    is_ok = 1 == fwrite(row.data(), row.size(), 1, fp);
+  }
+
+  is_ok = is_ok && 1 == fwrite(&part, sizeof(part), 1, fp);
+  is_ok = is_ok && 1 == fwrite(&num_materials, sizeof(num_materials), 1, fp);
+  is_ok = is_ok && 1 == fwrite(&material_len, sizeof(material_len), 1, fp);
+  is_ok = is_ok && 1 == fwrite(material_name, material_len + 1, 1, fp);
+
+  if (0 != fclose(fp)) {
+    is_ok = false;
+  }
+
+  if (false == is_ok) {
+    printf("Error: failed to write `%s`.\n", filepath.c_str());
+    return -3;
+  }
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+static int run_loader(filament::Engine* engine, filament::backend::Backend backend, int loader, const std::string& filepath, bool evict, double& load_ms, int64_t& peak_rss_kb) {
+
+  filamesh::MeshReader::MaterialRegistry registry;
+  filamesh::MeshReader::Mesh mesh;
+  std::chrono::steady_clock::time_point t0;
+  std::chrono::steady_clock::time_point t1;
+  int64_t rss_before = 0;
+
+  if (true == evict) {
+    evict_file(filepath);
+  }
+
+  reset_peak_rss();
+  rss_before = read_status_kb("VmRSS:");
+  t0 = std::chrono::steady_clock::now();
+
+  if (LOADER_HEAP == loader) {
+    mesh = filamesh::MeshReader::loadMeshFromFile(engine, utils::Path(filepath.c_str()), registry);
+  }
+  else if (0 != poly::mesh_load_mapped(engine, filepath, registry, mesh)) {
+    return -1;
+  }
+
+  /* Wait until the backend consumed the buffers and called the release callbacks. */
+  engine->flushAndWait();
+
+  /* The NOOP backend never reads the mapped buffers; read them like a driver would. */
+  if (LOADER_MAPPED == loader
+      && filament::backend::Backend::NOOP == backend)
+    {
+      poly::MappedFile file;
+      if (0 != file.open(filepath)) {
+        return -2;
+      }
+      file.prefault();
+      file.close();
+    }
+
+  t1 = std::chrono::steady_clock::now();
+  load_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+  peak_rss_kb = read_status_kb("VmHWM:") - rss_before;
+
+  if (nullptr == mesh.vertexBuffer
+      || nullptr == mesh.indexBuffer)
+    {
+      printf("Error: failed to load `%s`.\n", filepath.c_str());
+      return -3;
+    }
+
+  engine->destroy(mesh.renderable);
+  engine->destroy(mesh.vertexBuffer);
+  engine->destroy(mesh.indexBuffer);
+  utils::EntityManager::get().destroy(mesh.renderable);
+  engine->flushAndWait();
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+/* Drops the (clean) pages of the file from the page cache. */
+static void evict_file(const std::string& filepath) {
+
+#if defined(__linux)
+  int fd = open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+#endif
+}
+
+/* Resets VmHWM to the current RSS. */
+static void reset_peak_rss() {
+
+#if defined(__linux)
+  FILE* fp = fopen("/proc/self/clear_refs", "w");
+  if (nullptr == fp) {
+    return;
+  }
+
+  fputs("5", fp);
+  fclose(fp);
+#endif
+}
+
+/* Returns the value of e.g. "VmHWM:" from /proc/self/status, or -1. */
+static int64_t read_status_kb(const char* field) {
+
+  int64_t result = -1;
+
+#if defined(__linux)
+  char line[256] = {};
+  size_t field_len = strlen(field);
+  FILE* fp = fopen("/proc/self/status", "r");
+
+  if (nullptr == fp) {
+    return -1;
+  }
+
+  while (nullptr != fgets(line, sizeof(line), fp)) {
+    if (0 == strncmp(line, field, field_len)) {
+      result = strtoll(line + field_len, nullptr, 10);
+      break;
+    }
+  }
+
+  fclose(fp);
+#endif
+
+  return result;
+}
+
+/* -------------------------------------------- */
+
+static void print_results_json(FILE* fp, std::vector<LoadResult>& results) {
+
+  fprintf(fp, "{\n  \"results\": [\n");
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    LoadResult& res = results[i];
+    fprintf(fp, "    { \"loader\": ");
+    poly::json_write_string(fp, res.loader.c_str());
+    fprintf(fp, ", \"file_size\": %llu, \"load_ms\": ", (unsigned long long)res.file_size);
+    test_write_stats_json(fp, res.load_ms);
+    fprintf(fp, ", \"peak_rss_kb\": %lld }%s\n", (long long)res.peak_rss_kb, (i + 1 == results.size()) ? "" : ",");
+  }
+
+  fprintf(fp, "  ]\n}\n");
+}
+
+/* -------------------------------------------- */
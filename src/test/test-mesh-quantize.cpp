@@ -0,0 +1,403 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MESH QUANTIZE REPORT
+  ====================
+
+  GENERAL INFO:
+
+    Quantizes filamesh files with `poly/MeshQuantizer.h` and
+    reports, per file, the size of the vertex data before and
+    after and the position, normal and tangent errors against
+    the source. Nothing is written to disk; the loaders create
+    the quantized files through `mesh_get_optimized()`.
+
+    Before the files we quantize a box whose axes have different
+    lengths, once with frames along the axes (the box keeps its
+    scale per axis) and once with frames that the scaled space
+    would bend (we must fall back to one scale). We map
+    the stored frames back like Filament does, with the inverse
+    transpose of the position transform, and return non-zero
+    when a normal or tangent is off by more than
+    `BOX_MAX_ERROR` degrees or the handedness flipped.
+
+    For the files we also return non-zero when a normal or
+    tangent is off by more than `--max-error=` degrees (2 by
+    default; the 8 bit error grows with the ratio of the axes) or
+    a position by more than one step of 16 bits over the largest
+    half extent.
+
+    This tells us what we lose. What we gain in vertex fetch
+    bandwidth is measured on the GPU by the FBO benchmark:
+
+      ./benchmark.sh instances=10000
+      ./benchmark.sh instances=10000 quantize
+
+  USAGE:
+
+    ./test-mesh-quantize --input=monkey.filamesh,other.filamesh --max-error=2 --output=quantize.json
+
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <poly/Filamesh.h>
+#include <poly/MeshQuantizer.h>
+#include <poly/MappedFile.h>
+#include "TestUtils.h"
+
+/* -------------------------------------------- */
+
+#define BOX_MAX_ERROR 1.5f                             /* Degrees; 8 bits per component is about one degree. */
+#define BOX_NUM_FRAMES 6
+#define FILE_MAX_ERROR 2.0f                            /* Degrees; the default of `--max-error=`. */
+
+/* -------------------------------------------- */
+
+struct QuantizeReport {
+  std::string filepath;
+  uint32_t vertex_count;
+  float max_half_extent;                               /* Of the quantized position box. */
+  poly::MeshQuantizeStats stats;
+};
+
+/* -------------------------------------------- */
+
+static void check_box(bool is_skewed, uint32_t& num_failed);
+static void quat_to_frame(const float q[4], float normal[3], float tangent[3]);
+static float get_angle(const float a[3], const float b[3]);
+static int quantize_file(const std::string& filepath, QuantizeReport& report);
+static void print_reports_json(FILE* fp, const std::vector<QuantizeReport>& reports);
+
+/* -------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+
+  std::vector<std::string> inputs;
+  std::vector<QuantizeReport> reports;
+  std::string output;
+  uint32_t num_failed = 0;
+  float max_error = FILE_MAX_ERROR;
+  TestArgs args(argc, argv);
+
+  args.get("--input=", inputs);
+  args.get("--max-error=", max_error);
+  args.get("--output=", output);
+
+  if (0 != args.check("[--input=monkey.filamesh] [--max-error=2] [--output=quantize.json]")) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (true == inputs.empty()) {
+    inputs.push_back("./monkey.filamesh");
+  }
+
+  check_box(false, num_failed);
+  check_box(true, num_failed);
+
+  if (0 != num_failed) {
+    printf("Error: %u checks failed.\n", num_failed);
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t i = 0; i < inputs.size(); ++i) {
+
+    QuantizeReport report;
+    char what[512];
+
+    if (0 != quantize_file(inputs[i], report)) {
+      exit(EXIT_FAILURE);
+    }
+
+    printf("%s: ", inputs[i].c_str());
+    poly::mesh_quantize_print(report.stats);
+
+    snprintf(what, sizeof(what), "the normals and tangents of `%s` are within %.1f degrees", inputs[i].c_str(), max_error);
+    test_check(report.stats.max_normal_error <= max_error && report.stats.max_tangent_error <= max_error, what, num_failed);
+
+    snprintf(what, sizeof(what), "the positions of `%s` are within one 16 bit step", inputs[i].c_str());
+    test_check(report.stats.max_position_error <= report.max_half_extent / 32767.0f, what, num_failed);
+
+    reports.push_back(report);
+  }
+
+  /* -------------------------------------------- */
+
+  FILE* fp = test_open_output(output);
+  if (nullptr == fp) {
+    exit(EXIT_FAILURE);
+  }
+
+  print_reports_json(fp, reports);
+  test_close_output(fp);
+
+  if (0 != num_failed) {
+    printf("Error: %u checks failed.\n", num_failed);
+    return EXIT_FAILURE;
+  }
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+/*
+  A box of 2.4 x 2 x 1.6 with a frame for every face (and the
+  mirrored ones). When `is_skewed` is true the frames are
+  rotated by 45 degrees around the diagonal, so neither the
+  normal nor the tangent lies along an axis anymore.
+*/
+static void check_box(bool is_skewed, uint32_t& num_failed) {
+
+  const float s = 0.70710678f;
+  const float corners[3] = { 1.2f, 1.0f, 0.8f };
+  const float frames[BOX_NUM_FRAMES][4] = {
+    { 0.0f, 0.0f, 0.0f, 1.0f },                        /* +z */
+    { 1.0f, 0.0f, 0.0f, 0.0f },                        /* -z */
+    { s, 0.0f, 0.0f, s },                              /* -y */
+    { -s, 0.0f, 0.0f, s },                             /* +y */
+    { 0.0f, s, 0.0f, s },                              /* +x */
+    { 0.0f, -s, 0.0f, s }                              /* -x */
+  };
+
+  const float twist[4] = { 0.22094238f, 0.22094238f, 0.22094238f, 0.92387953f }; /* 45 degrees around (1, 1, 1). */
+  const uint32_t num_vertices = BOX_NUM_FRAMES * 2;
+  std::vector<uint8_t> vertices(num_vertices * 16);
+  poly::FilameshData data = {};
+  poly::MeshQuantizeResult result;
+  float max_normal_error = 0.0f;
+  float max_tangent_error = 0.0f;
+  uint32_t num_flipped = 0;
+  bool is_uniform = false;
+  char what[128];
+
+  for (uint32_t i = 0; i < num_vertices; ++i) {
+
+    uint16_t* position = (uint16_t*) (vertices.data() + i * 8);
+    int16_t* tangents = (int16_t*) (vertices.data() + num_vertices * 8 + i * 8);
+    const float* a = frames[i % BOX_NUM_FRAMES];
+    const float* b = twist;
+    float q[4] = { a[0], a[1], a[2], a[3] };
+    float sign = (i < BOX_NUM_FRAMES) ? 1.0f : -1.0f;  /* A negative `w` is a mirrored frame. */
+
+    /* The corners of the box. */
+    for (uint32_t j = 0; j < 3; ++j) {
+      position[j] = poly::filamesh_float_to_half((0 != (i & (1 << j))) ? corners[j] : -corners[j]);
+    }
+
+    position[3] = poly::filamesh_float_to_half(1.0f);
+
+    if (true == is_skewed) {
+      q[0] = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+      q[1] = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+      q[2] = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+      q[3] = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+    }
+
+    /* Keep `w` away from 0, so its sign survives. */
+    if (fabsf(q[3]) < 0.01f) {
+      q[3] = 0.01f;
+    }
+
+    if (q[3] < 0.0f) {
+      sign = -sign;
+    }
+
+    for (uint32_t j = 0; j < 4; ++j) {
+      tangents[j] = int16_t(lrintf(sign * q[j] * 32767.0f));
+    }
+  }
+
+  data.header.version = 1;
+  data.header.parts = 0;
+  data.header.offset_position = 0;
+  data.header.stride_position = 0;
+  data.header.offset_tangents = num_vertices * 8;
+  data.header.stride_tangents = 0;
+  data.header.offset_color = FILAMESH_NO_ATTRIBUTE;
+  data.header.stride_color = FILAMESH_NO_ATTRIBUTE;
+  data.header.offset_uv0 = FILAMESH_NO_ATTRIBUTE;
+  data.header.stride_uv0 = FILAMESH_NO_ATTRIBUTE;
+  data.header.offset_uv1 = FILAMESH_NO_ATTRIBUTE;
+  data.header.stride_uv1 = FILAMESH_NO_ATTRIBUTE;
+  data.header.vertex_count = num_vertices;
+  data.header.vertex_size = uint32_t(vertices.size());
+  data.vertices = vertices.data();
+
+  if (0 != poly::mesh_quantize(data, result)) {
+    test_check(false, "the box can be quantized", num_failed);
+    return;
+  }
+
+  /* Map the frames back with the normal matrix, like Filament does. */
+  for (uint32_t i = 0; i < num_vertices; ++i) {
+
+    const int16_t* src = (const int16_t*) (vertices.data() + data.header.offset_tangents + i * 8);
+    const int8_t* dst = (const int8_t*) (result.vertices.data() + result.header.offset_tangents + i * 4);
+    float src_q[4], dst_q[4];
+    float src_normal[3], src_tangent[3];
+    float dst_normal[3], dst_tangent[3];
+
+    for (uint32_t j = 0; j < 4; ++j) {
+      src_q[j] = fmaxf(float(src[j]) / 32767.0f, -1.0f);
+      dst_q[j] = fmaxf(float(dst[j]) / 127.0f, -1.0f);
+    }
+
+    quat_to_frame(src_q, src_normal, src_tangent);
+    quat_to_frame(dst_q, dst_normal, dst_tangent);
+
+    for (uint32_t j = 0; j < 3; ++j) {
+      dst_normal[j] /= result.header.aabb.half_extent[j];
+      dst_tangent[j] /= result.header.aabb.half_extent[j];
+    }
+
+    max_normal_error = fmaxf(max_normal_error, get_angle(src_normal, dst_normal));
+    max_tangent_error = fmaxf(max_tangent_error, get_angle(src_tangent, dst_tangent));
+
+    if ((src_q[3] < 0.0f) != (dst_q[3] < 0.0f)) {
+      num_flipped++;
+    }
+  }
+
+  is_uniform = (result.header.aabb.half_extent[0] == result.header.aabb.half_extent[1]
+                && result.header.aabb.half_extent[0] == result.header.aabb.half_extent[2]);
+
+  printf("Box with %s frames: half extent %.3f %.3f %.3f, normal error max %.2f deg, tangent error max %.2f deg.\n",
+         (true == is_skewed) ? "rotated" : "axis aligned",
+         result.header.aabb.half_extent[0],
+         result.header.aabb.half_extent[1],
+         result.header.aabb.half_extent[2],
+         max_normal_error,
+         max_tangent_error);
+
+  if (true == is_skewed) {
+    test_check(true == is_uniform, "a box with rotated frames uses one scale for all axes", num_failed);
+  }
+  else {
+    test_check(false == is_uniform, "a box with axis aligned frames keeps its scale per axis", num_failed);
+  }
+
+  snprintf(what, sizeof(what), "the normals of the box are within %.1f degrees", BOX_MAX_ERROR);
+  test_check(max_normal_error <= BOX_MAX_ERROR, what, num_failed);
+
+  snprintf(what, sizeof(what), "the tangents of the box are within %.1f degrees", BOX_MAX_ERROR);
+  test_check(max_tangent_error <= BOX_MAX_ERROR, what, num_failed);
+
+  test_check(0 == num_flipped, "the handedness of the box frames is kept", num_failed);
+}
+
+/* Same as `toTangentFrame()` in Filament's shaders. */
+static void quat_to_frame(const float q[4], float normal[3], float tangent[3]) {
+
+  float x = q[0];
+  float y = q[1];
+  float z = q[2];
+  float w = q[3];
+
+  normal[0] = 2.0f * (x * z + y * w);
+  normal[1] = 2.0f * (y * z - x * w);
+  normal[2] = 1.0f - 2.0f * (x * x + y * y);
+
+  tangent[0] = 1.0f - 2.0f * (y * y + z * z);
+  tangent[1] = 2.0f * (x * y + z * w);
+  tangent[2] = 2.0f * (x * z - y * w);
+}
+
+/* Returns the angle between `a` and `b` in degrees. */
+static float get_angle(const float a[3], const float b[3]) {
+
+  float la = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+  float lb = sqrtf(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+  float d = 0.0f;
+
+  if (0.0f == la
+      || 0.0f == lb)
+    {
+      return 180.0f;
+    }
+
+  d = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) / (la * lb);
+
+  return acosf(fminf(fmaxf(d, -1.0f), 1.0f)) * 57.29577951f;
+}
+
+static int quantize_file(const std::string& filepath, QuantizeReport& report) {
+
+  poly::MappedFile file;
+  poly::FilameshData data;
+  poly::MeshQuantizeResult result;
+  int r = 0;
+
+  if (0 != file.open(filepath)) {
+    return -1;
+  }
+
+  if (0 != poly::filamesh_parse(file.get_data(), file.get_size(), data)) {
+    printf("Error: `%s` is not a valid filamesh.\n", filepath.c_str());
+    file.close();
+    return -2;
+  }
+
+  r = poly::mesh_quantize(data, result);
+  file.close();
+
+  if (0 != r) {
+    printf("Error: failed to quantize `%s`.\n", filepath.c_str());
+    return -3;
+  }
+
+  report.filepath = filepath;
+  report.vertex_count = data.header.vertex_count;
+  report.max_half_extent = fmaxf(fmaxf(result.header.aabb.half_extent[0], result.header.aabb.half_extent[1]), result.header.aabb.half_extent[2]);
+  report.stats = result.stats;
+
+  return 0;
+}
+
+static void print_reports_json(FILE* fp, const std::vector<QuantizeReport>& reports) {
+
+  fprintf(fp, "{\n  \"results\": [\n");
+
+  for (size_t i = 0; i < reports.size(); ++i) {
+
+    const QuantizeReport& rep = reports[i];
+    const poly::MeshQuantizeStats& st = rep.stats;
+
+    fprintf(fp, "    { \"mesh\": ");
+    poly::json_write_string(fp, rep.filepath.c_str());
+    fprintf(fp, ", \"vertices\": %u, \"bytes_per_vertex\": { \"before\": %.2f, \"after\": %.2f }, \"vertex_bytes\": { \"before\": %zu, \"after\": %zu }, "
+            "\"position_error\": { \"max\": %g, \"rms\": %g }, \"normal_error_deg\": { \"max\": %.3f, \"mean\": %.3f }, \"tangent_error_deg\": { \"max\": %.3f } }%s\n",
+            rep.vertex_count,
+            double(st.num_bytes_before) / double(rep.vertex_count),
+            double(st.num_bytes_after) / double(rep.vertex_count),
+            st.num_bytes_before,
+            st.num_bytes_after,
+            st.max_position_error,
+            st.rms_position_error,
+            st.max_normal_error,
+            st.mean_normal_error,
+            st.max_tangent_error,
+            (i + 1 == reports.size()) ? "" : ",");
+  }
+
+  fprintf(fp, "  ]\n}\n");
+}
+
+/* -------------------------------------------- */
@@ -0,0 +1,302 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  MESH STREAMING BENCHMARK
+  ========================
+
+  GENERAL INFO:
+
+    Flies a camera over a grid of `--grid` x `--grid` chunks
+    which are streamed in and out by `poly/MeshStreamer.h`. Every
+    chunk is a copy of the mesh (the monkey by default) at its
+    own position. Per frame we measure the main thread time of
+    `MeshStreamer::update()`, the part of it that created
+    buffers and the vertex and index data handed to Filament,
+    and print the percentiles as JSON together with the number
+    of loads, unloads and resident chunks.
+
+    Run it with and without a budget to see what the budget
+    does to the worst frames:
+
+      ./test-mesh-streaming --upload-kb=0 --create-ms=0
+      ./test-mesh-streaming --upload-kb=1024 --create-ms=2
+
+    We use the NOOP backend, so this measures the CPU side only;
+    after every frame we call `Engine::flushAndWait()`, which is
+    where the driver consumes the uploads.
+
+  USAGE:
+
+    ./test-mesh-streaming --mesh=./monkey.filamesh --grid=32 --spacing=4 --frames=600 --output=streaming.json
+
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <filament/Engine.h>
+#include <filament/Scene.h>
+#include <filameshio/MeshReader.h>
+#include <poly/Filamesh.h>
+#include <poly/MappedFile.h>
+#include <poly/AsyncMeshLoader.h>
+#include <poly/MeshStreamer.h>
+#include <poly/Stats.h>
+
+/* -------------------------------------------- */
+
+#define CAMERA_HEIGHT 2.0f
+#define CAMERA_FOV_Y 60.0f
+
+/* -------------------------------------------- */
+
+static int get_mesh_radius(const std::string& filepath, float& radius);
+static void print_stats_json(FILE* fp, const char* name, poly::RollingStats& stats, bool is_last);
+
+/* -------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+
+  std::string mesh_path = "./monkey.filamesh";
+  std::string output;
+  uint32_t grid_size = 32;
+  uint32_t num_frames = 600;
+  float spacing = 4.0f;
+  float radius = 0.0f;
+  poly::MeshStreamer streamer;
+  poly::MeshStreamerSettings settings = streamer.get_settings();
+
+  settings.load_distance = 20.0f;
+  settings.unload_distance = 24.0f;
+
+  for (int i = 1; i < argc; ++i) {
+    if (0 == strncmp(argv[i], "--mesh=", 7)) {
+      mesh_path = argv[i] + 7;
+    }
+    else if (0 == strncmp(argv[i], "--grid=", 7)) {
+      grid_size = (uint32_t)atoi(argv[i] + 7);
+    }
+    else if (0 == strncmp(argv[i], "--spacing=", 10)) {
+      spacing = float(atof(argv[i] + 10));
+    }
+    else if (0 == strncmp(argv[i], "--frames=", 9)) {
+      num_frames = (uint32_t)atoi(argv[i] + 9);
+    }
+    else if (0 == strncmp(argv[i], "--load-distance=", 16)) {
+      settings.load_distance = float(atof(argv[i] + 16));
+      settings.unload_distance = settings.load_distance * 1.2f;
+    }
+    else if (0 == strncmp(argv[i], "--max-loading=", 14)) {
+      settings.max_loading = (uint32_t)atoi(argv[i] + 14);
+    }
+    else if (0 == strncmp(argv[i], "--upload-kb=", 12)) {
+      settings.max_upload_bytes = uint64_t(atoi(argv[i] + 12)) * 1024;
+    }
+    else if (0 == strncmp(argv[i], "--create-ms=", 12)) {
+      settings.max_create_ms = atof(argv[i] + 12);
+    }
+    else if (0 == strncmp(argv[i], "--output=", 9)) {
+      output = argv[i] + 9;
+    }
+    else {
+      printf("Usage: %s [--mesh=./monkey.filamesh] [--grid=32] [--spacing=4] [--frames=600] [--load-distance=20] [--max-loading=8] [--upload-kb=4096] [--create-ms=2] [--output=streaming.json]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (0 == grid_size
+      || 0 == num_frames
+      || spacing <= 0.0f)
+    {
+      printf("Error: we need a grid of at least one chunk, a spacing > 0 and at least one frame.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  if (0 != get_mesh_radius(mesh_path, radius)) {
+    exit(EXIT_FAILURE);
+  }
+
+  /* -------------------------------------------- */
+
+  filament::Engine* engine = filament::Engine::create(filament::backend::Backend::NOOP);
+  if (nullptr == engine) {
+    printf("Error: failed to create the engine.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  filament::Scene* scene = engine->createScene();
+  filamesh::MeshReader::MaterialRegistry registry;
+  poly::AsyncMeshLoader loader;
+
+  loader.set_placeholders(false);
+
+  if (0 != loader.init(engine, scene, &registry)) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 != streamer.init(engine, scene, &loader)) {
+    exit(EXIT_FAILURE);
+  }
+
+  streamer.set_settings(settings);
+
+  /* The grid is centered around the origin, in the xz-plane. */
+  float half_size = 0.5f * spacing * float(grid_size - 1);
+
+  for (uint32_t z = 0; z < grid_size; ++z) {
+    for (uint32_t x = 0; x < grid_size; ++x) {
+      float position[3] = { float(x) * spacing - half_size, 0.0f, float(z) * spacing - half_size };
+      if (streamer.add_chunk(mesh_path, position, radius) < 0) {
+        exit(EXIT_FAILURE);
+      }
+    }
+  }
+
+  /* -------------------------------------------- */
+
+  /* We fly over the middle of the grid, from one side to the other. */
+  poly::RollingStats update_ms(num_frames);
+  poly::RollingStats create_ms(num_frames);
+  poly::RollingStats upload_kb(num_frames);
+  float projection_scale = 1.0f / tanf(0.5f * CAMERA_FOV_Y * 3.14159265f / 180.0f);
+  uint32_t max_resident = 0;
+  uint64_t max_resident_bytes = 0;
+  uint32_t num_failed = 0;
+
+  for (uint32_t i = 0; i < num_frames; ++i) {
+
+    float t = (num_frames > 1) ? float(i) / float(num_frames - 1) : 0.0f;
+    float camera_position[3] = { -half_size - settings.load_distance + t * 2.0f * (half_size + settings.load_distance), CAMERA_HEIGHT, 0.0f };
+
+    auto start = std::chrono::steady_clock::now();
+    streamer.update(camera_position, projection_scale);
+    update_ms.add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    const poly::MeshStreamerStats& stats = streamer.get_stats();
+    create_ms.add(stats.create_ms);
+    upload_kb.add(double(stats.num_upload_bytes) / 1024.0);
+    max_resident = std::max(max_resident, stats.num_resident);
+    max_resident_bytes = std::max(max_resident_bytes, stats.num_resident_bytes);
+
+    engine->flushAndWait();
+  }
+
+  for (size_t i = 0; i < streamer.get_num_chunks(); ++i) {
+    if (MESH_STREAMER_CHUNK_FAILED == streamer.get_chunk(i)->state) {
+      num_failed++;
+    }
+  }
+
+  const poly::MeshStreamerStats& stats = streamer.get_stats();
+
+  printf("update p50 %.3f ms, p99 %.3f ms, max %.3f ms; %llu loads, %llu unloads, at most %u chunks (%.2f MB) resident.\n",
+         update_ms.percentile(50.0),
+         update_ms.percentile(99.0),
+         update_ms.max(),
+         (unsigned long long)stats.num_loads,
+         (unsigned long long)stats.num_unloads,
+         max_resident,
+         double(max_resident_bytes) / (1024.0 * 1024.0));
+
+  /* -------------------------------------------- */
+
+  FILE* fp = stdout;
+
+  if (false == output.empty()) {
+    fp = fopen(output.c_str(), "w");
+    if (nullptr == fp) {
+      printf("Error: failed to open `%s`.\n", output.c_str());
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"chunks\": %u,\n", grid_size * grid_size);
+  fprintf(fp, "  \"frames\": %u,\n", num_frames);
+  fprintf(fp, "  \"load_distance\": %.3f,\n", settings.load_distance);
+  fprintf(fp, "  \"max_loading\": %u,\n", settings.max_loading);
+  fprintf(fp, "  \"max_upload_kb\": %llu,\n", (unsigned long long)(settings.max_upload_bytes / 1024));
+  fprintf(fp, "  \"max_create_ms\": %.3f,\n", settings.max_create_ms);
+  fprintf(fp, "  \"loads\": %llu,\n", (unsigned long long)stats.num_loads);
+  fprintf(fp, "  \"unloads\": %llu,\n", (unsigned long long)stats.num_unloads);
+  fprintf(fp, "  \"failed\": %u,\n", num_failed);
+  fprintf(fp, "  \"max_resident\": %u,\n", max_resident);
+  fprintf(fp, "  \"max_resident_kb\": %.2f,\n", double(max_resident_bytes) / 1024.0);
+  print_stats_json(fp, "update_ms", update_ms, false);
+  print_stats_json(fp, "create_ms", create_ms, false);
+  print_stats_json(fp, "upload_kb", upload_kb, true);
+  fprintf(fp, "}\n");
+
+  if (stdout != fp) {
+    fclose(fp);
+  }
+
+  /* -------------------------------------------- */
+
+  streamer.shutdown();
+  loader.shutdown();
+  engine->destroy(scene);
+  filament::Engine::destroy(&engine);
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+/* The radius of the sphere around the origin of the mesh which contains its bounding box. */
+static int get_mesh_radius(const std::string& filepath, float& radius) {
+
+  poly::MappedFile file;
+  poly::FilameshData data;
+  float center = 0.0f;
+  float extent = 0.0f;
+
+  if (0 != file.open(filepath)) {
+    return -1;
+  }
+
+  if (0 != poly::filamesh_parse(file.get_data(), file.get_size(), data)) {
+    printf("Error: `%s` is not a valid filamesh.\n", filepath.c_str());
+    file.close();
+    return -2;
+  }
+
+  for (size_t i = 0; i < 3; ++i) {
+    center += data.header.aabb.center[i] * data.header.aabb.center[i];
+    extent += data.header.aabb.half_extent[i] * data.header.aabb.half_extent[i];
+  }
+
+  radius = sqrtf(center) + sqrtf(extent);
+  file.close();
+
+  return 0;
+}
+
+static void print_stats_json(FILE* fp, const char* name, poly::RollingStats& stats, bool is_last) {
+  fprintf(fp, "  \"%s\": { \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f }%s\n",
+         name,
+         stats.percentile(50.0),
+         stats.percentile(95.0),
+         stats.percentile(99.0),
+         stats.max(),
+         (true == is_last) ? "" : ",");
+}
+
+/* -------------------------------------------- */
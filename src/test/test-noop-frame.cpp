@@ -0,0 +1,631 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  NOOP FRAME BENCHMARK
+  ====================
+
+  GENERAL INFO:
+
+    Measures the CPU side of a Filament frame: culling,
+    froxelization of the lights and the generation of the
+    commands. We create the engine with the NOOP backend, so
+    there is no driver and no GPU and it runs on any Linux box
+    without GL. The synthetic scene has `--instances` cubes with
+    the default material on a grid and `--lights` point lights
+    at random positions above it; with `--shadows` we add a sun
+    which casts shadows. The camera orbits around the grid so
+    the culling results change every frame.
+
+    Per frame we time `beginFrame()`, `render()` and
+    `endFrame()` on the main thread and `Engine::flushAndWait()`
+    (the driver thread, which is almost free with NOOP) and print
+    the percentiles as JSON for every value of `--cores`.
+
+    The Filament version we link has no setting for the number
+    of `JobSystem` threads; it uses one per core. So instead of
+    a thread count we pass core counts: we limit the cores the
+    process may run on with `sched_setaffinity()` (Linux) or
+    `SetProcessAffinityMask()` (Windows) before we create the
+    engine, which is inherited by the threads that Filament
+    creates. `0` means all cores. With fewer cores the job
+    threads share them, which is what happens on a smaller
+    machine too. The JSON has the requested count as `cores` and
+    the cores we actually ran on as `num_cores`. On other
+    platforms we can't limit the cores; we warn and run every
+    count on all cores.
+
+  USAGE:
+
+    ./test-noop-frame --instances=10000 --lights=64 --cores=1,2,4,0 --frames=300 --output=noop-frame.json
+
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <filament/Engine.h>
+#include <filament/Renderer.h>
+#include <filament/SwapChain.h>
+#include <filament/Scene.h>
+#include <filament/View.h>
+#include <filament/Viewport.h>
+#include <filament/Camera.h>
+#include <filament/Box.h>
+#include <filament/Material.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <filament/RenderableManager.h>
+#include <filament/TransformManager.h>
+#include <filament/LightManager.h>
+#include <utils/EntityManager.h>
+#include <math/mat4.h>
+#include <poly/Stats.h>
+#include "TestUtils.h"
+
+#if defined(_WIN32)
+#  include <windows.h>
+#elif defined(__linux__)
+#  include <sched.h>
+#endif
+
+using namespace filament;
+using namespace filament::math;
+
+/* -------------------------------------------- */
+
+#define FRAME_WIDTH 1280
+#define FRAME_HEIGHT 720
+#define GRID_SPACING 3.0f
+#define NUM_WARMUP_FRAMES 10      /* Not measured; the first frames allocate. */
+
+/* -------------------------------------------- */
+
+struct FrameSettings {
+  uint32_t num_instances;
+  uint32_t num_lights;
+  uint32_t num_frames;
+  bool shadows;
+};
+
+/* The cores the process may run on. */
+#if defined(_WIN32)
+typedef DWORD_PTR CoreMask;
+#elif defined(__linux__)
+typedef cpu_set_t CoreMask;
+#else
+typedef uint32_t CoreMask;        /* The number of cores; we can't limit them. */
+#endif
+
+struct FrameResult {
+  uint32_t requested_cores;       /* The value from `--cores`, 0 = all cores. */
+  uint32_t num_cores;             /* The cores we ran on. */
+  uint32_t num_skipped;           /* `beginFrame()` returned false. */
+  poly::RollingStats begin_ms;
+  poly::RollingStats render_ms;
+  poly::RollingStats end_ms;
+  poly::RollingStats cpu_ms;      /* begin + render + end. */
+  poly::RollingStats wait_ms;     /* `flushAndWait()`. */
+};
+
+/* Position and tangent frame (a quaternion; the normal is its z-axis). */
+struct CubeVertex {
+  float position[3];
+  int16_t tangents[4];
+};
+
+/* -------------------------------------------- */
+
+static int get_allowed_cores(CoreMask& allowed);
+static int set_num_cores(const CoreMask& allowed, uint32_t count, uint32_t& num_cores);
+static int run_frames(const FrameSettings& settings, FrameResult& result);
+static void create_cube(std::vector<CubeVertex>& vertices, std::vector<uint16_t>& indices);
+static void print_results_json(FILE* fp, const FrameSettings& settings, std::vector<FrameResult>& results);
+static void print_stats_json(FILE* fp, const char* name, poly::RollingStats& stats, bool is_last);
+
+/* -------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+
+  std::vector<uint32_t> cores = { 1, 2, 4, 0 };
+  std::vector<FrameResult> results;
+  std::string output;
+  FrameSettings settings;
+  CoreMask allowed;
+  uint32_t num_all_cores = 0;
+
+  settings.num_instances = 10000;
+  settings.num_lights = 64;
+  settings.num_frames = 300;
+  settings.shadows = false;
+
+  TestArgs args(argc, argv);
+
+  args.get("--instances=", settings.num_instances);
+  args.get("--lights=", settings.num_lights);
+  args.get("--frames=", settings.num_frames);
+  args.get("--cores=", cores);
+  args.get("--output=", output);
+  settings.shadows = args.has("--shadows");
+
+  if (0 != args.check("[--instances=10000] [--lights=64] [--shadows] [--cores=1,2,4,0] [--frames=300] [--output=noop-frame.json]")) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 == settings.num_instances
+      || 0 == settings.num_frames
+      || true == cores.empty())
+    {
+      printf("Error: we need at least one instance, one frame and one core count.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  /* We restore this mask after every run. */
+  if (0 != get_allowed_cores(allowed)) {
+    exit(EXIT_FAILURE);
+  }
+
+  /* -------------------------------------------- */
+
+  for (size_t i = 0; i < cores.size(); ++i) {
+
+    FrameResult res;
+    res.requested_cores = cores[i];
+    res.num_skipped = 0;
+    res.begin_ms = poly::RollingStats(settings.num_frames);
+    res.render_ms = poly::RollingStats(settings.num_frames);
+    res.end_ms = poly::RollingStats(settings.num_frames);
+    res.cpu_ms = poly::RollingStats(settings.num_frames);
+    res.wait_ms = poly::RollingStats(settings.num_frames);
+
+    if (0 != set_num_cores(allowed, cores[i], res.num_cores)) {
+      exit(EXIT_FAILURE);
+    }
+
+    if (0 != run_frames(settings, res)) {
+      exit(EXIT_FAILURE);
+    }
+
+    set_num_cores(allowed, 0, num_all_cores);
+
+    printf("%2u cores: cpu p50 %.3f ms, p99 %.3f ms (begin %.3f ms, render %.3f ms, end %.3f ms), wait p50 %.3f ms, %u skipped.\n",
+           res.num_cores,
+           res.cpu_ms.percentile(50.0),
+           res.cpu_ms.percentile(99.0),
+           res.begin_ms.percentile(50.0),
+           res.render_ms.percentile(50.0),
+           res.end_ms.percentile(50.0),
+           res.wait_ms.percentile(50.0),
+           res.num_skipped);
+
+    results.push_back(res);
+  }
+
+  /* -------------------------------------------- */
+
+  FILE* fp = test_open_output(output);
+  if (nullptr == fp) {
+    exit(EXIT_FAILURE);
+  }
+
+  print_results_json(fp, settings, results);
+  test_close_output(fp);
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+#if defined(_WIN32)
+
+static int get_allowed_cores(CoreMask& allowed) {
+
+  DWORD_PTR system_mask = 0;
+
+  if (0 == GetProcessAffinityMask(GetCurrentProcess(), &allowed, &system_mask)) {
+    printf("Error: failed to get the cores we may run on.\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Lets the process, including the threads it creates from now on, only run on the first `count` allowed cores. */
+static int set_num_cores(const CoreMask& allowed, uint32_t count, uint32_t& num_cores) {
+
+  CoreMask mask = 0;
+  uint32_t num_bits = uint32_t(sizeof(CoreMask) * 8);
+
+  num_cores = 0;
+
+  for (uint32_t i = 0; i < num_bits; ++i) {
+
+    CoreMask bit = CoreMask(1) << i;
+
+    if (0 == (allowed & bit)) {
+      continue;
+    }
+
+    if (0 != count
+        && num_cores >= count)
+      {
+        break;
+      }
+
+    mask |= bit;
+    num_cores++;
+  }
+
+  if (0 == SetProcessAffinityMask(GetCurrentProcess(), mask)) {
+    printf("Error: failed to limit the process to %u cores.\n", num_cores);
+    return -1;
+  }
+
+  return 0;
+}
+
+#elif defined(__linux__)
+
+static int get_allowed_cores(CoreMask& allowed) {
+
+  CPU_ZERO(&allowed);
+
+  if (0 != sched_getaffinity(0, sizeof(allowed), &allowed)) {
+    printf("Error: failed to get the cores we may run on.\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Lets the calling thread, and the threads it creates from now on, only run on the first `count` allowed cores. */
+static int set_num_cores(const CoreMask& allowed, uint32_t count, uint32_t& num_cores) {
+
+  cpu_set_t mask;
+  uint32_t num_allowed = (uint32_t)CPU_COUNT(&allowed);
+
+  if (0 == count
+      || count >= num_allowed)
+    {
+      num_cores = num_allowed;
+      return (0 == sched_setaffinity(0, sizeof(allowed), &allowed)) ? 0 : -1;
+    }
+
+  CPU_ZERO(&mask);
+  num_cores = 0;
+
+  for (int i = 0; i < CPU_SETSIZE && num_cores < count; ++i) {
+    if (CPU_ISSET(i, &allowed)) {
+      CPU_SET(i, &mask);
+      num_cores++;
+    }
+  }
+
+  if (0 != sched_setaffinity(0, sizeof(mask), &mask)) {
+    printf("Error: failed to limit the process to %u cores.\n", count);
+    return -1;
+  }
+
+  return 0;
+}
+
+#else
+
+static int get_allowed_cores(CoreMask& allowed) {
+
+  allowed = std::thread::hardware_concurrency();
+
+  if (0 == allowed) {
+    allowed = 1;
+  }
+
+  return 0;
+}
+
+/* We can't limit the cores on this platform, so every run uses all of them. */
+static int set_num_cores(const CoreMask& allowed, uint32_t count, uint32_t& num_cores) {
+
+  if (0 != count
+      && count < allowed)
+    {
+      printf("Warning: `--cores` only limits the cores on Linux and Windows; running on all %u cores.\n", allowed);
+    }
+
+  num_cores = allowed;
+
+  return 0;
+}
+
+#endif
+
+/* -------------------------------------------- */
+
+/* Creates a new engine and scene, so the `JobSystem` threads are created with the current affinity. */
+static int run_frames(const FrameSettings& settings, FrameResult& result) {
+
+  Engine* engine = Engine::create(backend::Backend::NOOP);
+  if (nullptr == engine) {
+    printf("Error: failed to create the engine.\n");
+    return -1;
+  }
+
+  utils::EntityManager& em = utils::EntityManager::get();
+  TransformManager& tm = engine->getTransformManager();
+  SwapChain* swap_chain = engine->createSwapChain(FRAME_WIDTH, FRAME_HEIGHT, 0);
+  Renderer* renderer = engine->createRenderer();
+  Scene* scene = engine->createScene();
+  View* view = engine->createView();
+  Camera* camera = engine->createCamera();
+  const MaterialInstance* material = engine->getDefaultMaterial()->getDefaultInstance();
+  std::vector<utils::Entity> instances(settings.num_instances);
+  std::vector<utils::Entity> lights(settings.num_lights);
+  std::vector<CubeVertex> vertices;
+  std::vector<uint16_t> indices;
+  utils::Entity sun;
+  uint32_t grid_size = (uint32_t)ceilf(sqrtf(float(settings.num_instances)));
+  float half_size = 0.5f * GRID_SPACING * float(grid_size - 1);
+  Box aabb;
+
+  view->setScene(scene);
+  view->setCamera(camera);
+  view->setViewport({ 0, 0, FRAME_WIDTH, FRAME_HEIGHT });
+  view->setShadowsEnabled(settings.shadows);
+  camera->setProjection(60.0, double(FRAME_WIDTH) / double(FRAME_HEIGHT), 0.1, 1000.0);
+
+  /* -------------------------------------------- */
+
+  create_cube(vertices, indices);
+
+  VertexBuffer* vb = VertexBuffer::Builder()
+    .vertexCount(uint32_t(vertices.size()))
+    .bufferCount(1)
+    .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3, offsetof(CubeVertex, position), sizeof(CubeVertex))
+    .attribute(VertexAttribute::TANGENTS, 0, VertexBuffer::AttributeType::SHORT4, offsetof(CubeVertex, tangents), sizeof(CubeVertex))
+    .normalized(VertexAttribute::TANGENTS)
+    .build(*engine);
+
+  IndexBuffer* ib = IndexBuffer::Builder()
+    .indexCount(uint32_t(indices.size()))
+    .bufferType(IndexBuffer::IndexType::USHORT)
+    .build(*engine);
+
+  vb->setBufferAt(*engine, 0, VertexBuffer::BufferDescriptor(vertices.data(), vertices.size() * sizeof(CubeVertex)));
+  ib->setBuffer(*engine, IndexBuffer::BufferDescriptor(indices.data(), indices.size() * sizeof(uint16_t)));
+
+  aabb.set({ -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f });
+  em.create(settings.num_instances, instances.data());
+
+  for (uint32_t i = 0; i < settings.num_instances; ++i) {
+
+    float3 position(float(i % grid_size) * GRID_SPACING - half_size, 0.0f, float(i / grid_size) * GRID_SPACING - half_size);
+
+    RenderableManager::Builder(1)
+      .boundingBox(aabb)
+      .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vb, ib, 0, indices.size())
+      .material(0, material)
+      .castShadows(settings.shadows)
+      .receiveShadows(settings.shadows)
+      .build(*engine, instances[i]);
+
+    tm.create(instances[i], TransformManager::Instance(), mat4f::translation(position));
+  }
+
+  scene->addEntities(instances.data(), instances.size());
+
+  /* -------------------------------------------- */
+
+  srand(1234);
+  em.create(settings.num_lights, lights.data());
+
+  for (uint32_t i = 0; i < settings.num_lights; ++i) {
+
+    float3 position(
+      2.0f * half_size * (float(rand()) / float(RAND_MAX)) - half_size,
+      2.0f + 4.0f * (float(rand()) / float(RAND_MAX)),
+      2.0f * half_size * (float(rand()) / float(RAND_MAX)) - half_size
+    );
+
+    LightManager::Builder(LightManager::Type::POINT)
+      .color({ 1.0f, 0.9f, 0.8f })
+      .intensity(100000.0f)
+      .position(position)
+      .falloff(8.0f)
+      .build(*engine, lights[i]);
+  }
+
+  scene->addEntities(lights.data(), lights.size());
+
+  if (true == settings.shadows) {
+
+    sun = em.create();
+
+    LightManager::Builder(LightManager::Type::SUN)
+      .color({ 1.0f, 1.0f, 1.0f })
+      .intensity(100000.0f)
+      .direction({ 0.0f, -1.0f, -1.0f })
+      .castShadows(true)
+      .build(*engine, sun);
+
+    scene->addEntity(sun);
+  }
+
+  /* -------------------------------------------- */
+
+  /* The camera orbits around the grid, looking at its center. */
+  float orbit_radius = half_size + 10.0f;
+  uint32_t num_frames = NUM_WARMUP_FRAMES + settings.num_frames;
+
+  for (uint32_t i = 0; i < num_frames; ++i) {
+
+    float angle = 2.0f * 3.14159265f * float(i) / float(num_frames);
+    float3 eye(orbit_radius * cosf(angle), 0.25f * orbit_radius, orbit_radius * sinf(angle));
+    bool is_measured = (i >= NUM_WARMUP_FRAMES);
+
+    camera->lookAt(eye, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    if (false == renderer->beginFrame(swap_chain)) {
+      if (true == is_measured) {
+        result.num_skipped++;
+      }
+      engine->flushAndWait();
+      continue;
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    renderer->render(view);
+    auto t2 = std::chrono::steady_clock::now();
+    renderer->endFrame();
+    auto t3 = std::chrono::steady_clock::now();
+    engine->flushAndWait();
+    auto t4 = std::chrono::steady_clock::now();
+
+    if (false == is_measured) {
+      continue;
+    }
+
+    result.begin_ms.add(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    result.render_ms.add(std::chrono::duration<double, std::milli>(t2 - t1).count());
+    result.end_ms.add(std::chrono::duration<double, std::milli>(t3 - t2).count());
+    result.cpu_ms.add(std::chrono::duration<double, std::milli>(t3 - t0).count());
+    result.wait_ms.add(std::chrono::duration<double, std::milli>(t4 - t3).count());
+  }
+
+  /* -------------------------------------------- */
+
+  for (uint32_t i = 0; i < settings.num_instances; ++i) {
+    engine->destroy(instances[i]);
+  }
+
+  for (uint32_t i = 0; i < settings.num_lights; ++i) {
+    engine->destroy(lights[i]);
+  }
+
+  em.destroy(instances.size(), instances.data());
+  em.destroy(lights.size(), lights.data());
+
+  if (false == sun.isNull()) {
+    engine->destroy(sun);
+    em.destroy(sun);
+  }
+
+  engine->destroy(vb);
+  engine->destroy(ib);
+  engine->destroy(camera);
+  engine->destroy(view);
+  engine->destroy(scene);
+  engine->destroy(renderer);
+  engine->destroy(swap_chain);
+  Engine::destroy(&engine);
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+/* A unit cube with 4 vertices per face, so every face has its own normal. */
+static void create_cube(std::vector<CubeVertex>& vertices, std::vector<uint16_t>& indices) {
+
+  /* Per face: the normal and two axes in the plane with `a x b = n`, so the triangles are counter clockwise from the outside. */
+  static const float faces[6][3][3] = {
+    { {  1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f,  1.0f } },
+    { { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } },
+    { { 0.0f,  1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f,  0.0f } },
+    { { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f,  1.0f } },
+    { { 0.0f, 0.0f,  1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f,  0.0f } },
+    { { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f,  0.0f } },
+  };
+
+  /* The quaternions which rotate +z onto the normal of each face. */
+  static const int16_t tangents[6][4] = {
+    { 0, 23170, 0, 23170 },
+    { 0, -23170, 0, 23170 },
+    { -23170, 0, 0, 23170 },
+    { 23170, 0, 0, 23170 },
+    { 0, 0, 0, 32767 },
+    { 32767, 0, 0, 0 },
+  };
+
+  static const float corners[4][2] = {
+    { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f },
+  };
+
+  vertices.clear();
+  indices.clear();
+
+  for (int f = 0; f < 6; ++f) {
+
+    uint16_t base = uint16_t(vertices.size());
+
+    for (int c = 0; c < 4; ++c) {
+      CubeVertex v;
+      for (int k = 0; k < 3; ++k) {
+        v.position[k] = 0.5f * (faces[f][0][k] + corners[c][0] * faces[f][1][k] + corners[c][1] * faces[f][2][k]);
+      }
+      memcpy(v.tangents, tangents[f], sizeof(v.tangents));
+      vertices.push_back(v);
+    }
+
+    indices.push_back(base);
+    indices.push_back(base + 1);
+    indices.push_back(base + 2);
+    indices.push_back(base);
+    indices.push_back(base + 2);
+    indices.push_back(base + 3);
+  }
+}
+
+/* -------------------------------------------- */
+
+static void print_results_json(FILE* fp, const FrameSettings& settings, std::vector<FrameResult>& results) {
+
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"instances\": %u,\n", settings.num_instances);
+  fprintf(fp, "  \"lights\": %u,\n", settings.num_lights);
+  fprintf(fp, "  \"shadows\": %s,\n", (true == settings.shadows) ? "true" : "false");
+  fprintf(fp, "  \"frames\": %u,\n", settings.num_frames);
+  fprintf(fp, "  \"results\": [\n");
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    FrameResult& res = results[i];
+    fprintf(fp, "    {\n");
+    fprintf(fp, "      \"cores\": %u,\n", res.requested_cores);
+    fprintf(fp, "      \"num_cores\": %u,\n", res.num_cores);
+    fprintf(fp, "      \"skipped\": %u,\n", res.num_skipped);
+    print_stats_json(fp, "begin_ms", res.begin_ms, false);
+    print_stats_json(fp, "render_ms", res.render_ms, false);
+    print_stats_json(fp, "end_ms", res.end_ms, false);
+    print_stats_json(fp, "cpu_ms", res.cpu_ms, false);
+    print_stats_json(fp, "wait_ms", res.wait_ms, true);
+    fprintf(fp, "    }%s\n", (i + 1 < results.size()) ? "," : "");
+  }
+
+  fprintf(fp, "  ]\n");
+  fprintf(fp, "}\n");
+}
+
+static void print_stats_json(FILE* fp, const char* name, poly::RollingStats& stats, bool is_last) {
+  fprintf(fp, "      \"%s\": ", name);
+  test_write_stats_json(fp, stats);
+  fprintf(fp, "%s\n", (true == is_last) ? "" : ",");
+}
+
+/* -------------------------------------------- */
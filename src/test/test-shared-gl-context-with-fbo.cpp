@@ -78,7 +78,10 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sstream>
+#include <chrono>
+#include <thread>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <GLFW/glfw3native.h>
@@ -92,11 +95,31 @@
 #include <filament/TransformManager.h>
 #include <filament/Texture.h>
 #include <filament/RenderTarget.h>
+#include <filament/Material.h>
 #include <filameshio/MeshReader.h>
 #include <math/mat3.h>
 #include <math/mat4.h>
 #include <utils/Path.h>
 #include <utils/EntityManager.h>
+#include <utils/JobSystem.h>
+#include <poly/GpuTimer.h>
+#include <poly/Trace.h>
+#include <poly/InputLatency.h>
+#include <poly/CameraController.h>
+#include <poly/LatestValue.h>
+#include <poly/InputQueue.h>
+#include <poly/AsyncMeshLoader.h>
+#include <poly/MeshLoader.h>
+#include <poly/AssetArchive.h>
+#include <poly/MeshCache.h>
+#include <poly/InstancingScene.h>
+#include <poly/MeshOptimizer.h>
+#include <poly/GltfLoader.h>
+#include <poly/MappedFile.h>
+#include <poly/StartupTimeline.h>
+#include <poly/MaterialPrewarmer.h>
+#include <poly/ShaderManager.h>
+#include <poly/Json.h>
 
 /* -------------------------------------------- */
 
@@ -108,7 +131,13 @@ void error_callback(int err, const char* desc);
 void resize_callback(GLFWwindow* window, int width, int height);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 
-static int print_shader_compile_info(uint32_t shader); 
+static void process_input(GLFWwindow* win);
+static void handle_key(GLFWwindow* win, int key, int action);
+static void print_stats_json(FILE* fp, const char* name, poly::RollingStats& stats, bool is_last);
+static void on_mesh_loaded(poly::AsyncMesh* mesh, void* user);
+static void on_gltf_loaded(poly::GltfAsset* asset, void* user);
+static void add_gltf_materials(poly::MaterialPrewarmer& prewarmer, std::vector<poly::GltfAsset*>& assets);
+static void prefetch_files(const std::vector<std::string>& filepaths);
 
 /* -------------------------------------------- */
 
@@ -117,6 +146,126 @@ uint32_t win_h = 720;
 
 /* -------------------------------------------- */
 
+poly::InputQueue input_queue; /* The input callbacks push into this queue, we drain it once per frame. */
+poly::InputLatency input_latency; /* Timestamps input events and measures how long it takes before they're presented. */
+poly::CameraController camera_controller; /* Orbit camera; drag with the left mouse button and scroll to zoom. */
+poly::LatestValue<poly::CameraPose> camera_slot(camera_controller.get_pose()); /* The latest camera pose, read right before we render. */
+
+/* -------------------------------------------- */
+
+/*
+  When started with `--bench` we render a fixed number of frames
+  as fast as possible (no vsync, no sleep), discard the warm-up
+  frames and write the CPU and GPU frame time percentiles as
+  JSON into the file given with `--output=`, which is required;
+  stdout has our logs. Use `build/benchmark.sh` to run it under
+  Xvfb.
+*/
+bool bench_enabled = false;
+uint32_t bench_num_frames = 1000;
+uint32_t bench_num_warmup = 100;
+std::string bench_output;
+
+/*
+  With `--instances=N` we don't show one monkey but a stress
+  scene of N instances which share the buffers of the monkey
+  (see `poly/InstancingScene.h`). Their transforms are updated
+  every frame; the benchmark also reports the CPU time of the
+  transform update, `render()` (culling and command generation)
+  and `endFrame()`. The transforms are composed and committed in
+  one batch (see `poly/TransformBatch.h`); `--scalar-transforms`
+  sets them one by one, so we can compare both.
+*/
+uint32_t stress_num_instances = 0;
+bool stress_batched = true;
+
+/*
+  With `--lods=N` (2-4) the mesh cache generates N levels of
+  detail for the stress scene and every instance gets the level
+  that matches its size on screen, see `poly/MeshLod.h`. The
+  benchmark then also reports the submitted triangles, the CPU
+  time of the level selection and how often instances switched.
+*/
+uint32_t stress_num_lods = 0;
+
+/*
+  With `--optimize-meshes` we load the meshoptimizer'd copy of
+  the monkey (vertex cache, overdraw and vertex fetch order),
+  which is cached next to it as `monkey.opt.filamesh`; see
+  `poly/MeshOptimizer.h`. Add `--compress-meshes` to also encode
+  the vertex and index data (only used by the async loader, the
+  mesh cache needs uncompressed data). `--quantize-meshes` stores
+  the vertices in the compact format of `poly/MeshQuantizer.h`
+  instead (20 instead of 24 bytes per vertex); with `--instances`
+  this shows what the smaller vertices save in vertex fetch
+  bandwidth. In benchmark mode the statistics of the optimizer
+  (ACMR, overfetch, vertex count and size) are printed and
+  written into the JSON as `mesh_optimize`.
+*/
+bool mesh_optimize = false;
+uint32_t mesh_optimize_flags = MESH_OPTIMIZE_DEFAULT;
+
+/*
+  With `--gltf=scene.gltf,other.glb` we load glTF files with
+  `poly/GltfLoader.h` instead of the monkey. Files and their
+  buffers are read on worker threads, textures are decoded on
+  Filament's job system and the work on the main thread is
+  spread over frames: at most `gltf_max_main_ms` per frame to add
+  entities. When the assets are loaded we print how long every
+  stage took.
+*/
+std::vector<std::string> gltf_paths;
+double gltf_max_main_ms = 2.0;
+
+/*
+  After the first frame was presented we print the startup
+  timeline; with `--startup-output=startup.json` we also save it
+  as JSON, see `poly/StartupTimeline.h`.
+*/
+std::string startup_output;
+
+/*
+  Before the first frame we render every material once into a
+  tiny offscreen target (see `poly/MaterialPrewarmer.h`), so the
+  driver compiles their programs then and not during the first
+  visible frames; the compile time per material is printed.
+  `--no-prewarm` disables this so you can compare the first
+  frames.
+*/
+bool prewarm_enabled = true;
+
+/*
+  The composite shader is cached as a program binary in
+  `shader_cache_dir` (see `poly/ShaderManager.h`), so we only
+  compile it when the sources or the driver changed. Use
+  `--shader-cache=` (empty) to always compile from source.
+*/
+std::string shader_cache_dir = "./";
+
+/*
+  With `--archive=assets.pack` we load the monkey from the entry
+  `monkey.filamesh` of an archive made with `poly-pack` (see
+  `poly/AssetArchive.h`) instead of from the loose file. The
+  buffers point into the archive, so it stays open until the
+  engine released them at shutdown.
+*/
+std::string archive_path;
+
+/* -------------------------------------------- */
+
+/*
+  When reprojection is enabled (press `R`) and Filament couldn't
+  render a frame (`beginFrame()` returned false) or took longer
+  than `reproject_deadline_ms`, we reproject the last frame that
+  Filament completed to the most recent camera pose while
+  compositing. This keeps the perceived latency and judder low
+  during heavy frames.
+*/
+bool reproject_enabled = false;
+double reproject_deadline_ms = 12.0;
+
+/* -------------------------------------------- */
+
 static const std::string VS = R"(#version 430
   out vec2 v_uv;
   void main() {
@@ -128,14 +277,51 @@ static const std::string VS = R"(#version 430
   }
 )";
 
+/*
+  When `u_reproject` is 1 we don't show Filament's last frame as
+  is but reproject it to the current camera. For every pixel we
+  take the depth that Filament wrote at the same position, turn
+  it into a world position using the current camera and project
+  that position with the camera of the frame that Filament
+  rendered. This is an approximation (the depth belongs to the
+  previous frame) which works well for the small camera changes
+  between two frames.
+
+  Filament converts the GL clip space depth to an inverted [0,1]
+  range (1 = near plane) in its vertex shaders. When the driver
+  supports `glClipControl()` (GL 4.5 or `GL_ARB_clip_control`)
+  Filament enables the [0,1] clip depth and the depth buffer
+  stores this value directly; otherwise it has been remapped by
+  the regular [-1,1] to [0,1] depth range transform. Clip
+  control is state of Filament's context, so we can't query it;
+  we check the same driver support as Filament when we create
+  the composite shader and set `u_depth_zero_to_one` from that.
+*/
+
 static const std::string FS = R"(#version 430
   layout (location = 0) uniform sampler2D u_tex;
+  layout (location = 1) uniform sampler2D u_depth;
+  layout (location = 2) uniform int u_reproject;
+  layout (location = 3) uniform mat4 u_curr_inv_view_proj;
+  layout (location = 4) uniform mat4 u_prev_view_proj;
+  layout (location = 5) uniform int u_depth_zero_to_one;
   layout (location = 0) out vec4 fragcolor;
   in vec2 v_uv;
  
   void main() { 
     fragcolor = vec4(1.0, 0.14, 0.0, 1.0);
-    fragcolor.rgb = texture(u_tex, v_uv).rgb;
+
+    vec2 uv = v_uv;
+    
+    if (1 == u_reproject) {
+      float depth = texture(u_depth, v_uv).r;
+      float z_ndc = (1 == u_depth_zero_to_one) ? (1.0 - 2.0 * depth) : (3.0 - 4.0 * depth);
+      vec4 world = u_curr_inv_view_proj * vec4(v_uv * 2.0 - 1.0, z_ndc, 1.0);
+      vec4 prev_clip = u_prev_view_proj * vec4(world.xyz / world.w, 1.0);
+      uv = clamp((prev_clip.xy / prev_clip.w) * 0.5 + 0.5, vec2(0.0), vec2(1.0));
+    }
+    
+    fragcolor.rgb = texture(u_tex, uv).rgb;
   }
 )";
 
@@ -143,13 +329,178 @@ static const std::string FS = R"(#version 430
 
 int main(int argc, char* argv[]) {
 
+  poly::trace_set_thread_name("main");
+
+  for (int i = 1; i < argc; ++i) {
+    if (0 == strcmp(argv[i], "--bench")) {
+      bench_enabled = true;
+    }
+    else if (0 == strncmp(argv[i], "--frames=", 9)) {
+      bench_num_frames = (uint32_t)atoi(argv[i] + 9);
+    }
+    else if (0 == strncmp(argv[i], "--warmup=", 9)) {
+      bench_num_warmup = (uint32_t)atoi(argv[i] + 9);
+    }
+    else if (0 == strncmp(argv[i], "--output=", 9)) {
+      bench_output = argv[i] + 9;
+    }
+    else if (0 == strncmp(argv[i], "--instances=", 12)) {
+      stress_num_instances = (uint32_t)atoi(argv[i] + 12);
+    }
+    else if (0 == strncmp(argv[i], "--lods=", 7)) {
+      stress_num_lods = (uint32_t)atoi(argv[i] + 7);
+    }
+    else if (0 == strcmp(argv[i], "--scalar-transforms")) {
+      stress_batched = false;
+    }
+    else if (0 == strcmp(argv[i], "--optimize-meshes")) {
+      mesh_optimize = true;
+    }
+    else if (0 == strcmp(argv[i], "--compress-meshes")) {
+      mesh_optimize = true;
+      mesh_optimize_flags |= MESH_OPTIMIZE_COMPRESS;
+    }
+    else if (0 == strcmp(argv[i], "--quantize-meshes")) {
+      mesh_optimize = true;
+      mesh_optimize_flags |= MESH_OPTIMIZE_QUANTIZE;
+    }
+    else if (0 == strncmp(argv[i], "--gltf=", 7)) {
+      for (const char* s = argv[i] + 7; 0 != *s; ) {
+        const char* end = strchr(s, ',');
+        if (nullptr == end) {
+          gltf_paths.push_back(s);
+          break;
+        }
+        gltf_paths.push_back(std::string(s, end - s));
+        s = end + 1;
+      }
+    }
+    else if (0 == strncmp(argv[i], "--startup-output=", 17)) {
+      startup_output = argv[i] + 17;
+    }
+    else if (0 == strcmp(argv[i], "--no-prewarm")) {
+      prewarm_enabled = false;
+    }
+    else if (0 == strncmp(argv[i], "--shader-cache=", 15)) {
+      shader_cache_dir = argv[i] + 15;
+    }
+    else if (0 == strncmp(argv[i], "--archive=", 10)) {
+      archive_path = argv[i] + 10;
+    }
+    else {
+      printf("Usage: %s [--bench] [--frames=1000] [--warmup=100] [--output=bench.json] [--instances=10000] [--lods=4] [--scalar-transforms] [--optimize-meshes] [--compress-meshes | --quantize-meshes] [--gltf=scene.gltf,other.glb] [--startup-output=startup.json] [--no-prewarm] [--shader-cache=./] [--archive=assets.pack]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (true == bench_enabled
+      && 0 == bench_num_frames)
+    {
+      printf("Error: the number of benchmark frames must be > 0.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  if (true == bench_enabled
+      && true == bench_output.empty())
+    {
+      printf("Error: `--bench` needs `--output=bench.json`; stdout is used for the logs.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  if (0 != (mesh_optimize_flags & MESH_OPTIMIZE_COMPRESS)
+      && 0 != (mesh_optimize_flags & MESH_OPTIMIZE_QUANTIZE))
+    {
+      printf("Error: `--compress-meshes` and `--quantize-meshes` can't be combined.\n");
+      exit(EXIT_FAILURE);
+    }
+  
+  /*
+    The startup is a small dependency graph. `Engine::create()`
+    only needs the handle of our GL context, so we create the
+    engine on its own thread as soon as we have the window, while
+    the main thread loads GL and compiles the shader that we use
+    to composite. Our context must not be current while Filament
+    creates its shared context, so the main thread does that on
+    a hidden startup context which shares with ours. The mesh
+    files are read into the page cache on another thread, so the
+    loaders don't have to wait for the disk. Then we create the
+    Filament objects on the main thread.
+
+      glfwInit > window +-- Engine::create (engine) --+-- swapchain, renderer, scene, view
+                        +-- gladLoadGL > host shader  |
+                                              |       +-- mesh load (loader)
+                                              |       +-- material prewarm > first beginFrame
+                                              +---------- first glfwSwapBuffers
+      mesh read (prefetch)
+
+    After the first frame was presented we print the timeline
+    with the critical path, which ends at the first
+    `glfwSwapBuffers()`: our time to first frame. Pass
+    `--startup-output=startup.json` to save it as JSON, so it
+    can be compared across releases.
+  */
+  poly::StartupTimeline startup;
+  int startup_read = startup.add_task("mesh read", "prefetch");
+  int startup_glfw = startup.add_task("glfwInit", "main");
+  int startup_window = startup.add_task("window", "main", { startup_glfw });
+  int startup_engine = startup.add_task("Engine::create", "engine", { startup_window });
+  int startup_glad = startup.add_task("gladLoadGL", "main", { startup_window });
+  int startup_shader = startup.add_task("host shader", "main", { startup_glad });
+  int startup_swap_chain = startup.add_task("swapchain", "main", { startup_engine });
+  int startup_renderer = startup.add_task("renderer", "main", { startup_engine });
+  int startup_scene = startup.add_task("scene", "main", { startup_engine });
+  int startup_view = startup.add_task("view", "main", { startup_engine });
+  int startup_mesh = startup.add_task("mesh load", "loader", { startup_scene });
+  int startup_prewarm = startup.add_task("material prewarm", "main", { startup_swap_chain, startup_renderer, startup_view });
+  int startup_begin_frame = startup.add_task("first beginFrame", "main", { startup_swap_chain, startup_renderer, startup_view, startup_prewarm });
+  int startup_present = startup.add_task("first glfwSwapBuffers", "main", { startup_begin_frame, startup_shader });
+  bool startup_reported = false;
+  std::vector<std::string> prefetch_paths = gltf_paths;
+  utils::Path mesh_path("./monkey.filamesh");
+
+  if (true == gltf_paths.empty()
+      && false == archive_path.empty())
+    {
+      prefetch_paths.push_back(archive_path);
+    }
+  else if (true == gltf_paths.empty()) {
+    prefetch_paths.push_back((true == mesh_optimize) ? poly::mesh_get_optimized_filepath(mesh_path.getPath(), mesh_optimize_flags) : mesh_path.getPath());
+  }
+
+  std::thread prefetch_thread([&startup, startup_read, &prefetch_paths]() {
+    poly::trace_set_thread_name("prefetch");
+    startup.begin(startup_read);
+    prefetch_files(prefetch_paths);
+    startup.end(startup_read);
+  });
+
+  std::thread engine_thread;
+
+  /* The startup threads must be joined before we exit. */
+  auto exit_startup = [&prefetch_thread, &engine_thread]() {
+
+    if (true == engine_thread.joinable()) {
+      engine_thread.join();
+    }
+
+    prefetch_thread.join();
+    exit(EXIT_FAILURE);
+  };
+
+  /* -------------------------------------------- */
+
+  startup.begin(startup_glfw);
+
   glfwSetErrorCallback(error_callback);
   
   if(!glfwInit()) {
     printf("Error: cannot setup glfw.\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
 
+  startup.end(startup_glfw);
+  startup.begin(startup_window);
+
   glfwWindowHint(GLFW_SAMPLES, 0);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
@@ -158,6 +509,10 @@ int main(int argc, char* argv[]) {
   glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
   glfwWindowHint(GLFW_DECORATED, GL_FALSE);
 
+  if (true == bench_enabled) {
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  }
+
 #if !USE_GL
   printf("Not using a GL context.\n");
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -168,7 +523,7 @@ int main(int argc, char* argv[]) {
   win = glfwCreateWindow(win_w, win_h, "Filament Shared OpenGL Context", NULL, NULL);
   if(!win) {
     glfwTerminate();
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
 
   glfwSetFramebufferSizeCallback(win, resize_callback);
@@ -178,28 +533,6 @@ int main(int argc, char* argv[]) {
   glfwSetMouseButtonCallback(win, button_callback);
   glfwSetScrollCallback(win, scroll_callback);
 
-#if USE_GL
-  glfwMakeContextCurrent(win);
-  glfwSwapInterval(1);
-
-  if (!gladLoadGL()) {
-    printf("Cannot load GL.\n");
-    exit(1);
-  }
-#endif
-  
-  /* -------------------------------------------- */
-
-#if USE_GL
-  glEnable(GL_TEXTURE_2D);
-  glDisable(GL_DEPTH_TEST);
-  glDisable(GL_DITHER);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-#endif  
-
-  /* -------------------------------------------- */
-
   void* main_opengl_context = nullptr;
   void* native_window = nullptr;
 
@@ -214,12 +547,25 @@ int main(int argc, char* argv[]) {
 #if USE_GL
   if (nullptr == main_opengl_context) {
     printf("Failed to get main opengl context. (exiting)\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
 
-  glfwMakeContextCurrent(nullptr);
+  /* The hidden context on which we load GL and compile the composite shader while the engine is created. */
+  GLFWwindow* startup_win = NULL;
+
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  startup_win = glfwCreateWindow(1, 1, "Startup", NULL, win);
+
+  if (NULL == startup_win) {
+    printf("Failed to create the startup context. (exiting)\n");
+    exit_startup();
+  }
 #endif  
 
+  startup.end(startup_window);
+
+  /* -------------------------------------------- */
+
   /* 
      Our first step is to create the engine itself, which we use
      in the next couple of lines to create the other base types
@@ -227,17 +573,164 @@ int main(int argc, char* argv[]) {
      create a engine that uses OpenGL as it's backend. This will
      create the correct backend instance e.g. PlatformGLX,
      PlatformCocoaGL, PlatformWGL.
+
+     We create it on another thread. Filament creates its own
+     context which shares with ours on its driver thread; like
+     the README says, our context must not be current anywhere
+     while it does that, so in the meantime the main thread uses
+     the startup context. The engine adopts the thread that
+     creates it as the main thread of its `JobSystem`; we hand
+     that over to our main thread with `emancipate()` and
+     `adopt()`, which is what `Engine::createAsync()` does in
+     newer versions of Filament.
    */
-  filament::Engine* fila_engine = filament::Engine::create(
-    filament::backend::Backend::OPENGL,
-    nullptr,
-    main_opengl_context
-  );
+  filament::Engine* fila_engine = nullptr;
+  poly::AssetArchive archive;
+
+  engine_thread = std::thread([&startup, startup_engine, &fila_engine, main_opengl_context]() {
+
+    poly::trace_set_thread_name("engine");
+    startup.begin(startup_engine);
+
+    {
+      POLY_TRACE_SCOPE("Engine::create");
+    
+      fila_engine = filament::Engine::create(
+        filament::backend::Backend::OPENGL,
+        nullptr,
+        main_opengl_context
+      );
+    }
+
+    if (nullptr != fila_engine) {
+      fila_engine->getJobSystem().emancipate();
+    }
+
+    startup.end(startup_engine);
+  });
+
+  /* -------------------------------------------- */
+
+  startup.begin(startup_glad);
+
+#if USE_GL
+  glfwMakeContextCurrent(startup_win);
+
+  if (!gladLoadGL()) {
+    printf("Cannot load GL.\n");
+    exit_startup();
+  }
+#endif
+
+  startup.end(startup_glad);
+  startup.begin(startup_shader);
+
+#if USE_GL
+
+  /* -------------------------------------------- */
+
+  /* 
+     Create the shader and the necessary GL objects that we use
+     to render the result of what Filament renders into the
+     framebuffer. The shader manager loads the program from its
+     binary cache when the sources and the driver didn't change
+     and otherwise compiles it; with parallel shader compiling
+     the driver does that on its own threads while we create the
+     other GL objects. Programs and samplers are shared with our
+     main context; the vertex array and the GL state are not, so
+     we create those once the main context is current.
+   */
+  poly::ShaderManager shader_manager;
+  poly::ShaderProgram* composite_program = nullptr;
+  uint32_t vao = 0;
+  uint32_t prog = 0;
+
+  if (0 != shader_manager.init(shader_cache_dir)) {
+    exit_startup();
+  }
+
+  composite_program = shader_manager.add("composite", VS, FS);
+  if (nullptr == composite_program) {
+    exit_startup();
+  }
+
+  /*
+    We sample the depth texture with our own sampler object so
+    we don't depend on the texture state that Filament set and
+    never do a depth comparison.
+  */
+  uint32_t depth_sampler = 0;
+  glGenSamplers(1, &depth_sampler);
+  glSamplerParameteri(depth_sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glSamplerParameteri(depth_sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glSamplerParameteri(depth_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(depth_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(depth_sampler, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+  if (0 != shader_manager.finish()) {
+    printf("Failed to create the composite shader. (exiting)\n");
+    exit_startup();
+  }
+
+  shader_manager.print();
+  prog = composite_program->id;
+
+  /* The main context only sees the objects once the startup context finished them. */
+  glFinish();
+  glfwMakeContextCurrent(NULL);
+
+#endif /* USE_GL */
+
+  startup.end(startup_shader);
+
+  /* -------------------------------------------- */
+
+  /* The archive doesn't need GL, so we open it while the engine is created too. */
+  if (false == archive_path.empty()
+      && 0 != archive.open(archive_path))
+    {
+      exit_startup();
+    }
+
+  engine_thread.join();
   
   if (nullptr == fila_engine) {
     printf("Failled to create the filament::Engine. (exiting)\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
+  }
+
+  fila_engine->getJobSystem().adopt();
+
+  /* -------------------------------------------- */
+
+#if USE_GL
+  glfwMakeContextCurrent(win);
+  glfwDestroyWindow(startup_win);
+  startup_win = NULL;
+  glfwSwapInterval((true == bench_enabled) ? 0 : 1);
+
+  glEnable(GL_TEXTURE_2D);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_DITHER);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  glGenVertexArrays(1, &vao);
+  glUseProgram(prog);
+  glUniform1i(0, 0);
+  glUniform1i(1, 1);
+  glUniform1i(2, 0);
+
+  {
+    int depth_zero_to_one = (0 != GLAD_GL_VERSION_4_5 || 0 != GLAD_GL_ARB_clip_control) ? 1 : 0;
+    glUniform1i(5, depth_zero_to_one);
+    printf("Reprojection expects a [%s,1] clip depth.\n", (1 == depth_zero_to_one) ? "0" : "-1");
   }
+#endif
+
+  /* -------------------------------------------- */
+
+  startup.begin(startup_swap_chain);
 
   /*
     This step hides an important detail: `createSwapChain()`
@@ -255,7 +748,7 @@ int main(int argc, char* argv[]) {
   
   if (nullptr == native_window) {
     printf("Failed to get the native window. (exiting)\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
 
 #if USE_GL
@@ -281,36 +774,46 @@ int main(int argc, char* argv[]) {
   
   if (nullptr == fila_swap_chain) {
     printf("Failed to create the filament::SwapChain. (exiting)\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
+
+  startup.end(startup_swap_chain);
   
   /*
     Next we create a renderer, scene, view and a camera. These
     are the basic elements that manage the items that we want to
     render using the OpenGL context and swap chain.
    */
+  startup.begin(startup_renderer);
+
   filament::Renderer* fila_renderer = fila_engine->createRenderer();
   if (nullptr == fila_renderer) {
     printf("Failed to create the filament::Renderer. (exiting)\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
+
+  startup.end(startup_renderer);
+  startup.begin(startup_scene);
   
   filament::Scene* fila_scene = fila_engine->createScene();
   if (nullptr == fila_scene) {
     printf("Failed to create the filament::Scene. (exiting)\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
 
+  startup.end(startup_scene);
+  startup.begin(startup_view);
+
   filament::View* fila_view = fila_engine->createView();
   if (nullptr == fila_view) {
     printf("Failed to create the filament::View. (exiting)\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
 
   filament::Camera* fila_cam = fila_engine->createCamera();
   if (nullptr == fila_cam) {
     printf("Failed to create a filament::Camera. (exting)\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
   
   /* -------------------------------------------- */
@@ -331,20 +834,132 @@ int main(int argc, char* argv[]) {
     .clear = true
   });
 #endif
+
+  startup.end(startup_view);
   
   /* -------------------------------------------- */
 
+  /*
+    The mesh is mapped and parsed on a worker thread while we
+    already render a placeholder; `mesh_loader.update()` swaps in
+    the real renderable. In benchmark mode we wait for it so we
+    measure the frames of the real mesh.
+  */
   filamesh::MeshReader::MaterialRegistry material_registry;
-  filamesh::MeshReader::Mesh mesh;
-  utils::Path mesh_path("./monkey.filamesh");
-  
-  mesh = filamesh::MeshReader::loadMeshFromFile(
-    fila_engine,
-    mesh_path,
-    material_registry
-  );
+  poly::AsyncMeshLoader mesh_loader;
+  poly::MeshCache& mesh_cache = poly::MeshCache::get();
+  poly::InstancingScene stress_scene;
+  poly::GltfLoader gltf_loader;
+  filamesh::MeshReader::Mesh archive_mesh;
+  poly::MaterialPrewarmer prewarmer;
+  size_t num_prewarm_registered = 0;
+  std::vector<poly::GltfAsset*> gltf_prewarm;                /* Assets whose materials we didn't add to the prewarmer yet. */
+
+  mesh_loader.set_optimize(mesh_optimize, mesh_optimize_flags);
+  mesh_cache.set_optimize(mesh_optimize, mesh_optimize_flags & MESH_OPTIMIZE_QUANTIZE);
+  mesh_cache.set_lods(stress_num_lods);
+
+  if (0 != mesh_loader.init(fila_engine, fila_scene, &material_registry)) {
+    exit_startup();
+  }
+
+  if (0 != mesh_cache.init(fila_engine, &material_registry)) {
+    exit_startup();
+  }
+
+  startup.begin(startup_mesh);
+
+  if (false == gltf_paths.empty()) {
 
-  fila_scene->addEntity(mesh.renderable);
+    if (0 != gltf_loader.init(fila_engine, fila_scene)) {
+      exit_startup();
+    }
+
+    for (size_t i = 0; i < gltf_paths.size(); ++i) {
+      gltf_prewarm.push_back(gltf_loader.load(gltf_paths[i], on_gltf_loaded, nullptr));
+    }
+  }
+
+  /* The glTF files replace the monkey; the stress scene uses its own instances of it. */
+  if (0 != stress_num_instances) {
+    if (0 != stress_scene.init(fila_engine, fila_scene, &mesh_cache, mesh_path.getPath(), stress_num_instances)) {
+      exit_startup();
+    }
+  }
+  else if (false == gltf_paths.empty()) {
+    /* Loaded above. */
+  }
+  else if (false == archive_path.empty()) {
+    /* The archive was opened while the engine was created and is in the page cache already, so we load it right here. */
+    if (0 != poly::mesh_load_archive(fila_engine, archive, "monkey.filamesh", material_registry, archive_mesh)) {
+      exit_startup();
+    }
+    fila_scene->addEntity(archive_mesh.renderable);
+  }
+  else {
+    mesh_loader.load(mesh_path.getPath(), on_mesh_loaded, nullptr);
+  }
+
+  stress_scene.set_batched(stress_batched);
+
+  while (true == bench_enabled
+         && (0 != mesh_loader.get_num_pending() || 0 != gltf_loader.get_num_pending()))
+    {
+      fila_engine->flushAndWait();
+      mesh_loader.update();
+      gltf_loader.update();
+
+      /* Give the workers the core instead of spinning while they parse; this adds at most a millisecond to the startup time. */
+      if (0 != mesh_loader.get_num_pending()
+          || 0 != gltf_loader.get_num_pending())
+        {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+  if (0 == mesh_loader.get_num_pending()
+      && 0 == gltf_loader.get_num_pending())
+    {
+      startup.end(startup_mesh);
+    }
+
+  /* -------------------------------------------- */
+
+  /*
+    Our view uses the default features (post processing on) and
+    the scene has no lights, so the materials only need their
+    unlit variants without shadows. In benchmark mode the meshes
+    were loaded, so the registry also contains their materials.
+    Otherwise the loaders register them while we render; we
+    prewarm those in the frame loop.
+  */
+  poly::MaterialPrewarmFeatures prewarm_features = {};
+  prewarm_features.directional_light = false;
+  prewarm_features.shadows = false;
+  prewarm_features.post_processing = true;
+
+  if (true == prewarm_enabled) {
+
+    startup.begin(startup_prewarm);
+
+    if (0 != prewarmer.init(fila_engine)) {
+      exit_startup();
+    }
+
+    prewarmer.add(fila_engine->getDefaultMaterial()->getDefaultInstance(), "default");
+    prewarmer.add(material_registry);
+    num_prewarm_registered = material_registry.numRegistered();
+    add_gltf_materials(prewarmer, gltf_prewarm);
+
+    if (0 != prewarmer.prewarm(fila_renderer, fila_swap_chain, prewarm_features)) {
+      printf("Failed to prewarm the materials; we continue without.\n");
+      prewarm_enabled = false;
+    }
+
+    prewarmer.print();
+
+    startup.end(startup_prewarm);
+  }
   
   /* -------------------------------------------- */
 
@@ -368,20 +983,20 @@ int main(int argc, char* argv[]) {
 
   if (nullptr == tex_col) {
     printf("Failed to create our color texture for the render target. (exiting).\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
 
   filament::Texture* tex_depth = filament::Texture::Builder()
     .width(win_w)
     .height(win_h)
     .levels(1)
-    .usage(filament::Texture::Usage::DEPTH_ATTACHMENT)
+    .usage(filament::Texture::Usage::DEPTH_ATTACHMENT | filament::Texture::Usage::SAMPLEABLE)
     .format(filament::Texture::InternalFormat::DEPTH24)
     .build(*fila_engine);
 
   if (nullptr == tex_depth) {
     printf("Failed to create our depth texture for the render target. (exiting).\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
 
   filament::RenderTarget::Builder render_target_builder = filament::RenderTarget::Builder();
@@ -391,7 +1006,7 @@ int main(int argc, char* argv[]) {
   filament::RenderTarget* render_target = render_target_builder.build(*fila_engine);
   if (nullptr == render_target) {
     printf("Failed to create the render target. (exiting).\n");
-    exit(EXIT_FAILURE);
+    exit_startup();
   }
 
   fila_view->setRenderTarget(render_target);
@@ -399,82 +1014,466 @@ int main(int argc, char* argv[]) {
   uint32_t tex_col_id = 0;
   tex_col->getId(*fila_engine, (void*)&tex_col_id);
 
-  printf("Texture color id: %u.\n", tex_col_id);
+  uint32_t tex_depth_id = 0;
+  tex_depth->getId(*fila_engine, (void*)&tex_depth_id);
+
+  printf("Texture color id: %u, depth id: %u.\n", tex_col_id, tex_depth_id);
             
   /* -------------------------------------------- */
 
   /* 
-     Create the shader and the necessary GL objects that we use
-     to render the result of what Filament renders into the
-     framebuffer.
-   */
-  uint32_t vao = 0;
-  uint32_t vert = 0;
-  uint32_t frag = 0;
-  uint32_t prog = 0;
-  const char* vss = VS.c_str();
-  const char* fss = FS.c_str();
-    
-  glfwMakeContextCurrent(win);
-
-  vert = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vert, 1, &vss, nullptr);
-  glCompileShader(vert);
-  print_shader_compile_info(vert);
-
-  frag = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(frag, 1, &fss, nullptr);
-  glCompileShader(frag);
-  print_shader_compile_info(frag);
-
-  prog = glCreateProgram();
-  glAttachShader(prog, vert);
-  glAttachShader(prog, frag);
-  glLinkProgram(prog);
+     The GPU timer uses timestamp queries in our main GL
+     context. We read the results back a couple of frames later
+     so this never stalls the loop; every couple of seconds we
+     print the CPU and GPU percentiles which tells us whether a
+     frame is CPU or GPU bound.
+  */
+  poly::GpuTimer gpu_timer((true == bench_enabled) ? bench_num_frames : 512);
+  int sec_filament = gpu_timer.add_section("filament");
+  int sec_composite = gpu_timer.add_section("composite");
+  uint64_t frame_count = 0;
 
-  glGenVertexArrays(1, &vao);
+  if (0 != gpu_timer.init()) {
+    printf("Failed to initialize the GPU timer; we continue without GPU timings.\n");
+  }
   
 #endif /* USE_GL */
     
   /* -------------------------------------------- */
 
+  filament::math::mat4f rendered_view_proj;
+  bool has_rendered_frame = false;
+  
+  poly::RollingStats bench_cpu_ms(bench_num_frames);
+  poly::RollingStats bench_render_ms(bench_num_frames);
+  poly::RollingStats bench_end_frame_ms(bench_num_frames);
+  poly::RollingStats bench_triangles(bench_num_frames);
+  std::chrono::steady_clock::time_point app_start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point bench_start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point bench_end = bench_start;
+  uint32_t bench_frame = 0;
+  uint32_t bench_num_skipped = 0;
+
   while(!glfwWindowShouldClose(win)) {
 
+    POLY_TRACE_SCOPE("frame");
+
+    std::chrono::steady_clock::time_point frame_start = std::chrono::steady_clock::now();
+
+    if (true == bench_enabled
+        && bench_frame == bench_num_warmup)
+      {
+        bench_start = frame_start;
+        bench_num_skipped = 0;
+        gpu_timer.reset();
+        stress_scene.reset_stats();
+      }
+
+    mesh_loader.update();
+    gltf_loader.update(gltf_max_main_ms);
+
+    if (false == startup.is_ended(startup_mesh)
+        && 0 == mesh_loader.get_num_pending()
+        && 0 == gltf_loader.get_num_pending())
+      {
+        startup.end(startup_mesh);
+      }
+
+    /* The loaders register the materials of a mesh in `update()`; compile them before the first frame that draws them. */
+    if (true == prewarm_enabled
+        && num_prewarm_registered != material_registry.numRegistered())
+      {
+        num_prewarm_registered = material_registry.numRegistered();
+        prewarmer.add(material_registry);
+      }
+
+    if (true == prewarm_enabled) {
+      add_gltf_materials(prewarmer, gltf_prewarm);
+    }
+
+    if (true == prewarm_enabled
+        && 0 != prewarmer.get_num_pending())
+      {
+        if (0 != prewarmer.prewarm(fila_renderer, fila_swap_chain, prewarm_features)) {
+          printf("Failed to prewarm the materials; we continue without.\n");
+          prewarm_enabled = false;
+        }
+        prewarmer.print();
+      }
+
 #if USE_GL
     glfwMakeContextCurrent(win);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glViewport(0, 0, win_w, win_h);
     glClearColor(0.0f, 0.6f, 0.13f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    gpu_timer.begin_frame();
+    gpu_timer.begin(sec_filament);
 #endif    
 
-    if (true == fila_renderer->beginFrame(fila_swap_chain)) {
-      fila_renderer->render(fila_view);
-      fila_renderer->endFrame();
+    bool can_render = false;
+    std::chrono::steady_clock::time_point filament_start = std::chrono::steady_clock::now();
+    
+    {
+      POLY_TRACE_SCOPE("beginFrame");
+      
+      if (false == startup_reported) {
+        startup.begin(startup_begin_frame);
+      }
+      
+      can_render = fila_renderer->beginFrame(fila_swap_chain);
+      
+      if (false == startup_reported) {
+        startup.end(startup_begin_frame);
+      }
+    }
+    
+    if (false == can_render) {
+      bench_num_skipped++;
+    }
+
+    /*
+      The stress scene is animated before we poll for events and
+      latch the camera, so nothing runs between the latch and
+      `render()`; its lods are selected with the camera of the
+      previous frame.
+    */
+    if (true == can_render) {
+      stress_scene.update(std::chrono::duration<double>(frame_start - app_start).count());
+      stress_scene.update_lods(*fila_cam);
+    }
+
+    /*
+      We poll for events after `beginFrame()` (which may have to
+      wait for the GPU) and sample the camera pose right before
+      we render. This way the frame uses the most recent input
+      that we can possibly have. The input callbacks only push
+      into `input_queue`; `process_input()` drains it and
+      publishes the pose into `camera_slot`, which never blocks
+      either side.
+    */
+    {
+      POLY_TRACE_SCOPE("glfwPollEvents");
+      glfwPollEvents();
+    }
+
+    {
+      POLY_TRACE_SCOPE("process_input");
+      process_input(win);
+    }
+
+    input_latency.begin_frame();
+    
+    {
+      poly::CameraPose pose;
+      camera_slot.load(pose);
+      fila_cam->lookAt(
+        { pose.eye[0], pose.eye[1], pose.eye[2] },
+        { pose.target[0], pose.target[1], pose.target[2] },
+        { pose.up[0], pose.up[1], pose.up[2] }
+      );
     }
+    
+    input_latency.mark(INPUT_LATENCY_STAGE_CAMERA);
+    
+    if (true == can_render) {
+
+      /* Remember the camera of the frame in `tex_col` and `tex_depth`; we need it to reproject. */
+      rendered_view_proj = filament::math::mat4f(fila_cam->getProjectionMatrix()) * fila_cam->getViewMatrix();
+      has_rendered_frame = true;
+      
+      std::chrono::steady_clock::time_point render_start = std::chrono::steady_clock::now();
+      
+      {
+        POLY_TRACE_SCOPE("render");
+        fila_renderer->render(fila_view);
+      }
+
+      std::chrono::steady_clock::time_point end_frame_start = std::chrono::steady_clock::now();
+      
+      {
+        POLY_TRACE_SCOPE("endFrame");
+        fila_renderer->endFrame();
+      }
+
+      if (true == bench_enabled
+          && bench_frame >= bench_num_warmup)
+        {
+          bench_render_ms.add(std::chrono::duration<double, std::milli>(end_frame_start - render_start).count());
+          bench_end_frame_ms.add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - end_frame_start).count());
+          bench_triangles.add(double(stress_scene.get_num_triangles()));
+        }
+
+      input_latency.mark(INPUT_LATENCY_STAGE_SUBMIT);
+    }
+
+    std::chrono::duration<double, std::milli> filament_dt = std::chrono::steady_clock::now() - filament_start;
 
 #if USE_GL    
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, tex_col_id);
-    glUseProgram(prog);
-    glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-#endif    
+    gpu_timer.end(sec_filament);
+    gpu_timer.begin(sec_composite);
+
+    /*
+      When Filament missed the deadline, input arrived while it
+      was busy; we pick it up and reproject to this newer pose.
+      When Filament didn't render at all, the camera already
+      holds the pose that we latched for this frame.
+    */
+    bool do_reproject = false;
+    
+    if (true == reproject_enabled
+        && true == has_rendered_frame)
+      {
+        if (false == can_render) {
+          do_reproject = true;
+        }
+        else if (filament_dt.count() > reproject_deadline_ms) {
+          
+          glfwPollEvents();
+          process_input(win);
+
+          /* The reprojected frame shows this input, so it counts for this frame. */
+          input_latency.consume_late_input();
+          
+          poly::CameraPose pose;
+          camera_slot.load(pose);
+          fila_cam->lookAt(
+            { pose.eye[0], pose.eye[1], pose.eye[2] },
+            { pose.target[0], pose.target[1], pose.target[2] },
+            { pose.up[0], pose.up[1], pose.up[2] }
+          );
+
+          input_latency.mark(INPUT_LATENCY_STAGE_CAMERA);
+          do_reproject = true;
+        }
+      }
+
+    /* We show the last frame again, without the new input; the next frame that we render shows it. */
+    if (false == can_render
+        && false == do_reproject)
+      {
+        input_latency.skip_frame();
+      }
+
+    {
+      POLY_TRACE_SCOPE("composite");
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, tex_col_id);
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D, tex_depth_id);
+      glBindSampler(1, depth_sampler);
+      glUseProgram(prog);
+
+      if (true == do_reproject) {
+        filament::math::mat4f curr_view_proj = filament::math::mat4f(fila_cam->getProjectionMatrix()) * fila_cam->getViewMatrix();
+        filament::math::mat4f curr_inv_view_proj = inverse(curr_view_proj);
+        glUniformMatrix4fv(3, 1, GL_FALSE, &curr_inv_view_proj[0][0]);
+        glUniformMatrix4fv(4, 1, GL_FALSE, &rendered_view_proj[0][0]);
+      }
+      
+      glUniform1i(2, (true == do_reproject) ? 1 : 0);
+      glBindVertexArray(vao);
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
 
-#if defined(__linux)    
-    usleep(16e3);
+    input_latency.mark(INPUT_LATENCY_STAGE_COMPOSITE);
+    gpu_timer.end(sec_composite);
+    gpu_timer.end_frame();
+
+    if (false == bench_enabled
+        && 0 == (++frame_count % 300))
+      {
+        gpu_timer.print();
+      }
 #endif    
 
 #if USE_GL    
-    glfwSwapBuffers(win);
+    {
+      POLY_TRACE_SCOPE("glfwSwapBuffers");
+      
+      if (false == startup_reported) {
+        startup.begin(startup_present);
+      }
+      
+      glfwSwapBuffers(win);
+      
+      if (false == startup_reported) {
+        startup.end(startup_present);
+      }
+    }
+    
+    input_latency.mark(INPUT_LATENCY_STAGE_PRESENT);
 #endif
 
-    glfwPollEvents();
+    /* After the present, so the sleep isn't part of the input latency. */
+#if defined(__linux)    
+    if (false == bench_enabled) {
+      usleep(16e3);
+    }
+#endif    
+
+    if (false == startup_reported) {
+
+      prefetch_thread.join();
+      startup.print();
+      
+      if (false == startup_output.empty()) {
+        startup.save_json(startup_output);
+      }
+      
+      startup_reported = true;
+    }
+
+    input_latency.end_frame();
+
+    if (true == bench_enabled) {
+      
+      std::chrono::steady_clock::time_point frame_end = std::chrono::steady_clock::now();
+      std::chrono::duration<double, std::milli> frame_dt = frame_end - frame_start;
+
+      /* The clock stops at the end of the last measured frame, also when the window is closed early; the reports below aren't part of it. */
+      if (bench_frame >= bench_num_warmup) {
+        bench_cpu_ms.add(frame_dt.count());
+        bench_end = frame_end;
+      }
+
+      if (++bench_frame >= (bench_num_warmup + bench_num_frames)) {
+        break;
+      }
+    }
   }
 
   /* -------------------------------------------- */
 
+  input_latency.print();
+  mesh_loader.print();
+  mesh_cache.print();
+
+  if (false == gltf_paths.empty()) {
+    gltf_loader.print();
+  }
+  
+  printf("Input queue, merged events: %llu, dropped events: %llu\n",
+         (unsigned long long)input_queue.get_num_merged(),
+         (unsigned long long)input_queue.get_num_dropped());
+  
+  /* -------------------------------------------- */
+
+  /* 
+     Print the benchmark results as JSON. The throughput is based
+     on the wall time of the measured frames; the GPU times are
+     read back from the timestamp queries; we wait for the frames
+     that are still in flight.
+  */
+#if USE_GL
+  if (true == bench_enabled) {
+    
+    std::chrono::duration<double, std::milli> bench_dt = bench_end - bench_start;
+    poly::GpuTimerSection* gpu_frame = gpu_timer.get_section(gpu_timer.get_frame_section());
+    poly::GpuTimerSection* gpu_filament = gpu_timer.get_section(sec_filament);
+    poly::GpuTimerSection* gpu_composite = gpu_timer.get_section(sec_composite);
+    const char* gl_renderer = (const char*)glGetString(GL_RENDERER);
+    poly::MeshOptimizeResult optimize_result;
+    std::string optimized_path;
+    bool has_optimize_result = false;
+
+    gpu_timer.finish();
+
+    /* The loaders already created the optimized file; this only gets the statistics. */
+    if (true == mesh_optimize
+        && 0 == poly::mesh_get_optimized(mesh_path.getPath(), mesh_optimize_flags, optimized_path, &optimize_result))
+      {
+        poly::mesh_optimize_print(optimize_result);
+        has_optimize_result = true;
+      }
+
+    FILE* fp = fopen(bench_output.c_str(), "wb");
+    if (nullptr == fp) {
+      printf("Error: cannot open `%s` to write the benchmark results.\n", bench_output.c_str());
+    }
+    else {
+      fprintf(fp, "{\n");
+      fprintf(fp, "  \"benchmark\": \"shared-gl-context-with-fbo\",\n");
+      fprintf(fp, "  \"mesh\": ");
+      poly::json_write_string(fp, mesh_path.getPath().c_str());
+      fprintf(fp, ",\n");
+      fprintf(fp, "  \"instances\": %u,\n", stress_scene.get_num_instances());
+      fprintf(fp, "  \"lods\": %u,\n", stress_scene.get_num_lod_levels());
+      fprintf(fp, "  \"lod_switches\": %llu,\n", (unsigned long long)stress_scene.get_num_lod_switches());
+      fprintf(fp, "  \"optimized_meshes\": %s,\n", (true == mesh_optimize) ? "true" : "false");
+      fprintf(fp, "  \"quantized_meshes\": %s,\n", (0 != (mesh_optimize_flags & MESH_OPTIMIZE_QUANTIZE)) ? "true" : "false");
+      if (true == has_optimize_result) {
+        fprintf(fp, "  \"mesh_optimize\": { \"acmr_before\": %.3f, \"acmr_after\": %.3f, \"overfetch_before\": %.3f, \"overfetch_after\": %.3f, \"vertices_before\": %u, \"vertices_after\": %u, \"bytes_before\": %zu, \"bytes_after\": %zu },\n",
+                optimize_result.acmr_before,
+                optimize_result.acmr_after,
+                optimize_result.overfetch_before,
+                optimize_result.overfetch_after,
+                optimize_result.vertex_count_before,
+                optimize_result.vertex_count_after,
+                optimize_result.num_bytes_before,
+                optimize_result.num_bytes_after);
+      }
+      fprintf(fp, "  \"vertex_bytes\": %u,\n", stress_scene.get_num_vertex_bytes());
+      fprintf(fp, "  \"transforms\": \"%s\",\n", (true == stress_batched) ? poly::transform_kernel_to_string(poly::transform_get_best_kernel()) : "mat4f");
+      fprintf(fp, "  \"gl_renderer\": ");
+      poly::json_write_string(fp, (nullptr != gl_renderer) ? gl_renderer : "unknown");
+      fprintf(fp, ",\n");
+      fprintf(fp, "  \"width\": %u,\n", win_w);
+      fprintf(fp, "  \"height\": %u,\n", win_h);
+      fprintf(fp, "  \"warmup_frames\": %u,\n", bench_num_warmup);
+      fprintf(fp, "  \"frames\": %u,\n", (uint32_t)bench_cpu_ms.size());
+      fprintf(fp, "  \"skipped_frames\": %u,\n", bench_num_skipped);
+      fprintf(fp, "  \"gpu_dropped_frames\": %llu,\n", (unsigned long long)gpu_timer.get_num_dropped_frames());
+      fprintf(fp, "  \"total_ms\": %.3f,\n", bench_dt.count());
+      fprintf(fp, "  \"fps\": %.3f,\n", (bench_dt.count() > 0.0) ? (1000.0 * bench_cpu_ms.size()) / bench_dt.count() : 0.0);
+      print_stats_json(fp, "cpu_frame_ms", bench_cpu_ms, false);
+      print_stats_json(fp, "cpu_transform_ms", stress_scene.get_transform_stats(), false);
+      print_stats_json(fp, "cpu_lod_ms", stress_scene.get_lod_stats(), false);
+      print_stats_json(fp, "triangles", bench_triangles, false);
+      print_stats_json(fp, "cpu_render_ms", bench_render_ms, false);
+      print_stats_json(fp, "cpu_end_frame_ms", bench_end_frame_ms, false);
+      print_stats_json(fp, "gpu_frame_ms", gpu_frame->gpu_ms, false);
+      print_stats_json(fp, "gpu_filament_ms", gpu_filament->gpu_ms, false);
+      print_stats_json(fp, "gpu_composite_ms", gpu_composite->gpu_ms, true);
+      fprintf(fp, "}\n");
+      fclose(fp);
+
+      printf("Saved the benchmark results into `%s`.\n", bench_output.c_str());
+    }
+  }
+#endif
+
+  /* -------------------------------------------- */
+
+  stress_scene.shutdown();
+  if (true == prefetch_thread.joinable()) {
+    prefetch_thread.join();
+  }
+
+  prewarmer.shutdown();
+  mesh_cache.shutdown();
+  mesh_loader.shutdown();
+  gltf_loader.shutdown();
+
+  /* The buffers point into the archive; close it once the engine released them. */
+  if (false == archive_mesh.renderable.isNull()) {
+    fila_scene->remove(archive_mesh.renderable);
+    fila_engine->destroy(archive_mesh.renderable);
+    fila_engine->destroy(archive_mesh.vertexBuffer);
+    fila_engine->destroy(archive_mesh.indexBuffer);
+    utils::EntityManager::get().destroy(archive_mesh.renderable);
+    fila_engine->flushAndWait();
+  }
+
+  archive.close();
+
 #if USE_GL  
+  glfwMakeContextCurrent(win);
+  gpu_timer.shutdown();
+  shader_manager.shutdown();
+  glDeleteSamplers(1, &depth_sampler);
+  
   fila_engine->destroy(tex_col);
   fila_engine->destroy(tex_depth);
   fila_engine->destroy(render_target);
@@ -505,6 +1504,127 @@ int main(int argc, char* argv[]) {
 
 void key_callback(GLFWwindow* win, int key, int scancode, int action, int mods) {
 
+  poly::InputEvent ev = {};
+  ev.type = INPUT_EVENT_KEY;
+  ev.button = key;
+  ev.action = action;
+  ev.mods = mods;
+  ev.arrival_ns = poly::InputLatency::get_time_ns();
+
+  input_queue.push(ev);
+}
+
+void error_callback(int err, const char* desc) {
+  printf("GLFW error: %s (%d)\n", desc, err);
+}
+
+/* -------------------------------------------- */
+
+void resize_callback(GLFWwindow* window, int width, int height) { }
+
+void cursor_callback(GLFWwindow* win, double x, double y) {
+
+  poly::InputEvent ev = {};
+  ev.type = INPUT_EVENT_CURSOR;
+  ev.x = x;
+  ev.y = y;
+  ev.arrival_ns = poly::InputLatency::get_time_ns();
+
+  input_queue.push(ev);
+}
+
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
+
+  poly::InputEvent ev = {};
+  ev.type = INPUT_EVENT_SCROLL;
+  ev.x = xoffset;
+  ev.y = yoffset;
+  ev.arrival_ns = poly::InputLatency::get_time_ns();
+
+  input_queue.push(ev);
+}
+
+void button_callback(GLFWwindow* win, int bt, int action, int mods) {
+
+  poly::InputEvent ev = {};
+  ev.type = INPUT_EVENT_BUTTON;
+  ev.button = bt;
+  ev.action = action;
+  ev.mods = mods;
+  ev.arrival_ns = poly::InputLatency::get_time_ns();
+  glfwGetCursorPos(win, &ev.x, &ev.y);
+
+  input_queue.push(ev);
+}
+
+void char_callback(GLFWwindow* win, unsigned int key) {
+
+  poly::InputEvent ev = {};
+  ev.type = INPUT_EVENT_CHAR;
+  ev.codepoint = key;
+  ev.arrival_ns = poly::InputLatency::get_time_ns();
+
+  input_queue.push(ev);
+}
+
+/* -------------------------------------------- */
+
+/*
+  Drains the input queue once per frame. Motion and scroll events
+  have already been merged by the queue, so the work we do here
+  is bounded by the capacity of the queue, no matter how many
+  events the devices generate. The arrival time of every event
+  goes to `input_latency` here, before `begin_frame()`, so the
+  frame that applies the input measures its latency.
+*/
+static void process_input(GLFWwindow* win) {
+
+  static poly::InputEvent events[INPUT_QUEUE_CAPACITY];
+  uint32_t num_events = input_queue.drain(events, INPUT_QUEUE_CAPACITY);
+  bool is_camera_changed = false;
+
+  for (uint32_t i = 0; i < num_events; ++i) {
+
+    poly::InputEvent& ev = events[i];
+
+    /* Merged events keep the arrival time of the first one, so this is when the input really arrived. */
+    if (INPUT_EVENT_CHAR != ev.type) {
+      input_latency.on_input(ev.arrival_ns);
+    }
+
+    switch (ev.type) {
+      case INPUT_EVENT_CURSOR: {
+        is_camera_changed |= camera_controller.on_cursor(ev.x, ev.y);
+        break;
+      }
+      case INPUT_EVENT_SCROLL: {
+        is_camera_changed |= camera_controller.on_scroll(ev.y);
+        break;
+      }
+      case INPUT_EVENT_BUTTON: {
+        if (GLFW_MOUSE_BUTTON_LEFT == ev.button) {
+          camera_controller.on_button(GLFW_PRESS == ev.action, ev.x, ev.y);
+        }
+        break;
+      }
+      case INPUT_EVENT_KEY: {
+        handle_key(win, ev.button, ev.action);
+        break;
+      }
+      case INPUT_EVENT_CHAR: {
+        /* We have no text input; shortcuts are handled as key events. */
+        break;
+      }
+    }
+  }
+
+  if (true == is_camera_changed) {
+    camera_slot.store(camera_controller.get_pose());
+  }
+}
+
+static void handle_key(GLFWwindow* win, int key, int action) {
+
   if (GLFW_RELEASE == action) {
     return;
   }
@@ -514,62 +1634,128 @@ void key_callback(GLFWwindow* win, int key, int scancode, int action, int mods)
       glfwSetWindowShouldClose(win, GL_TRUE);
       break;
     }
+    case GLFW_KEY_R: {
+      reproject_enabled = !reproject_enabled;
+      printf("Reprojection: %s.\n", (true == reproject_enabled) ? "on" : "off");
+      break;
+    }
+    case GLFW_KEY_T: {
+      if (false == poly::trace_is_available()) {
+        printf("Tracing is not compiled in; build with `./release.sh profile`.\n");
+        break;
+      }
+      poly::trace_save("trace.json");
+      break;
+    }
   };
 }
 
-void error_callback(int err, const char* desc) {
-  printf("GLFW error: %s (%d)\n", desc, err);
-}
-
 /* -------------------------------------------- */
 
-void resize_callback(GLFWwindow* window, int width, int height) { }
-void cursor_callback(GLFWwindow* win, double x, double y) { }
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) { }
-void button_callback(GLFWwindow* win, int bt, int action, int mods) { }
-void char_callback(GLFWwindow* win, unsigned int key) { }
+static void print_stats_json(FILE* fp, const char* name, poly::RollingStats& stats, bool is_last) {
+  fprintf(fp, "  \"%s\": { \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f }%s\n",
+         name,
+         stats.percentile(50.0),
+         stats.percentile(95.0),
+         stats.percentile(99.0),
+         stats.max(),
+         (true == is_last) ? "" : ",");
+}
 
 /* -------------------------------------------- */
 
-/* 
-   Checks the compile info, if it didn't compile we return < 0,
-   otherwise 0
+/*
+  A glTF asset has its material instances once it's created,
+  i.e. frames before its entities are added to the scene. We add
+  them to the prewarmer and remove the asset from `assets`.
 */
-static int print_shader_compile_info(uint32_t shader) {
+static void add_gltf_materials(poly::MaterialPrewarmer& prewarmer, std::vector<poly::GltfAsset*>& assets) {
+
+  for (size_t i = 0; i < assets.size(); ) {
 
-  GLint status = 0;
-  GLint count = 0;
-  GLchar* error = NULL;
+    poly::GltfAsset* asset = assets[i];
 
-  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-  if(status) {
-    return 0;
+    if (nullptr != asset
+        && GLTF_ASSET_STATE_READING == asset->state)
+      {
+        ++i;
+        continue;
+      }
+
+    if (nullptr != asset
+        && GLTF_ASSET_STATE_FAILED != asset->state)
+      {
+        prewarmer.add(asset->asset);
+      }
+
+    assets.erase(assets.begin() + i);
   }
+}
 
-  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &count);
-  if (0 == count) {
-    return 0;
+/* -------------------------------------------- */
+
+static void on_mesh_loaded(poly::AsyncMesh* mesh, void* user) {
+
+  if (ASYNC_MESH_STATE_READY != mesh->state) {
+    printf("Error: failed to load `%s`.\n", mesh->filepath.c_str());
+    return;
   }
-    
-  error = (GLchar*) malloc(count);
-  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &count);
-  if(count <= 0) {
-    free(error);
-    error = NULL;
-    return 0;
+
+  printf("Loaded `%s` in %.3f ms (parse: %.3f ms, create: %.3f ms, upload: %.3f ms).\n",
+         mesh->filepath.c_str(),
+         mesh->total_ms,
+         mesh->parse_ms,
+         mesh->create_ms,
+         mesh->upload_ms);
+}
+
+static void on_gltf_loaded(poly::GltfAsset* asset, void* user) {
+
+  if (GLTF_ASSET_STATE_READY != asset->state) {
+    printf("Error: failed to load `%s`.\n", asset->filepath.c_str());
+    return;
   }
 
-  glGetShaderInfoLog(shader, count, NULL, error);
-    
-  printf("SHADER COMPILE ERROR\n");
-  printf("--------------------------------------------------------\n");
-  printf("%s\n", error);
-  printf("--------------------------------------------------------\n");
+  printf("Loaded `%s` in %.3f ms (read: %.3f ms, create: %.3f ms, fetch: %.3f ms, begin: %.3f ms, textures: %.3f ms, add: %.3f ms, main thread: %.3f ms).\n",
+         asset->filepath.c_str(),
+         asset->total_ms,
+         asset->read_ms,
+         asset->create_ms,
+         asset->fetch_ms,
+         asset->begin_ms,
+         asset->textures_ms,
+         asset->add_ms,
+         asset->main_ms);
+}
 
-  free(error);
-  error = NULL;
-    
-  return -1;
+/* -------------------------------------------- */
+
+/*
+  Maps every file and reads its pages, so they are in the page
+  cache when the loaders need them. Files which don't exist
+  (e.g. the optimized mesh on the first run) are skipped; the
+  loaders report those.
+*/
+static void prefetch_files(const std::vector<std::string>& filepaths) {
+
+  for (size_t i = 0; i < filepaths.size(); ++i) {
+
+    poly::MappedFile file;
+    FILE* fp = fopen(filepaths[i].c_str(), "rb");
+
+    if (nullptr == fp) {
+      continue;
+    }
+
+    fclose(fp);
+
+    if (0 != file.open(filepaths[i])) {
+      continue;
+    }
+
+    file.prefault();
+    file.close();
+  }
 }
 
 /* -------------------------------------------- */
@@ -97,6 +97,7 @@
 #include <math/mat4.h>
 #include <utils/Path.h>
 #include <utils/EntityManager.h>
+#include <poly/InputLatency.h>
 
 /* -------------------------------------------- */
 
@@ -115,6 +116,10 @@ uint32_t win_h = 720;
 
 /* -------------------------------------------- */
 
+poly::InputLatency input_latency; /* Timestamps input events and measures how long it takes before they're presented. */
+
+/* -------------------------------------------- */
+
 int main(int argc, char* argv[]) {
 
   glfwSetErrorCallback(error_callback);
@@ -331,11 +336,30 @@ int main(int argc, char* argv[]) {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 #endif    
 
+    /* 
+       This frame consumes all the input that arrived during the
+       previous `glfwPollEvents()`. Filament presents from its own
+       driver thread, so the last stage we can observe here is the
+       submit; compare it with the FBO example to see what the
+       composite and our own swap cost. Our own context (with
+       `USE_GL`) doesn't show Filament's image, so its swap isn't
+       a present stage. When Filament skips the frame its input
+       counts for the next one.
+    */
+    input_latency.begin_frame();
+    input_latency.mark(INPUT_LATENCY_STAGE_CAMERA);
+    
     if (true == fila_renderer->beginFrame(fila_swap_chain)) {
       fila_renderer->render(fila_view);
       fila_renderer->endFrame();
+      input_latency.mark(INPUT_LATENCY_STAGE_SUBMIT);
+    }
+    else {
+      input_latency.skip_frame();
     }
 
+    input_latency.end_frame();
+
 #if defined(__linux)    
     usleep(16e3);
 #endif    
@@ -343,12 +367,16 @@ int main(int argc, char* argv[]) {
 #if USE_GL    
     glfwSwapBuffers(win);
 #endif
-
+    
     glfwPollEvents();
   }
 
   /* -------------------------------------------- */
 
+  input_latency.print();
+  
+  /* -------------------------------------------- */
+
   fila_engine->destroy(fila_view);
   fila_engine->destroy(fila_scene);
   fila_engine->destroy(fila_renderer);
@@ -374,6 +402,8 @@ int main(int argc, char* argv[]) {
 
 void key_callback(GLFWwindow* win, int key, int scancode, int action, int mods) {
 
+  input_latency.on_input();
+  
   if (GLFW_RELEASE == action) {
     return;
   }
@@ -393,9 +423,19 @@ void error_callback(int err, const char* desc) {
 /* -------------------------------------------- */
 
 void resize_callback(GLFWwindow* window, int width, int height) { }
-void cursor_callback(GLFWwindow* win, double x, double y) { }
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) { }
-void button_callback(GLFWwindow* win, int bt, int action, int mods) { }
+
+void cursor_callback(GLFWwindow* win, double x, double y) {
+  input_latency.on_input();
+}
+
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
+  input_latency.on_input();
+}
+
+void button_callback(GLFWwindow* win, int bt, int action, int mods) {
+  input_latency.on_input();
+}
+
 void char_callback(GLFWwindow* win, unsigned int key) { }
 
 /* -------------------------------------------- */
@@ -0,0 +1,320 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  TRANSFORM BENCHMARK
+  ===================
+
+  GENERAL INFO:
+
+    Compares the scalar transform update, which composes a
+    `mat4f` per entity as translation * rotation * scale and
+    calls `TransformManager::setTransform()` for each of them,
+    with the batched update of `poly/TransformBatch.h`, for every
+    kernel this CPU supports. We create N entities with a
+    transform component, give them random positions, rotations
+    and scales and update all of them `--iterations` times.
+
+    For the batched paths we report the time to compose the
+    matrices and the time to commit them (one transaction)
+    separately; `total_ms` is the sum of both. We also compare
+    the matrices of every kernel with the scalar ones and print
+    the largest difference; when it's larger than `MAX_ERROR` we
+    exit with a non-zero status, so this doubles as a test of the
+    kernels.
+
+    The engine uses the NOOP backend; we only measure the CPU.
+
+  USAGE:
+
+    ./test-transforms --counts=10000,100000 --iterations=200 --output=transforms.json
+
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filament/Engine.h>
+#include <filament/TransformManager.h>
+#include <utils/EntityManager.h>
+#include <math/mat4.h>
+#include <math/quat.h>
+#include <poly/TransformBatch.h>
+#include <poly/Stats.h>
+#include "TestUtils.h"
+
+using namespace filament;
+using namespace filament::math;
+
+/* -------------------------------------------- */
+
+#define PATH_SCALAR -1  /* The `mat4f` composition; other paths are a `TRANSFORM_KERNEL_*`. */
+#define MAX_ERROR 1e-4f /* The largest difference with the scalar matrices we accept; the rotation and scale elements are at most 2. */
+
+/* -------------------------------------------- */
+
+struct TransformResult {
+  std::string path;
+  uint32_t count;
+  poly::RollingStats compose_ms;
+  poly::RollingStats commit_ms;
+  poly::RollingStats total_ms;
+  float max_error;                 /* Largest difference with the scalar matrices. */
+};
+
+/* -------------------------------------------- */
+
+static void fill_batch(poly::TransformBatch& batch, uint32_t count);
+static void run_path(TransformManager& tm, const std::vector<TransformManager::Instance>& instances, poly::TransformBatch& batch, int path, uint32_t num_iterations, TransformResult& result);
+static void compose_scalar(poly::TransformBatch& batch, size_t index, mat4f& result);
+static void print_results_json(FILE* fp, std::vector<TransformResult>& results);
+
+/* -------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+
+  std::vector<uint32_t> counts = { 10000, 100000 };
+  std::string output;
+  uint32_t num_iterations = 200;
+  TestArgs args(argc, argv);
+
+  args.get("--counts=", counts);
+  args.get("--iterations=", num_iterations);
+  args.get("--output=", output);
+
+  if (0 != args.check("[--counts=10000,100000] [--iterations=200] [--output=transforms.json]")) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 == num_iterations
+      || true == counts.empty())
+    {
+      printf("Error: we need at least one iteration and one count.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  /* -------------------------------------------- */
+
+  Engine* engine = Engine::create(backend::Backend::NOOP);
+  if (nullptr == engine) {
+    printf("Error: failed to create the engine.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  TransformManager& tm = engine->getTransformManager();
+  utils::EntityManager& em = utils::EntityManager::get();
+  std::vector<TransformResult> results;
+  uint32_t num_failed = 0;
+
+  printf("Best transform kernel: %s\n", poly::transform_kernel_to_string(poly::transform_get_best_kernel()));
+
+  for (size_t i = 0; i < counts.size(); ++i) {
+
+    std::vector<utils::Entity> entities(counts[i]);
+    std::vector<TransformManager::Instance> instances(counts[i]);
+    poly::TransformBatch batch;
+
+    em.create(counts[i], entities.data());
+
+    for (uint32_t j = 0; j < counts[i]; ++j) {
+      tm.create(entities[j]);
+      instances[j] = tm.getInstance(entities[j]);
+    }
+
+    fill_batch(batch, counts[i]);
+
+    for (int path = PATH_SCALAR; path <= poly::transform_get_best_kernel(); ++path) {
+
+      TransformResult res;
+      res.path = (PATH_SCALAR == path) ? "mat4f" : std::string("batch-") + poly::transform_kernel_to_string(path);
+      res.count = counts[i];
+      res.max_error = 0.0f;
+
+      run_path(tm, instances, batch, path, num_iterations, res);
+
+      printf("%-12s %7u entities: p50 %8.3f ms (compose %8.3f ms, commit %8.3f ms), max error %g\n",
+             res.path.c_str(),
+             res.count,
+             res.total_ms.percentile(50.0),
+             res.compose_ms.percentile(50.0),
+             res.commit_ms.percentile(50.0),
+             res.max_error);
+
+      if (res.max_error > MAX_ERROR) {
+        printf("Error: the matrices of %s differ %g from the scalar ones, more than %g.\n", res.path.c_str(), res.max_error, MAX_ERROR);
+        num_failed++;
+      }
+
+      results.push_back(res);
+    }
+
+    for (uint32_t j = 0; j < counts[i]; ++j) {
+      engine->destroy(entities[j]);
+    }
+
+    em.destroy(counts[i], entities.data());
+  }
+
+  /* -------------------------------------------- */
+
+  FILE* fp = test_open_output(output);
+  if (nullptr == fp) {
+    exit(EXIT_FAILURE);
+  }
+
+  print_results_json(fp, results);
+  test_close_output(fp);
+
+  Engine::destroy(&engine);
+
+  if (0 != num_failed) {
+    return EXIT_FAILURE;
+  }
+
+  return 0;
+}
+
+/* -------------------------------------------- */
+
+/* Random positions in a 100 unit cube, random unit quaternions and scales in [0.5, 2]. */
+static void fill_batch(poly::TransformBatch& batch, uint32_t count) {
+
+  poly::transform_batch_resize(batch, count);
+
+  srand(1234);
+
+  for (uint32_t i = 0; i < count; ++i) {
+
+    float q[4];
+    float len = 0.0f;
+
+    for (int j = 0; j < 4; ++j) {
+      q[j] = 2.0f * (float(rand()) / float(RAND_MAX)) - 1.0f;
+      len += q[j] * q[j];
+    }
+
+    len = (len > 1e-6f) ? sqrtf(len) : 1.0f;
+
+    batch.px[i] = 100.0f * (float(rand()) / float(RAND_MAX)) - 50.0f;
+    batch.py[i] = 100.0f * (float(rand()) / float(RAND_MAX)) - 50.0f;
+    batch.pz[i] = 100.0f * (float(rand()) / float(RAND_MAX)) - 50.0f;
+    batch.qx[i] = q[0] / len;
+    batch.qy[i] = q[1] / len;
+    batch.qz[i] = q[2] / len;
+    batch.qw[i] = q[3] / len;
+    batch.sx[i] = 0.5f + 1.5f * (float(rand()) / float(RAND_MAX));
+    batch.sy[i] = 0.5f + 1.5f * (float(rand()) / float(RAND_MAX));
+    batch.sz[i] = 0.5f + 1.5f * (float(rand()) / float(RAND_MAX));
+  }
+}
+
+/* -------------------------------------------- */
+
+static void run_path(
+  TransformManager& tm,
+  const std::vector<TransformManager::Instance>& instances,
+  poly::TransformBatch& batch,
+  int path,
+  uint32_t num_iterations,
+  TransformResult& result
+)
+{
+  std::chrono::steady_clock::time_point t0;
+  std::chrono::steady_clock::time_point t1;
+  std::chrono::steady_clock::time_point t2;
+
+  for (uint32_t i = 0; i < num_iterations; ++i) {
+
+    t0 = std::chrono::steady_clock::now();
+
+    if (PATH_SCALAR == path) {
+      for (size_t j = 0; j < batch.count; ++j) {
+        mat4f m;
+        compose_scalar(batch, j, m);
+        tm.setTransform(instances[j], m);
+      }
+      t1 = t0;
+    }
+    else {
+      poly::transform_batch_compose(batch, path);
+      t1 = std::chrono::steady_clock::now();
+      poly::transform_batch_commit(batch, tm, instances.data());
+    }
+
+    t2 = std::chrono::steady_clock::now();
+
+    result.compose_ms.add(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    result.commit_ms.add(std::chrono::duration<double, std::milli>(t2 - t1).count());
+    result.total_ms.add(std::chrono::duration<double, std::milli>(t2 - t0).count());
+  }
+
+  if (PATH_SCALAR == path) {
+    return;
+  }
+
+  for (size_t j = 0; j < batch.count; ++j) {
+    mat4f expected;
+    compose_scalar(batch, j, expected);
+    for (int c = 0; c < 4; ++c) {
+      for (int r = 0; r < 4; ++r) {
+        result.max_error = fmaxf(result.max_error, fabsf(expected[c][r] - batch.matrices[j][c][r]));
+      }
+    }
+  }
+}
+
+/* How the transforms were set before the batch existed. */
+static void compose_scalar(poly::TransformBatch& batch, size_t index, mat4f& result) {
+
+  quatf q;
+
+  /* The quaternion constructor takes (w, x, y, z), so we set the members. */
+  q.x = batch.qx[index];
+  q.y = batch.qy[index];
+  q.z = batch.qz[index];
+  q.w = batch.qw[index];
+
+  result = mat4f::translation(float3{ batch.px[index], batch.py[index], batch.pz[index] })
+    * mat4f(q)
+    * mat4f::scaling(float3{ batch.sx[index], batch.sy[index], batch.sz[index] });
+}
+
+/* -------------------------------------------- */
+
+static void print_results_json(FILE* fp, std::vector<TransformResult>& results) {
+
+  fprintf(fp, "{\n  \"results\": [\n");
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    TransformResult& res = results[i];
+    fprintf(fp, "    { \"path\": ");
+    poly::json_write_string(fp, res.path.c_str());
+    fprintf(fp, ", \"count\": %u, \"total_ms\": ", res.count);
+    test_write_stats_json(fp, res.total_ms);
+    fprintf(fp, ", \"compose_ms\": %.3f, \"commit_ms\": %.3f, \"max_error\": %g }%s\n",
+            res.compose_ms.percentile(50.0),
+            res.commit_ms.percentile(50.0),
+            res.max_error,
+            (i + 1 == results.size()) ? "" : ",");
+  }
+
+  fprintf(fp, "  ]\n}\n");
+}
+
+/* -------------------------------------------- */
@@ -0,0 +1,667 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  VULKAN GL INTEROP TEST
+  ======================
+
+  GENERAL INFO:
+
+    Checks `poly/GlExternalImage.h` end to end. Vulkan (through
+    bluevk, which Filament already links) creates an image with
+    exportable memory and two exportable semaphores, clears the
+    image to a known color, transitions it to
+    `SHADER_READ_ONLY_OPTIMAL` and signals `ready`. We export the
+    file descriptors, import them into a GL context of a hidden
+    GLFW window, wait for `ready` with `begin_read()`, read the
+    pixels back through an FBO and compare them with the clear
+    color. `end_read()` signals `done`, which Vulkan waits for
+    before we destroy the image.
+
+    Before the import we compare the UUIDs of the GL context
+    with `VkPhysicalDeviceIDProperties`; both APIs have to run on
+    the same device and driver. With Mesa you can run it without
+    a GPU:
+
+      VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json LIBGL_ALWAYS_SOFTWARE=1 ./test-vk-gl-interop
+
+    Returns non-zero when the UUIDs or the pixels don't match.
+
+  USAGE:
+
+    ./test-vk-gl-interop --device=0 --size=64
+
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <bluevk/BlueVK.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <poly/GlExternalImage.h>
+
+/* -------------------------------------------- */
+
+#define CLEAR_R 64                                /* The color Vulkan clears to, as 8 bit values. */
+#define CLEAR_G 128
+#define CLEAR_B 191
+#define CLEAR_A 255
+#define MAX_PIXEL_ERROR 1                         /* Allowed difference per channel, for the unorm conversion. */
+
+/* -------------------------------------------- */
+
+struct VkInterop {
+  VkInstance instance;
+  VkPhysicalDevice physical_device;
+  VkDevice device;
+  VkQueue queue;
+  uint32_t queue_family;
+  VkImage image;
+  VkDeviceMemory memory;
+  VkDeviceSize memory_size;
+  VkSemaphore ready;
+  VkSemaphore done;
+  VkCommandPool pool;
+  VkCommandBuffer cmd;
+  uint8_t device_uuid[VK_UUID_SIZE];
+  uint8_t driver_uuid[VK_UUID_SIZE];
+};
+
+/* -------------------------------------------- */
+
+static int vk_create(VkInterop& vk, uint32_t device_index, uint32_t size);
+static int vk_clear(VkInterop& vk);
+static int vk_export(VkInterop& vk, int& memory_fd, int& ready_fd, int& done_fd);
+static int vk_wait_done(VkInterop& vk);
+static void vk_destroy(VkInterop& vk);
+static int find_memory_type(VkInterop& vk, uint32_t type_bits, VkMemoryPropertyFlags flags);
+static int read_and_compare(poly::GlExternalImage& image, uint32_t size);
+static void error_callback(int err, const char* desc);
+
+/* -------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+
+  uint32_t device_index = 0;
+  uint32_t size = 64;
+  VkInterop vk = {};
+  int memory_fd = -1;
+  int ready_fd = -1;
+  int done_fd = -1;
+  int result = EXIT_SUCCESS;
+
+  for (int i = 1; i < argc; ++i) {
+    if (0 == strncmp(argv[i], "--device=", 9)) {
+      device_index = (uint32_t)atoi(argv[i] + 9);
+    }
+    else if (0 == strncmp(argv[i], "--size=", 7)) {
+      size = (uint32_t)atoi(argv[i] + 7);
+    }
+    else {
+      printf("Usage: %s [--device=0] [--size=64]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (0 == size) {
+    printf("Error: the size must be > 0.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* -------------------------------------------- */
+
+  if (0 != vk_create(vk, device_index, size)) {
+    vk_destroy(vk);
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 != vk_export(vk, memory_fd, ready_fd, done_fd)
+      || 0 != vk_clear(vk))
+    {
+      close(memory_fd);
+      close(ready_fd);
+      close(done_fd);
+      vk_destroy(vk);
+      exit(EXIT_FAILURE);
+    }
+
+  /* -------------------------------------------- */
+
+  glfwSetErrorCallback(error_callback);
+
+  if (!glfwInit()) {
+    printf("Error: cannot setup glfw.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+  GLFWwindow* win = glfwCreateWindow(size, size, "Vulkan GL Interop", NULL, NULL);
+  if (!win) {
+    glfwTerminate();
+    exit(EXIT_FAILURE);
+  }
+
+  glfwMakeContextCurrent(win);
+
+  if (!gladLoadGL()) {
+    printf("Cannot load GL.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* -------------------------------------------- */
+
+  uint8_t gl_device_uuid[GL_EXTERNAL_IMAGE_UUID_SIZE] = {};
+  uint8_t gl_driver_uuid[GL_EXTERNAL_IMAGE_UUID_SIZE] = {};
+  poly::GlExternalImage image;
+  poly::GlExternalImageSettings cfg;
+
+  if (0 != poly::GlExternalImage::get_uuids(gl_device_uuid, gl_driver_uuid)) {
+    result = EXIT_FAILURE;
+  }
+  else if (0 != memcmp(gl_device_uuid, vk.device_uuid, GL_EXTERNAL_IMAGE_UUID_SIZE)
+           || 0 != memcmp(gl_driver_uuid, vk.driver_uuid, GL_EXTERNAL_IMAGE_UUID_SIZE))
+    {
+      printf("Error: GL and Vulkan don't run on the same device and driver.\n");
+      result = EXIT_FAILURE;
+    }
+
+  if (EXIT_SUCCESS != result) {
+    close(memory_fd);
+    close(ready_fd);
+    close(done_fd);
+  }
+  else {
+
+    cfg.memory_fd = memory_fd;
+    cfg.memory_size = vk.memory_size;
+    cfg.memory_offset = 0;
+    cfg.is_dedicated = true;
+    cfg.width = size;
+    cfg.height = size;
+    cfg.internal_format = GL_RGBA8;
+    cfg.ready_fd = ready_fd;
+    cfg.done_fd = done_fd;
+    cfg.read_layout = GL_LAYOUT_SHADER_READ_ONLY_EXT;
+    cfg.release_layout = GL_LAYOUT_SHADER_READ_ONLY_EXT;
+
+    /* On -1, -2 and -3 the descriptors are still ours; otherwise `init()` took them. */
+    int r = image.init(cfg);
+    if (r < 0 && r >= -3) {
+      close(memory_fd);
+      close(ready_fd);
+      close(done_fd);
+    }
+
+    if (0 != r) {
+      result = EXIT_FAILURE;
+    }
+    else {
+
+      if (0 != image.begin_read()
+          || 0 != read_and_compare(image, size))
+        {
+          result = EXIT_FAILURE;
+        }
+
+      /* Always signal `done`, Vulkan may only destroy the image after our read finished. */
+      if (0 != image.end_read()
+          || 0 != vk_wait_done(vk))
+        {
+          result = EXIT_FAILURE;
+        }
+
+      image.shutdown();
+    }
+  }
+
+  glFinish();
+  glfwDestroyWindow(win);
+  glfwTerminate();
+
+  vkDeviceWaitIdle(vk.device);
+  vk_destroy(vk);
+
+  if (EXIT_SUCCESS == result) {
+    printf("GL read the %u x %u image that Vulkan cleared.\n", size, size);
+  }
+
+  return result;
+}
+
+/* -------------------------------------------- */
+
+static int vk_create(VkInterop& vk, uint32_t device_index, uint32_t size) {
+
+  std::vector<VkPhysicalDevice> physical_devices;
+  std::vector<VkQueueFamilyProperties> families;
+  uint32_t count = 0;
+  int memory_type = -1;
+
+  if (false == bluevk::initialize()) {
+    printf("Error: failed to load the Vulkan loader.\n");
+    return -1;
+  }
+
+  /* Instance; external memory and semaphores are core since 1.1. */
+  VkApplicationInfo app_info = {};
+  app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+  app_info.pApplicationName = "test-vk-gl-interop";
+  app_info.apiVersion = VK_MAKE_VERSION(1, 1, 0);
+
+  VkInstanceCreateInfo instance_info = {};
+  instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  instance_info.pApplicationInfo = &app_info;
+
+  if (VK_SUCCESS != vkCreateInstance(&instance_info, nullptr, &vk.instance)) {
+    printf("Error: failed to create the Vulkan instance.\n");
+    return -2;
+  }
+
+  bluevk::bindInstance(vk.instance);
+
+  vkEnumeratePhysicalDevices(vk.instance, &count, nullptr);
+  if (device_index >= count) {
+    printf("Error: there is no Vulkan device %u, we found %u.\n", device_index, count);
+    return -3;
+  }
+
+  physical_devices.resize(count);
+  vkEnumeratePhysicalDevices(vk.instance, &count, physical_devices.data());
+  vk.physical_device = physical_devices[device_index];
+
+  /* The UUIDs that we compare with the ones of the GL context. */
+  VkPhysicalDeviceIDProperties id_props = {};
+  id_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 props = {};
+  props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  props.pNext = &id_props;
+
+  vkGetPhysicalDeviceProperties2(vk.physical_device, &props);
+  memcpy(vk.device_uuid, id_props.deviceUUID, VK_UUID_SIZE);
+  memcpy(vk.driver_uuid, id_props.driverUUID, VK_UUID_SIZE);
+  printf("Using the Vulkan device `%s`.\n", props.properties.deviceName);
+
+  /* A queue that can clear color images. */
+  vkGetPhysicalDeviceQueueFamilyProperties(vk.physical_device, &count, nullptr);
+  families.resize(count);
+  vkGetPhysicalDeviceQueueFamilyProperties(vk.physical_device, &count, families.data());
+
+  vk.queue_family = count;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (0 != (families[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      vk.queue_family = i;
+      break;
+    }
+  }
+
+  if (count == vk.queue_family) {
+    printf("Error: the Vulkan device has no graphics or compute queue.\n");
+    return -4;
+  }
+
+  const char* extensions[] = {
+    VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+    VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME
+  };
+
+  float priority = 1.0f;
+  VkDeviceQueueCreateInfo queue_info = {};
+  queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+  queue_info.queueFamilyIndex = vk.queue_family;
+  queue_info.queueCount = 1;
+  queue_info.pQueuePriorities = &priority;
+
+  VkDeviceCreateInfo device_info = {};
+  device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  device_info.queueCreateInfoCount = 1;
+  device_info.pQueueCreateInfos = &queue_info;
+  device_info.enabledExtensionCount = 2;
+  device_info.ppEnabledExtensionNames = extensions;
+
+  if (VK_SUCCESS != vkCreateDevice(vk.physical_device, &device_info, nullptr, &vk.device)) {
+    printf("Error: failed to create the Vulkan device; it needs %s and %s.\n", extensions[0], extensions[1]);
+    return -5;
+  }
+
+  vkGetDeviceQueue(vk.device, vk.queue_family, 0, &vk.queue);
+
+  /* The image, with memory that we can export. */
+  VkExternalMemoryImageCreateInfo external_image_info = {};
+  external_image_info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO;
+  external_image_info.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+  VkImageCreateInfo image_info = {};
+  image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_info.pNext = &external_image_info;
+  image_info.imageType = VK_IMAGE_TYPE_2D;
+  image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+  image_info.extent = { size, size, 1 };
+  image_info.mipLevels = 1;
+  image_info.arrayLayers = 1;
+  image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  if (VK_SUCCESS != vkCreateImage(vk.device, &image_info, nullptr, &vk.image)) {
+    printf("Error: failed to create an exportable image of %u x %u.\n", size, size);
+    return -6;
+  }
+
+  VkMemoryRequirements requirements = {};
+  vkGetImageMemoryRequirements(vk.device, vk.image, &requirements);
+
+  memory_type = find_memory_type(vk, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (memory_type < 0) {
+    printf("Error: no device local memory type for the image.\n");
+    return -7;
+  }
+
+  VkMemoryDedicatedAllocateInfo dedicated_info = {};
+  dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+  dedicated_info.image = vk.image;
+
+  VkExportMemoryAllocateInfo export_info = {};
+  export_info.sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO;
+  export_info.pNext = &dedicated_info;
+  export_info.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+  VkMemoryAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.pNext = &export_info;
+  alloc_info.allocationSize = requirements.size;
+  alloc_info.memoryTypeIndex = uint32_t(memory_type);
+
+  if (VK_SUCCESS != vkAllocateMemory(vk.device, &alloc_info, nullptr, &vk.memory)
+      || VK_SUCCESS != vkBindImageMemory(vk.device, vk.image, vk.memory, 0))
+    {
+      printf("Error: failed to allocate the exportable memory of the image.\n");
+      return -8;
+    }
+
+  vk.memory_size = requirements.size;
+
+  /* The semaphores. */
+  VkExportSemaphoreCreateInfo export_semaphore_info = {};
+  export_semaphore_info.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO;
+  export_semaphore_info.handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+  VkSemaphoreCreateInfo semaphore_info = {};
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphore_info.pNext = &export_semaphore_info;
+
+  if (VK_SUCCESS != vkCreateSemaphore(vk.device, &semaphore_info, nullptr, &vk.ready)
+      || VK_SUCCESS != vkCreateSemaphore(vk.device, &semaphore_info, nullptr, &vk.done))
+    {
+      printf("Error: failed to create the exportable semaphores.\n");
+      return -9;
+    }
+
+  /* The command buffer. */
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.queueFamilyIndex = vk.queue_family;
+
+  if (VK_SUCCESS != vkCreateCommandPool(vk.device, &pool_info, nullptr, &vk.pool)) {
+    printf("Error: failed to create the command pool.\n");
+    return -10;
+  }
+
+  VkCommandBufferAllocateInfo cmd_info = {};
+  cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmd_info.commandPool = vk.pool;
+  cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmd_info.commandBufferCount = 1;
+
+  if (VK_SUCCESS != vkAllocateCommandBuffers(vk.device, &cmd_info, &vk.cmd)) {
+    printf("Error: failed to allocate the command buffer.\n");
+    return -11;
+  }
+
+  return 0;
+}
+
+/* Clears the image, hands it to GL in `SHADER_READ_ONLY_OPTIMAL` and signals `ready`. */
+static int vk_clear(VkInterop& vk) {
+
+  VkImageSubresourceRange range = {};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.levelCount = 1;
+  range.layerCount = 1;
+
+  VkClearColorValue color = {};
+  color.float32[0] = CLEAR_R / 255.0f;
+  color.float32[1] = CLEAR_G / 255.0f;
+  color.float32[2] = CLEAR_B / 255.0f;
+  color.float32[3] = CLEAR_A / 255.0f;
+
+  VkImageMemoryBarrier to_transfer = {};
+  to_transfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  to_transfer.srcAccessMask = 0;
+  to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  to_transfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  to_transfer.image = vk.image;
+  to_transfer.subresourceRange = range;
+
+  /* Releases the image to GL, which is an external queue. */
+  VkImageMemoryBarrier to_external = to_transfer;
+  to_external.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  to_external.dstAccessMask = 0;
+  to_external.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  to_external.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  to_external.srcQueueFamilyIndex = vk.queue_family;
+  to_external.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(vk.cmd, &begin_info);
+  vkCmdPipelineBarrier(vk.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+  vkCmdClearColorImage(vk.cmd, vk.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &color, 1, &range);
+  vkCmdPipelineBarrier(vk.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_external);
+
+  if (VK_SUCCESS != vkEndCommandBuffer(vk.cmd)) {
+    printf("Error: failed to record the clear.\n");
+    return -1;
+  }
+
+  VkSubmitInfo submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &vk.cmd;
+  submit_info.signalSemaphoreCount = 1;
+  submit_info.pSignalSemaphores = &vk.ready;
+
+  if (VK_SUCCESS != vkQueueSubmit(vk.queue, 1, &submit_info, VK_NULL_HANDLE)) {
+    printf("Error: failed to submit the clear.\n");
+    return -2;
+  }
+
+  return 0;
+}
+
+/* The descriptors are ours until we pass them to `GlExternalImage::init()`. */
+static int vk_export(VkInterop& vk, int& memory_fd, int& ready_fd, int& done_fd) {
+
+  VkMemoryGetFdInfoKHR memory_info = {};
+  memory_info.sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR;
+  memory_info.memory = vk.memory;
+  memory_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+  if (VK_SUCCESS != vkGetMemoryFdKHR(vk.device, &memory_info, &memory_fd)) {
+    printf("Error: failed to export the memory of the image.\n");
+    return -1;
+  }
+
+  VkSemaphoreGetFdInfoKHR semaphore_info = {};
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR;
+  semaphore_info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+  semaphore_info.semaphore = vk.ready;
+  if (VK_SUCCESS != vkGetSemaphoreFdKHR(vk.device, &semaphore_info, &ready_fd)) {
+    printf("Error: failed to export the ready semaphore.\n");
+    return -2;
+  }
+
+  semaphore_info.semaphore = vk.done;
+  if (VK_SUCCESS != vkGetSemaphoreFdKHR(vk.device, &semaphore_info, &done_fd)) {
+    printf("Error: failed to export the done semaphore.\n");
+    return -3;
+  }
+
+  return 0;
+}
+
+/* Makes the queue wait for `done`, which GL signals in `end_read()`. */
+static int vk_wait_done(VkInterop& vk) {
+
+  VkPipelineStageFlags stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+  VkSubmitInfo submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.waitSemaphoreCount = 1;
+  submit_info.pWaitSemaphores = &vk.done;
+  submit_info.pWaitDstStageMask = &stage;
+
+  if (VK_SUCCESS != vkQueueSubmit(vk.queue, 1, &submit_info, VK_NULL_HANDLE)
+      || VK_SUCCESS != vkQueueWaitIdle(vk.queue))
+    {
+      printf("Error: failed to wait for the done semaphore.\n");
+      return -1;
+    }
+
+  return 0;
+}
+
+static void vk_destroy(VkInterop& vk) {
+
+  if (VK_NULL_HANDLE != vk.device) {
+
+    if (VK_NULL_HANDLE != vk.pool) {
+      vkDestroyCommandPool(vk.device, vk.pool, nullptr);
+    }
+
+    if (VK_NULL_HANDLE != vk.ready) {
+      vkDestroySemaphore(vk.device, vk.ready, nullptr);
+    }
+
+    if (VK_NULL_HANDLE != vk.done) {
+      vkDestroySemaphore(vk.device, vk.done, nullptr);
+    }
+
+    if (VK_NULL_HANDLE != vk.image) {
+      vkDestroyImage(vk.device, vk.image, nullptr);
+    }
+
+    if (VK_NULL_HANDLE != vk.memory) {
+      vkFreeMemory(vk.device, vk.memory, nullptr);
+    }
+
+    vkDestroyDevice(vk.device, nullptr);
+  }
+
+  if (VK_NULL_HANDLE != vk.instance) {
+    vkDestroyInstance(vk.instance, nullptr);
+  }
+
+  vk = {};
+}
+
+static int find_memory_type(VkInterop& vk, uint32_t type_bits, VkMemoryPropertyFlags flags) {
+
+  VkPhysicalDeviceMemoryProperties props = {};
+  vkGetPhysicalDeviceMemoryProperties(vk.physical_device, &props);
+
+  for (uint32_t i = 0; i < props.memoryTypeCount; ++i) {
+    if (0 != (type_bits & (1u << i))
+        && flags == (props.memoryTypes[i].propertyFlags & flags))
+      {
+        return int(i);
+      }
+  }
+
+  return -1;
+}
+
+/* -------------------------------------------- */
+
+/* Reads the imported texture through an FBO and compares every pixel with the clear color. */
+static int read_and_compare(poly::GlExternalImage& image, uint32_t size) {
+
+  std::vector<uint8_t> pixels(size_t(size) * size * 4, 0);
+  const int expected[4] = { CLEAR_R, CLEAR_G, CLEAR_B, CLEAR_A };
+  uint32_t num_wrong = 0;
+  uint32_t fbo = 0;
+  GLenum status = GL_FRAMEBUFFER_COMPLETE;
+
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, image.get_texture(), 0);
+
+  status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (GL_FRAMEBUFFER_COMPLETE == status) {
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(1, &fbo);
+
+  if (GL_FRAMEBUFFER_COMPLETE != status) {
+    printf("Error: the imported texture can't be read through an FBO (0x%04x).\n", status);
+    return -1;
+  }
+
+  for (size_t i = 0; i < pixels.size(); i += 4) {
+    for (size_t j = 0; j < 4; ++j) {
+      if (abs(int(pixels[i + j]) - expected[j]) > MAX_PIXEL_ERROR) {
+        if (0 == num_wrong) {
+          printf("Error: pixel %zu is %u, %u, %u, %u; expected %d, %d, %d, %d.\n",
+                 i / 4,
+                 pixels[i + 0], pixels[i + 1], pixels[i + 2], pixels[i + 3],
+                 expected[0], expected[1], expected[2], expected[3]);
+        }
+        num_wrong++;
+        break;
+      }
+    }
+  }
+
+  if (0 != num_wrong) {
+    printf("Error: %u of %u pixels don't have the color that Vulkan cleared to.\n", num_wrong, size * size);
+    return -2;
+  }
+
+  return 0;
+}
+
+static void error_callback(int err, const char* desc) {
+  printf("GLFW error: %s (%d)\n", desc, err);
+}
+
+/* -------------------------------------------- */
@@ -0,0 +1,186 @@
+/*
+  ---------------------------------------------------------------
+
+                                                 oooo
+                                                 `888
+                  oooo d8b  .ooooo.  oooo    ooo  888  oooo  oooo
+                  `888""8P d88' `88b  `88b..8P'   888  `888  `888
+                   888     888   888    Y888'     888   888   888
+                   888     888   888  .o8"'88b    888   888   888
+                  d888b    `Y8bod8P' o88'   888o o888o  `V88V"V8P'
+
+                                                    www.roxlu.com
+                                            www.twitter.com/roxlu
+
+  ----------------------------------------------------------------
+
+  POLY PACK
+  =========
+
+  GENERAL INFO:
+
+    Packs asset files into an archive (see `poly/AssetArchive.h`)
+    or lists the entries of an archive. The files are stored in
+    the order you pass them, so pass them in the order the
+    application loads them. An entry is named after its path,
+    without the `--base` prefix when it starts with it.
+
+    With many files use `--input-list` with one path per line
+    instead of the command line.
+
+  USAGE:
+
+    ./poly-pack --output=assets.pack --base=./assets/ ./assets/monkey.filamesh ./assets/lit.filamat
+    ./poly-pack --output=assets.pack --compress --input-list=files.txt
+    ./poly-pack --list=assets.pack
+
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <poly/AssetArchive.h>
+
+/* -------------------------------------------- */
+
+static int read_input_list(const std::string& filepath, std::vector<std::string>& result);
+static int list_archive(const std::string& filepath);
+
+/* -------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+
+  std::vector<poly::AssetArchiveInput> inputs;
+  std::vector<std::string> filepaths;
+  std::string output;
+  std::string base;
+  std::string list;
+  uint32_t flags = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    if (0 == strncmp(argv[i], "--output=", 9)) {
+      output = argv[i] + 9;
+    }
+    else if (0 == strncmp(argv[i], "--base=", 7)) {
+      base = argv[i] + 7;
+    }
+    else if (0 == strncmp(argv[i], "--input-list=", 13)) {
+      if (0 != read_input_list(argv[i] + 13, filepaths)) {
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (0 == strncmp(argv[i], "--list=", 7)) {
+      list = argv[i] + 7;
+    }
+    else if (0 == strcmp(argv[i], "--compress")) {
+      flags |= ASSET_ARCHIVE_FLAG_COMPRESS;
+    }
+    else if (0 == strncmp(argv[i], "--", 2)) {
+      printf("Usage: %s --output=assets.pack [--base=./assets/] [--compress] [--input-list=files.txt] [files...]\n", argv[0]);
+      printf("       %s --list=assets.pack\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+    else {
+      filepaths.push_back(argv[i]);
+    }
+  }
+
+  if (false == list.empty()) {
+    return (0 == list_archive(list)) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (true == output.empty()
+      || true == filepaths.empty())
+    {
+      printf("Error: we need an `--output` and at least one file.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  for (size_t i = 0; i < filepaths.size(); ++i) {
+
+    poly::AssetArchiveInput input;
+    input.filepath = filepaths[i];
+    input.name = filepaths[i];
+
+    if (false == base.empty()
+        && 0 == input.name.compare(0, base.size(), base))
+      {
+        input.name = input.name.substr(base.size());
+      }
+
+    inputs.push_back(input);
+  }
+
+  if (0 != poly::asset_archive_write(output, inputs, flags)) {
+    exit(EXIT_FAILURE);
+  }
+
+  return (0 == list_archive(output)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* -------------------------------------------- */
+
+static int read_input_list(const std::string& filepath, std::vector<std::string>& result) {
+
+  FILE* fp = fopen(filepath.c_str(), "r");
+  char line[4096];
+
+  if (nullptr == fp) {
+    printf("Error: cannot open the input list `%s`.\n", filepath.c_str());
+    return -1;
+  }
+
+  while (nullptr != fgets(line, sizeof(line), fp)) {
+
+    size_t len = strlen(line);
+
+    while (len > 0
+           && ('\n' == line[len - 1] || '\r' == line[len - 1]))
+      {
+        line[--len] = '\0';
+      }
+
+    if (0 != len) {
+      result.push_back(line);
+    }
+  }
+
+  fclose(fp);
+
+  return 0;
+}
+
+static int list_archive(const std::string& filepath) {
+
+  poly::AssetArchive archive;
+  uint64_t stored = 0;
+  uint64_t original = 0;
+
+  if (0 != archive.open(filepath)) {
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < archive.get_num_entries(); ++i) {
+
+    const poly::AssetArchiveEntry* entry = archive.get_entry(i);
+
+    printf("%10llu %10llu %-8s %s\n",
+           (unsigned long long) entry->original_size,
+           (unsigned long long) entry->size,
+           (ASSET_COMPRESSION_MESHOPT == entry->compression) ? "meshopt" : "stored",
+           archive.get_name(entry));
+
+    stored += entry->size;
+    original += entry->original_size;
+  }
+
+  printf("%u entries, %.2f KB -> %.2f KB\n", archive.get_num_entries(), double(original) / 1024.0, double(stored) / 1024.0);
+
+  archive.close();
+
+  return 0;
+}
+
+/* -------------------------------------------- */